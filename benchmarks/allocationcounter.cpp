@@ -0,0 +1,47 @@
+#include "benchmarks/allocationcounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+  std::atomic<size_t> allocations(0);
+
+  void* allocate(size_t size)
+  {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+  }
+} // namespace
+
+namespace benchmarks
+{
+  size_t allocationCount() { return allocations.load(std::memory_order_relaxed); }
+} // namespace benchmarks
+
+void* operator new(size_t size)
+{
+  auto memory = allocate(size);
+  if (memory == nullptr)
+    throw std::bad_alloc();
+  return memory;
+}
+
+void* operator new[](size_t size)
+{
+  auto memory = allocate(size);
+  if (memory == nullptr)
+    throw std::bad_alloc();
+  return memory;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
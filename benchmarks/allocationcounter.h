@@ -0,0 +1,16 @@
+#ifndef BENCHMARKS_ALLOCATIONCOUNTER_H
+#define BENCHMARKS_ALLOCATIONCOUNTER_H
+
+#include <cstddef>
+
+namespace benchmarks
+{
+  /**
+   * @brief allocationCount returns the number of calls to the global operator new so far
+   * Only available in benchmarks linking allocationcounter.cpp, which replaces the global operators new and delete.
+   */
+  size_t allocationCount();
+
+} // namespace benchmarks
+
+#endif // BENCHMARKS_ALLOCATIONCOUNTER_H
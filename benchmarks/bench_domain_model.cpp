@@ -0,0 +1,157 @@
+#include "benchmarks/allocationcounter.h"
+#include "benchmarks/harness.h"
+
+#include "cli/testdata.h"
+
+#include "persistence/executor.h"
+
+#include "hotel/hotelcollection.h"
+#include "hotel/planning.h"
+
+#include "json.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Measures the operations of the planning board and the hotel collection on generated data sets of growing size, from
+ * 1000 atoms up to the given number. The results are written to stdout as JSON, with the time and the number of heap
+ * allocations per run of each operation and data set size.
+ *
+ * Usage: bench_domain_model [max atoms] [time budget per operation in ms]
+ */
+
+namespace
+{
+  using benchmarks::Clock;
+
+  class Suite
+  {
+  public:
+    explicit Suite(Clock::duration budget) : _budget(budget), _results(nlohmann::json::array()), _checksum(0) {}
+
+    //! Runs the operation at most maxRuns times, within the time budget
+    template <typename Operation>
+    void measure(const std::string& name, size_t atoms, size_t maxRuns, Operation operation)
+    {
+      Clock::duration elapsed;
+      auto allocations = benchmarks::allocationCount();
+      auto runs = benchmarks::measureRuns(_budget, maxRuns, operation, elapsed);
+      allocations = benchmarks::allocationCount() - allocations;
+      if (runs == 0)
+        return;
+
+      auto nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / runs;
+      std::cerr << name << " atoms=" << atoms << ": " << nanoseconds << " ns/op" << std::endl;
+      _results.push_back({{"operation", name},
+                          {"atoms", atoms},
+                          {"runs", runs},
+                          {"ns_per_op", nanoseconds},
+                          {"allocations_per_op", static_cast<double>(allocations) / runs}});
+    }
+
+    //! Folds a result into the checksum, such that the compiler cannot drop the operations
+    void use(size_t value) { _checksum = _checksum * 31 + value; }
+
+    nlohmann::json report() const
+    {
+      return {{"benchmark", "domain_model"}, {"checksum", _checksum}, {"results", _results}};
+    }
+
+  private:
+    Clock::duration _budget;
+    nlohmann::json _results;
+    size_t _checksum;
+  };
+
+  // Spreads the runs over the data set without the cost of a random engine
+  size_t scatter(size_t run, size_t count) { return (run * 2654435761u + 12345) % count; }
+
+  void runDataSet(Suite& suite, size_t targetAtoms, persistence::Executor& executor)
+  {
+    using namespace boost::gregorian;
+
+    // The generator books about 30 atoms per room over its horizon at the default occupancy
+    const int atomsPerRoom = 30;
+    const int maxRoomsPerHotel = 1000;
+    cli::TestDataOptions options;
+    auto rooms = std::max<int>(1, static_cast<int>(targetAtoms / atomsPerRoom));
+    options.hotels = (rooms + maxRoomsPerHotel - 1) / maxRoomsPerHotel;
+    options.roomsPerHotel = (rooms + options.hotels - 1) / options.hotels;
+    auto data = cli::createTestData(options, executor);
+
+    size_t atoms = 0;
+    for (auto& reservation : data.reservations)
+      atoms += reservation->atoms().size();
+    auto horizonDays = static_cast<size_t>(options.horizonDays);
+
+    hotel::HotelCollection hotels(std::move(data.hotels));
+    auto roomIds = hotels.allRoomIDs();
+    auto categoryIds = hotels.allCategoryIDs();
+    hotel::PlanningBoard planning;
+    for (auto id : roomIds)
+      planning.addRoomId(id);
+
+    // Every reservation but a spread out sample is added up front, the sample is used to measure the changes
+    const size_t sampleSize = 1000;
+    auto sampleStep = std::max<size_t>(1, data.reservations.size() / sampleSize);
+    std::vector<std::unique_ptr<hotel::Reservation>> sample;
+    // The reservations have the ids 1 to reservationCount, see cli::createTestData()
+    auto reservationCount = data.reservations.size();
+    for (size_t i = 0; i < data.reservations.size(); ++i)
+    {
+      if (i % sampleStep == 0 && sample.size() < sampleSize)
+        sample.push_back(std::move(data.reservations[i]));
+      else
+        planning.addReservation(std::move(data.reservations[i]));
+    }
+    data.reservations.clear();
+
+    std::vector<const hotel::Reservation*> added;
+    suite.measure("PlanningBoard::addReservation", atoms, sample.size(),
+                  [&](size_t run) { added.push_back(planning.addReservation(std::move(sample[run]))); });
+
+    const auto& board = planning;
+    auto day = [&](size_t run) { return options.firstDay + days(static_cast<long>(scatter(run, horizonDays))); };
+    auto room = [&](size_t run) { return roomIds[scatter(run, roomIds.size())]; };
+    const size_t maxRuns = 10000000;
+    suite.measure("PlanningBoard::isFree", atoms, maxRuns, [&](size_t run) {
+      suite.use(board.isFree(room(run), date_period(day(run), days(3))));
+    });
+    suite.measure("PlanningBoard::getAvailableDaysFrom", atoms, maxRuns,
+                  [&](size_t run) { suite.use(board.getAvailableDaysFrom(room(run), day(run))); });
+    suite.measure("PlanningBoard::getReservationsInPeriod", atoms, maxRuns, [&](size_t run) {
+      suite.use(board.getReservationsInPeriod(date_period(day(run), days(7))).size());
+    });
+    suite.measure("PlanningBoard::getReservationById", atoms, maxRuns, [&](size_t run) {
+      suite.use(board.getReservationById(static_cast<int>(scatter(run, reservationCount)) + 1) != nullptr);
+    });
+    suite.measure("PlanningBoard::removeReservation", atoms, added.size(),
+                  [&](size_t run) { planning.removeReservation(added[run]); });
+
+    suite.measure("HotelCollection::findRoomById", atoms, maxRuns,
+                  [&](size_t run) { suite.use(hotels.findRoomById(room(run)) != nullptr); });
+    suite.measure("HotelCollection::allRoomsByCategory", atoms, maxRuns, [&](size_t run) {
+      suite.use(hotels.allRoomsByCategory(categoryIds[scatter(run, categoryIds.size())]).size());
+    });
+    suite.measure("HotelCollection::allRoomIDs", atoms, maxRuns,
+                  [&](size_t) { suite.use(hotels.allRoomIDs().size()); });
+  }
+} // namespace
+
+int main(int argc, char** argv)
+{
+  auto maxAtoms = static_cast<size_t>(benchmarks::intArgument(argc, argv, 1, 10000000));
+  auto budget = std::chrono::milliseconds(benchmarks::intArgument(argc, argv, 2, 200));
+
+  Suite suite(budget);
+  persistence::ThreadPoolExecutor executor;
+  for (size_t atoms = 1000; atoms <= maxAtoms; atoms *= 10)
+    runDataSet(suite, atoms, executor);
+
+  std::cout << suite.report().dump(2) << std::endl;
+  return 0;
+}
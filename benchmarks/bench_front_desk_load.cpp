@@ -0,0 +1,295 @@
+#include "benchmarks/harness.h"
+#include "benchmarks/testdatabase.h"
+
+#include "persistence/datasource.h"
+#include "persistence/op/operations.h"
+
+#include "json.hpp"
+
+#include <poll.h>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Simulates front desks working concurrently on one data source. Each client thread waits for a think time drawn from
+ * an exponential distribution, then sends a request and waits for the answer. The requests are handled on the main
+ * thread, which integrates the results of the data source, just like the GUI does: availability queries are answered
+ * from the planning, bookings and cancellations are queued as optimistic operations, and loads request a month of the
+ * planning from the backend. Bookings and cancellations are answered once their results have been integrated, bookings
+ * of a room which is not free are rejected right away and counted separately.
+ *
+ * The latency of a request runs from sending it until the answer. The tool reports the throughput and the latency
+ * histogram of each kind of request, and samples of the queue depths over time: the operations waiting for the backend
+ * or for integration, and the requests waiting for the main thread. The report is written to stdout as JSON.
+ *
+ * Usage: bench_front_desk_load [clients] [seconds] [mean think time in ms] [reservations in the database]
+ *                              [availability %] [booking %] [cancellation %] [load %]
+ */
+
+namespace
+{
+  using benchmarks::Clock;
+
+  enum RequestKind
+  {
+    Availability,
+    Booking,
+    Cancellation,
+    Load
+  };
+  const size_t requestKindCount = 4;
+  const char* const requestKindNames[requestKindCount] = {"availability", "booking", "cancellation", "load"};
+
+  struct Request
+  {
+    RequestKind kind;
+    // Random numbers drawn by the client, they choose the room, the period or the reservation
+    uint32_t first;
+    uint32_t second;
+  };
+
+  /**
+   * @brief The FrontDesk class handles the requests of the clients on the thread which integrates the results
+   */
+  class FrontDesk
+  {
+  public:
+    FrontDesk(persistence::DataSource& dataSource, std::vector<int> roomIds, boost::gregorian::date firstDay,
+              int horizonDays)
+        : _dataSource(dataSource), _roomIds(std::move(roomIds)), _firstDay(firstDay), _horizonDays(horizonDays),
+          _bookedIds(), _rejectedBookings(0)
+    {
+    }
+
+    size_t rejectedBookings() const { return _rejectedBookings; }
+
+    void handle(const Request& request, std::function<void()> answer)
+    {
+      using namespace boost::gregorian;
+      auto roomId = _roomIds[request.first % _roomIds.size()];
+      auto begin = _firstDay + days(static_cast<int>(request.second % _horizonDays));
+      auto length = days(1 + static_cast<int>((request.first / _roomIds.size()) % 7));
+      auto& executor = _dataSource.integrationExecutor();
+
+      switch (request.kind)
+      {
+      case Availability:
+        _dataSource.planning().isFree(roomId, date_period(begin, length));
+        answer();
+        break;
+      case Booking:
+      {
+        if (!_dataSource.planning().isFree(roomId, date_period(begin, length)))
+        {
+          ++_rejectedBookings;
+          answer();
+          break;
+        }
+        persistence::op::Operations operations;
+        operations.push_back(persistence::op::StoreNewReservation{
+            std::make_unique<hotel::Reservation>("Walk-in", roomId, date_period(begin, length))});
+        _dataSource.assignIds(operations);
+        auto id = boost::get<persistence::op::StoreNewReservation>(operations[0]).newReservation->id();
+        if (id > 0)
+          _bookedIds.push_back(id);
+        _dataSource.queueOptimisticOperations(std::move(operations)).then(executor, [answer](auto&) { answer(); });
+        break;
+      }
+      case Cancellation:
+      {
+        // The clients cancel the bookings made during the run
+        if (_bookedIds.empty())
+        {
+          answer();
+          break;
+        }
+        auto index = request.second % _bookedIds.size();
+        auto id = _bookedIds[index];
+        _bookedIds[index] = _bookedIds.back();
+        _bookedIds.pop_back();
+        _dataSource.queueOptimisticOperation(persistence::op::DeleteReservation{id})
+            .then(executor, [answer](auto&) { answer(); });
+        break;
+      }
+      case Load:
+        _dataSource
+            .queueOperation(persistence::op::LoadPlanningWindow{date_period(begin, days(30))},
+                            persistence::op::TaskPriority::Interactive)
+            .then(executor, [answer](auto&) { answer(); });
+        break;
+      }
+    }
+
+  private:
+    persistence::DataSource& _dataSource;
+    std::vector<int> _roomIds;
+    boost::gregorian::date _firstDay;
+    int _horizonDays;
+    std::vector<int> _bookedIds;
+    size_t _rejectedBookings;
+  };
+
+  struct Options
+  {
+    int clients;
+    int seconds;
+    int thinkMilliseconds;
+    int reservations;
+    std::array<int, requestKindCount> mix;
+  };
+
+  struct SharedState
+  {
+    std::atomic<bool> stop{false};
+    std::atomic<int> activeClients{0};
+    std::atomic<int> waitingRequests{0}; // Sent to the main thread, but not handled yet
+  };
+
+  void runClient(unsigned index, const Options& options, persistence::DataSource& dataSource, FrontDesk& frontDesk,
+                 SharedState& shared, std::array<benchmarks::LatencyStatistics, requestKindCount>& latencies)
+  {
+    std::mt19937 rng(index + 1);
+    std::exponential_distribution<> thinkTime(1.0 / std::max(options.thinkMilliseconds, 1));
+    std::discrete_distribution<> mix(options.mix.begin(), options.mix.end());
+    while (!shared.stop)
+    {
+      std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(thinkTime(rng)));
+      Request request{static_cast<RequestKind>(mix(rng)), static_cast<uint32_t>(rng()), static_cast<uint32_t>(rng())};
+
+      std::mutex mutex;
+      std::condition_variable answeredCondition;
+      auto answered = false;
+      auto sent = Clock::now();
+      ++shared.waitingRequests;
+      dataSource.integrationExecutor().post([&]() {
+        --shared.waitingRequests;
+        frontDesk.handle(request, [&]() {
+          // Notified under the lock, the client destroys the condition as soon as it sees the answer
+          std::lock_guard<std::mutex> lock(mutex);
+          answered = true;
+          answeredCondition.notify_one();
+        });
+      });
+
+      std::unique_lock<std::mutex> lock(mutex);
+      answeredCondition.wait(lock, [&]() { return answered; });
+      latencies[request.kind].add(Clock::now() - sent);
+    }
+    --shared.activeClients;
+  }
+
+  nlohmann::json reportLatency(const benchmarks::LatencyStatistics& latency, double seconds)
+  {
+    auto microseconds = [](Clock::duration duration) {
+      return std::chrono::duration<double, std::micro>(duration).count();
+    };
+    auto histogram = nlohmann::json::array();
+    auto buckets = latency.histogram();
+    for (size_t i = 0; i < buckets.size(); ++i)
+      histogram.push_back({{"below_us", 1u << i}, {"count", buckets[i]}});
+
+    return {{"count", latency.count()},
+            {"per_s", latency.count() / seconds},
+            {"latency_us",
+             {{"mean", microseconds(latency.mean())},
+              {"p50", microseconds(latency.percentile(0.5))},
+              {"p99", microseconds(latency.percentile(0.99))},
+              {"p999", microseconds(latency.percentile(0.999))},
+              {"max", microseconds(latency.max())}}},
+            {"histogram", histogram}};
+  }
+} // namespace
+
+int main(int argc, char** argv)
+{
+  Options options;
+  options.clients = benchmarks::intArgument(argc, argv, 1, 8);
+  options.seconds = benchmarks::intArgument(argc, argv, 2, 10);
+  options.thinkMilliseconds = benchmarks::intArgument(argc, argv, 3, 50);
+  options.reservations = benchmarks::intArgument(argc, argv, 4, 10000);
+  options.mix = {benchmarks::intArgument(argc, argv, 5, 70), benchmarks::intArgument(argc, argv, 6, 15),
+                 benchmarks::intArgument(argc, argv, 7, 10), benchmarks::intArgument(argc, argv, 8, 5)};
+
+  const std::string path = "bench_front_desk_load.db";
+  std::remove(path.c_str());
+  std::remove((path + ".snapshot").c_str());
+  nlohmann::json report;
+  {
+    persistence::DataSource dataSource(path);
+    cli::TestDataOptions dataOptions;
+    auto roomIds = benchmarks::storeTestData(dataSource, dataOptions, options.reservations);
+    FrontDesk frontDesk(dataSource, roomIds, dataOptions.firstDay, dataOptions.horizonDays);
+
+    SharedState shared;
+    std::vector<std::array<benchmarks::LatencyStatistics, requestKindCount>> latencies(options.clients);
+    std::vector<std::thread> clients;
+    shared.activeClients = options.clients;
+    for (int i = 0; i < options.clients; ++i)
+      clients.emplace_back([&, i]() {
+        runClient(static_cast<unsigned>(i), options, dataSource, frontDesk, shared, latencies[i]);
+      });
+
+    // The main thread handles the requests and integrates the results until the clients have received their answers
+    const auto sampleInterval = std::chrono::milliseconds(100);
+    auto queueDepths = nlohmann::json::array();
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::seconds(options.seconds);
+    auto nextSample = start;
+    pollfd descriptor{dataSource.resultsAvailableFileDescriptor(), POLLIN, 0};
+    while (shared.activeClients != 0)
+    {
+      auto now = Clock::now();
+      if (now >= deadline)
+        shared.stop = true;
+      if (now >= nextSample)
+      {
+        queueDepths.push_back(
+            {{"ms", std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count()},
+             {"pending_operations", dataSource.pendingOperationsCount()},
+             {"waiting_requests", shared.waitingRequests.load()}});
+        nextSample += sampleInterval;
+      }
+      auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(nextSample - now).count();
+      ::poll(&descriptor, 1, static_cast<int>(std::max<long>(timeout, 0)));
+      dataSource.processIntegrationQueue();
+    }
+    auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (auto& client : clients)
+      client.join();
+
+    auto requests = nlohmann::json::object();
+    for (size_t kind = 0; kind < requestKindCount; ++kind)
+    {
+      benchmarks::LatencyStatistics latency;
+      for (auto& clientLatencies : latencies)
+        latency.add(clientLatencies[kind]);
+      latency.print(std::cerr, requestKindNames[kind]);
+      requests[requestKindNames[kind]] = reportLatency(latency, seconds);
+    }
+
+    report = {{"benchmark", "front_desk_load"},
+              {"clients", options.clients},
+              {"seconds", seconds},
+              {"think_ms", options.thinkMilliseconds},
+              {"reservations", options.reservations},
+              {"requests", requests},
+              {"rejected_bookings", frontDesk.rejectedBookings()},
+              {"queue_depth", queueDepths}};
+  }
+  std::remove(path.c_str());
+  std::remove((path + ".snapshot").c_str());
+
+  std::cout << report.dump(2) << std::endl;
+  return 0;
+}
@@ -0,0 +1,143 @@
+#include "benchmarks/harness.h"
+
+#include "gui/datasourcechangeintegrator.h"
+#include "gui/planningwidget.h"
+
+#include "persistence/datasource.h"
+#include "persistence/op/operations.h"
+
+#include <QApplication>
+#include <QEvent>
+#include <QTimer>
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+
+/**
+ * Measures the end-to-end latency from the commit of a new reservation in the backend until the first paint event
+ * after the reservation has been integrated into the planning board shown by a PlanningWidget.
+ *
+ * Usage: bench_gui_latency [iterations]
+ */
+
+namespace
+{
+  // Number of consecutive days on which reservations are placed in one room
+  const int daysPerRoom = 30;
+
+  class LatencyProbe : public QObject, public hotel::PlanningBoardObserver
+  {
+  public:
+    LatencyProbe(persistence::DataSource& dataSource, int iterations)
+        : _dataSource(dataSource), _iterations(iterations), _iteration(0), _roomIds(), _commitTime(0),
+          _waitingForPaint(false)
+    {
+      _dataSource.taskCompletedSignal().connect(
+          [this](int) { _commitTime = benchmarks::Clock::now().time_since_epoch().count(); });
+    }
+
+    ~LatencyProbe() { _dataSource.taskCompletedSignal().disconnect_all_slots(); }
+
+    void start(std::vector<int> roomIds)
+    {
+      _roomIds = std::move(roomIds);
+      _iterations = std::min(_iterations, static_cast<int>(_roomIds.size()) * daysPerRoom);
+      queueNextReservation();
+    }
+
+    // PlanningBoardObserver interface
+    virtual void itemsAdded(const std::vector<const hotel::Reservation*>&) override
+    {
+      if (_roomIds.empty())
+        return;
+      _integratedTime = benchmarks::Clock::now();
+      _waitingForPaint = true;
+    }
+    virtual void itemsRemoved(const std::vector<const hotel::Reservation*>&) override {}
+    virtual void allItemsRemoved() override {}
+
+  protected:
+    virtual bool eventFilter(QObject* object, QEvent* event) override
+    {
+      if (_waitingForPaint && event->type() == QEvent::Paint)
+      {
+        auto committed = benchmarks::Clock::time_point(benchmarks::Clock::duration(_commitTime.load()));
+        auto painted = benchmarks::Clock::now();
+        _waitingForPaint = false;
+        _integrationLatency.add(_integratedTime - committed);
+        _paintLatency.add(painted - committed);
+        QTimer::singleShot(0, [this]() { this->queueNextReservation(); });
+      }
+      return QObject::eventFilter(object, event);
+    }
+
+  private:
+    void queueNextReservation()
+    {
+      if (_iteration == _iterations)
+      {
+        _integrationLatency.print(std::cout, "commit -> integrated");
+        _paintLatency.print(std::cout, "commit -> painted");
+        QApplication::quit();
+        return;
+      }
+
+      // Reservations are placed next to each other after the current date, such that they are visible
+      using namespace boost::gregorian;
+      auto roomId = _roomIds[_iteration / daysPerRoom];
+      auto begin = day_clock::local_day() + days(_iteration % daysPerRoom);
+      auto reservation = std::make_unique<hotel::Reservation>("Benchmark", roomId, date_period(begin, begin + days(1)));
+      reservation->setStatus(hotel::Reservation::New);
+      ++_iteration;
+      _dataSource.queueOperation(persistence::op::StoreNewReservation{std::move(reservation)});
+    }
+
+    persistence::DataSource& _dataSource;
+    int _iterations;
+    int _iteration;
+    std::vector<int> _roomIds;
+    std::atomic<benchmarks::Clock::rep> _commitTime;
+    benchmarks::Clock::time_point _integratedTime;
+    bool _waitingForPaint;
+
+    benchmarks::LatencyStatistics _integrationLatency;
+    benchmarks::LatencyStatistics _paintLatency;
+  };
+} // namespace
+
+int main(int argc, char** argv)
+{
+  QApplication app(argc, argv);
+  auto iterations = benchmarks::intArgument(argc, argv, 1, 200);
+
+  persistence::DataSource dataSource("benchmark.db");
+  dataSource.queueOperation(persistence::op::EraseAllData());
+  auto hotel = std::make_unique<hotel::Hotel>("Benchmark Hotel");
+  hotel->addRoomCategory(std::make_unique<hotel::RoomCategory>("cat", "Category"));
+  for (int i = 0; i < 20; ++i)
+    hotel->addRoom(std::make_unique<hotel::HotelRoom>("Room " + std::to_string(i + 1)), "cat");
+  dataSource.queueOperation(persistence::op::StoreNewHotel{std::move(hotel)});
+
+  gui::PlanningWidget widget(dataSource);
+  widget.show();
+  gui::ChangeIntegrator integrator(&dataSource);
+
+  LatencyProbe probe(dataSource, iterations);
+  dataSource.planning().addObserver(&probe);
+  app.installEventFilter(&probe);
+
+  // Start measuring once the hotel has been stored and shown
+  QTimer startTimer;
+  QObject::connect(&startTimer, &QTimer::timeout, [&]() {
+    if (dataSource.pendingOperationsCount() != 0)
+      return;
+    startTimer.stop();
+    probe.start(dataSource.hotels().allRoomIDs());
+  });
+  startTimer.start(10);
+
+  auto result = app.exec();
+  dataSource.planning().removeObserver(&probe);
+  return result;
+}
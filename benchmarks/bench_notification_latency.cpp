@@ -0,0 +1,120 @@
+#include "benchmarks/harness.h"
+
+#include "persistence/datasource.h"
+#include "persistence/memory/memorybackend.h"
+#include "persistence/op/operations.h"
+#include "persistence/sqlite/sqlitebackend.h"
+
+#include <poll.h>
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+/**
+ * Measures how long it takes from the commit of an operation in the backend until the waiting thread has been woken up
+ * and has integrated the results. The waiting thread blocks in poll() on the results descriptor of the data source,
+ * just like the event loop of the GUI does.
+ *
+ * Usage: bench_notification_latency [iterations] [burst size] [sqlite|memory]
+ *
+ * With the memory backend, the numbers do not include the cost of sqlite.
+ */
+
+namespace
+{
+  void waitForResults(persistence::DataSource& dataSource)
+  {
+    pollfd descriptor{dataSource.resultsAvailableFileDescriptor(), POLLIN, 0};
+    while (poll(&descriptor, 1, -1) == -1)
+      ;
+  }
+
+  void integrateAll(persistence::DataSource& dataSource)
+  {
+    while (dataSource.pendingOperationsCount() != 0)
+    {
+      waitForResults(dataSource);
+      dataSource.processIntegrationQueue();
+    }
+  }
+
+  std::unique_ptr<hotel::Reservation> makeReservation(int roomId, int index)
+  {
+    using namespace boost::gregorian;
+    auto begin = date(2017, 1, 1) + days(index);
+    auto reservation = std::make_unique<hotel::Reservation>("Benchmark", roomId, date_period(begin, begin + days(1)));
+    reservation->setStatus(hotel::Reservation::New);
+    return reservation;
+  }
+} // namespace
+
+int main(int argc, char** argv)
+{
+  using benchmarks::Clock;
+  auto iterations = benchmarks::intArgument(argc, argv, 1, 500);
+  auto burstSize = benchmarks::intArgument(argc, argv, 2, 100);
+
+  auto inMemory = argc > 3 && std::string(argv[3]) == "memory";
+
+  std::unique_ptr<persistence::Backend> backend;
+  if (inMemory)
+    backend = std::make_unique<persistence::memory::MemoryBackend>();
+  else
+    backend = std::make_unique<persistence::sqlite::SqliteBackend>("benchmark.db");
+  persistence::DataSource dataSource(std::move(backend));
+  dataSource.queueOperation(persistence::op::EraseAllData());
+  auto hotel = std::make_unique<hotel::Hotel>("Benchmark Hotel");
+  hotel->addRoomCategory(std::make_unique<hotel::RoomCategory>("cat", "Category"));
+  hotel->addRoom(std::make_unique<hotel::HotelRoom>("Room"), "cat");
+  dataSource.queueOperation(persistence::op::StoreNewHotel{std::move(hotel)});
+  integrateAll(dataSource);
+  auto roomId = dataSource.hotels().allRoomIDs().at(0);
+
+  // The completion signal is emitted by the backend right after the commit
+  std::atomic<Clock::rep> commitTime(0);
+  dataSource.taskCompletedSignal().connect(
+      [&](int) { commitTime = Clock::now().time_since_epoch().count(); });
+
+  benchmarks::LatencyStatistics wakeupLatency;
+  benchmarks::LatencyStatistics integrationLatency;
+  benchmarks::LatencyStatistics roundTrip;
+  for (int i = 0; i < iterations; ++i)
+  {
+    auto start = Clock::now();
+    dataSource.queueOperation(persistence::op::StoreNewReservation{makeReservation(roomId, 2 * i)});
+    waitForResults(dataSource);
+    auto wokenUp = Clock::now();
+    dataSource.processIntegrationQueue();
+    auto integrated = Clock::now();
+
+    auto committed = Clock::time_point(Clock::duration(commitTime.load()));
+    wakeupLatency.add(wokenUp - committed);
+    integrationLatency.add(integrated - committed);
+    roundTrip.add(integrated - start);
+  }
+
+  wakeupLatency.print(std::cout, "commit -> wakeup");
+  integrationLatency.print(std::cout, "commit -> integrated");
+  roundTrip.print(std::cout, "queue -> integrated");
+
+  // Completions arriving while the waiting thread is busy collapse into a single wakeup
+  int wakeups = 0;
+  for (int i = 0; i < burstSize; ++i)
+    dataSource.queueOperation(persistence::op::StoreNewReservation{makeReservation(roomId, 2 * (iterations + i))});
+  while (dataSource.pendingOperationsCount() != 0)
+  {
+    waitForResults(dataSource);
+    ++wakeups;
+    dataSource.processIntegrationQueue();
+
+    // Simulate an event loop which has other work to do as well
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  std::cout << "wakeups for a burst of " << burstSize << " completions: " << wakeups << std::endl;
+
+  dataSource.taskCompletedSignal().disconnect_all_slots();
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include "benchmarks/harness.h"
+
+#include "persistence/executor.h"
+#include "persistence/exporter/planningexporter.h"
+
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+/**
+ * Measures how the export of a large planning board scales with the number of threads. The output is discarded, thus
+ * the numbers show the cost of the serialization.
+ *
+ * Usage: bench_parallel_export [reservations] [max threads]
+ */
+
+namespace
+{
+  //! Counts the characters written to it and drops them
+  class CountingBuffer : public std::streambuf
+  {
+  public:
+    size_t count() const { return _count; }
+
+  protected:
+    virtual std::streamsize xsputn(const char*, std::streamsize size) override
+    {
+      _count += size;
+      return size;
+    }
+    virtual int overflow(int c) override
+    {
+      ++_count;
+      return c;
+    }
+
+  private:
+    size_t _count = 0;
+  };
+
+  void run(const hotel::PlanningBoard& planning, const persistence::exporter::ReservationFormat& format,
+           const std::string& name, unsigned threads)
+  {
+    using benchmarks::Clock;
+    persistence::ThreadPoolExecutor executor(threads);
+    persistence::exporter::PlanningExporter exporter(executor);
+    CountingBuffer buffer;
+    std::ostream stream(&buffer);
+
+    auto start = Clock::now();
+    exporter.exportPlanning(planning, format, stream);
+    auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << name << " threads=" << threads << ": " << elapsed * 1000 << "ms, " << buffer.count() / elapsed / 1e6
+              << " MB/s" << std::endl;
+  }
+} // namespace
+
+int main(int argc, char** argv)
+{
+  using namespace boost::gregorian;
+  auto reservationCount = benchmarks::intArgument(argc, argv, 1, 1000000);
+  auto maxThreads = static_cast<unsigned>(benchmarks::intArgument(argc, argv, 2, std::thread::hardware_concurrency()));
+
+  // Each room holds a sequence of short reservations
+  const int rooms = 1000;
+  hotel::PlanningBoard planning;
+  for (int room = 1; room <= rooms; ++room)
+    planning.addRoomId(room);
+  for (int i = 0; i < reservationCount; ++i)
+  {
+    auto begin = date(2000, 1, 1) + days(2 * (i / rooms));
+    auto reservation = std::make_unique<hotel::Reservation>("Reservation " + std::to_string(i), 1 + i % rooms,
+                                                            date_period(begin, begin + days(2)));
+    reservation->setId(i + 1);
+    planning.addReservation(std::move(reservation));
+  }
+
+  for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    run(planning, persistence::exporter::JsonReservationFormat(), "json", threads);
+    run(planning, persistence::exporter::CsvReservationFormat(), "csv", threads);
+  }
+  return 0;
+}
@@ -0,0 +1,168 @@
+#include "benchmarks/harness.h"
+#include "benchmarks/testdatabase.h"
+
+#include "persistence/datasource.h"
+#include "persistence/op/operations.h"
+
+#include "json.hpp"
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Measures the throughput and latency of the data source with the sqlite backend, on disk and in memory, for databases
+ * of growing size. Reservations are stored and deleted with one operation per task and in batches, and the initial data
+ * is reloaded. The latency of each task is measured from queueing it until its results have been integrated, the next
+ * task is queued afterwards. The results are written to stdout as JSON.
+ *
+ * Usage: bench_persistence [max reservations in the database] [tasks per scenario] [operations per batch]
+ */
+
+namespace
+{
+  using benchmarks::Clock;
+
+  class Scenario
+  {
+  public:
+    Scenario(persistence::DataSource& dataSource) : _dataSource(dataSource), _latency(), _operations(0) {}
+
+    //! Queues the operations as one task and waits until its results have been integrated
+    void run(persistence::op::Operations operations, persistence::op::TaskPriority priority)
+    {
+      _operations += operations.size();
+      _latency.add(benchmarks::runTask(_dataSource, std::move(operations), priority));
+    }
+
+    nlohmann::json report(const std::string& name, const std::string& database, size_t reservations,
+                          Clock::duration elapsed) const
+    {
+      auto microseconds = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+      };
+      auto seconds = std::chrono::duration<double>(elapsed).count();
+      std::cerr << name << " database=" << database << " reservations=" << reservations << ": "
+                << _operations / seconds << " ops/s" << std::endl;
+      _latency.print(std::cerr, "  task latency");
+
+      return {{"scenario", name},
+              {"database", database},
+              {"reservations", reservations},
+              {"tasks", _latency.count()},
+              {"operations", _operations},
+              {"ops_per_s", _operations / seconds},
+              {"tasks_per_s", _latency.count() / seconds},
+              {"latency_us",
+               {{"mean", microseconds(_latency.mean())},
+                {"p50", microseconds(_latency.percentile(0.5))},
+                {"p99", microseconds(_latency.percentile(0.99))},
+                {"p999", microseconds(_latency.percentile(0.999))},
+                {"max", microseconds(_latency.max())}}}};
+    }
+
+  private:
+    persistence::DataSource& _dataSource;
+    benchmarks::LatencyStatistics _latency;
+    size_t _operations;
+  };
+
+  /**
+   * Fills the database with generated data and runs all scenarios on it. The new reservations lie after the horizon of
+   * the generated ones, thus they never conflict with them.
+   */
+  void runDatabase(const std::string& database, const std::string& path, size_t targetReservations, int tasks,
+                   int batchSize, nlohmann::json& results)
+  {
+    using namespace boost::gregorian;
+    if (path != ":memory:")
+    {
+      std::remove(path.c_str());
+      std::remove((path + ".snapshot").c_str());
+    }
+    persistence::DataSource dataSource(path);
+
+    cli::TestDataOptions options;
+    auto roomIds = benchmarks::storeTestData(dataSource, options, targetReservations);
+    auto reservations = dataSource.planning().reservations().size();
+
+    auto measure = [&](const std::string& name, auto body) {
+      Scenario scenario(dataSource);
+      auto start = Clock::now();
+      body(scenario);
+      results.push_back(scenario.report(name, database, reservations, Clock::now() - start));
+    };
+
+    measure("load_initial_data", [&](Scenario& scenario) {
+      for (int i = 0; i < 5; ++i)
+      {
+        persistence::op::Operations operations;
+        operations.push_back(persistence::op::LoadInitialData());
+        scenario.run(std::move(operations), persistence::op::TaskPriority::Interactive);
+      }
+    });
+
+    auto afterHorizon = options.firstDay + days(options.horizonDays);
+    int nextReservation = 0;
+    std::vector<int> storedIds;
+    auto storeTasks = [&](Scenario& scenario, int count, int operationsPerTask) {
+      for (int i = 0; i < count; ++i)
+      {
+        persistence::op::Operations operations;
+        for (int j = 0; j < operationsPerTask; ++j, ++nextReservation)
+        {
+          auto roomId = roomIds[nextReservation % roomIds.size()];
+          auto begin = afterHorizon + days(2 * static_cast<int>(nextReservation / roomIds.size()));
+          operations.push_back(persistence::op::StoreNewReservation{
+              std::make_unique<hotel::Reservation>("Benchmark", roomId, date_period(begin, begin + days(2)))});
+        }
+        dataSource.assignIds(operations);
+        for (auto& operation : operations)
+        {
+          auto id = boost::get<persistence::op::StoreNewReservation>(operation).newReservation->id();
+          if (id != 0)
+            storedIds.push_back(id);
+        }
+        scenario.run(std::move(operations), persistence::op::TaskPriority::Normal);
+      }
+    };
+    auto deleteTasks = [&](Scenario& scenario, int operationsPerTask) {
+      while (!storedIds.empty())
+      {
+        persistence::op::Operations operations;
+        for (int j = 0; j < operationsPerTask && !storedIds.empty(); ++j)
+        {
+          operations.push_back(persistence::op::DeleteReservation{storedIds.back()});
+          storedIds.pop_back();
+        }
+        scenario.run(std::move(operations), persistence::op::TaskPriority::Normal);
+      }
+    };
+
+    measure("store_single", [&](Scenario& scenario) { storeTasks(scenario, tasks, 1); });
+    measure("delete_single", [&](Scenario& scenario) { deleteTasks(scenario, 1); });
+    measure("store_batched", [&](Scenario& scenario) { storeTasks(scenario, tasks, batchSize); });
+    measure("delete_batched", [&](Scenario& scenario) { deleteTasks(scenario, batchSize); });
+  }
+} // namespace
+
+int main(int argc, char** argv)
+{
+  auto maxReservations = static_cast<size_t>(benchmarks::intArgument(argc, argv, 1, 100000));
+  auto tasks = benchmarks::intArgument(argc, argv, 2, 1000);
+  auto batchSize = benchmarks::intArgument(argc, argv, 3, 100);
+
+  auto results = nlohmann::json::array();
+  for (size_t reservations = 1000; reservations <= maxReservations; reservations *= 10)
+  {
+    runDatabase("disk", "bench_persistence.db", reservations, tasks, batchSize, results);
+    runDatabase("memory", ":memory:", reservations, tasks, batchSize, results);
+  }
+  std::remove("bench_persistence.db");
+  std::remove("bench_persistence.db.snapshot");
+
+  std::cout << nlohmann::json{{"benchmark", "persistence"}, {"results", results}}.dump(2) << std::endl;
+  return 0;
+}
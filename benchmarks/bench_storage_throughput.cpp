@@ -0,0 +1,115 @@
+#include "benchmarks/harness.h"
+
+#include "persistence/datasource.h"
+#include "persistence/log/logbackend.h"
+#include "persistence/op/operations.h"
+#include "persistence/sqlite/sqlitebackend.h"
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Compares the write throughput of the sqlite backend and the log-structured backend. Each task stores a batch of
+ * reservations and deletes one of them again. The tasks are first queued one after the other, such that each one is
+ * committed durably on its own, and then all at once, such that the log backend commits the queued tasks in groups
+ * sharing one sync. The latency of each task is measured from queueing it until the backend has completed it.
+ *
+ * Usage: bench_storage_throughput [tasks] [reservations per task]
+ */
+
+namespace
+{
+  std::unique_ptr<hotel::Reservation> makeReservation(int roomId, int index)
+  {
+    using namespace boost::gregorian;
+    auto begin = date(2017, 1, 1) + days(index % 3000);
+    auto reservation = std::make_unique<hotel::Reservation>("Benchmark", roomId, date_period(begin, begin + days(1)));
+    reservation->setStatus(hotel::Reservation::New);
+    return reservation;
+  }
+
+  void run(const std::string& name, std::unique_ptr<persistence::Backend> backend, int tasks, int batchSize,
+           bool queueAtOnce)
+  {
+    using benchmarks::Clock;
+    persistence::DataSource dataSource(std::move(backend));
+    dataSource.queueOperation(persistence::op::EraseAllData());
+    auto hotel = std::make_unique<hotel::Hotel>("Benchmark Hotel");
+    hotel->addRoomCategory(std::make_unique<hotel::RoomCategory>("cat", "Category"));
+    hotel->addRoom(std::make_unique<hotel::HotelRoom>("Room"), "cat");
+    auto storeHotel = dataSource.queueOperation(persistence::op::StoreNewHotel{std::move(hotel)});
+    storeHotel.waitForCompletion();
+    dataSource.processIntegrationQueue();
+    auto roomId = dataSource.hotels().allRoomIDs().at(0);
+
+    benchmarks::LatencyStatistics latency;
+    std::vector<std::pair<persistence::op::Task<persistence::op::OperationResults>, Clock::time_point>> queuedTasks;
+    auto start = Clock::now();
+    for (int i = 0; i < tasks; ++i)
+    {
+      // The client assigns the ids, thus the reservation to delete is known before the task has been executed. Tasks
+      // queued at once may use up the leased ids before the next lease has been integrated.
+      persistence::op::Operations operations;
+      for (int j = 0; j < batchSize; ++j)
+        operations.push_back(persistence::op::StoreNewReservation{makeReservation(roomId, i * batchSize + j)});
+      auto& firstReservation = *boost::get<persistence::op::StoreNewReservation>(operations[0]).newReservation;
+      dataSource.assignIds(operations);
+      while (firstReservation.id() == 0)
+      {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        dataSource.processIntegrationQueue();
+        dataSource.assignIds(operations);
+      }
+      operations.push_back(persistence::op::DeleteReservation{firstReservation.id()});
+
+      auto queued = Clock::now();
+      queuedTasks.emplace_back(dataSource.queueOperations(std::move(operations)), queued);
+      if (queueAtOnce)
+        continue;
+
+      queuedTasks.back().first.waitForCompletion();
+      latency.add(Clock::now() - queued);
+      dataSource.processIntegrationQueue();
+    }
+    if (queueAtOnce)
+    {
+      // The tasks complete in order, thus each one is seen right after it has been completed
+      for (auto& queuedTask : queuedTasks)
+      {
+        queuedTask.first.waitForCompletion();
+        latency.add(Clock::now() - queuedTask.second);
+      }
+      dataSource.processIntegrationQueue();
+    }
+    auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    latency.print(std::cout, name + " task");
+    std::cout << name << ": " << tasks / elapsed << " tasks/s, " << tasks * (batchSize + 1) / elapsed << " ops/s"
+              << std::endl;
+  }
+} // namespace
+
+int main(int argc, char** argv)
+{
+  auto tasks = benchmarks::intArgument(argc, argv, 1, 1000);
+  auto batchSize = benchmarks::intArgument(argc, argv, 2, 10);
+
+  for (auto queueAtOnce : {false, true})
+  {
+    auto suffix = queueAtOnce ? " (queued at once)" : "";
+    std::remove("benchmark.db.snapshot");
+    run(std::string("sqlite") + suffix, std::make_unique<persistence::sqlite::SqliteBackend>("benchmark.db"), tasks,
+        batchSize, queueAtOnce);
+
+    std::remove("benchmark.log");
+    std::remove("benchmark.log.snapshot");
+    run(std::string("log") + suffix, std::make_unique<persistence::log::LogBackend>("benchmark.log"), tasks, batchSize,
+        queueAtOnce);
+  }
+  return 0;
+}
@@ -0,0 +1,124 @@
+#ifndef BENCHMARKS_HARNESS_H
+#define BENCHMARKS_HARNESS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace benchmarks
+{
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * @brief The LatencyStatistics class collects latency samples and reports their distribution
+   */
+  class LatencyStatistics
+  {
+  public:
+    void add(Clock::duration sample) { _samples.push_back(sample); }
+    //! Adds all samples of the other statistics, e.g. of another thread
+    void add(const LatencyStatistics& other)
+    {
+      _samples.insert(_samples.end(), other._samples.begin(), other._samples.end());
+    }
+    size_t count() const { return _samples.size(); }
+
+    //! Returns the sample below which the given fraction of all samples lie, e.g. 0.99 for the 99th percentile
+    Clock::duration percentile(double fraction) const
+    {
+      if (_samples.empty())
+        return Clock::duration::zero();
+
+      auto sorted = _samples;
+      auto index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+      std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+      return sorted[index];
+    }
+
+    Clock::duration mean() const
+    {
+      if (_samples.empty())
+        return Clock::duration::zero();
+
+      Clock::duration sum = Clock::duration::zero();
+      for (auto sample : _samples)
+        sum += sample;
+      return sum / _samples.size();
+    }
+
+    Clock::duration max() const
+    {
+      return _samples.empty() ? Clock::duration::zero() : *std::max_element(_samples.begin(), _samples.end());
+    }
+
+    /**
+     * @brief histogram counts the samples in buckets of doubling width
+     * Bucket 0 holds the samples below 1us, bucket i > 0 those from 2^(i-1)us up to 2^i us.
+     */
+    std::vector<size_t> histogram() const
+    {
+      std::vector<size_t> buckets;
+      for (auto sample : _samples)
+      {
+        size_t bucket = 0;
+        for (auto limit = 1.0; microseconds(sample) >= limit; limit *= 2)
+          ++bucket;
+        if (buckets.size() <= bucket)
+          buckets.resize(bucket + 1, 0);
+        ++buckets[bucket];
+      }
+      return buckets;
+    }
+
+    //! Prints one line with the distribution of the samples in microseconds
+    void print(std::ostream& stream, const std::string& name) const
+    {
+      stream << name << ": n=" << count() << " mean=" << microseconds(mean())
+             << "us p50=" << microseconds(percentile(0.5)) << "us p99=" << microseconds(percentile(0.99))
+             << "us p999=" << microseconds(percentile(0.999)) << "us max=" << microseconds(max()) << "us" << std::endl;
+    }
+
+  private:
+    static double microseconds(Clock::duration duration)
+    {
+      return std::chrono::duration<double, std::micro>(duration).count();
+    }
+
+    std::vector<Clock::duration> _samples;
+  };
+
+  /**
+   * @brief measureRuns runs the operation until the time budget is used up or the given number of runs is reached
+   *
+   * The operation gets the index of the run as its argument. It runs in rounds of doubling size, thus the clock is read
+   * once per round, and a slow operation is only run once if that uses up the budget.
+   * @return The number of runs, elapsed receives their total duration
+   */
+  template <typename Operation>
+  size_t measureRuns(Clock::duration budget, size_t maxRuns, Operation operation, Clock::duration& elapsed)
+  {
+    size_t runs = 0;
+    auto start = Clock::now();
+    elapsed = Clock::duration::zero();
+    for (size_t round = 1; runs < maxRuns && elapsed < budget; round *= 2)
+    {
+      auto end = std::min(maxRuns, runs + round);
+      for (; runs < end; ++runs)
+        operation(runs);
+      elapsed = Clock::now() - start;
+    }
+    return runs;
+  }
+
+  //! Returns the integer command line argument at the given index, or the default value if it has not been given
+  inline int intArgument(int argc, char** argv, int index, int defaultValue)
+  {
+    return index < argc ? std::atoi(argv[index]) : defaultValue;
+  }
+
+} // namespace benchmarks
+
+#endif // BENCHMARKS_HARNESS_H
@@ -0,0 +1,87 @@
+#ifndef BENCHMARKS_TESTDATABASE_H
+#define BENCHMARKS_TESTDATABASE_H
+
+#include "benchmarks/harness.h"
+
+#include "cli/testdata.h"
+
+#include "persistence/datasource.h"
+#include "persistence/executor.h"
+#include "persistence/op/operations.h"
+
+#include <poll.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace benchmarks
+{
+  /**
+   * @brief runTask queues the operations as one task and integrates results until those of the task are integrated
+   * @return The time from queueing the task until its results have been integrated
+   * @note Must be called on the thread which integrates the results of the data source
+   */
+  inline Clock::duration runTask(persistence::DataSource& dataSource, persistence::op::Operations operations,
+                                 persistence::op::TaskPriority priority)
+  {
+    auto integrated = false;
+    Clock::duration latency;
+    auto queued = Clock::now();
+    auto task = dataSource.queueOperations(std::move(operations), priority);
+    task.then(dataSource.integrationExecutor(), [&](auto&) {
+      latency = Clock::now() - queued;
+      integrated = true;
+    });
+
+    pollfd descriptor{dataSource.resultsAvailableFileDescriptor(), POLLIN, 0};
+    while (!integrated)
+    {
+      ::poll(&descriptor, 1, 100);
+      dataSource.processIntegrationQueue();
+    }
+    return latency;
+  }
+
+  /**
+   * @brief storeTestData stores one generated hotel with about the given number of reservations
+   *
+   * The objects get their ids from the leases of the data source, like the ones stored by the benchmark later on.
+   * The reservations lie within the horizon of the options, the rooms are free after it.
+   * @return The ids of the rooms of the hotel
+   */
+  inline std::vector<int> storeTestData(persistence::DataSource& dataSource, cli::TestDataOptions options,
+                                        size_t reservations)
+  {
+    // The generator books about 28 reservations per room over its horizon at the default occupancy
+    const int reservationsPerRoom = 28;
+    const size_t batchSize = 10000;
+    options.hotels = 1;
+    options.roomsPerHotel = std::max<int>(1, static_cast<int>(reservations / reservationsPerRoom));
+
+    persistence::ThreadPoolExecutor executor;
+    auto data = cli::createTestData(options, executor);
+    auto generatedRoomIds = cli::resetHotelIds(data.hotels);
+
+    // The stored hotel is the last one integrated
+    persistence::op::Operations operations;
+    operations.push_back(persistence::op::StoreNewHotel{std::move(data.hotels[0])});
+    runTask(dataSource, std::move(operations), persistence::op::TaskPriority::Bulk);
+    std::vector<int> roomIds;
+    for (auto& room : dataSource.hotels().hotels().back()->rooms())
+      roomIds.push_back(room->id());
+    cli::resetReservationIds(data.reservations, generatedRoomIds, roomIds);
+
+    for (size_t begin = 0; begin < data.reservations.size(); begin += batchSize)
+    {
+      operations = persistence::op::Operations();
+      auto end = std::min(begin + batchSize, data.reservations.size());
+      for (auto i = begin; i < end; ++i)
+        operations.push_back(persistence::op::StoreNewReservation{std::move(data.reservations[i])});
+      runTask(dataSource, std::move(operations), persistence::op::TaskPriority::Bulk);
+    }
+    return roomIds;
+  }
+
+} // namespace benchmarks
+
+#endif // BENCHMARKS_TESTDATABASE_H
@@ -1,37 +1,251 @@
 #include "cli/testdata.h"
 
 #include "persistence/datasource.h"
+#include "persistence/executor.h"
+#include "persistence/exporter/planningexporter.h"
+#include "persistence/importer/csvimporter.h"
 #include "persistence/sqlite/sqlitestorage.h"
 
+#include <poll.h>
+
+#include <algorithm>
 #include <chrono>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <vector>
 
-void createTestDatabase(const std::string& db)
+// Waits until the backend has processed all queued operations, e.g. the initial load, and integrates their results
+void waitForBackend(persistence::DataSource& dataSource)
 {
-  // Get us some random test data
-  auto seed = static_cast<unsigned>(std::chrono::system_clock::now().time_since_epoch().count());
-  std::mt19937 rng(seed);
+  pollfd descriptor{dataSource.resultsAvailableFileDescriptor(), POLLIN, 0};
+  while (dataSource.pendingOperationsCount() != 0)
+  {
+    ::poll(&descriptor, 1, 100);
+    dataSource.processIntegrationQueue();
+  }
+  dataSource.processIntegrationQueue();
+}
 
-  // Store all of the random test data into the database
-  persistence::DataSource dataSource(db);
+// Waits for the task and returns true if each of its operations has stored its object and the task has been committed
+bool waitForStoreTask(persistence::op::Task<persistence::op::OperationResults>& task)
+{
+  task.waitForCompletion();
+  auto& results = task.results();
+  return !task.cancelled() && std::all_of(results.begin(), results.end(), [](auto& result) {
+    return boost::get<persistence::op::StoreNewHotelResult>(&result) != nullptr ||
+           boost::get<persistence::op::StoreNewReservationResult>(&result) != nullptr;
+  });
+}
+
+long millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+int createTestDatabase(const cli::TestDataOptions& options, const std::string& db)
+{
+  auto start = std::chrono::steady_clock::now();
+  persistence::ThreadPoolExecutor executor;
+  auto data = cli::createTestData(options, executor);
+  auto reservationCount = data.reservations.size();
+  auto generated = millisecondsSince(start);
 
-  dataSource.queueOperation(persistence::op::EraseAllData());
-  auto hotels = cli::createTestHotels(rng);
-  for (auto& hotel : hotels)
-    dataSource.queueOperation(persistence::op::StoreNewHotel{ std::move(hotel) });
+  // The data is erased anyway, thus only a small part of the planning is loaded initially
+  persistence::DataSource dataSource(db, boost::gregorian::date_period(options.firstDay, boost::gregorian::days(1)));
+  auto eraseTask = dataSource.queueOperation(persistence::op::EraseAllData(), persistence::op::TaskPriority::Bulk);
 
-  // TODO: Wait for operations to complete
+  // The generated ids may have been handed out before, e.g. leased by the data source, thus the data source assigns new
+  // ones. The reservations are moved to the stored rooms once the hotels have been stored.
+  auto hotelCount = data.hotels.size();
+  auto generatedRoomIds = cli::resetHotelIds(data.hotels);
   persistence::op::Operations operations;
-  auto planning = cli::createTestPlanning(rng, dataSource.hotels());
-  for (auto& reservation : planning->reservations())
-    operations.push_back(persistence::op::StoreNewReservation{ std::make_unique<hotel::Reservation>(*reservation) });
-  dataSource.queueOperations(std::move(operations));
+  for (auto& hotel : data.hotels)
+    operations.push_back(persistence::op::StoreNewHotel{std::move(hotel)});
+  auto hotelsTask = dataSource.queueOperations(std::move(operations), persistence::op::TaskPriority::Bulk);
+
+  // Tasks of the same priority are executed in order
+  eraseTask.waitForCompletion();
+  if (eraseTask.results().size() != 1 ||
+      boost::get<persistence::op::EraseAllDataResult>(&eraseTask.results()[0]) == nullptr)
+  {
+    std::cerr << "Cannot erase the data of " << db << std::endl;
+    return 1;
+  }
+  if (!waitForStoreTask(hotelsTask))
+  {
+    std::cerr << "Cannot store the test data in " << db << std::endl;
+    return 1;
+  }
+
+  waitForBackend(dataSource);
+  std::vector<int> storedRoomIds;
+  for (auto& result : hotelsTask.results())
+  {
+    auto storedHotelId = boost::get<persistence::op::StoreNewHotelResult>(result).storedHotelId;
+    auto hotel = dataSource.hotels().findHotelById(storedHotelId);
+    if (hotel == nullptr)
+      continue;
+    for (auto& room : hotel->rooms())
+      storedRoomIds.push_back(room->id());
+  }
+  if (storedRoomIds.size() != generatedRoomIds.size() ||
+      !cli::resetReservationIds(data.reservations, generatedRoomIds, storedRoomIds))
+  {
+    std::cerr << "Cannot find the stored rooms in " << db << std::endl;
+    return 1;
+  }
+
+  // Batches of operations of the same kind take the bulk storage path, each batch is stored in one transaction
+  const size_t batchSize = 10000;
+  std::vector<persistence::op::Task<persistence::op::OperationResults>> tasks;
+  for (size_t begin = 0; begin < data.reservations.size(); begin += batchSize)
+  {
+    operations = persistence::op::Operations();
+    auto end = std::min(begin + batchSize, data.reservations.size());
+    for (auto i = begin; i < end; ++i)
+      operations.push_back(persistence::op::StoreNewReservation{std::move(data.reservations[i])});
+    tasks.push_back(dataSource.queueOperations(std::move(operations), persistence::op::TaskPriority::Bulk));
+  }
+
+  // Their results are only checked, nothing here uses the planning
+  for (auto& task : tasks)
+  {
+    if (!waitForStoreTask(task))
+    {
+      std::cerr << "Cannot store the test data in " << db << std::endl;
+      return 1;
+    }
+  }
+  std::cout << "Generated " << hotelCount << " hotels with " << reservationCount << " reservations in "
+            << generated << " ms, stored them in " << millisecondsSince(start) - generated << " ms" << std::endl;
+  return 0;
 }
 
-int main(int argc, char** argv)
+// Reads the options following the command, the last argument may name the database
+bool parseGeneratorArguments(const std::vector<std::string>& arguments, cli::TestDataOptions& options, std::string& db)
+{
+  for (size_t i = 1; i < arguments.size(); ++i)
+  {
+    auto& argument = arguments[i];
+    if (argument.compare(0, 2, "--") != 0)
+    {
+      if (i + 1 != arguments.size())
+        return false;
+      db = argument;
+      break;
+    }
+    if (i + 1 == arguments.size())
+      return false;
+
+    auto& value = arguments[++i];
+    try
+    {
+      if (argument == "--seed")
+        options.seed = static_cast<unsigned>(std::stoul(value));
+      else if (argument == "--hotels")
+        options.hotels = std::stoi(value);
+      else if (argument == "--rooms")
+        options.roomsPerHotel = std::stoi(value);
+      else if (argument == "--first-day")
+        options.firstDay = boost::gregorian::from_string(value);
+      else if (argument == "--days")
+        options.horizonDays = std::stoi(value);
+      else if (argument == "--occupancy")
+        options.occupancy = std::stod(value);
+      else if (argument == "--today")
+        options.today = boost::gregorian::from_string(value);
+      else
+        return false;
+    }
+    catch (std::exception&)
+    {
+      std::cerr << "Invalid value for " << argument << ": " << value << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int importCsv(const std::string& csvFile, const std::string& db)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  // The database is loaded by the backend while the file is parsed
+  persistence::DataSource dataSource(db);
+  persistence::ThreadPoolExecutor executor;
+  persistence::importer::CsvImporter importer(executor);
+  if (!importer.parseFile(csvFile))
+  {
+    std::cerr << csvFile << ": " << importer.errorMessage() << std::endl;
+    return 1;
+  }
+  waitForBackend(dataSource);
+  if (!importer.validate(dataSource.planning()))
+  {
+    std::cerr << csvFile << ": " << importer.errorMessage() << std::endl;
+    return 1;
+  }
+
+  // The stored reservations are not integrated, nothing here uses the planning anymore
+  auto count = importer.reservations().size();
+  auto task = importer.queueReservations(dataSource);
+  if (!waitForStoreTask(task))
+  {
+    std::cerr << csvFile << ": Cannot store the reservations in " << db << std::endl;
+    return 1;
+  }
+  std::cout << "Imported " << count << " reservations in " << millisecondsSince(start) << " ms" << std::endl;
+  return 0;
+}
+
+int exportCsv(const std::string& csvFile, const std::string& db)
 {
-  // Fill the test.db with randomly generated test data
-  createTestDatabase("test.db");
+  auto start = std::chrono::steady_clock::now();
+  persistence::DataSource dataSource(db);
+  waitForBackend(dataSource);
+
+  std::ofstream stream(csvFile, std::ios::binary | std::ios::trunc);
+  persistence::ThreadPoolExecutor executor;
+  persistence::exporter::PlanningExporter exporter(executor);
+  if (!stream ||
+      !exporter.exportPlanning(dataSource.planning(), persistence::exporter::CsvReservationFormat(), stream))
+  {
+    std::cerr << "Cannot write " << csvFile << std::endl;
+    return 1;
+  }
+  std::cout << "Exported " << dataSource.planning().reservations().size() << " reservations in "
+            << millisecondsSince(start) << " ms" << std::endl;
   return 0;
 }
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> arguments(argv + 1, argv + argc);
+
+  // Fill the database with generated test data, by default the test.db
+  if (arguments.empty() || arguments[0] == "generate")
+  {
+    cli::TestDataOptions options;
+    std::string db = "test.db";
+    if (parseGeneratorArguments(arguments, options, db))
+      return createTestDatabase(options, db);
+  }
+
+  if ((arguments[0] == "import" || arguments[0] == "export") && arguments.size() >= 2 && arguments.size() <= 3)
+  {
+    auto db = arguments.size() == 3 ? arguments[2] : "test.db";
+    return arguments[0] == "import" ? importCsv(arguments[1], db) : exportCsv(arguments[1], db);
+  }
+
+  std::cerr << "Usage: hotel_cli generate [<options>] [<db>]     Replaces the data of the database with test data"
+            << std::endl
+            << "         --seed <n>, --hotels <n>, --rooms <rooms per hotel>, --first-day <yyyy-mm-dd>," << std::endl
+            << "         --days <length of the horizon>, --occupancy <0..1>, --today <yyyy-mm-dd>" << std::endl
+            << "       hotel_cli import <file.csv> [<db>]       Adds the reservations of the file to the database"
+            << std::endl
+            << "       hotel_cli export <file.csv> [<db>]       Writes the reservations of the database to the file"
+            << std::endl;
+  return 1;
+}
@@ -1,146 +1,218 @@
 #include "cli/testdata.h"
 
-#include "hotel/reservation.h"
-
-#include <boost/range/irange.hpp>
-
 #include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
 #include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
 
 namespace cli
 {
-
-  std::vector<std::unique_ptr<hotel::Hotel>> createTestHotels(std::mt19937& rng)
+  namespace
   {
-    std::vector<std::unique_ptr<hotel::Hotel>> result;
-    std::uniform_int_distribution<> hotels_dist(2, 2);
-    std::uniform_int_distribution<> floors_dist(1, 10);
-    std::uniform_int_distribution<> rooms_dist(0, 40);
-
-    int numOfHotels = hotels_dist(rng);
-    for (auto i : boost::irange(0, numOfHotels))
+    // The engine is specified by the standard, unlike the distributions, thus the values are drawn by hand in order to
+    // get the same data with every standard library
+    int uniform(std::mt19937& rng, int min, int max)
     {
-      auto hotel = std::make_unique<hotel::Hotel>("Hotel " + std::to_string(i));
-      auto numOfFloors = floors_dist(rng);
-      auto numOfCategories = numOfFloors / 3 + 1;
-      for (auto c : boost::irange(0, numOfCategories))
-        hotel->addRoomCategory(
-            std::make_unique<hotel::RoomCategory>("cat" + std::to_string(c), "Category " + std::to_string(c)));
-
-      auto category_dist = std::uniform_int_distribution<>(0, numOfCategories - 1);
-      for (auto f : boost::irange(0, numOfFloors))
-      {
-        auto numOfRooms = rooms_dist(rng);
-        for (auto r : boost::irange(0, numOfRooms))
-        {
-          auto category = "cat" + std::to_string(category_dist(rng));
-          auto roomNumber = std::to_string(i) + "_" + std::to_string(100 * (1 + f) + r + 1);
-          hotel->addRoom(std::make_unique<hotel::HotelRoom>(roomNumber), category);
-        }
-      }
-      result.push_back(std::move(hotel));
+      return min + static_cast<int>(rng() % static_cast<uint32_t>(max - min + 1));
     }
 
-    return result;
-  }
+    bool chance(std::mt19937& rng, int percentage) { return uniform(rng, 0, 99) < percentage; }
 
-  void addRandomReservations(std::mt19937& rng, hotel::Hotel& hotel, hotel::PlanningBoard& planning, int count,
-                             boost::gregorian::date_period period)
-  {
-    // std::uniform_int_distribution<> dayDist(0, period.length().days());
-    std::normal_distribution<> dayDist(period.length().days() / 4, period.length().days() / 2);
-    std::uniform_int_distribution<> roomDist(0, hotel.rooms().size() - 1);
-    std::uniform_int_distribution<> lengthDist(3, 21);
-    std::uniform_int_distribution<> percentageDist(0, 100);
+    int exponential(std::mt19937& rng, double mean)
+    {
+      auto unit = (rng() + 0.5) / 4294967296.0;
+      return static_cast<int>(-std::log(unit) * mean);
+    }
 
-    for (auto i : boost::irange(0, count))
+    struct HotelData
     {
-      auto day = dayDist(rng);
-      auto length = lengthDist(rng);
-      if (percentageDist(rng) < 70)
+      std::unique_ptr<hotel::Hotel> hotel;
+      std::vector<std::unique_ptr<hotel::Reservation>> reservations;
+    };
+
+    std::unique_ptr<hotel::Hotel> createHotel(const TestDataOptions& options, int index)
+    {
+      const int roomsPerFloor = 40;
+      auto categoryCount = options.roomsPerHotel / 100 + 1;
+      auto hotel = std::make_unique<hotel::Hotel>("Hotel " + std::to_string(index));
+      hotel->setId(index + 1);
+      for (int c = 0; c < categoryCount; ++c)
       {
-        // Snap to whole weeks
-        day = std::floor(day / 7) * 7;
-        length = std::ceil(length / 7.0) * 7;
+        auto category =
+            std::make_unique<hotel::RoomCategory>("cat" + std::to_string(c), "Category " + std::to_string(c));
+        category->setId(index * categoryCount + c + 1);
+        hotel->addRoomCategory(std::move(category));
       }
-
-      auto startDate = period.begin() + boost::gregorian::days(day);
-      auto endDate = startDate + boost::gregorian::days(length);
-      auto resPeriod = boost::gregorian::date_period(startDate, endDate);
-      auto additionalDays = 0;
-      if (!period.contains(resPeriod))
-        continue;
-
-      auto roomId = hotel.rooms()[roomDist(rng)]->id();
-      if (!planning.isFree(roomId, resPeriod))
+      for (int r = 0; r < options.roomsPerHotel; ++r)
       {
-        // Try to add it with room change
-        auto availableDaysInRoom = planning.getAvailableDaysFrom(roomId, resPeriod.begin());
-        if (availableDaysInRoom == 0)
-          continue; // Room is fully booked!
-
-        additionalDays = (endDate - startDate).days() - availableDaysInRoom;
-        endDate = startDate + boost::gregorian::days(availableDaysInRoom);
-        resPeriod = boost::gregorian::date_period(startDate, endDate);
+        auto number = 100 * (1 + r / roomsPerFloor) + r % roomsPerFloor + 1;
+        auto room = std::make_unique<hotel::HotelRoom>(std::to_string(index) + "_" + std::to_string(number));
+        room->setId(index * options.roomsPerHotel + r + 1);
+        hotel->addRoom(std::move(room), "cat" + std::to_string(r % categoryCount));
       }
+      return hotel;
+    }
 
-      auto reservation = std::make_unique<hotel::Reservation>("Reservation " + std::to_string(i), roomId, resPeriod);
-      // Fill in any missing days by changing rooms (10 attempts)
-      for (int i = 0; i < 10; ++i)
+    hotel::Reservation::ReservationStatus chooseStatus(std::mt19937& rng, const TestDataOptions& options,
+                                                       boost::gregorian::date_period period)
+    {
+      if (period.contains(options.today))
+        return hotel::Reservation::CheckedIn;
+      if (period.end() < options.today - boost::gregorian::days(5))
+        return hotel::Reservation::Archived;
+      if (period.end() <= options.today)
+        return hotel::Reservation::CheckedOut;
+      return chance(rng, 90) ? hotel::Reservation::Confirmed : hotel::Reservation::New;
+    }
+
+    /**
+     * Fills the rooms of the hotel from the start of the horizon on. The room which is booked up to the earliest day is
+     * extended with a gap and a stay, thus all rooms are filled evenly and the planning never has to be searched for
+     * free rooms. Some stays move to another room which is free by then.
+     */
+    void addReservations(std::mt19937& rng, const TestDataOptions& options, HotelData& data)
+    {
+      const double meanStayLength = 14; // Of the lengths below, after snapping
+      auto occupancy = std::min(std::max(options.occupancy, 0.01), 1.0);
+      auto meanGap = meanStayLength * (1 - occupancy) / occupancy;
+      auto& rooms = data.hotel->rooms();
+
+      typedef std::pair<int, size_t> Cursor; // Day up to which the room is booked, index of the room
+      std::vector<int> bookedUntil(rooms.size(), 0);
+      std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> cursors;
+      for (size_t room = 0; room < rooms.size(); ++room)
+        cursors.push(Cursor(0, room));
+
+      while (!cursors.empty())
       {
-        startDate = endDate;
-        if (additionalDays == 0)
-          break;
-        roomId = hotel.rooms()[roomDist(rng)]->id();
-        auto availableDays = std::min(additionalDays, planning.getAvailableDaysFrom(roomId, startDate));
-        if (availableDays != 0)
+        auto cursor = cursors.top();
+        cursors.pop();
+        if (cursor.first != bookedUntil[cursor.second])
+          continue; // The room has been booked further by a room change
+
+        auto start = cursor.first + exponential(rng, meanGap);
+        auto length = uniform(rng, 3, 21);
+        if (chance(rng, 70))
+        {
+          // Snap to whole weeks, to the closest start which does not precede the cursor
+          start = (start + 3) / 7 * 7;
+          if (start < cursor.first)
+            start += 7;
+          length = (length + 6) / 7 * 7;
+        }
+        if (start + length > options.horizonDays)
+          continue;
+
+        auto room = cursor.second;
+        auto day = [&](int offset) { return options.firstDay + boost::gregorian::days(offset); };
+        auto reservation = std::make_unique<hotel::Reservation>(
+            "Reservation " + std::to_string(data.reservations.size()), rooms[room]->id(),
+            boost::gregorian::date_period(day(start), day(start + length)));
+        bookedUntil[room] = start + length;
+
+        if (chance(rng, 10))
         {
-          endDate = startDate + boost::gregorian::days(availableDays);
-          reservation->addContinuation(roomId, endDate);
-          additionalDays -= availableDays;
+          auto change = start + uniform(rng, 1, length - 1);
+          auto otherRoom = static_cast<size_t>(uniform(rng, 0, static_cast<int>(rooms.size()) - 1));
+          if (otherRoom != room && bookedUntil[otherRoom] <= change)
+          {
+            reservation->atoms().front().setDateRange(boost::gregorian::date_period(day(start), day(change)));
+            reservation->addContinuation(rooms[otherRoom]->id(), day(start + length));
+            bookedUntil[room] = change;
+            bookedUntil[otherRoom] = start + length;
+            cursors.push(Cursor(bookedUntil[otherRoom], otherRoom));
+          }
         }
+        cursors.push(Cursor(bookedUntil[room], room));
+
+        reservation->setNumberOfAdults(uniform(rng, 1, 3));
+        reservation->setNumberOfChildren(chance(rng, 20) ? uniform(rng, 1, 3) : 0);
+        reservation->setStatus(chooseStatus(rng, options, reservation->dateRange()));
+        data.reservations.push_back(std::move(reservation));
       }
+    }
+  } // namespace
 
-      // If we manage to account for all of the requested days
-      if (additionalDays == 0)
+  TestData createTestData(const TestDataOptions& options, persistence::Executor& executor)
+  {
+    std::vector<HotelData> hotels(std::max(options.hotels, 0));
+    std::mutex mutex;
+    std::condition_variable completedCondition;
+    size_t completed = 0;
+    for (size_t i = 0; i < hotels.size(); ++i)
+    {
+      executor.post([&, i]() {
+        std::seed_seq seed{options.seed, static_cast<unsigned>(i)};
+        std::mt19937 rng(seed);
+        hotels[i].hotel = createHotel(options, static_cast<int>(i));
+        addReservations(rng, options, hotels[i]);
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          ++completed;
+        }
+        completedCondition.notify_all();
+      });
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      completedCondition.wait(lock, [&]() { return completed == hotels.size(); });
+    }
+
+    TestData result;
+    for (auto& hotel : hotels)
+    {
+      result.hotels.push_back(std::move(hotel.hotel));
+      for (auto& reservation : hotel.reservations)
       {
-        // Set the reservation status
-        auto today = boost::gregorian::day_clock::local_day();
-        if (reservation->dateRange().contains(today))
-          reservation->setStatus(hotel::Reservation::CheckedIn);
-        else if (reservation->dateRange().end() < today + boost::gregorian::days(-5))
-          reservation->setStatus(hotel::Reservation::Archived);
-        else if (reservation->dateRange().end() <= today)
-          reservation->setStatus(hotel::Reservation::CheckedOut);
-        else if (percentageDist(rng) < 90)
-          reservation->setStatus(hotel::Reservation::Confirmed);
-        else
-          reservation->setStatus(hotel::Reservation::New);
-
-        planning.addReservation(std::move(reservation));
+        reservation->setId(static_cast<int>(result.reservations.size()) + 1);
+        result.reservations.push_back(std::move(reservation));
       }
     }
+    return result;
   }
 
-  std::unique_ptr<hotel::PlanningBoard> createTestPlanning(std::mt19937& rng,
-                                                           hotel::HotelCollection& hotels)
+  std::vector<int> resetHotelIds(const std::vector<std::unique_ptr<hotel::Hotel>>& hotels)
   {
-    using namespace boost::gregorian;
-    auto today = day_clock::local_day();
-    auto periodFrom = today + days(-14);
-    auto periodTo = today + days(600);
-
-    auto period = boost::gregorian::date_period(periodFrom, periodTo);
-
-    auto planning = std::make_unique<hotel::PlanningBoard>();
-
-    for (auto id : hotels.allRoomIDs())
-      planning->addRoomId(id);
+    std::vector<int> roomIds;
+    for (auto& hotel : hotels)
+    {
+      hotel->setId(0);
+      for (auto& category : hotel->categories())
+        category->setId(0);
+      for (auto& room : hotel->rooms())
+      {
+        roomIds.push_back(room->id());
+        room->setId(0);
+      }
+    }
+    return roomIds;
+  }
 
-    for (auto& hotel : hotels.hotels())
-      addRandomReservations(rng, *hotel, *planning, 200 * hotel->rooms().size(), period);
+  bool resetReservationIds(const std::vector<std::unique_ptr<hotel::Reservation>>& reservations,
+                           const std::vector<int>& generatedRoomIds, const std::vector<int>& storedRoomIds)
+  {
+    std::unordered_map<int, int> roomIds;
+    for (size_t i = 0; i < generatedRoomIds.size() && i < storedRoomIds.size(); ++i)
+      roomIds[generatedRoomIds[i]] = storedRoomIds[i];
 
-    return planning;
+    for (auto& reservation : reservations)
+    {
+      reservation->setId(0);
+      for (auto& atom : reservation->atoms())
+      {
+        auto roomId = roomIds.find(atom.roomId());
+        if (roomId == roomIds.end())
+          return false;
+        atom.setRoomId(roomId->second);
+      }
+    }
+    return true;
   }
 
 } // namespace cli
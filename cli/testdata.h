@@ -1,20 +1,71 @@
 #ifndef CLI_TESTDATA_H
 #define CLI_TESTDATA_H
 
+#include "persistence/executor.h"
+
 #include "hotel/hotel.h"
-#include "hotel/hotelcollection.h"
-#include "hotel/planning.h"
+#include "hotel/reservation.h"
+
+#include <boost/date_time.hpp>
 
 #include <memory>
-#include <random>
 #include <vector>
 
 namespace cli
 {
+  /**
+   * @brief The TestDataOptions struct describes the size and shape of a generated data set
+   * The same options, including the seed, always result in the same data set on the same platform. The gaps between
+   * the reservations are drawn with std::log, whose results are not bit-identical across math libraries, thus
+   * another libm may yield slightly different data.
+   */
+  struct TestDataOptions
+  {
+    unsigned seed = 0;
+    int hotels = 2;
+    int roomsPerHotel = 200;
+    //! The reservations lie within the horizonDays days starting at firstDay
+    boost::gregorian::date firstDay = boost::gregorian::date(2017, 1, 1);
+    int horizonDays = 600;
+    //! Fraction of the room nights of the horizon which are booked, approximately
+    double occupancy = 0.7;
+    //! Day from which the status of the reservations is derived, e.g. past reservations are checked out
+    boost::gregorian::date today = boost::gregorian::date(2017, 1, 15);
+  };
+
+  struct TestData
+  {
+    std::vector<std::unique_ptr<hotel::Hotel>> hotels;
+    std::vector<std::unique_ptr<hotel::Reservation>> reservations;
+  };
+
+  /**
+   * @brief createTestData generates hotels and their reservations
+   *
+   * The hotels are generated in parallel on the executor, each from its own random engine seeded with the seed and the
+   * index of the hotel, thus the data does not depend on the number of threads. All objects get ids counting from 1 in
+   * the order of the hotels, which relate them to each other. The atoms of the reservations do not get ids.
+   *
+   * The ids may have been handed out by the backend before, thus they are not meant to be stored. Reset them with
+   * resetHotelIds() and resetReservationIds() to let the data source assign new ones.
+   */
+  TestData createTestData(const TestDataOptions& options, persistence::Executor& executor);
+
+  /**
+   * @brief resetHotelIds resets the ids of the hotels, their room categories and rooms to 0
+   * @return The generated ids of the rooms, in the order of the hotels and their rooms
+   */
+  std::vector<int> resetHotelIds(const std::vector<std::unique_ptr<hotel::Hotel>>& hotels);
 
-  std::vector<std::unique_ptr<hotel::Hotel>> createTestHotels(std::mt19937& rng);
-  std::unique_ptr<hotel::PlanningBoard> createTestPlanning(std::mt19937& rng, hotel::HotelCollection& hotels);
+  /**
+   * @brief resetReservationIds resets the ids of the reservations to 0 and moves them to the stored rooms
+   * The atoms of a room of generatedRoomIds are moved to the room at the same position in storedRoomIds, which hold the
+   * ids of the rooms once the hotels have been stored.
+   * @return false if the atoms refer to a room which is not part of generatedRoomIds
+   */
+  bool resetReservationIds(const std::vector<std::unique_ptr<hotel::Reservation>>& reservations,
+                           const std::vector<int>& generatedRoomIds, const std::vector<int>& storedRoomIds);
 
-} // namespaec cli
+} // namespace cli
 
 #endif // CLI_TESTDATA_H
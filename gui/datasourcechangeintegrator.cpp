@@ -1,18 +1,28 @@
 #include "gui/datasourcechangeintegrator.h"
 
+#include <QTimer>
+
 namespace gui
 {
+  namespace
+  {
+    // Time which may be spent on integrating results in one event loop iteration
+    const auto integrationTimeBudget = std::chrono::milliseconds(8);
+  } // namespace
 
-  ChangeIntegrator::ChangeIntegrator(persistence::DataSource* dataSource) : _ds(dataSource)
+  ChangeIntegrator::ChangeIntegrator(persistence::DataSource* dataSource)
+      : _ds(dataSource),
+        _notifier(new QSocketNotifier(dataSource->resultsAvailableFileDescriptor(), QSocketNotifier::Read, this))
   {
-    connect(this, SIGNAL(resultsAvailable()), this, SLOT(handleAvailableResults()));
-    _ds->taskCompletedSignal().connect([this](int) { this->emitResultsAvailable(); });
+    connect(_notifier, SIGNAL(activated(int)), this, SLOT(handleAvailableResults()));
   }
 
-  ChangeIntegrator::~ChangeIntegrator() { _ds->taskCompletedSignal().disconnect_all_slots(); }
-
-  void ChangeIntegrator::handleAvailableResults() { _ds->processIntegrationQueue(); }
-
-  void ChangeIntegrator::emitResultsAvailable() { emit resultsAvailable(); }
+  void ChangeIntegrator::handleAvailableResults()
+  {
+    // Integrate only a slice of the results per event loop iteration to keep the UI responsive while large amounts of
+    // data arrive. The rest is integrated on the next iteration.
+    if (_ds->processIntegrationQueue(integrationTimeBudget))
+      QTimer::singleShot(0, this, SLOT(handleAvailableResults()));
+  }
 
 } // namespace gui
@@ -4,6 +4,7 @@
 #include "persistence/datasource.h"
 
 #include <QObject>
+#include <QSocketNotifier>
 
 namespace gui
 {
@@ -11,25 +12,23 @@ namespace gui
    * @brief The ChangeIntegrator class observes the given data source and integrates any available changes.
    *
    * The main difficulty is that the data source events are triggered on an arbitrary thread, while the changes need
-   * to be integrated on the main thread.
+   * to be integrated on the main thread. The integrator watches the descriptor of the data source with a
+   * QSocketNotifier, thus the event loop wakes up once per burst of results without any cross-thread signals.
    */
   class ChangeIntegrator : public QObject
   {
     Q_OBJECT
   public:
     ChangeIntegrator(persistence::DataSource* dataSource);
-    ~ChangeIntegrator();
 
-  signals:
-    void resultsAvailable();
   private slots:
     void handleAvailableResults();
 
   private:
-    void emitResultsAvailable();
     persistence::DataSource* _ds;
+    QSocketNotifier* _notifier;
   };
 
 } // namespace gui
 
-#endif // GUI_STATUSBAR_H
+#endif // GUI_DATASOURCECHANGEINTEGRATOR_H
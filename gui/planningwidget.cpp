@@ -35,6 +35,7 @@ namespace gui
 
     // Wire up events
     connect(_dateBar, SIGNAL(dateClicked(boost::gregorian::date)), this, SLOT(setPivotDate(boost::gregorian::date)));
+    connect(_horizontalScrollbar, SIGNAL(valueChanged(int)), this, SLOT(loadVisiblePlanning()));
     _planningObserver.itemsAddedSignal.connect(boost::bind(&PlanningWidget::reservationsAdded, this, boost::placeholders::_1));
     _planningObserver.itemsRemovedSignal.connect(boost::bind(&PlanningWidget::reservationsRemoved, this, boost::placeholders::_1));
     _planningObserver.allItemsRemovedSignal.connect(boost::bind(&PlanningWidget::allReservationsRemoved, this));
@@ -68,6 +69,16 @@ namespace gui
     emit pivotDateChanged(pivotDate);
   }
 
+  void PlanningWidget::loadVisiblePlanning()
+  {
+    auto& layout = _context.layout();
+    auto visibleRect = _planningBoard->mapToScene(_planningBoard->viewport()->rect()).boundingRect();
+    auto firstDate = layout.getNearestDatePosition(visibleRect.left()).first;
+    auto lastDate = layout.getNearestDatePosition(visibleRect.right()).first;
+    _context.dataSource().ensurePlanningLoaded(
+        boost::gregorian::date_period(firstDate, lastDate + boost::gregorian::days(1)));
+  }
+
   void PlanningWidget::keyPressEvent(QKeyEvent* event)
   {
     if (event->key() == Qt::Key_F1)
@@ -80,7 +91,7 @@ namespace gui
       persistence::op::Operations removals;
       for (auto reservation : _context.selectedReservations())
         removals.push_back(persistence::op::DeleteReservation{reservation->id()});
-      _context.dataSource().queueOperations(std::move(removals));
+      _context.dataSource().queueOptimisticOperations(std::move(removals));
     }
 
     if (event->key() == Qt::Key_F1 || event->key() == Qt::Key_F2)
@@ -61,6 +61,10 @@ namespace gui
   public slots:
     void setPivotDate(boost::gregorian::date pivotDate);
 
+  private slots:
+    //! Requests the reservations in (and around) the currently visible date range from the data source
+    void loadVisiblePlanning();
+
   signals:
     void pivotDateChanged(boost::gregorian::date pivotDate);
 
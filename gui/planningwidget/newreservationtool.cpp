@@ -165,7 +165,7 @@ namespace gui
 
         namespace op = persistence::op;
         for (auto& reservation : reservations)
-          _context->dataSource().queueOperation(op::StoreNewReservation{std::move(reservation)});
+          _context->dataSource().queueOptimisticOperation(op::StoreNewReservation{std::move(reservation)});
       }
     }
 
@@ -18,14 +18,16 @@ int main(int argc, char** argv)
   QApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
   QApplication app(argc, argv);
 
-  persistence::DataSource dataSource("test.db");
+  // Only load the planning around the current date, the rest is loaded on demand when scrolling
+  auto today = boost::gregorian::day_clock::local_day();
+  auto initialWindow = boost::gregorian::date_period(today - boost::gregorian::days(14), today + boost::gregorian::days(90));
+  persistence::DataSource dataSource("test.db", initialWindow);
 
   gui::PlanningWidget widget(dataSource);
   widget.registerTool("new-reservation", std::make_unique<gui::planningwidget::NewReservationTool>());
   widget.activateTool("new-reservation");
   widget.show();
 
-  // TODO: We are basically polling for changes here. This should be replaced with a more robust notification mechanism
   gui::ChangeIntegrator integrator(&dataSource);
 
   return app.exec();
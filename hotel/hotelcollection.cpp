@@ -87,6 +87,14 @@ namespace hotel
     return categoryIds;
   }
 
+  Hotel *HotelCollection::findHotelById(int id)
+  {
+    for (auto& hotel : _hotels)
+      if (hotel->id() == id)
+        return hotel.get();
+    return nullptr;
+  }
+
   HotelRoom *HotelCollection::findRoomById(int id)
   {
     for (auto& hotel : _hotels)
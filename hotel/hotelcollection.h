@@ -33,6 +33,7 @@ namespace hotel
     std::vector<int> allRoomIDs() const;
     std::vector<int> allCategoryIDs() const;
 
+    hotel::Hotel* findHotelById(int id);
     hotel::HotelRoom* findRoomById(int id);
 
     std::vector<hotel::HotelRoom*> allRooms();
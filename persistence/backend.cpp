@@ -0,0 +1,219 @@
+#include "persistence/backend.h"
+
+#include "persistence/resultintegrator.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace persistence
+{
+  namespace
+  {
+    // Number of times the next task of a priority class may be passed over by higher classes before it is executed
+    const int starvationLimit = 4;
+    // Maximum number of tasks which share one transaction, such that the first of them are not delayed for too long
+    const size_t maxCommitGroupSize = 64;
+
+    //! Loading the initial data publishes partial results, which must not overtake those of earlier tasks
+    bool publishesPartialResults(const op::Operations& operations)
+    {
+      return std::any_of(operations.begin(), operations.end(), [](const op::Operation& operation) {
+        return boost::get<op::LoadInitialData>(&operation) != nullptr;
+      });
+    }
+  } // namespace
+
+  Backend::Backend()
+      : _nextOperationId(1), _resultIntegrator(nullptr), _currentTask(nullptr), _currentResults(nullptr),
+        _backendThread(), _quitBackendThread(false), _idleWorkPending(false), _uncommittedTasks(),
+        _transactionOpen(false), _workAvailableCondition(), _queueMutex(), _operationsQueues(), _passedOver()
+  {
+  }
+
+  Backend::~Backend() { assert(!_backendThread.joinable()); }
+
+  op::Task<op::OperationResults> Backend::queueOperation(op::Operations operations, op::TaskPriority priority)
+  {
+    // Create a task
+    auto sharedState = op::makeTaskSharedState<op::OperationResults>(_nextOperationId++);
+    op::Task<op::OperationResults> task(sharedState);
+
+    std::unique_lock<std::mutex> lock(_queueMutex);
+    auto pair = QueuedOperation{std::move(operations), sharedState};
+    _operationsQueues[static_cast<size_t>(priority)].push(std::move(pair));
+    lock.unlock();
+    _workAvailableCondition.notify_one();
+
+    return task;
+  }
+
+  void Backend::start(persistence::ResultIntegrator& resultIntegrator)
+  {
+    assert(!_backendThread.joinable());
+    _resultIntegrator = &resultIntegrator;
+    _backendThread = std::thread([this]() { this->threadMain(); });
+  }
+
+  void Backend::stopAndJoin()
+  {
+    assert(_backendThread.joinable());
+
+    _quitBackendThread = true;
+    _workAvailableCondition.notify_one();
+    _backendThread.join();
+  }
+
+  void Backend::threadMain()
+  {
+    auto hasQueuedOperations = [this]() {
+      return std::any_of(_operationsQueues.begin(), _operationsQueues.end(),
+                         [](auto& queue) { return !queue.empty(); });
+    };
+
+    while (!_quitBackendThread)
+    {
+      std::unique_lock<std::mutex> lock(_queueMutex);
+      if (!hasQueuedOperations())
+      {
+        // A group of tasks ends once no further task is ready
+        if (!_uncommittedTasks.empty())
+        {
+          lock.unlock();
+          commitGroup();
+          continue;
+        }
+        if (_idleWorkPending)
+        {
+          _idleWorkPending = false;
+          lock.unlock();
+          runIdleWork();
+          continue;
+        }
+        _workAvailableCondition.wait(lock);
+      }
+      else
+      {
+        auto operationsMessage = popNextOperation();
+        lock.unlock();
+
+        auto& sharedState = operationsMessage.second;
+        if (!sharedState->start())
+        {
+          // Cancelled tasks are skipped, the integrator still has to learn that the task is done. It learns so in order
+          // with the tasks waiting for the commit.
+          _uncommittedTasks.push_back(UncommittedTask{sharedState, op::OperationResults(), false});
+          if (!_transactionOpen)
+            commitGroup();
+          continue;
+        }
+
+        if (!_uncommittedTasks.empty() && publishesPartialResults(operationsMessage.first))
+          commitGroup();
+
+        op::OperationResults results;
+        _currentTask = sharedState.get();
+        _currentResults = &results;
+        if (!_transactionOpen)
+        {
+          beginTransaction();
+          _transactionOpen = true;
+        }
+        executeOperations(operationsMessage.first, results);
+        _currentTask = nullptr;
+        _currentResults = nullptr;
+
+        _uncommittedTasks.push_back(UncommittedTask{sharedState, std::move(results), true});
+        if (!groupsCommits() || _uncommittedTasks.size() >= maxCommitGroupSize)
+          commitGroup();
+      }
+    }
+
+    // The tasks which have already been executed are not abandoned
+    if (!_uncommittedTasks.empty())
+      commitGroup();
+  }
+
+  void Backend::commitGroup()
+  {
+    auto committed = !_transactionOpen || commitTransaction();
+    if (_transactionOpen)
+      _idleWorkPending = true;
+    _transactionOpen = false;
+
+    for (auto& task : _uncommittedTasks)
+    {
+      auto uniqueId = task.state->uniqueId();
+      if (!task.executed)
+      {
+        _resultIntegrator->pushResults(op::OperationResultsMessage{uniqueId, op::OperationResults(), true});
+        _taskCompletedSignal(uniqueId);
+        continue;
+      }
+
+      if (!committed)
+        task.results.push_back(op::CommitFailedResult());
+
+      // The results go to the integrator before the task is completed, such that anyone waiting for the task can
+      // integrate them right away. The integrator takes the stored objects over, the task keeps their ids.
+      auto taskResults = op::summarizeResults(task.results);
+      _resultIntegrator->pushResults(op::OperationResultsMessage{uniqueId, std::move(task.results), true});
+      task.state->setCompleted(std::move(taskResults));
+      _taskCompletedSignal(uniqueId);
+    }
+    _uncommittedTasks.clear();
+  }
+
+  Backend::QueuedOperation Backend::popNextOperation()
+  {
+    auto chosen = op::taskPriorityCount;
+    for (size_t priority = 0; priority < op::taskPriorityCount; ++priority)
+    {
+      if (!_operationsQueues[priority].empty())
+      {
+        chosen = priority;
+        break;
+      }
+    }
+    assert(chosen < op::taskPriorityCount);
+
+    // Lower classes which have been passed over too often get their turn, such that bulk work keeps progressing
+    for (auto priority = chosen + 1; priority < op::taskPriorityCount; ++priority)
+    {
+      if (!_operationsQueues[priority].empty() && _passedOver[priority] >= starvationLimit)
+      {
+        chosen = priority;
+        break;
+      }
+    }
+
+    _passedOver[chosen] = 0;
+    for (auto priority = chosen + 1; priority < op::taskPriorityCount; ++priority)
+      if (!_operationsQueues[priority].empty())
+        ++_passedOver[priority];
+
+    auto operation = std::move(_operationsQueues[chosen].front());
+    _operationsQueues[chosen].pop();
+    return operation;
+  }
+
+  void Backend::publishPartialResult(op::OperationResult result)
+  {
+    assert(_currentTask != nullptr && _currentResults != nullptr);
+    assert(_uncommittedTasks.empty());
+
+    // The results of the preceding operations of the task are published first to keep them in order
+    _currentResults->push_back(std::move(result));
+    _resultIntegrator->pushResults(
+        op::OperationResultsMessage{_currentTask->uniqueId(), std::move(*_currentResults), false});
+    _currentResults->clear();
+    _taskCompletedSignal(_currentTask->uniqueId());
+  }
+
+  void Backend::executeOperations(op::Operations& operations, op::OperationResults& results)
+  {
+    results.reserve(results.size() + operations.size());
+    for (auto& operation : operations)
+      results.push_back(boost::apply_visitor([this](auto& op) { return this->executeOperation(op); }, operation));
+  }
+
+} // namespace persistence
@@ -0,0 +1,136 @@
+#ifndef PERSISTENCE_BACKEND_H
+#define PERSISTENCE_BACKEND_H
+
+#include "persistence/op/operations.h"
+#include "persistence/op/results.h"
+#include "persistence/op/task.h"
+
+#include <boost/signals2.hpp>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace persistence
+{
+  class ResultIntegrator;
+
+  /**
+   * @brief The Backend class executes the queued operations on a worker thread
+   *
+   * The base class implements the task queues, the worker thread and the delivery of the results to the integrator.
+   * Concrete backends implement the storage by overriding the executeOperation() functions, which are only called on
+   * the worker thread.
+   */
+  class Backend
+  {
+  public:
+    Backend();
+    virtual ~Backend();
+
+    op::Task<op::OperationResults> queueOperation(op::Operations operations,
+                                                  op::TaskPriority priority = op::TaskPriority::Normal);
+
+    void start(persistence::ResultIntegrator& resultIntegrator);
+    void stopAndJoin();
+
+    /**
+     * @brief taskCompletedSignal returns the signal which is triggered when operations have been completed and results
+     * are available
+     * The signal is also triggered when a long running task publishes a part of its results.
+     * @note The signal is not called on the main thread, but on the backend worker thread
+     */
+    boost::signals2::signal<void(int)>& taskCompletedSignal() { return _taskCompletedSignal; }
+
+  protected:
+    /**
+     * @brief executeOperations executes the operations of one task and appends their results
+     * The default implementation executes the operations one by one.
+     */
+    virtual void executeOperations(op::Operations& operations, op::OperationResults& results);
+    /**
+     * @brief Called around executeOperations(), such that all operations of a task can be executed under one transaction
+     * commitTransaction() returns false if the changes could not be made durable. An op::CommitFailedResult is then
+     * appended to the results of each task of the transaction.
+     */
+    virtual void beginTransaction() {}
+    virtual bool commitTransaction() { return true; }
+    /**
+     * @brief groupsCommits returns true if the tasks which are executed in a row share one transaction
+     * Tasks which are queued by the time a task has been executed then join its transaction, which is committed once
+     * no task is ready anymore. The tasks are completed together after the commit, and all of them fail if it fails.
+     * This saves e.g. a sync to disk per task, at the expense of the latency of the earlier tasks of a group.
+     */
+    virtual bool groupsCommits() const { return false; }
+    /**
+     * @brief runIdleWork is called on the worker thread once the queues have run empty after executing tasks
+     * Backends defer housekeeping which no task waits for, e.g. writing a snapshot, to this point. A task queued in the
+     * meantime is only started once the function returns.
+     */
+    virtual void runIdleWork() {}
+
+    //! Publishes a result of the currently executed task before the whole task has been completed
+    void publishPartialResult(op::OperationResult result);
+
+    virtual op::OperationResult executeOperation(op::EraseAllData&) = 0;
+    virtual op::OperationResult executeOperation(op::LoadInitialData& op) = 0;
+    virtual op::OperationResult executeOperation(op::LoadPlanningWindow& op) = 0;
+    virtual op::OperationResult executeOperation(op::StoreNewHotel& op) = 0;
+    virtual op::OperationResult executeOperation(op::StoreNewReservation& op) = 0;
+    virtual op::OperationResult executeOperation(op::StoreNewPerson& op) = 0;
+    virtual op::OperationResult executeOperation(op::DeleteReservation& op) = 0;
+    virtual op::OperationResult executeOperation(op::LeaseIds& op) = 0;
+
+  private:
+    typedef std::shared_ptr<op::TaskSharedState<op::OperationResults>> SharedState;
+    typedef std::pair<op::Operations, SharedState> QueuedOperation;
+
+    void threadMain();
+    //! Commits the transaction of the tasks waiting for it and hands their results over
+    void commitGroup();
+
+    //! Removes the next operation to execute from the queues, must be called with the queue mutex being locked
+    QueuedOperation popNextOperation();
+
+    // Operations may be queued from any thread
+    std::atomic<int> _nextOperationId;
+
+    // Receives the results of all tasks
+    persistence::ResultIntegrator* _resultIntegrator;
+
+    // Task executed by the backend thread and the results it has produced so far
+    op::TaskSharedState<op::OperationResults>* _currentTask;
+    op::OperationResults* _currentResults;
+
+    std::thread _backendThread;
+    std::atomic<bool> _quitBackendThread;
+    // Whether tasks have been executed since runIdleWork() has last been called, only used by the backend thread
+    bool _idleWorkPending;
+
+    // Task which has been executed or cancelled and waits for the transaction of its group to be committed
+    struct UncommittedTask
+    {
+      SharedState state;
+      op::OperationResults results;
+      bool executed;
+    };
+    // Tasks waiting for the commit in the order of their execution, and whether a transaction has been begun
+    std::vector<UncommittedTask> _uncommittedTasks;
+    bool _transactionOpen;
+    std::condition_variable _workAvailableCondition;
+
+    std::mutex _queueMutex;
+    std::array<std::queue<QueuedOperation>, op::taskPriorityCount> _operationsQueues;
+    // Number of times the next task of each priority class has been passed over by a higher class
+    std::array<int, op::taskPriorityCount> _passedOver;
+    boost::signals2::signal<void(int)> _taskCompletedSignal;
+  };
+
+} // namespace persistence
+
+#endif // PERSISTENCE_BACKEND_H
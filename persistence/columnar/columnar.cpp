@@ -0,0 +1,420 @@
+#include "persistence/columnar/columnar.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+
+namespace persistence
+{
+  namespace columnar
+  {
+    namespace
+    {
+      // A file consists of the header, the chunks of all columns, the footer describing the chunks, and the trailer
+      // pointing to the footer. The trailer is written last, a file cut short lacks its magic. Values are stored in
+      // native byte order.
+      const char columnarMagic[8] = {'H', 'O', 'T', 'E', 'L', 'C', 'O', 'L'};
+
+      struct Header
+      {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+      };
+
+      struct FooterHeader
+      {
+        uint64_t reservationCount;
+        uint64_t atomCount;
+        uint32_t chunkEntryCount;
+        uint32_t dictionaryEntryCount;
+        uint64_t dictionarySize; // Each entry is stored as its length (uint32) followed by its characters
+      };
+
+      struct Trailer
+      {
+        uint64_t footerOffset;
+        char magic[8];
+      };
+
+      enum class Encoding : uint32_t
+      {
+        Plain = 1,      // int32 values
+        DeltaVarint = 2 // Zigzag encoded differences to the previous value as LEB128 varints, the first one to 0
+      };
+
+      const size_t chunkAlignment = 8;
+
+      bool isAtomColumn(Column column) { return column >= Column::AtomReservationId; }
+
+      void encodeDeltaVarint(const std::vector<int32_t>& values, std::vector<char>& output)
+      {
+        int64_t previous = 0;
+        for (auto value : values)
+        {
+          auto delta = static_cast<int64_t>(value) - previous;
+          previous = value;
+          auto zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+          while (zigzag >= 0x80)
+          {
+            output.push_back(static_cast<char>(zigzag | 0x80));
+            zigzag >>= 7;
+          }
+          output.push_back(static_cast<char>(zigzag));
+        }
+      }
+
+      bool decodeDeltaVarint(const char* data, size_t size, size_t count, std::vector<int32_t>& values)
+      {
+        values.resize(count);
+        auto end = data + size;
+        int64_t previous = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+          uint64_t zigzag = 0;
+          for (int shift = 0;; shift += 7)
+          {
+            if (data == end || shift > 63)
+              return false;
+            auto byte = static_cast<unsigned char>(*data++);
+            zigzag |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+              break;
+          }
+          auto delta = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+          previous += delta;
+          if (previous < std::numeric_limits<int32_t>::min() || previous > std::numeric_limits<int32_t>::max())
+            return false;
+          values[i] = static_cast<int32_t>(previous);
+        }
+        return data == end;
+      }
+    } // namespace
+
+    struct ColumnarReader::ChunkEntry
+    {
+      uint32_t column;
+      uint32_t encoding;
+      uint32_t chunk; // Index of the chunk within its column
+      uint32_t rowCount;
+      int32_t min;
+      int32_t max;
+      uint64_t offset;
+      uint64_t size;
+    };
+
+    bool writeColumnar(const std::string& path, const hotel::PlanningBoard& planning, const WriteOptions& options)
+    {
+      typedef ColumnarReader::ChunkEntry ChunkEntry;
+
+      // Atoms are ordered by their start, such that the chunks cover short periods and can be skipped by date
+      auto reservations = planning.reservations();
+      std::sort(reservations.begin(), reservations.end(), [](auto a, auto b) { return a->id() < b->id(); });
+      std::vector<std::pair<int32_t, const hotel::ReservationAtom*>> atoms;
+      for (auto reservation : reservations)
+        for (auto& atom : reservation->atoms())
+          atoms.emplace_back(reservation->id(), &atom);
+      std::stable_sort(atoms.begin(), atoms.end(), [](auto& a, auto& b) {
+        return a.second->dateRange().begin() < b.second->dateRange().begin();
+      });
+
+      std::vector<std::string> dictionary;
+      std::unordered_map<std::string, int32_t> dictionaryIndices;
+      auto descriptionIndex = [&](const std::string& description) {
+        auto entry = dictionaryIndices.emplace(description, static_cast<int32_t>(dictionary.size()));
+        if (entry.second)
+          dictionary.push_back(description);
+        return entry.first->second;
+      };
+
+      auto temporaryPath = path + ".tmp";
+      std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+      Header header;
+      std::memcpy(header.magic, columnarMagic, sizeof(columnarMagic));
+      header.version = columnarVersion;
+      header.headerSize = sizeof(Header);
+      stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      uint64_t position = sizeof(Header);
+
+      std::vector<ChunkEntry> entries;
+      std::vector<int32_t> values;
+      std::vector<char> encoded;
+      auto writeChunk = [&](Column column, uint32_t chunk) {
+        ChunkEntry entry{static_cast<uint32_t>(column), 0, chunk, static_cast<uint32_t>(values.size()), 0, 0, position,
+                         0};
+        if (!values.empty())
+        {
+          auto minMax = std::minmax_element(values.begin(), values.end());
+          entry.min = *minMax.first;
+          entry.max = *minMax.second;
+        }
+
+        encoded.clear();
+        if (options.compress)
+        {
+          entry.encoding = static_cast<uint32_t>(Encoding::DeltaVarint);
+          encodeDeltaVarint(values, encoded);
+        }
+        else
+        {
+          entry.encoding = static_cast<uint32_t>(Encoding::Plain);
+          auto bytes = reinterpret_cast<const char*>(values.data());
+          encoded.assign(bytes, bytes + values.size() * sizeof(int32_t));
+        }
+        entry.size = encoded.size();
+        encoded.resize((encoded.size() + chunkAlignment - 1) / chunkAlignment * chunkAlignment, 0);
+        stream.write(encoded.data(), encoded.size());
+        position += encoded.size();
+        entries.push_back(entry);
+      };
+
+      auto rowsPerChunk = std::max<uint32_t>(options.rowsPerChunk, 1);
+      for (size_t begin = 0, chunk = 0; begin < reservations.size(); begin += rowsPerChunk, ++chunk)
+      {
+        auto end = std::min(begin + rowsPerChunk, reservations.size());
+        auto writeColumn = [&](Column column, auto value) {
+          values.clear();
+          for (auto i = begin; i < end; ++i)
+            values.push_back(value(*reservations[i]));
+          writeChunk(column, chunk);
+        };
+        writeColumn(Column::ReservationId, [](auto& r) { return r.id(); });
+        writeColumn(Column::ReservationStatus, [](auto& r) { return static_cast<int32_t>(r.status()); });
+        writeColumn(Column::ReservationAdults, [](auto& r) { return r.numberOfAdults(); });
+        writeColumn(Column::ReservationChildren, [](auto& r) { return r.numberOfChildren(); });
+        writeColumn(Column::ReservationDescription, [&](auto& r) { return descriptionIndex(r.description()); });
+      }
+      for (size_t begin = 0, chunk = 0; begin < atoms.size(); begin += rowsPerChunk, ++chunk)
+      {
+        auto end = std::min(begin + rowsPerChunk, atoms.size());
+        auto writeColumn = [&](Column column, auto value) {
+          values.clear();
+          for (auto i = begin; i < end; ++i)
+            values.push_back(value(atoms[i]));
+          writeChunk(column, chunk);
+        };
+        writeColumn(Column::AtomReservationId, [](auto& a) { return a.first; });
+        writeColumn(Column::AtomRoomId, [](auto& a) { return a.second->roomId(); });
+        writeColumn(Column::AtomDateFrom,
+                    [](auto& a) { return static_cast<int32_t>(a.second->dateRange().begin().day_number()); });
+        writeColumn(Column::AtomDateTo,
+                    [](auto& a) { return static_cast<int32_t>(a.second->dateRange().end().day_number()); });
+      }
+
+      std::vector<char> dictionaryData;
+      for (auto& description : dictionary)
+      {
+        auto length = static_cast<uint32_t>(description.size());
+        auto lengthBytes = reinterpret_cast<const char*>(&length);
+        dictionaryData.insert(dictionaryData.end(), lengthBytes, lengthBytes + sizeof(length));
+        dictionaryData.insert(dictionaryData.end(), description.begin(), description.end());
+      }
+
+      FooterHeader footer{reservations.size(), atoms.size(), static_cast<uint32_t>(entries.size()),
+                          static_cast<uint32_t>(dictionary.size()), dictionaryData.size()};
+      Trailer trailer;
+      trailer.footerOffset = position;
+      std::memcpy(trailer.magic, columnarMagic, sizeof(columnarMagic));
+      stream.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+      stream.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ChunkEntry));
+      stream.write(dictionaryData.data(), dictionaryData.size());
+      stream.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+
+      if (!stream.flush())
+      {
+        std::cerr << "Cannot write columnar file: " << temporaryPath << std::endl;
+        std::remove(temporaryPath.c_str());
+        return false;
+      }
+      stream.close();
+      if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+      {
+        std::cerr << "Cannot replace columnar file: " << path << std::endl;
+        std::remove(temporaryPath.c_str());
+        return false;
+      }
+      return true;
+    }
+
+    ColumnarReader::ColumnarReader(const std::string& path)
+        : _file(path, sizeof(Header) + sizeof(Trailer)), _dictionary(), _chunks()
+    {
+      if (!_file.empty() && !validate())
+      {
+        std::cerr << "Ignoring invalid columnar file: " << path << std::endl;
+        _file.reset();
+        _dictionary.clear();
+        _chunks = {};
+      }
+    }
+
+    bool ColumnarReader::validate()
+    {
+      auto& header = *reinterpret_cast<const Header*>(_file.data());
+      auto& trailer = *reinterpret_cast<const Trailer*>(_file.data() + _file.size() - sizeof(Trailer));
+      if (std::memcmp(header.magic, columnarMagic, sizeof(columnarMagic)) != 0 || header.version != columnarVersion ||
+          header.headerSize != sizeof(Header) || std::memcmp(trailer.magic, columnarMagic, sizeof(columnarMagic)) != 0)
+        return false;
+
+      auto footerEnd = _file.size() - sizeof(Trailer);
+      if (trailer.footerOffset < sizeof(Header) || trailer.footerOffset % chunkAlignment != 0 ||
+          trailer.footerOffset + sizeof(FooterHeader) > footerEnd)
+        return false;
+      auto& footer = *reinterpret_cast<const FooterHeader*>(_file.data() + trailer.footerOffset);
+      auto entriesOffset = trailer.footerOffset + sizeof(FooterHeader);
+      if (entriesOffset + static_cast<uint64_t>(footer.chunkEntryCount) * sizeof(ChunkEntry) + footer.dictionarySize !=
+          footerEnd)
+        return false;
+
+      // Scans trust the offsets and sizes of the footer, only the encoded chunk data is checked while decoding
+      auto dictionary = _file.data() + entriesOffset + footer.chunkEntryCount * sizeof(ChunkEntry);
+      auto dictionaryEnd = dictionary + footer.dictionarySize;
+      for (uint32_t i = 0; i < footer.dictionaryEntryCount; ++i)
+      {
+        uint32_t length;
+        if (static_cast<size_t>(dictionaryEnd - dictionary) < sizeof(length))
+          return false;
+        std::memcpy(&length, dictionary, sizeof(length));
+        dictionary += sizeof(length);
+        if (static_cast<size_t>(dictionaryEnd - dictionary) < length)
+          return false;
+        _dictionary.emplace_back(dictionary, length);
+        dictionary += length;
+      }
+
+      auto entries = reinterpret_cast<const ChunkEntry*>(_file.data() + entriesOffset);
+      for (uint32_t i = 0; i < footer.chunkEntryCount; ++i)
+      {
+        auto& entry = entries[i];
+        auto plain = entry.encoding == static_cast<uint32_t>(Encoding::Plain);
+        if (entry.column >= columnCount || (!plain && entry.encoding != static_cast<uint32_t>(Encoding::DeltaVarint)) ||
+            entry.offset < sizeof(Header) || entry.offset % chunkAlignment != 0 ||
+            entry.offset + entry.size > trailer.footerOffset ||
+            (plain && entry.size != static_cast<uint64_t>(entry.rowCount) * sizeof(int32_t)))
+          return false;
+
+        auto& chunks = _chunks[isAtomColumn(static_cast<Column>(entry.column)) ? Atoms : Reservations];
+        auto index = static_cast<size_t>(entry.chunk) * columnCount + entry.column;
+        if (entry.chunk > footer.reservationCount + footer.atomCount)
+          return false;
+        if (chunks.size() <= index)
+          chunks.resize((entry.chunk + 1) * columnCount, nullptr);
+        if (chunks[index] != nullptr)
+          return false;
+        chunks[index] = &entry;
+      }
+
+      // Each chunk holds all columns of its table, with the same number of rows
+      auto validateTable = [&](Table table, Column first, Column last, uint64_t rowCount) {
+        uint64_t rows = 0;
+        auto& chunks = _chunks[table];
+        for (size_t chunk = 0; chunk < chunks.size() / columnCount; ++chunk)
+        {
+          auto entry = chunks[chunk * columnCount + static_cast<size_t>(first)];
+          if (entry == nullptr)
+            return false;
+          for (auto column = static_cast<size_t>(first); column <= static_cast<size_t>(last); ++column)
+          {
+            auto other = chunks[chunk * columnCount + column];
+            if (other == nullptr || other->rowCount != entry->rowCount)
+              return false;
+          }
+          rows += entry->rowCount;
+        }
+        return rows == rowCount;
+      };
+      return validateTable(Reservations, Column::ReservationId, Column::ReservationDescription,
+                           footer.reservationCount) &&
+             validateTable(Atoms, Column::AtomReservationId, Column::AtomDateTo, footer.atomCount);
+    }
+
+    uint64_t ColumnarReader::reservationCount() const
+    {
+      auto& trailer = *reinterpret_cast<const Trailer*>(_file.data() + _file.size() - sizeof(Trailer));
+      return reinterpret_cast<const FooterHeader*>(_file.data() + trailer.footerOffset)->reservationCount;
+    }
+
+    uint64_t ColumnarReader::atomCount() const
+    {
+      auto& trailer = *reinterpret_cast<const Trailer*>(_file.data() + _file.size() - sizeof(Trailer));
+      return reinterpret_cast<const FooterHeader*>(_file.data() + trailer.footerOffset)->atomCount;
+    }
+
+    const std::string& ColumnarReader::description(int32_t index) const
+    {
+      static const std::string unknown;
+      return index >= 0 && static_cast<size_t>(index) < _dictionary.size() ? _dictionary[index] : unknown;
+    }
+
+    void ColumnarReader::scanReservations(const std::vector<Column>& columns, const BatchConsumer& consumer) const
+    {
+      scan(Reservations, columns, boost::none, consumer);
+    }
+
+    size_t ColumnarReader::scanAtoms(const std::vector<Column>& columns,
+                                     boost::optional<boost::gregorian::date_period> window,
+                                     const BatchConsumer& consumer) const
+    {
+      return scan(Atoms, columns, window, consumer);
+    }
+
+    size_t ColumnarReader::scan(Table table, const std::vector<Column>& columns,
+                                boost::optional<boost::gregorian::date_period> window,
+                                const BatchConsumer& consumer) const
+    {
+      auto& chunks = _chunks[table];
+      std::array<std::vector<int32_t>, columnCount> buffers;
+      size_t scannedChunks = 0;
+      for (size_t chunk = 0; chunk < chunks.size() / columnCount; ++chunk)
+      {
+        auto entries = chunks.data() + chunk * columnCount;
+        if (window)
+        {
+          auto windowBegin = static_cast<int32_t>(window->begin().day_number());
+          auto windowEnd = static_cast<int32_t>(window->end().day_number());
+          auto from = entries[static_cast<size_t>(Column::AtomDateFrom)];
+          auto to = entries[static_cast<size_t>(Column::AtomDateTo)];
+          if (from->rowCount == 0 || from->min >= windowEnd || to->max <= windowBegin)
+            continue;
+        }
+
+        Batch batch;
+        batch.rowCount = entries[static_cast<size_t>(table == Atoms ? Column::AtomReservationId
+                                                                    : Column::ReservationId)]->rowCount;
+        batch.columns.fill(nullptr);
+        bool damaged = false;
+        for (auto column : columns)
+        {
+          auto entry = entries[static_cast<size_t>(column)];
+          if (entry == nullptr)
+            continue;
+          auto data = _file.data() + entry->offset;
+          if (entry->encoding == static_cast<uint32_t>(Encoding::Plain))
+            batch.columns[static_cast<size_t>(column)] = reinterpret_cast<const int32_t*>(data);
+          else
+          {
+            auto& buffer = buffers[static_cast<size_t>(column)];
+            if (!decodeDeltaVarint(data, entry->size, entry->rowCount, buffer))
+            {
+              std::cerr << "Skipping damaged chunk " << chunk << " of column " << entry->column << std::endl;
+              damaged = true;
+              break;
+            }
+            batch.columns[static_cast<size_t>(column)] = buffer.data();
+          }
+        }
+        if (damaged)
+          continue;
+
+        consumer(batch);
+        ++scannedChunks;
+      }
+      return scannedChunks;
+    }
+
+  } // namespace columnar
+} // namespace persistence
@@ -0,0 +1,137 @@
+#ifndef PERSISTENCE_COLUMNAR_COLUMNAR_H
+#define PERSISTENCE_COLUMNAR_COLUMNAR_H
+
+#include "persistence/mappedfile.h"
+
+#include "hotel/planning.h"
+
+#include <boost/optional.hpp>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace persistence
+{
+  namespace columnar
+  {
+    /**
+     * @brief Version of the columnar format
+     * Files of other versions are rejected. Increase it whenever the layout or the meaning of a column changes.
+     */
+    const uint32_t columnarVersion = 1;
+
+    /**
+     * @brief Columns of the two tables of a columnar file
+     *
+     * The reservations table holds one row per reservation, ordered by id. The description is an index into the
+     * dictionary of the file, see ColumnarReader::description(). The atoms table holds one row per reservation atom,
+     * ordered by the start date. Dates are day numbers, as used by boost::gregorian.
+     */
+    enum class Column
+    {
+      ReservationId,
+      ReservationStatus,
+      ReservationAdults,
+      ReservationChildren,
+      ReservationDescription,
+      AtomReservationId,
+      AtomRoomId,
+      AtomDateFrom,
+      AtomDateTo
+    };
+    const size_t columnCount = 9;
+
+    struct WriteOptions
+    {
+      //! Number of rows in each chunk of a column, the unit in which chunks are skipped
+      uint32_t rowsPerChunk = 16384;
+      //! Stores the columns as varints of the differences between consecutive values instead of plain integers
+      bool compress = true;
+    };
+
+    /**
+     * @brief writeColumnar writes the reservations of the board to a columnar file
+     *
+     * Each column is split into chunks of consecutive rows, stored along with the minimum and maximum value of the
+     * chunk. Readers never see a partial file, it is only renamed to the given path once it is complete.
+     * @return false if the file cannot be written
+     */
+    bool writeColumnar(const std::string& path, const hotel::PlanningBoard& planning,
+                       const WriteOptions& options = WriteOptions());
+
+    /**
+     * @brief The ColumnarReader class maps a columnar file into memory and scans selected columns
+     *
+     * Only the chunks of the requested columns are read. Plain chunks are handed out in place, compressed ones are
+     * decoded into a buffer which is reused for all chunks of a scan.
+     */
+    class ColumnarReader
+    {
+    public:
+      /**
+       * @brief The Batch struct holds the values of the requested columns for a run of consecutive rows
+       * The values are only valid while the consumer runs.
+       */
+      struct Batch
+      {
+        size_t rowCount;
+        std::array<const int32_t*, columnCount> columns;
+
+        //! Returns the values of the given column, nullptr if it has not been requested
+        const int32_t* column(Column column) const { return columns[static_cast<size_t>(column)]; }
+      };
+      typedef std::function<void(const Batch&)> BatchConsumer;
+
+      //! Maps the given file and reads its footer, check valid() before scanning
+      explicit ColumnarReader(const std::string& path);
+      ColumnarReader(const ColumnarReader&) = delete;
+      ColumnarReader& operator=(const ColumnarReader&) = delete;
+
+      //! Returns false if the file is missing, has been written by another version, or its footer is damaged
+      bool valid() const { return !_file.empty(); }
+      uint64_t reservationCount() const;
+      uint64_t atomCount() const;
+
+      //! Returns the description with the given index in the dictionary
+      const std::string& description(int32_t index) const;
+
+      //! Hands the given columns of all reservations to the consumer, chunk by chunk, skipping damaged chunks
+      void scanReservations(const std::vector<Column>& columns, const BatchConsumer& consumer) const;
+      /**
+       * @brief Hands the given columns of the atoms to the consumer, chunk by chunk
+       * If a window is given, the chunks whose atoms all lie outside of it are skipped. The atoms of the other chunks
+       * are handed out completely and need to be filtered by the consumer. Chunks whose data is damaged are skipped
+       * as well, with a message.
+       * @return The number of chunks which have been handed out
+       */
+      size_t scanAtoms(const std::vector<Column>& columns, boost::optional<boost::gregorian::date_period> window,
+                       const BatchConsumer& consumer) const;
+
+    private:
+      friend bool writeColumnar(const std::string& path, const hotel::PlanningBoard& planning,
+                                const WriteOptions& options);
+
+      struct ChunkEntry;
+      enum Table
+      {
+        Reservations,
+        Atoms
+      };
+
+      bool validate();
+      size_t scan(Table table, const std::vector<Column>& columns,
+                  boost::optional<boost::gregorian::date_period> window, const BatchConsumer& consumer) const;
+
+      MappedFile _file;
+      std::vector<std::string> _dictionary;
+      // For each table, the entries of all columns of each chunk, at chunk * columnCount + column
+      std::array<std::vector<const ChunkEntry*>, 2> _chunks;
+    };
+
+  } // namespace columnar
+} // namespace persistence
+
+#endif // PERSISTENCE_COLUMNAR_COLUMNAR_H
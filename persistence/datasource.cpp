@@ -1,20 +1,69 @@
 #include "persistence/datasource.h"
 
+#include "persistence/sqlite/sqlitebackend.h"
+
 #include <algorithm>
 #include <iostream>
 
 namespace persistence
 {
-  DataSource::DataSource(const std::string& databaseFile)
-      : _backend(databaseFile), _resultIntegrator(), _nextOperationId(0)
+  namespace
+  {
+    // Length of one page of the planning, which is loaded as a whole
+    const int planningPageDays = 56;
+
+    // Number of ids leased at once, and the number of remaining ids at which the next lease is requested
+    const int idLeaseSize = 256;
+    const int idLeaseLowWatermark = 64;
+
+    int planningPageIndex(boost::gregorian::date date)
+    {
+      return static_cast<int>(date.day_number() / planningPageDays);
+    }
+
+    boost::gregorian::date planningPageBegin(int page)
+    {
+      using namespace boost::gregorian;
+      return date(gregorian_calendar::from_day_number(page * planningPageDays));
+    }
+  } // namespace
+
+  DataSource::DataSource(const std::string& databaseFile,
+                         boost::optional<boost::gregorian::date_period> initialPlanningWindow)
+      : DataSource(std::make_unique<sqlite::SqliteBackend>(databaseFile), initialPlanningWindow)
   {
-    _backend.start(_resultIntegrator);
-    queueOperation(op::LoadInitialData());
+  }
+
+  DataSource::DataSource(std::unique_ptr<Backend> backend,
+                         boost::optional<boost::gregorian::date_period> initialPlanningWindow)
+      : _backend(std::move(backend)), _resultIntegrator(), _nextOperationId(0), _nextProvisionalId(-1),
+        _planningFullyLoaded(!initialPlanningWindow), _requestedPlanningPages(), _queuedPlanningResets(0),
+        _lastResetPriority(op::TaskPriority::Interactive)
+  {
+    _backend->start(_resultIntegrator);
+
+    // The initial load resets the planning once, the pages requested here are part of it
+    if (initialPlanningWindow && !initialPlanningWindow->is_null())
+    {
+      // Load the pages covering the window plus a margin of one page on each side
+      auto firstPage = planningPageIndex(initialPlanningWindow->begin()) - 1;
+      auto lastPage = planningPageIndex(initialPlanningWindow->last()) + 1;
+      auto window = boost::gregorian::date_period(planningPageBegin(firstPage), planningPageBegin(lastPage + 1));
+      queueOperation(op::LoadInitialData{window}, op::TaskPriority::Interactive);
+      for (auto page = firstPage; page <= lastPage; ++page)
+        _requestedPlanningPages[page] = _queuedPlanningResets;
+    }
+    else
+    {
+      _planningFullyLoaded = true;
+      queueOperation(op::LoadInitialData(), op::TaskPriority::Interactive);
+    }
+    requestIdLeases();
   }
 
   DataSource::~DataSource()
   {
-    _backend.stopAndJoin();
+    _backend->stopAndJoin();
   }
 
   hotel::HotelCollection& DataSource::hotels() { return _resultIntegrator.hotels(); }
@@ -22,28 +71,234 @@ namespace persistence
   hotel::PlanningBoard& DataSource::planning() { return _resultIntegrator.planning(); }
   const hotel::PlanningBoard& DataSource::planning() const { return _resultIntegrator.planning(); }
 
-  op::Task<op::OperationResults> DataSource::queueOperation(op::Operation operation)
+  op::Task<op::OperationResults> DataSource::queueOperation(op::Operation operation, op::TaskPriority priority)
+  {
+    op::Operations item;
+    item.push_back(std::move(operation));
+    return queueOperations(std::move(item), priority);
+  }
+
+  op::Task<op::OperationResults> DataSource::queueOperations(op::Operations operations, op::TaskPriority priority)
+  {
+    for (auto& operation : operations)
+    {
+      if (boost::get<op::EraseAllData>(&operation) != nullptr || boost::get<op::LoadInitialData>(&operation) != nullptr)
+      {
+        ++_queuedPlanningResets;
+        _lastResetPriority = priority;
+      }
+    }
+
+    assignIds(operations);
+    _resultIntegrator.addPendingOperation();
+    auto task = _backend->queueOperation(std::move(operations), priority);
+    requestIdLeases();
+    return task;
+  }
+
+  void DataSource::assignIds(op::Operations& operations)
+  {
+    // Objects which already have an id keep it. If the leased ids run out, the backend assigns the remaining ones.
+    auto& allocator = _resultIntegrator.idAllocator();
+    auto assign = [&](hotel::PersistentObject& object, op::IdSpace space) {
+      if (object.id() == 0)
+        object.setId(allocator.takeId(space));
+    };
+
+    for (auto& operation : operations)
+    {
+      if (auto store = boost::get<op::StoreNewHotel>(&operation))
+      {
+        if (store->newHotel == nullptr)
+          continue;
+        assign(*store->newHotel, op::IdSpace::Hotel);
+        for (auto& category : store->newHotel->categories())
+          assign(*category, op::IdSpace::RoomCategory);
+        for (auto& room : store->newHotel->rooms())
+          assign(*room, op::IdSpace::Room);
+      }
+      else if (auto store = boost::get<op::StoreNewReservation>(&operation))
+      {
+        if (store->newReservation == nullptr)
+          continue;
+        assign(*store->newReservation, op::IdSpace::Reservation);
+        for (auto& atom : store->newReservation->atoms())
+          assign(atom, op::IdSpace::ReservationAtom);
+      }
+    }
+  }
+
+  void DataSource::requestIdLeases()
+  {
+    auto& allocator = _resultIntegrator.idAllocator();
+    op::Operations leases;
+    std::vector<op::IdSpace> spaces;
+    for (size_t i = 0; i < op::idSpaceCount; ++i)
+    {
+      auto space = static_cast<op::IdSpace>(i);
+      if (!allocator.requestLease(space, idLeaseLowWatermark))
+        continue;
+      leases.push_back(op::LeaseIds{space, idLeaseSize});
+      spaces.push_back(space);
+    }
+
+    // The leases are short, and the next new objects depend on them
+    if (leases.empty())
+      return;
+    _resultIntegrator.addPendingOperation();
+    auto task = _backend->queueOperation(std::move(leases), op::TaskPriority::Interactive);
+
+    // The integrator skips the results of a task which fails to commit. The requests which have not been answered by
+    // then are cancelled, otherwise no lease would ever be requested again for their spaces.
+    task.then(_resultIntegrator, [&allocator, spaces](op::Task<op::OperationResults>& task) {
+      std::vector<op::IdSpace> granted;
+      if (!task.cancelled() && !task.results().empty() &&
+          boost::get<op::CommitFailedResult>(&task.results().back()) == nullptr)
+      {
+        for (auto& result : task.results())
+          if (auto lease = boost::get<op::LeaseIdsResult>(&result))
+            granted.push_back(lease->space);
+      }
+      for (auto space : spaces)
+        if (std::find(granted.begin(), granted.end(), space) == granted.end())
+          allocator.cancelLeaseRequest(space);
+    });
+  }
+
+  op::Task<op::OperationResults> DataSource::queueOptimisticOperation(op::Operation operation)
   {
     op::Operations item;
     item.push_back(std::move(operation));
-    return queueOperations(std::move(item));
+    return queueOptimisticOperations(std::move(item));
   }
 
-  op::Task<op::OperationResults> DataSource::queueOperations(op::Operations operations)
+  op::Task<op::OperationResults> DataSource::queueOptimisticOperations(op::Operations operations)
   {
-    auto task = _backend.queueOperation(std::move(operations));
-    _resultIntegrator.addPendingOperation(task);
+    // The local changes are applied before the operations are handed over to the backend. New reservations already
+    // carry their final id if one could be assigned from the leases. The results are integrated on this thread, thus
+    // they cannot overtake the local changes.
+    assignIds(operations);
+    bool applied = true;
+    for (auto& operation : operations)
+    {
+      if (auto store = boost::get<op::StoreNewReservation>(&operation))
+      {
+        if (store->newReservation == nullptr)
+          continue;
+        store->provisionalId = (store->newReservation->id() != 0) ? store->newReservation->id() : _nextProvisionalId--;
+        auto reservation = std::make_unique<hotel::Reservation>(*store->newReservation);
+        reservation->setId(store->provisionalId);
+        if (!_resultIntegrator.addProvisionalReservation(ResultIntegrator::unqueuedTaskId, std::move(reservation)))
+        {
+          std::cerr << "Cannot add reservation " << store->newReservation->description()
+                    << ": it conflicts with the planning" << std::endl;
+          applied = false;
+          break;
+        }
+      }
+      else if (auto erase = boost::get<op::DeleteReservation>(&operation))
+      {
+        // The backend does not know the provisional ids, which are only used when the leased ids have run out
+        if (erase->reservationId < 0)
+        {
+          std::cerr << "Cannot delete reservation with id " << erase->reservationId << ": it has not been stored yet"
+                    << std::endl;
+          applied = false;
+          break;
+        }
+        _resultIntegrator.removeReservationProvisionally(ResultIntegrator::unqueuedTaskId, erase->reservationId);
+      }
+    }
+
+    if (!applied)
+    {
+      _resultIntegrator.rollbackOptimisticChanges(ResultIntegrator::unqueuedTaskId);
+      auto rejected = op::makeTaskSharedState<op::OperationResults>(ResultIntegrator::unqueuedTaskId);
+      rejected->cancel();
+      return op::Task<op::OperationResults>(rejected);
+    }
+
+    auto task = queueOperations(std::move(operations), op::TaskPriority::Interactive);
+    _resultIntegrator.bindOptimisticChanges(task.uniqueId());
     return task;
   }
 
+  void DataSource::ensurePlanningLoaded(boost::gregorian::date_period period)
+  {
+    if (_planningFullyLoaded || period.is_null())
+      return;
+
+    // Pages requested before a reset of the planning has been queued are gone once the reset has been integrated
+    auto integratedResets = _resultIntegrator.planningResetCount();
+    for (auto page = _requestedPlanningPages.begin(); page != _requestedPlanningPages.end();)
+    {
+      if (page->second < integratedResets)
+        page = _requestedPlanningPages.erase(page);
+      else
+        ++page;
+    }
+
+    // The user is looking at these pages, thus they are loaded with the same priority as the initial data
+    auto firstPage = planningPageIndex(period.begin());
+    auto lastPage = planningPageIndex(period.last());
+    op::Operations operations;
+    addPlanningPageLoads(firstPage, lastPage, operations);
+    if (!operations.empty())
+      queueOperations(std::move(operations), op::TaskPriority::Interactive);
+
+    // The adjacent pages are prefetched, such that they are available by the time the user scrolls there. This must not
+    // delay the interactive work.
+    operations = op::Operations();
+    addPlanningPageLoads(firstPage - 1, firstPage - 1, operations);
+    addPlanningPageLoads(lastPage + 1, lastPage + 1, operations);
+    if (!operations.empty())
+      queueOperations(std::move(operations), op::TaskPriority::Normal);
+  }
+
+  void DataSource::addPlanningPageLoads(int firstPage, int lastPage, op::Operations& operations)
+  {
+    // A pending reset which is queued with a lower priority than the interactive loads may be executed after them,
+    // then the pages are requested again once it has been integrated
+    int resetCount = _queuedPlanningResets;
+    if (_resultIntegrator.planningResetCount() < resetCount && _lastResetPriority != op::TaskPriority::Interactive)
+      --resetCount;
+
+    // Consecutive missing pages are loaded with one operation
+    auto page = firstPage;
+    while (page <= lastPage)
+    {
+      if (_requestedPlanningPages.count(page) != 0)
+      {
+        ++page;
+        continue;
+      }
+
+      auto runBegin = page;
+      while (page <= lastPage && _requestedPlanningPages.emplace(page, resetCount).second)
+        ++page;
+      operations.push_back(
+          op::LoadPlanningWindow{boost::gregorian::date_period(planningPageBegin(runBegin), planningPageBegin(page))});
+    }
+  }
+
   void DataSource::processIntegrationQueue()
   {
     _resultIntegrator.processIntegrationQueue();
   }
 
+  bool DataSource::processIntegrationQueue(std::chrono::steady_clock::duration timeBudget)
+  {
+    return _resultIntegrator.processIntegrationQueue(timeBudget);
+  }
+
   size_t DataSource::pendingOperationsCount() const
   {
     return _resultIntegrator.pendingOperationsCount();
   }
 
+  int DataSource::resultsAvailableFileDescriptor() const
+  {
+    return _resultIntegrator.resultsAvailableFileDescriptor();
+  }
+
 } // namespace persistence
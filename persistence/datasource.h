@@ -1,19 +1,23 @@
 #ifndef PERSISTENCE_DATASOURCE_H
 #define PERSISTENCE_DATASOURCE_H
 
+#include "persistence/backend.h"
 #include "persistence/op/operations.h"
 #include "persistence/op/results.h"
 #include "persistence/resultintegrator.h"
-#include "persistence/sqlite/sqlitebackend.h"
 
 #include "hotel/planning.h"
 
+#include "boost/date_time.hpp"
+#include "boost/optional.hpp"
 #include "boost/signals2.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
-#include <set>
 
 namespace persistence
 {
@@ -24,7 +28,20 @@ namespace persistence
   class DataSource
   {
   public:
-    DataSource(const std::string& databaseFile);
+    /**
+     * @brief Opens the given database and starts loading its data
+     * @param databaseFile Path to the database file
+     * @param initialPlanningWindow If given, only the reservations around this period are loaded initially. Further
+     *                              parts of the planning are loaded on demand, see ensurePlanningLoaded().
+     */
+    DataSource(const std::string& databaseFile,
+               boost::optional<boost::gregorian::date_period> initialPlanningWindow = boost::none);
+    /**
+     * @brief Starts loading the data of the given backend, e.g. of a memory::MemoryBackend
+     * @param initialPlanningWindow See above
+     */
+    DataSource(std::unique_ptr<Backend> backend,
+               boost::optional<boost::gregorian::date_period> initialPlanningWindow = boost::none);
     ~DataSource();
 
     hotel::HotelCollection& hotels();
@@ -35,35 +52,115 @@ namespace persistence
     /**
      * @brief queueOperation queues a given operation to perform on the data
      * @param operation The operation to perform
+     * @param priority Priority class of the operation, see op::TaskPriority
      *
      * @note The operation might be performed immediately or queued for later execution
      */
-    op::Task<op::OperationResults> queueOperation(op::Operation operation);
+    op::Task<op::OperationResults> queueOperation(op::Operation operation,
+                                                  op::TaskPriority priority = op::TaskPriority::Normal);
 
     /**
      * @brief queueOperations queues multiple operations
-     * The operations are executed together under a transaction if possible.
+     * The operations are executed together under a transaction if possible. New hotels and reservations get their ids
+     * right away from the ids which the data source has leased from the backend, thus later operations can refer to
+     * them before they have been stored. The ids are only assigned by the backend if the leased ids have run out.
      * @param operations List of operations to perform.
+     * @param priority Priority class of the operations, see op::TaskPriority
+     *
+     * @note May be called from any thread, the leased ids are handed out under a lock
+     */
+    op::Task<op::OperationResults> queueOperations(op::Operations operations,
+                                                   op::TaskPriority priority = op::TaskPriority::Normal);
+
+    /**
+     * @brief assignIds assigns leased ids to the new objects of the operations which do not have an id yet
+     * queueOperations() does this as well. Call it beforehand in order to refer to the new objects, e.g. to a room of a
+     * new hotel, within the same batch of operations.
      */
-    op::Task<op::OperationResults> queueOperations(op::Operations operations);
+    void assignIds(op::Operations& operations);
 
+    /**
+     * @brief queueOptimisticOperations applies the operations to the local data right away and queues them
+     *
+     * New reservations appear on the planning immediately under their assigned id, or under a provisional (negative) id
+     * if no leased id is available, and deleted reservations disappear immediately, such that the user does not have to
+     * wait for the backend. Once the results arrive, the provisional reservations are replaced by the stored ones.
+     * Changes which the backend does not confirm, e.g. because the task has been cancelled, are rolled back. Other
+     * kinds of operations are only queued. The operations are queued with interactive priority.
+     *
+     * If a new reservation does not fit into the planning, or a reservation is deleted while it only has a provisional
+     * id, none of the operations are applied or queued and the returned task is cancelled.
+     *
+     * @note Must be called on the thread which integrates the results, since it changes the local data
+     */
+    op::Task<op::OperationResults> queueOptimisticOperations(op::Operations operations);
+    op::Task<op::OperationResults> queueOptimisticOperation(op::Operation operation);
+
+    /**
+     * @brief ensurePlanningLoaded makes sure that all of the reservations intersecting the given period get loaded
+     *
+     * The planning is loaded in pages of fixed length. Pages which have not been requested yet are queued for loading,
+     * and the pages adjacent to the given period are prefetched in the background. Once the planning has been reset,
+     * e.g. by erasing all data, the pages are requested again. Does nothing if the whole planning has been loaded
+     * initially.
+     *
+     * @note Must be called on the thread which integrates the results
+     */
+    void ensurePlanningLoaded(boost::gregorian::date_period period);
+
+    /**
+     * @brief integrationExecutor returns an executor running work on the thread which integrates the results
+     * Use it for task continuations which access the hotels or the planning, see op::Task::then().
+     */
+    Executor& integrationExecutor() { return _resultIntegrator; }
+
+    //! Integrates all of the results which the backend has made available
     void processIntegrationQueue();
+    /**
+     * @brief processIntegrationQueue integrates available results until the given time budget is used up
+     * @return true if available results are left over, i.e. the function should be called again soon
+     */
+    bool processIntegrationQueue(std::chrono::steady_clock::duration timeBudget);
 
     //! Returns the number of operations that the backend has yet to process
     size_t pendingOperationsCount() const;
 
+    /**
+     * @brief resultsAvailableFileDescriptor returns a file descriptor which becomes readable when new results are waiting
+     * to be integrated
+     *
+     * Many results arriving in a burst only make the descriptor readable once. It is reset by processIntegrationQueue(),
+     * thus an event loop can watch it (e.g. with a QSocketNotifier) and integrate the results whenever it fires.
+     */
+    int resultsAvailableFileDescriptor() const;
+
     /**
      * @brief taskCompletedSignal returns the signal which is triggered when new results are waiting to be integrated
      * @note The signal is not called on the main thread, but on the backend worker thread
      */
-    boost::signals2::signal<void(int)>& taskCompletedSignal() { return _backend.taskCompletedSignal(); }
+    boost::signals2::signal<void(int)>& taskCompletedSignal() { return _backend->taskCompletedSignal(); }
 
   private:
     // Backing store and result integrator
-    persistence::sqlite::SqliteBackend _backend;
+    std::unique_ptr<Backend> _backend;
     persistence::ResultIntegrator _resultIntegrator;
 
+    // Adds the operations loading all pages in [firstPage, lastPage] which have not been requested yet
+    void addPlanningPageLoads(int firstPage, int lastPage, op::Operations& operations);
+    // Queues new id leases for the kinds of objects whose leased ids run low
+    void requestIdLeases();
+
     int _nextOperationId;
+    // Provisional ids are negative, such that they never collide with the ids leased from the database
+    int _nextProvisionalId;
+
+    // Pages of the planning which have already been requested from the backend, with the number of resets of the
+    // planning (see ResultIntegrator::planningResetCount()) which their loads follow. The resets are counted when
+    // they are queued, which may happen on any thread, along with the priority of the last one.
+    bool _planningFullyLoaded;
+    std::map<int, int> _requestedPlanningPages;
+    std::atomic<int> _queuedPlanningResets;
+    std::atomic<op::TaskPriority> _lastResetPriority;
   };
 
 } // namespace persistence
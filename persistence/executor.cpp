@@ -0,0 +1,57 @@
+#include "persistence/executor.h"
+
+#include <algorithm>
+
+namespace persistence
+{
+  InlineExecutor& InlineExecutor::instance()
+  {
+    static InlineExecutor executor;
+    return executor;
+  }
+
+  ThreadPoolExecutor::ThreadPoolExecutor(unsigned numberOfThreads) : _quit(false)
+  {
+    // hardware_concurrency() may return 0 if the number of cores is unknown
+    numberOfThreads = std::max(numberOfThreads, 1u);
+    for (unsigned i = 0; i < numberOfThreads; ++i)
+      _threads.emplace_back([this]() { this->threadMain(); });
+  }
+
+  ThreadPoolExecutor::~ThreadPoolExecutor()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _quit = true;
+    }
+    _workAvailableCondition.notify_all();
+    for (auto& thread : _threads)
+      thread.join();
+  }
+
+  void ThreadPoolExecutor::post(std::function<void()> work)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _work.push(std::move(work));
+    }
+    _workAvailableCondition.notify_one();
+  }
+
+  void ThreadPoolExecutor::threadMain()
+  {
+    while (true)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _workAvailableCondition.wait(lock, [this]() { return _quit || !_work.empty(); });
+      if (_work.empty())
+        return;
+
+      auto work = std::move(_work.front());
+      _work.pop();
+      lock.unlock();
+      work();
+    }
+  }
+
+} // namespace persistence
@@ -0,0 +1,64 @@
+#ifndef PERSISTENCE_EXECUTOR_H
+#define PERSISTENCE_EXECUTOR_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace persistence
+{
+  /**
+   * @brief The Executor class is the interface of everything which can run work items, e.g. task continuations
+   */
+  class Executor
+  {
+  public:
+    virtual ~Executor() = default;
+
+    //! Schedules the given work, may be called from any thread
+    virtual void post(std::function<void()> work) = 0;
+  };
+
+  /**
+   * @brief The InlineExecutor class runs the work immediately on the posting thread
+   *
+   * Continuations of tasks thus run on the backend thread which completed the task. They must be short and must not
+   * block, otherwise they delay all of the following operations.
+   */
+  class InlineExecutor : public Executor
+  {
+  public:
+    virtual void post(std::function<void()> work) override { work(); }
+
+    //! Returns a shared instance, the executor does not have any state
+    static InlineExecutor& instance();
+  };
+
+  /**
+   * @brief The ThreadPoolExecutor class runs the work on a fixed number of worker threads
+   * Work which has been posted before the executor is destroyed is still run.
+   */
+  class ThreadPoolExecutor : public Executor
+  {
+  public:
+    explicit ThreadPoolExecutor(unsigned numberOfThreads = std::thread::hardware_concurrency());
+    ~ThreadPoolExecutor();
+
+    virtual void post(std::function<void()> work) override;
+
+  private:
+    void threadMain();
+
+    std::mutex _mutex;
+    std::condition_variable _workAvailableCondition;
+    std::queue<std::function<void()>> _work;
+    bool _quit;
+    std::vector<std::thread> _threads;
+  };
+
+} // namespace persistence
+
+#endif // PERSISTENCE_EXECUTOR_H
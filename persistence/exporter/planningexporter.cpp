@@ -0,0 +1,90 @@
+#include "persistence/exporter/planningexporter.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace persistence
+{
+  namespace exporter
+  {
+    namespace
+    {
+      // Buffers of the chunks which have been posted to the executor, indexed modulo the number of chunks in flight
+      struct ChunkSlots
+      {
+        explicit ChunkSlots(size_t count) : buffers(count), completed(count, false) {}
+
+        std::mutex mutex;
+        std::condition_variable completedCondition;
+        std::vector<std::string> buffers;
+        std::vector<bool> completed;
+      };
+    } // namespace
+
+    PlanningExporter::PlanningExporter(Executor& executor, size_t chunkSize, size_t maxChunksInFlight)
+        : _executor(executor), _chunkSize(std::max<size_t>(chunkSize, 1)),
+          _maxChunksInFlight(std::max<size_t>(maxChunksInFlight, 1))
+    {
+    }
+
+    bool PlanningExporter::exportPlanning(const hotel::PlanningBoard& planning, const ReservationFormat& format,
+                                          std::ostream& stream)
+    {
+      auto reservations = planning.reservations();
+      auto chunkCount = (reservations.size() + _chunkSize - 1) / _chunkSize;
+
+      std::string prefix;
+      format.writePrefix(prefix);
+      stream.write(prefix.data(), prefix.size());
+
+      ChunkSlots slots(_maxChunksInFlight);
+      auto post = [&](size_t chunk) {
+        _executor.post([&, chunk]() {
+          std::string buffer;
+          auto begin = chunk * _chunkSize;
+          format.writeReservations(reservations, begin, std::min(begin + _chunkSize, reservations.size()), buffer);
+
+          auto slot = chunk % slots.buffers.size();
+          {
+            std::lock_guard<std::mutex> lock(slots.mutex);
+            slots.buffers[slot] = std::move(buffer);
+            slots.completed[slot] = true;
+          }
+          slots.completedCondition.notify_all();
+        });
+      };
+
+      // Each chunk written frees the slot for the chunk following the ones in flight
+      size_t posted = 0;
+      for (; posted < std::min(chunkCount, _maxChunksInFlight); ++posted)
+        post(posted);
+      for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+      {
+        auto slot = chunk % slots.buffers.size();
+        std::string buffer;
+        {
+          std::unique_lock<std::mutex> lock(slots.mutex);
+          slots.completedCondition.wait(lock, [&]() { return slots.completed[slot]; });
+          std::swap(buffer, slots.buffers[slot]);
+          slots.completed[slot] = false;
+        }
+        if (posted < chunkCount)
+          post(posted++);
+
+        // After a failure, the remaining chunks are still awaited, as they refer to the local state
+        if (stream)
+          stream.write(buffer.data(), buffer.size());
+      }
+
+      std::string suffix;
+      format.writeSuffix(suffix);
+      stream.write(suffix.data(), suffix.size());
+      stream.flush();
+      return static_cast<bool>(stream);
+    }
+
+  } // namespace exporter
+} // namespace persistence
@@ -0,0 +1,48 @@
+#ifndef PERSISTENCE_EXPORTER_PLANNINGEXPORTER_H
+#define PERSISTENCE_EXPORTER_PLANNINGEXPORTER_H
+
+#include "persistence/executor.h"
+#include "persistence/exporter/reservationformat.h"
+
+#include "hotel/planning.h"
+
+#include <ostream>
+
+namespace persistence
+{
+  namespace exporter
+  {
+    /**
+     * @brief The PlanningExporter class writes the reservations of a planning board using several threads
+     *
+     * The reservations are split into chunks of consecutive reservations. The chunks are serialized on the executor,
+     * each into its own buffer, and the buffers are written in the order of the chunks, thus the output is the same as
+     * if the reservations had been written one by one. At most the given number of chunks is held in memory at the same
+     * time.
+     *
+     * The export is synchronous. The board must not change while it runs, which holds when it is started on the thread
+     * which integrates the results of the data source: no results are integrated until the export is complete.
+     */
+    class PlanningExporter
+    {
+    public:
+      /**
+       * @param executor Runs the serialization of the chunks, usually a ThreadPoolExecutor
+       * @param chunkSize Number of reservations in each chunk
+       * @param maxChunksInFlight Number of chunks which may be serialized or waiting to be written at the same time
+       */
+      PlanningExporter(Executor& executor, size_t chunkSize = 2048, size_t maxChunksInFlight = 32);
+
+      //! Writes all reservations of the board, returns false if writing to the stream has failed
+      bool exportPlanning(const hotel::PlanningBoard& planning, const ReservationFormat& format, std::ostream& stream);
+
+    private:
+      Executor& _executor;
+      size_t _chunkSize;
+      size_t _maxChunksInFlight;
+    };
+
+  } // namespace exporter
+} // namespace persistence
+
+#endif // PERSISTENCE_EXPORTER_PLANNINGEXPORTER_H
@@ -0,0 +1,90 @@
+#include "persistence/exporter/reservationformat.h"
+
+#include "persistence/json/jsonserializer.h"
+#include "persistence/json/jsonwriter.h"
+
+#include <boost/date_time/gregorian/formatters.hpp>
+
+namespace persistence
+{
+  namespace exporter
+  {
+    void ReservationFormat::writeReservations(const std::vector<const hotel::Reservation*>& reservations, size_t begin,
+                                              size_t end, std::string& output) const
+    {
+      for (auto i = begin; i < end; ++i)
+      {
+        if (i != 0)
+          writeSeparator(output);
+        writeReservation(*reservations[i], output);
+      }
+    }
+
+    void JsonReservationFormat::writeReservation(const hotel::Reservation& reservation, std::string& output) const
+    {
+      json::JsonWriter writer(output, 512);
+      json::JsonSerializer().serializeReservation(reservation, writer);
+    }
+
+    void JsonReservationFormat::writeReservations(const std::vector<const hotel::Reservation*>& reservations,
+                                                  size_t begin, size_t end, std::string& output) const
+    {
+      json::JsonWriter writer(output);
+      json::JsonSerializer serializer;
+      for (auto i = begin; i < end; ++i)
+      {
+        if (i != 0)
+          writer.separateValues();
+        serializer.serializeReservation(*reservations[i], writer);
+      }
+    }
+
+    void CsvReservationFormat::writePrefix(std::string& output) const
+    {
+      output.append("reservation_id,description,status,adults,children,room_id,from,to\r\n");
+    }
+
+    void CsvReservationFormat::writeReservation(const hotel::Reservation& reservation, std::string& output) const
+    {
+      // The fields of the reservation are repeated for each of its atoms
+      for (auto& atom : reservation.atoms())
+      {
+        output.append(std::to_string(reservation.id()));
+        output.push_back(',');
+        writeField(reservation.description(), output);
+        output.push_back(',');
+        output.append(std::to_string(static_cast<int>(reservation.status())));
+        output.push_back(',');
+        output.append(std::to_string(reservation.numberOfAdults()));
+        output.push_back(',');
+        output.append(std::to_string(reservation.numberOfChildren()));
+        output.push_back(',');
+        output.append(std::to_string(atom.roomId()));
+        output.push_back(',');
+        output.append(boost::gregorian::to_iso_extended_string(atom.dateRange().begin()));
+        output.push_back(',');
+        output.append(boost::gregorian::to_iso_extended_string(atom.dateRange().end()));
+        output.append("\r\n");
+      }
+    }
+
+    void CsvReservationFormat::writeField(const std::string& field, std::string& output)
+    {
+      if (field.find_first_of(",\"\r\n") == std::string::npos)
+      {
+        output.append(field);
+        return;
+      }
+
+      output.push_back('"');
+      for (auto c : field)
+      {
+        if (c == '"')
+          output.push_back('"');
+        output.push_back(c);
+      }
+      output.push_back('"');
+    }
+
+  } // namespace exporter
+} // namespace persistence
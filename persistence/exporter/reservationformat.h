@@ -0,0 +1,78 @@
+#ifndef PERSISTENCE_EXPORTER_RESERVATIONFORMAT_H
+#define PERSISTENCE_EXPORTER_RESERVATIONFORMAT_H
+
+#include "hotel/reservation.h"
+
+#include <string>
+#include <vector>
+
+namespace persistence
+{
+  namespace exporter
+  {
+    /**
+     * @brief The ReservationFormat class is the interface of the output formats of the PlanningExporter
+     *
+     * A document consists of the prefix, the reservations with the separator between each two of them, and the suffix.
+     * The functions append to the given buffer. writeReservations() is called from several threads at the same time
+     * and must thus not change the format.
+     */
+    class ReservationFormat
+    {
+    public:
+      virtual ~ReservationFormat() = default;
+
+      virtual void writePrefix(std::string& output) const = 0;
+      virtual void writeSeparator(std::string& output) const = 0;
+      virtual void writeReservation(const hotel::Reservation& reservation, std::string& output) const = 0;
+      virtual void writeSuffix(std::string& output) const = 0;
+
+      /**
+       * @brief writeReservations writes the reservations [begin, end) of the list, each preceded by the separator
+       * unless it is the first one of the list
+       *
+       * Formats override it to share state between the reservations of a chunk.
+       */
+      virtual void writeReservations(const std::vector<const hotel::Reservation*>& reservations, size_t begin,
+                                     size_t end, std::string& output) const;
+    };
+
+    /**
+     * @brief The JsonReservationFormat class writes a JSON array of reservations
+     * The document is the same as the one written by json::JsonSerializer::serializePlanning().
+     */
+    class JsonReservationFormat : public ReservationFormat
+    {
+    public:
+      virtual void writePrefix(std::string& output) const override { output.push_back('['); }
+      virtual void writeSeparator(std::string& output) const override { output.push_back(','); }
+      virtual void writeReservation(const hotel::Reservation& reservation, std::string& output) const override;
+      virtual void writeSuffix(std::string& output) const override { output.push_back(']'); }
+
+      //! Writes the reservations with a single writer, instead of one for each reservation
+      virtual void writeReservations(const std::vector<const hotel::Reservation*>& reservations, size_t begin,
+                                     size_t end, std::string& output) const override;
+    };
+
+    /**
+     * @brief The CsvReservationFormat class writes a CSV table with one row for each reservation atom
+     *
+     * The columns are reservation_id, description, status, adults, children, room_id, from and to, with the dates in
+     * ISO format. The fields are quoted as described in RFC 4180, the rows end with CRLF.
+     */
+    class CsvReservationFormat : public ReservationFormat
+    {
+    public:
+      virtual void writePrefix(std::string& output) const override;
+      virtual void writeSeparator(std::string&) const override {}
+      virtual void writeReservation(const hotel::Reservation& reservation, std::string& output) const override;
+      virtual void writeSuffix(std::string&) const override {}
+
+      //! Appends the field to the row, quoted if necessary
+      static void writeField(const std::string& field, std::string& output);
+    };
+
+  } // namespace exporter
+} // namespace persistence
+
+#endif // PERSISTENCE_EXPORTER_RESERVATIONFORMAT_H
@@ -0,0 +1,43 @@
+#include "persistence/filesync.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+
+namespace persistence
+{
+  namespace
+  {
+    bool syncPath(const std::string& path, int flags)
+    {
+      auto descriptor = ::open(path.c_str(), flags);
+      if (descriptor == -1)
+        return false;
+      auto synced = ::fsync(descriptor) == 0;
+      ::close(descriptor);
+      return synced;
+    }
+  } // namespace
+
+  bool syncFile(const std::string& path)
+  {
+    if (syncPath(path, O_RDONLY))
+      return true;
+
+    std::cerr << "Cannot sync file: " << path << std::endl;
+    return false;
+  }
+
+  bool syncParentDirectory(const std::string& path)
+  {
+    auto separator = path.find_last_of('/');
+    auto directory = (separator == std::string::npos) ? std::string(".") : path.substr(0, separator + 1);
+    if (syncPath(directory, O_RDONLY | O_DIRECTORY))
+      return true;
+
+    std::cerr << "Cannot sync directory: " << directory << std::endl;
+    return false;
+  }
+
+} // namespace persistence
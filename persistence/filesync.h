@@ -0,0 +1,22 @@
+#ifndef PERSISTENCE_FILESYNC_H
+#define PERSISTENCE_FILESYNC_H
+
+#include <string>
+
+namespace persistence
+{
+  /**
+   * @brief syncFile waits until the contents of the file at the given path are durable
+   * Use it before a file replaces another one by renaming it, otherwise a crash may leave an empty file behind.
+   */
+  bool syncFile(const std::string& path);
+
+  /**
+   * @brief syncParentDirectory waits until the entries of the directory containing the given path are durable
+   * Use it after creating or renaming a file, such that the file is still found under its name after a crash.
+   */
+  bool syncParentDirectory(const std::string& path);
+
+} // namespace persistence
+
+#endif // PERSISTENCE_FILESYNC_H
@@ -0,0 +1,55 @@
+#include "persistence/idallocator.h"
+
+namespace persistence
+{
+  void IdAllocator::addLease(op::IdSpace spaceId, int firstId, int count)
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    auto& ids = space(spaceId);
+    ids.leaseRequested = false;
+    if (count <= 0)
+      return;
+
+    ids.leases.push_back(Lease{firstId, firstId + count});
+    ids.availableIds += count;
+  }
+
+  int IdAllocator::takeId(op::IdSpace spaceId)
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    auto& ids = space(spaceId);
+    if (ids.leases.empty())
+      return 0;
+
+    auto& lease = ids.leases.front();
+    auto id = lease.nextId++;
+    if (lease.nextId == lease.endId)
+      ids.leases.pop_front();
+    --ids.availableIds;
+    return id;
+  }
+
+  int IdAllocator::availableIds(op::IdSpace spaceId) const
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    return space(spaceId).availableIds;
+  }
+
+  bool IdAllocator::requestLease(op::IdSpace spaceId, int lowWatermark)
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    auto& ids = space(spaceId);
+    if (ids.leaseRequested || ids.availableIds >= lowWatermark)
+      return false;
+
+    ids.leaseRequested = true;
+    return true;
+  }
+
+  void IdAllocator::cancelLeaseRequest(op::IdSpace spaceId)
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    space(spaceId).leaseRequested = false;
+  }
+
+} // namespace persistence
@@ -0,0 +1,62 @@
+#ifndef PERSISTENCE_IDALLOCATOR_H
+#define PERSISTENCE_IDALLOCATOR_H
+
+#include "persistence/op/operations.h"
+
+#include <array>
+#include <deque>
+#include <mutex>
+
+namespace persistence
+{
+  /**
+   * @brief The IdAllocator class hands out the ids which the client has leased from the backend
+   *
+   * Assigning ids on the client gives new objects their final identity as soon as the operation storing them is
+   * created. Later operations of the same batch can thus refer to them, and the backend does not have to read back the
+   * id of every inserted row. The allocator is thread safe: the leases are added by the thread integrating the results,
+   * while operations may be queued from any thread.
+   */
+  class IdAllocator
+  {
+  public:
+    //! Adds a range of leased ids, see op::LeaseIdsResult
+    void addLease(op::IdSpace space, int firstId, int count);
+    //! Returns the next unused leased id, or 0 if all leased ids have been used up
+    int takeId(op::IdSpace space);
+    //! Returns the number of leased ids which have not been used yet
+    int availableIds(op::IdSpace space) const;
+
+    /**
+     * @brief requestLease returns true if the ids of the space run low and no new lease has been requested yet
+     * The caller must queue the lease then. The request is considered answered by the next addLease() or
+     * cancelLeaseRequest(), until then this function returns false for the space.
+     */
+    bool requestLease(op::IdSpace space, int lowWatermark);
+    //! Answers the lease request of the space without ids, e.g. because the lease could not be committed
+    void cancelLeaseRequest(op::IdSpace space);
+
+  private:
+    struct Lease
+    {
+      int nextId;
+      int endId;
+    };
+
+    struct Space
+    {
+      std::deque<Lease> leases;
+      int availableIds = 0;
+      bool leaseRequested = false;
+    };
+
+    Space& space(op::IdSpace space) { return _spaces[static_cast<size_t>(space)]; }
+    const Space& space(op::IdSpace space) const { return _spaces[static_cast<size_t>(space)]; }
+
+    mutable std::mutex _mutex;
+    std::array<Space, op::idSpaceCount> _spaces;
+  };
+
+} // namespace persistence
+
+#endif // PERSISTENCE_IDALLOCATOR_H
@@ -0,0 +1,432 @@
+#include "persistence/importer/csvimporter.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace persistence
+{
+  namespace importer
+  {
+    namespace
+    {
+      const char csvHeader[] = "reservation_id,description,status,adults,children,room_id,from,to";
+
+      /**
+       * @brief The RowParser class reads the fields of the rows of a CSV table
+       * Each function reads one field or delimiter and returns false with an error message if it is malformed.
+       */
+      class RowParser
+      {
+      public:
+        RowParser(const char* begin, const char* end) : _position(begin), _end(end), _error() {}
+
+        bool atEnd() const { return _position == _end; }
+        const std::string& error() const { return _error; }
+
+        bool skipEmptyLine()
+        {
+          auto position = _position;
+          if (position != _end && *position == '\r')
+            ++position;
+          if (position == _end || *position != '\n')
+            return false;
+          _position = position + 1;
+          return true;
+        }
+
+        bool readInt(int& value)
+        {
+          auto negative = _position != _end && *_position == '-';
+          if (negative)
+            ++_position;
+
+          int64_t number = 0;
+          auto digits = _position;
+          while (_position != _end && *_position >= '0' && *_position <= '9' && _position - digits < 10)
+            number = number * 10 + (*_position++ - '0');
+          if (_position == digits || (_position != _end && *_position >= '0' && *_position <= '9'))
+            return fail("Expected an integer");
+          number = negative ? -number : number;
+          if (number < std::numeric_limits<int>::min() || number > std::numeric_limits<int>::max())
+            return fail("Integer out of range");
+          value = static_cast<int>(number);
+          return true;
+        }
+
+        bool readString(std::string& value)
+        {
+          value.clear();
+          if (_position == _end || *_position != '"')
+          {
+            auto begin = _position;
+            while (_position != _end && *_position != ',' && *_position != '\r' && *_position != '\n')
+              ++_position;
+            value.assign(begin, _position);
+            return true;
+          }
+
+          // A quoted field ends at a quote which is not doubled
+          ++_position;
+          for (;;)
+          {
+            auto quote = static_cast<const char*>(std::memchr(_position, '"', _end - _position));
+            if (quote == nullptr)
+              return fail("Unterminated quoted field");
+            value.append(_position, quote);
+            _position = quote + 1;
+            if (_position == _end || *_position != '"')
+              return true;
+            value.push_back('"');
+            ++_position;
+          }
+        }
+
+        //! Reads an ISO date, e.g. 2017-01-31
+        bool readDate(boost::gregorian::date& value)
+        {
+          const char pattern[] = "dddd-dd-dd";
+          const auto length = sizeof(pattern) - 1;
+          if (static_cast<size_t>(_end - _position) < length)
+            return fail("Expected a date");
+          int fields[3] = {0, 0, 0};
+          for (size_t i = 0, field = 0; i < length; ++i)
+          {
+            auto c = _position[i];
+            if (pattern[i] == '-')
+            {
+              if (c != '-')
+                return fail("Expected a date");
+              ++field;
+            }
+            else if (c < '0' || c > '9')
+              return fail("Expected a date");
+            else
+              fields[field] = fields[field] * 10 + (c - '0');
+          }
+
+          try
+          {
+            value = boost::gregorian::date(fields[0], fields[1], fields[2]);
+          }
+          catch (std::exception&)
+          {
+            return fail("Invalid date \"" + std::string(_position, length) + "\"");
+          }
+          _position += length;
+          return true;
+        }
+
+        bool readSeparator() { return (_position != _end && *_position++ == ',') || fail("Expected a separator"); }
+
+        bool readEndOfRow()
+        {
+          if (_position == _end || skipEmptyLine())
+            return true;
+          return fail("Expected the end of the row");
+        }
+
+      private:
+        bool fail(const std::string& message)
+        {
+          _error = message;
+          return false;
+        }
+
+        const char* _position;
+        const char* _end;
+        std::string _error;
+      };
+
+      struct ParsedChunk
+      {
+        std::vector<std::unique_ptr<hotel::Reservation>> reservations;
+        size_t rowCount = 0;
+        std::string error; // Refers to the last row if not empty
+      };
+
+      std::string reservationName(const hotel::Reservation& reservation)
+      {
+        return "Reservation " + std::to_string(reservation.id());
+      }
+
+      // Appends the atoms of the continuation, whose other fields have to be the ones of the reservation
+      bool continueReservation(hotel::Reservation& reservation, const hotel::Reservation& continuation,
+                               std::string& error)
+      {
+        if (continuation.description() != reservation.description() || continuation.status() != reservation.status() ||
+            continuation.numberOfAdults() != reservation.numberOfAdults() ||
+            continuation.numberOfChildren() != reservation.numberOfChildren())
+        {
+          error = reservationName(reservation) + " has rows with different fields";
+          return false;
+        }
+
+        try
+        {
+          for (auto& atom : continuation.atoms())
+            reservation.addAtom(atom);
+        }
+        catch (std::logic_error& e)
+        {
+          error = reservationName(reservation) + ": " + e.what();
+          return false;
+        }
+        return true;
+      }
+
+      void parseChunk(const char* begin, const char* end, ParsedChunk& chunk)
+      {
+        RowParser parser(begin, end);
+        int id, status, adults, children, roomId;
+        std::string description;
+        boost::gregorian::date from, to;
+        while (!parser.atEnd())
+        {
+          ++chunk.rowCount;
+          if (parser.skipEmptyLine())
+            continue;
+
+          if (!parser.readInt(id) || !parser.readSeparator() || !parser.readString(description) ||
+              !parser.readSeparator() || !parser.readInt(status) || !parser.readSeparator() ||
+              !parser.readInt(adults) || !parser.readSeparator() || !parser.readInt(children) ||
+              !parser.readSeparator() || !parser.readInt(roomId) || !parser.readSeparator() ||
+              !parser.readDate(from) || !parser.readSeparator() || !parser.readDate(to) || !parser.readEndOfRow())
+          {
+            chunk.error = parser.error();
+            return;
+          }
+          if (status < hotel::Reservation::Unknown || status > hotel::Reservation::Archived)
+          {
+            chunk.error = "Invalid status " + std::to_string(status);
+            return;
+          }
+          if (from >= to)
+          {
+            chunk.error = "The date range is empty";
+            return;
+          }
+
+          auto reservation =
+              std::make_unique<hotel::Reservation>(description, roomId, boost::gregorian::date_period(from, to));
+          reservation->setId(id);
+          reservation->setStatus(static_cast<hotel::Reservation::ReservationStatus>(status));
+          reservation->setNumberOfAdults(adults);
+          reservation->setNumberOfChildren(children);
+          if (!chunk.reservations.empty() && chunk.reservations.back()->id() == id)
+          {
+            if (!continueReservation(*chunk.reservations.back(), *reservation, chunk.error))
+              return;
+          }
+          else
+            chunk.reservations.push_back(std::move(reservation));
+        }
+      }
+    } // namespace
+
+    CsvImporter::CsvImporter(Executor& executor, size_t chunkSize)
+        : _executor(executor), _chunkSize(std::max<size_t>(chunkSize, 1)), _reservations(), _errorMessage()
+    {
+    }
+
+    bool CsvImporter::parseFile(const std::string& path)
+    {
+      auto descriptor = ::open(path.c_str(), O_RDONLY);
+      if (descriptor == -1)
+      {
+        _errorMessage = "Cannot open " + path;
+        return false;
+      }
+
+      struct stat status;
+      if (::fstat(descriptor, &status) != 0)
+      {
+        ::close(descriptor);
+        _errorMessage = "Cannot read " + path;
+        return false;
+      }
+      if (status.st_size == 0)
+      {
+        ::close(descriptor);
+        return parse(nullptr, 0);
+      }
+
+      auto data = ::mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      ::close(descriptor);
+      if (data == MAP_FAILED)
+      {
+        _errorMessage = "Cannot map " + path;
+        return false;
+      }
+      ::madvise(data, status.st_size, MADV_SEQUENTIAL);
+      auto success = parse(static_cast<const char*>(data), status.st_size);
+      ::munmap(data, status.st_size);
+      return success;
+    }
+
+    bool CsvImporter::parse(const char* data, size_t size)
+    {
+      _reservations.clear();
+      _errorMessage.clear();
+
+      auto end = data + size;
+      auto headerEnd = std::find(data, end, '\n');
+      auto header = std::string(data, headerEnd != data && headerEnd[-1] == '\r' ? headerEnd - 1 : headerEnd);
+      if (header != csvHeader)
+      {
+        _errorMessage = "Row 1: Expected the header \"" + std::string(csvHeader) + "\"";
+        return false;
+      }
+      auto begin = headerEnd == end ? end : headerEnd + 1;
+
+      // The chunks end at line breaks outside of quoted fields, i.e. after an even number of quotes since the start
+      std::vector<const char*> boundaries{begin};
+      size_t quotes = 0;
+      while (static_cast<size_t>(end - boundaries.back()) > _chunkSize)
+      {
+        auto position = boundaries.back() + _chunkSize;
+        quotes += std::count(boundaries.back(), position, '"');
+        while (position != end && (*position != '\n' || quotes % 2 != 0))
+          quotes += *position++ == '"';
+        if (position == end)
+          break;
+        boundaries.push_back(position + 1);
+      }
+      boundaries.push_back(end);
+
+      auto chunkCount = boundaries.size() - 1;
+      std::vector<ParsedChunk> chunks(chunkCount);
+      std::mutex mutex;
+      std::condition_variable completedCondition;
+      size_t completed = 0;
+      for (size_t i = 0; i < chunkCount; ++i)
+      {
+        _executor.post([&, i]() {
+          parseChunk(boundaries[i], boundaries[i + 1], chunks[i]);
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++completed;
+          }
+          completedCondition.notify_all();
+        });
+      }
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        completedCondition.wait(lock, [&]() { return completed == chunkCount; });
+      }
+
+      // A reservation may continue in the next chunk, its rows are joined here
+      size_t row = 1;
+      for (auto& chunk : chunks)
+      {
+        auto reservation = chunk.reservations.begin();
+        if (chunk.error.empty() && reservation != chunk.reservations.end() && !_reservations.empty() &&
+            _reservations.back()->id() == (*reservation)->id())
+        {
+          if (!continueReservation(*_reservations.back(), **reservation, chunk.error))
+            chunk.rowCount = 1;
+          ++reservation;
+        }
+        if (!chunk.error.empty())
+        {
+          _errorMessage = "Row " + std::to_string(row + chunk.rowCount) + ": " + chunk.error;
+          _reservations.clear();
+          return false;
+        }
+
+        std::move(reservation, chunk.reservations.end(), std::back_inserter(_reservations));
+        row += chunk.rowCount;
+      }
+      return true;
+    }
+
+    bool CsvImporter::validate(const hotel::PlanningBoard& planning)
+    {
+      _errorMessage.clear();
+
+      std::vector<int> ids;
+      ids.reserve(_reservations.size());
+      for (auto& reservation : _reservations)
+        ids.push_back(reservation->id());
+      std::sort(ids.begin(), ids.end());
+      auto duplicate = std::adjacent_find(ids.begin(), ids.end());
+      if (duplicate != ids.end())
+      {
+        _errorMessage = "Reservation " + std::to_string(*duplicate) + " occurs in separate places";
+        return false;
+      }
+
+      // The atoms of the planning take part in the check, such that a conflict with them is found in the same pass
+      struct Occupation
+      {
+        int roomId;
+        long from;
+        long to;
+        int reservationId;
+        bool existing;
+      };
+      std::vector<Occupation> occupations;
+      for (auto& reservation : _reservations)
+      {
+        for (auto& atom : reservation->atoms())
+        {
+          if (!planning.hasRoom(atom.roomId()))
+          {
+            _errorMessage = reservationName(*reservation) + " refers to the unknown room " +
+                            std::to_string(atom.roomId());
+            return false;
+          }
+          occupations.push_back(Occupation{atom.roomId(), atom.dateRange().begin().day_number(),
+                                           atom.dateRange().end().day_number(), reservation->id(), false});
+        }
+      }
+      for (auto reservation : planning.reservations())
+        for (auto& atom : reservation->atoms())
+          occupations.push_back(Occupation{atom.roomId(), atom.dateRange().begin().day_number(),
+                                           atom.dateRange().end().day_number(), reservation->id(), true});
+
+      // Once sorted, an occupation conflicts with another one if it starts before the latest end in its room so far
+      std::sort(occupations.begin(), occupations.end(), [](auto& a, auto& b) {
+        return a.roomId < b.roomId || (a.roomId == b.roomId && a.from < b.from);
+      });
+      const Occupation* latest = nullptr;
+      for (auto& occupation : occupations)
+      {
+        if (latest != nullptr && latest->roomId == occupation.roomId && occupation.from < latest->to &&
+            !(latest->existing && occupation.existing))
+        {
+          _errorMessage = "Reservations " + std::to_string(latest->reservationId) + " and " +
+                          std::to_string(occupation.reservationId) + " overlap in room " +
+                          std::to_string(occupation.roomId);
+          return false;
+        }
+        if (latest == nullptr || latest->roomId != occupation.roomId || occupation.to > latest->to)
+          latest = &occupation;
+      }
+      return true;
+    }
+
+    op::Task<op::OperationResults> CsvImporter::queueReservations(DataSource& dataSource)
+    {
+      op::Operations operations;
+      operations.reserve(_reservations.size());
+      for (auto& reservation : _reservations)
+      {
+        // The data source assigns an id from its leases instead of the one of the table
+        reservation->setId(0);
+        operations.push_back(op::StoreNewReservation{std::move(reservation)});
+      }
+      _reservations.clear();
+      return dataSource.queueOperations(std::move(operations), op::TaskPriority::Bulk);
+    }
+
+  } // namespace importer
+} // namespace persistence
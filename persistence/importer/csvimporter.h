@@ -0,0 +1,78 @@
+#ifndef PERSISTENCE_IMPORTER_CSVIMPORTER_H
+#define PERSISTENCE_IMPORTER_CSVIMPORTER_H
+
+#include "persistence/datasource.h"
+#include "persistence/executor.h"
+#include "persistence/op/operations.h"
+
+#include "hotel/planning.h"
+#include "hotel/reservation.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace persistence
+{
+  namespace importer
+  {
+    /**
+     * @brief The CsvImporter class reads the reservations of CSV tables written by exporter::CsvReservationFormat
+     *
+     * The input is split into chunks of whole rows, which are parsed on the executor at the same time. The rows of a
+     * reservation have to follow each other, ordered by date, and repeat the fields of the reservation. The ids of the
+     * table only tell the rows of the reservations apart and name them in error messages. The reservations are stored
+     * under new ids, which the data source assigns from its leases, the ids of the table could be taken already.
+     *
+     * An import consists of three steps: parse() or parseFile(), validate() against the planning which the reservations
+     * are added to, and queueReservations(), which stores all of them with a single task, i.e. in one transaction.
+     */
+    class CsvImporter
+    {
+    public:
+      /**
+       * @param executor Runs the parsing of the chunks, usually a ThreadPoolExecutor
+       * @param chunkSize Number of bytes of each chunk, it is extended up to the end of the row
+       */
+      explicit CsvImporter(Executor& executor, size_t chunkSize = 4 << 20);
+
+      //! Maps the file into memory and parses it, see parse()
+      bool parseFile(const std::string& path);
+      /**
+       * @brief parse reads the reservations of the given table
+       * @return false if the table is malformed, see errorMessage(). No reservations are kept in this case.
+       */
+      bool parse(const char* data, size_t size);
+
+      /**
+       * @brief validate checks the parsed reservations for conflicts with each other and with the given planning
+       *
+       * The reservations must refer to rooms of the planning, and must not occupy a room at the same time as another
+       * reservation, e.g. one imported before from the same table. All atoms are checked in one pass over them,
+       * ordered by room.
+       * @return false if there is a conflict, see errorMessage()
+       */
+      bool validate(const hotel::PlanningBoard& planning);
+
+      /**
+       * @brief Stores all of the parsed reservations with one task of bulk priority and hands them over to the data
+       * source
+       * The reservations get new ids when they are queued.
+       */
+      op::Task<op::OperationResults> queueReservations(DataSource& dataSource);
+
+      const std::vector<std::unique_ptr<hotel::Reservation>>& reservations() const { return _reservations; }
+      const std::string& errorMessage() const { return _errorMessage; }
+
+    private:
+      Executor& _executor;
+      size_t _chunkSize;
+
+      std::vector<std::unique_ptr<hotel::Reservation>> _reservations;
+      std::string _errorMessage;
+    };
+
+  } // namespace importer
+} // namespace persistence
+
+#endif // PERSISTENCE_IMPORTER_CSVIMPORTER_H
@@ -0,0 +1,357 @@
+#include "persistence/json/jsonimporter.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace persistence
+{
+  namespace json
+  {
+    typedef JsonReader::Token Token;
+
+    JsonImporter::JsonImporter(DataSource& dataSource, size_t batchSize, size_t maxPendingBatches)
+        : _dataSource(dataSource), _batchSize(std::max<size_t>(batchSize, 1)),
+          _maxPendingBatches(std::max<size_t>(maxPendingBatches, 1)), _batch(), _pendingBatches(), _roomIds(),
+          _unstoredRoomIds(), _importedHotels(0), _importedReservations(0), _failedObjects(0), _errorMessage()
+    {
+    }
+
+    bool JsonImporter::importHotelCollection(JsonReader& reader)
+    {
+      return importArray(reader, [this](JsonReader& reader) { return readHotel(reader); });
+    }
+
+    bool JsonImporter::importPlanning(JsonReader& reader)
+    {
+      return importArray(reader, [this](JsonReader& reader) { return readReservation(reader); });
+    }
+
+    template <typename ReadObject> bool JsonImporter::importArray(JsonReader& reader, ReadObject readObject)
+    {
+      _errorMessage.clear();
+      _failedObjects = 0;
+      auto success = reader.next() == Token::BeginArray || fail(reader, "Expected an array");
+      while (success)
+      {
+        auto token = reader.next();
+        if (token == Token::EndArray)
+          break;
+        success = token == Token::BeginObject ? readObject(reader) : fail(reader, "Expected an object");
+      }
+      if (success && reader.next() != Token::EndOfInput)
+        success = fail(reader, "Expected the end of the document");
+
+      // The objects read before an error are stored nevertheless
+      queueBatch();
+      waitForBatches(0);
+      if (success && _failedObjects > 0)
+      {
+        _errorMessage = std::to_string(_failedObjects) + " objects could not be stored";
+        success = false;
+      }
+      return success;
+    }
+
+    bool JsonImporter::readHotel(JsonReader& reader)
+    {
+      // The members may come in any order, the hotel is built once all of them have been read
+      struct Category
+      {
+        int id;
+        std::string shortCode;
+        std::string name;
+      };
+      struct Room
+      {
+        int id;
+        int categoryId;
+        std::string name;
+      };
+      int id = 0;
+      std::string name;
+      std::vector<Category> categories;
+      std::vector<Room> rooms;
+
+      for (auto token = reader.next(); token != Token::EndObject; token = reader.next())
+      {
+        if (token != Token::Key)
+          return fail(reader, "Expected a member of a hotel");
+
+        auto& key = reader.text();
+        if (key == "id")
+        {
+          if (!readInt(reader, id))
+            return false;
+        }
+        else if (key == "name")
+        {
+          if (!readString(reader, name))
+            return false;
+        }
+        else if (key == "categories" || key == "rooms")
+        {
+          auto isCategory = key == "categories";
+          if (reader.next() != Token::BeginArray)
+            return fail(reader, "Expected an array");
+          for (token = reader.next(); token != Token::EndArray; token = reader.next())
+          {
+            if (token != Token::BeginObject)
+              return fail(reader, "Expected an object");
+
+            Category category{0, {}, {}};
+            Room room{0, 0, {}};
+            for (token = reader.next(); token != Token::EndObject; token = reader.next())
+            {
+              if (token != Token::Key)
+                return fail(reader, "Expected a member");
+              auto& member = reader.text();
+              auto success = true;
+              if (member == "id")
+                success = readInt(reader, isCategory ? category.id : room.id);
+              else if (member == "name")
+                success = readString(reader, isCategory ? category.name : room.name);
+              else if (isCategory && member == "shortCode")
+                success = readString(reader, category.shortCode);
+              else if (!isCategory && member == "categoryId")
+                success = readInt(reader, room.categoryId);
+              else
+                success = reader.skipValue() || fail(reader, "Invalid value");
+              if (!success)
+                return false;
+            }
+            if (isCategory)
+              categories.push_back(std::move(category));
+            else
+              rooms.push_back(std::move(room));
+          }
+        }
+        else if (!reader.skipValue())
+          return fail(reader, "Invalid value");
+      }
+
+      // The document ids only connect the objects of the document, the stored objects get new ones
+      auto hotel = std::make_unique<hotel::Hotel>(name);
+      std::unordered_map<int, std::string> categoryCodes;
+      for (auto& category : categories)
+      {
+        categoryCodes[category.id] = category.shortCode;
+        try
+        {
+          hotel->addRoomCategory(std::make_unique<hotel::RoomCategory>(category.shortCode, category.name));
+        }
+        catch (std::logic_error& e)
+        {
+          return fail(reader, e.what());
+        }
+      }
+      std::vector<int> roomIds;
+      for (auto& room : rooms)
+      {
+        auto category = categoryCodes.find(room.categoryId);
+        if (category == categoryCodes.end())
+          return fail(reader, "Room " + std::to_string(room.id) + " refers to an unknown category");
+        hotel->addRoom(std::make_unique<hotel::HotelRoom>(room.name), category->second);
+        roomIds.push_back(room.id);
+      }
+
+      addOperation(op::StoreNewHotel{std::move(hotel)}, std::move(roomIds));
+      return true;
+    }
+
+    bool JsonImporter::readReservation(JsonReader& reader)
+    {
+      auto reservation = std::make_unique<hotel::Reservation>("");
+      int id = 0;
+      bool inUnstoredRoom = false;
+      for (auto token = reader.next(); token != Token::EndObject; token = reader.next())
+      {
+        if (token != Token::Key)
+          return fail(reader, "Expected a member of a reservation");
+
+        auto& key = reader.text();
+        if (key == "id")
+        {
+          // The reservation gets a new id, the document id is only used in error messages
+          if (!readInt(reader, id))
+            return false;
+        }
+        else if (key == "description")
+        {
+          std::string description;
+          if (!readString(reader, description))
+            return false;
+          reservation->setDescription(description);
+        }
+        else if (key == "atoms")
+        {
+          if (reader.next() != Token::BeginArray)
+            return fail(reader, "Expected an array");
+          for (token = reader.next(); token != Token::EndArray; token = reader.next())
+          {
+            if (token != Token::BeginObject)
+              return fail(reader, "Expected an object");
+
+            int roomId = 0;
+            boost::gregorian::date from;
+            boost::gregorian::date to;
+            for (token = reader.next(); token != Token::EndObject; token = reader.next())
+            {
+              if (token != Token::Key)
+                return fail(reader, "Expected a member of an atom");
+              auto& member = reader.text();
+              auto success = true;
+              if (member == "roomId")
+                success = readInt(reader, roomId);
+              else if (member == "from")
+                success = readDate(reader, from);
+              else if (member == "to")
+                success = readDate(reader, to);
+              else
+                success = reader.skipValue() || fail(reader, "Invalid value");
+              if (!success)
+                return false;
+            }
+
+            auto importedRoom = _roomIds.find(roomId);
+            if (importedRoom != _roomIds.end())
+              roomId = importedRoom->second;
+            else if (_unstoredRoomIds.count(roomId) != 0)
+              inUnstoredRoom = true;
+            try
+            {
+              reservation->addAtom(roomId, boost::gregorian::date_period(from, to));
+            }
+            catch (std::logic_error& e)
+            {
+              return fail(reader, e.what());
+            }
+          }
+        }
+        else if (!reader.skipValue())
+          return fail(reader, "Invalid value");
+      }
+
+      if (reservation->atoms().empty())
+        return fail(reader, "Reservation " + std::to_string(id) + " has no atoms");
+
+      // The document id of a room whose hotel could not be stored may refer to an unrelated room of the database
+      if (inUnstoredRoom)
+      {
+        ++_failedObjects;
+        return true;
+      }
+
+      addOperation(op::StoreNewReservation{std::move(reservation)});
+      return true;
+    }
+
+    bool JsonImporter::readInt(JsonReader& reader, int& value)
+    {
+      int64_t number = 0;
+      if (reader.next() != Token::Number || !reader.integer(number) || number < std::numeric_limits<int>::min() ||
+          number > std::numeric_limits<int>::max())
+        return fail(reader, "Expected an integer");
+      value = static_cast<int>(number);
+      return true;
+    }
+
+    bool JsonImporter::readString(JsonReader& reader, std::string& value)
+    {
+      if (reader.next() != Token::String)
+        return fail(reader, "Expected a string");
+      value = reader.text();
+      return true;
+    }
+
+    bool JsonImporter::readDate(JsonReader& reader, boost::gregorian::date& value)
+    {
+      if (reader.next() != Token::String)
+        return fail(reader, "Expected a date");
+      try
+      {
+        value = boost::gregorian::from_string(reader.text());
+      }
+      catch (std::exception&)
+      {
+        return fail(reader, "Invalid date \"" + reader.text() + "\"");
+      }
+      return true;
+    }
+
+    bool JsonImporter::fail(JsonReader& reader, const std::string& message)
+    {
+      // Syntax errors are reported by the reader
+      if (!reader.errorMessage().empty())
+        _errorMessage = reader.errorMessage();
+      else
+        _errorMessage = message + " at offset " + std::to_string(reader.offset());
+      return false;
+    }
+
+    void JsonImporter::addOperation(op::Operation operation, std::vector<int> roomIds)
+    {
+      _batch.operations.push_back(std::move(operation));
+      _batch.roomIds.push_back(std::move(roomIds));
+      if (_batch.operations.size() >= _batchSize)
+        queueBatch();
+    }
+
+    void JsonImporter::queueBatch()
+    {
+      if (_batch.operations.empty())
+        return;
+
+      // Backpressure: the parser does not get ahead of the backend by more than the given number of batches
+      waitForBatches(_maxPendingBatches - 1);
+      auto task = _dataSource.queueOperations(std::move(_batch.operations), op::TaskPriority::Bulk);
+      _pendingBatches.push_back(PendingBatch{task, std::move(_batch.roomIds)});
+      _batch = Batch();
+      _batch.operations.reserve(_batchSize);
+    }
+
+    void JsonImporter::waitForBatches(size_t maxPending)
+    {
+      while (_pendingBatches.size() > maxPending)
+      {
+        auto& batch = _pendingBatches.front();
+        batch.task.waitForCompletion();
+        _dataSource.processIntegrationQueue();
+
+        // Each operation has one result, the stored hotels tell the new ids of their rooms. If the batch could not
+        // be committed, a further result says so and none of its objects has been stored.
+        auto& results = batch.task.results();
+        auto committed = !results.empty() && boost::get<op::CommitFailedResult>(&results.back()) == nullptr;
+        for (size_t index = 0; index < batch.roomIds.size(); ++index)
+        {
+          auto result = committed && index < results.size() ? &results[index] : nullptr;
+          auto stored = result != nullptr ? boost::get<op::StoreNewHotelResult>(result) : nullptr;
+          auto hotel = stored != nullptr ? _dataSource.hotels().findHotelById(stored->storedHotelId) : nullptr;
+          if (hotel != nullptr)
+          {
+            auto& rooms = hotel->rooms();
+            auto& roomIds = batch.roomIds[index];
+            for (size_t i = 0; i < rooms.size() && i < roomIds.size(); ++i)
+            {
+              _roomIds[roomIds[i]] = rooms[i]->id();
+              _unstoredRoomIds.erase(roomIds[i]);
+            }
+            ++_importedHotels;
+          }
+          else if (result != nullptr && boost::get<op::StoreNewReservationResult>(result) != nullptr)
+          {
+            ++_importedReservations;
+          }
+          else
+          {
+            _unstoredRoomIds.insert(batch.roomIds[index].begin(), batch.roomIds[index].end());
+            ++_failedObjects;
+          }
+        }
+
+        _pendingBatches.pop_front();
+      }
+    }
+
+  } // namespace json
+} // namespace persistence
@@ -0,0 +1,104 @@
+#ifndef PERSISTENCE_JSON_JSONIMPORTER_H
+#define PERSISTENCE_JSON_JSONIMPORTER_H
+
+#include "persistence/datasource.h"
+#include "persistence/json/jsonreader.h"
+#include "persistence/op/operations.h"
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace persistence
+{
+  namespace json
+  {
+    /**
+     * @brief The JsonImporter class stores the hotels and reservations of JSON documents written by JsonSerializer
+     *
+     * The documents are parsed incrementally. The objects are queued on the data source in batches of bulk priority,
+     * each batch as soon as it is complete. Once the given number of batches is waiting for the backend, the importer
+     * waits for the oldest one to complete, such that the amount of data held at any time is bounded, independent of
+     * the size of the document.
+     *
+     * The imported objects get new ids from the data source, the ids of the document could be taken already. Room ids
+     * of reservations are translated to the new ids of the rooms which the same importer has imported before. Other
+     * room ids are kept, i.e. they have to refer to rooms of the database. Reservations in rooms which the importer has
+     * failed to store are not stored either.
+     *
+     * Objects which the backend fails to store are reported as an error once the import has finished. A batch which
+     * fails to commit counts all of its objects as failed.
+     *
+     * @note Must be used on the thread which integrates the results of the data source, it integrates them while
+     *       waiting for the backend.
+     */
+    class JsonImporter
+    {
+    public:
+      /**
+       * @param batchSize Number of objects stored by each task
+       * @param maxPendingBatches Number of tasks which may be waiting for the backend at the same time
+       */
+      JsonImporter(DataSource& dataSource, size_t batchSize = 256, size_t maxPendingBatches = 4);
+
+      /**
+       * @brief importHotelCollection stores the hotels of a document written by serializeHotelCollection()
+       * @return false if the document is malformed, see errorMessage(). The hotels preceding the error are stored.
+       */
+      bool importHotelCollection(JsonReader& reader);
+      //! Like importHotelCollection(), for the reservations of a document written by serializePlanning()
+      bool importPlanning(JsonReader& reader);
+
+      //! Numbers of objects which have been stored
+      size_t importedHotels() const { return _importedHotels; }
+      size_t importedReservations() const { return _importedReservations; }
+      const std::string& errorMessage() const { return _errorMessage; }
+
+    private:
+      template <typename ReadObject> bool importArray(JsonReader& reader, ReadObject readObject);
+      bool readHotel(JsonReader& reader);
+      bool readReservation(JsonReader& reader);
+
+      bool readInt(JsonReader& reader, int& value);
+      bool readString(JsonReader& reader, std::string& value);
+      bool readDate(JsonReader& reader, boost::gregorian::date& value);
+      bool fail(JsonReader& reader, const std::string& message);
+
+      void addOperation(op::Operation operation, std::vector<int> roomIds = {});
+      void queueBatch();
+      void waitForBatches(size_t maxPending);
+
+      DataSource& _dataSource;
+      size_t _batchSize;
+      size_t _maxPendingBatches;
+
+      // Operations of a batch together with the document ids of the rooms stored by each of them
+      struct Batch
+      {
+        op::Operations operations;
+        std::vector<std::vector<int>> roomIds;
+      };
+      struct PendingBatch
+      {
+        op::Task<op::OperationResults> task;
+        std::vector<std::vector<int>> roomIds;
+      };
+      Batch _batch;
+      std::deque<PendingBatch> _pendingBatches;
+
+      // New ids of the imported rooms by their ids in the document, and the document ids of rooms not stored
+      std::unordered_map<int, int> _roomIds;
+      std::unordered_set<int> _unstoredRoomIds;
+
+      size_t _importedHotels;
+      size_t _importedReservations;
+      size_t _failedObjects;
+      std::string _errorMessage;
+    };
+
+  } // namespace json
+} // namespace persistence
+
+#endif // PERSISTENCE_JSON_JSONIMPORTER_H
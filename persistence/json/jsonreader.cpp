@@ -0,0 +1,403 @@
+#include "persistence/json/jsonreader.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace persistence
+{
+  namespace json
+  {
+    JsonReader::JsonReader(std::istream& stream, size_t bufferSize)
+        : _stream(&stream), _fileDescriptor(-1), _buffer(std::max<size_t>(bufferSize, 16)), _position(0), _end(0),
+          _bufferOffset(0), _tokenOffset(0), _state(State::Value), _containers(), _text(), _errorMessage()
+    {
+    }
+
+    JsonReader::JsonReader(int fileDescriptor, size_t bufferSize)
+        : _stream(nullptr), _fileDescriptor(fileDescriptor), _buffer(std::max<size_t>(bufferSize, 16)), _position(0),
+          _end(0), _bufferOffset(0), _tokenOffset(0), _state(State::Value), _containers(), _text(), _errorMessage()
+    {
+    }
+
+    bool JsonReader::fill()
+    {
+      _bufferOffset += _end;
+      _position = 0;
+      _end = 0;
+      if (_stream != nullptr)
+      {
+        _stream->read(_buffer.data(), _buffer.size());
+        _end = static_cast<size_t>(_stream->gcount());
+      }
+      else
+      {
+        ssize_t count;
+        do
+          count = ::read(_fileDescriptor, _buffer.data(), _buffer.size());
+        while (count < 0 && errno == EINTR);
+        _end = count > 0 ? static_cast<size_t>(count) : 0;
+      }
+      return _end > 0;
+    }
+
+    JsonReader::Token JsonReader::next()
+    {
+      if (_state == State::Failed)
+        return Token::Error;
+
+      auto c = skipWhitespace();
+      _tokenOffset = currentOffset();
+      switch (_state)
+      {
+      case State::Done:
+        return c == -1 ? Token::EndOfInput : fail("Unexpected data after the end of the document");
+      case State::Value:
+        takeChar();
+        return readValueToken(c);
+      case State::ArrayFirst:
+        takeChar();
+        return c == ']' ? closeContainer(false) : readValueToken(c);
+      case State::ArrayNext:
+        takeChar();
+        if (c == ']')
+          return closeContainer(false);
+        if (c != ',')
+          return fail("Expected ',' or ']'");
+        c = skipWhitespace();
+        _tokenOffset = currentOffset();
+        takeChar();
+        return readValueToken(c);
+      case State::ObjectFirst:
+        takeChar();
+        if (c == '}')
+          return closeContainer(true);
+        return c == '"' ? readKey() : fail("Expected a key or '}'");
+      case State::ObjectNext:
+        takeChar();
+        if (c == '}')
+          return closeContainer(true);
+        if (c != ',')
+          return fail("Expected ',' or '}'");
+        c = skipWhitespace();
+        _tokenOffset = currentOffset();
+        takeChar();
+        return c == '"' ? readKey() : fail("Expected a key");
+      case State::Failed:
+        break;
+      }
+      return Token::Error;
+    }
+
+    bool JsonReader::integer(int64_t& value) const
+    {
+      if (_text.empty() || _text.find_first_of(".eE") != std::string::npos)
+        return false;
+      errno = 0;
+      char* end = nullptr;
+      auto parsed = std::strtoll(_text.c_str(), &end, 10);
+      if (errno == ERANGE || end != _text.c_str() + _text.size())
+        return false;
+      value = parsed;
+      return true;
+    }
+
+    bool JsonReader::skipValue()
+    {
+      int depth = 0;
+      do
+      {
+        switch (next())
+        {
+        case Token::BeginArray:
+        case Token::BeginObject:
+          ++depth;
+          break;
+        case Token::EndArray:
+        case Token::EndObject:
+          --depth;
+          break;
+        case Token::EndOfInput:
+        case Token::Error:
+          return false;
+        default:
+          break;
+        }
+      } while (depth > 0);
+      return true;
+    }
+
+    JsonReader::Token JsonReader::fail(const std::string& message)
+    {
+      if (_state != State::Failed)
+        _errorMessage = message + " at offset " + std::to_string(_tokenOffset);
+      _state = State::Failed;
+      return Token::Error;
+    }
+
+    bool JsonReader::error(const std::string& message)
+    {
+      fail(message);
+      return false;
+    }
+
+    int JsonReader::skipWhitespace()
+    {
+      auto c = peekChar();
+      while (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+      {
+        takeChar();
+        c = peekChar();
+      }
+      return c;
+    }
+
+    JsonReader::Token JsonReader::readValueToken(int c)
+    {
+      switch (c)
+      {
+      case '[':
+        _containers.push_back(false);
+        _state = State::ArrayFirst;
+        return Token::BeginArray;
+      case '{':
+        _containers.push_back(true);
+        _state = State::ObjectFirst;
+        return Token::BeginObject;
+      case '"':
+        if (!readString())
+          return Token::Error;
+        finishValue();
+        return Token::String;
+      case 't':
+        if (!readLiteral("rue"))
+          return Token::Error;
+        finishValue();
+        return Token::True;
+      case 'f':
+        if (!readLiteral("alse"))
+          return Token::Error;
+        finishValue();
+        return Token::False;
+      case 'n':
+        if (!readLiteral("ull"))
+          return Token::Error;
+        finishValue();
+        return Token::Null;
+      case -1:
+        return fail("Unexpected end of input");
+      default:
+        if (c == '-' || (c >= '0' && c <= '9'))
+        {
+          if (!readNumber(c))
+            return Token::Error;
+          finishValue();
+          return Token::Number;
+        }
+        return fail("Unexpected character");
+      }
+    }
+
+    JsonReader::Token JsonReader::readKey()
+    {
+      if (!readString())
+        return Token::Error;
+      if (skipWhitespace() != ':')
+        return fail("Expected ':'");
+      takeChar();
+      _state = State::Value;
+      return Token::Key;
+    }
+
+    JsonReader::Token JsonReader::closeContainer(bool isObject)
+    {
+      _containers.pop_back();
+      finishValue();
+      return isObject ? Token::EndObject : Token::EndArray;
+    }
+
+    void JsonReader::finishValue()
+    {
+      if (_containers.empty())
+        _state = State::Done;
+      else
+        _state = _containers.back() ? State::ObjectNext : State::ArrayNext;
+    }
+
+    bool JsonReader::readString()
+    {
+      // The opening quote has already been consumed
+      _text.clear();
+      while (true)
+      {
+        // Runs of plain characters are copied in one go
+        auto runBegin = _position;
+        while (_position < _end && _buffer[_position] != '"' && _buffer[_position] != '\\' &&
+               static_cast<unsigned char>(_buffer[_position]) >= 0x20)
+          ++_position;
+        _text.append(_buffer.data() + runBegin, _position - runBegin);
+
+        auto c = takeChar();
+        if (c == '"')
+          return true;
+        if (c == -1)
+          return error("Unterminated string");
+        if (c < 0x20)
+          return error("Control character in string");
+        if (c != '\\')
+        {
+          // The run has stopped at the end of the buffer
+          _text.push_back(static_cast<char>(c));
+          continue;
+        }
+
+        switch (takeChar())
+        {
+        case '"':
+          _text.push_back('"');
+          break;
+        case '\\':
+          _text.push_back('\\');
+          break;
+        case '/':
+          _text.push_back('/');
+          break;
+        case 'b':
+          _text.push_back('\b');
+          break;
+        case 'f':
+          _text.push_back('\f');
+          break;
+        case 'n':
+          _text.push_back('\n');
+          break;
+        case 'r':
+          _text.push_back('\r');
+          break;
+        case 't':
+          _text.push_back('\t');
+          break;
+        case 'u':
+        {
+          uint32_t codePoint;
+          if (!readHexQuad(codePoint))
+            return false;
+          // A high surrogate has to be followed by an escaped low surrogate
+          if (codePoint >= 0xd800 && codePoint < 0xdc00)
+          {
+            uint32_t low;
+            if (takeChar() != '\\' || takeChar() != 'u' || !readHexQuad(low) || low < 0xdc00 || low >= 0xe000)
+              return error("Invalid surrogate pair");
+            codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+          }
+          else if (codePoint >= 0xdc00 && codePoint < 0xe000)
+            return error("Invalid surrogate pair");
+          appendUtf8(codePoint);
+          break;
+        }
+        default:
+          return error("Invalid escape sequence");
+        }
+      }
+    }
+
+    bool JsonReader::readHexQuad(uint32_t& value)
+    {
+      value = 0;
+      for (int i = 0; i < 4; ++i)
+      {
+        auto c = takeChar();
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+          value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+          value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+          value |= c - 'A' + 10;
+        else
+          return error("Invalid unicode escape");
+      }
+      return true;
+    }
+
+    void JsonReader::appendUtf8(uint32_t codePoint)
+    {
+      if (codePoint < 0x80)
+        _text.push_back(static_cast<char>(codePoint));
+      else if (codePoint < 0x800)
+      {
+        _text.push_back(static_cast<char>(0xc0 | (codePoint >> 6)));
+        _text.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+      }
+      else if (codePoint < 0x10000)
+      {
+        _text.push_back(static_cast<char>(0xe0 | (codePoint >> 12)));
+        _text.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+        _text.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+      }
+      else
+      {
+        _text.push_back(static_cast<char>(0xf0 | (codePoint >> 18)));
+        _text.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f)));
+        _text.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+        _text.push_back(static_cast<char>(0x80 | (codePoint & 0x3f)));
+      }
+    }
+
+    bool JsonReader::readNumber(int first)
+    {
+      // The first character has already been consumed
+      _text.assign(1, static_cast<char>(first));
+      auto isDigit = [](int c) { return c >= '0' && c <= '9'; };
+      auto takeDigits = [&]() {
+        auto count = 0;
+        while (isDigit(peekChar()))
+        {
+          _text.push_back(static_cast<char>(takeChar()));
+          ++count;
+        }
+        return count;
+      };
+
+      if (first == '-')
+      {
+        auto c = takeChar();
+        if (!isDigit(c))
+          return error("Invalid number");
+        _text.push_back(static_cast<char>(c));
+        first = c;
+      }
+      if (first != '0')
+        takeDigits();
+      else if (isDigit(peekChar()))
+        return error("Invalid number");
+
+      if (peekChar() == '.')
+      {
+        _text.push_back(static_cast<char>(takeChar()));
+        if (takeDigits() == 0)
+          return error("Invalid number");
+      }
+      if (peekChar() == 'e' || peekChar() == 'E')
+      {
+        _text.push_back(static_cast<char>(takeChar()));
+        if (peekChar() == '+' || peekChar() == '-')
+          _text.push_back(static_cast<char>(takeChar()));
+        if (takeDigits() == 0)
+          return error("Invalid number");
+      }
+      return true;
+    }
+
+    bool JsonReader::readLiteral(const char* rest)
+    {
+      for (; *rest != '\0'; ++rest)
+        if (takeChar() != *rest)
+          return error("Invalid literal");
+      return true;
+    }
+
+  } // namespace json
+} // namespace persistence
@@ -0,0 +1,123 @@
+#ifndef PERSISTENCE_JSON_JSONREADER_H
+#define PERSISTENCE_JSON_JSONREADER_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace persistence
+{
+  namespace json
+  {
+    /**
+     * @brief The JsonReader class is a pull parser for JSON text read from a stream or file descriptor
+     *
+     * The text is read through a buffer of fixed size and handed out token by token, without building a document.
+     * The memory used thus only depends on the longest string in the input and on the nesting depth. The reader checks
+     * the syntax of the input: after an error, next() keeps returning Token::Error.
+     */
+    class JsonReader
+    {
+    public:
+      enum class Token
+      {
+        BeginArray,
+        EndArray,
+        BeginObject,
+        EndObject,
+        Key, //!< The name of an object member, see text()
+        String,
+        Number,
+        True,
+        False,
+        Null,
+        EndOfInput,
+        Error
+      };
+
+      static const size_t defaultBufferSize = 64 * 1024;
+
+      explicit JsonReader(std::istream& stream, size_t bufferSize = defaultBufferSize);
+      //! Reads from the given file descriptor, which stays owned by the caller
+      explicit JsonReader(int fileDescriptor, size_t bufferSize = defaultBufferSize);
+      JsonReader(const JsonReader&) = delete;
+      JsonReader& operator=(const JsonReader&) = delete;
+
+      //! Reads the next token
+      Token next();
+      //! Text of the last Key, String or Number token, with escape sequences resolved
+      const std::string& text() const { return _text; }
+      //! Value of the last Number token, if it is an integer within range
+      bool integer(int64_t& value) const;
+      /**
+       * @brief skipValue skips the value starting at the next token, including all of its nested values
+       * @return false if the input ends or is malformed
+       */
+      bool skipValue();
+
+      //! Description of the syntax error, empty if there has been no error
+      const std::string& errorMessage() const { return _errorMessage; }
+      //! Offset of the last token in the input
+      uint64_t offset() const { return _tokenOffset; }
+
+    private:
+      bool fill();
+      int peekChar()
+      {
+        if (_position == _end && !fill())
+          return -1;
+        return static_cast<unsigned char>(_buffer[_position]);
+      }
+      int takeChar()
+      {
+        auto c = peekChar();
+        if (c != -1)
+          ++_position;
+        return c;
+      }
+      uint64_t currentOffset() const { return _bufferOffset + _position; }
+
+      Token fail(const std::string& message);
+      //! Like fail(), for the functions reporting success as bool
+      bool error(const std::string& message);
+      int skipWhitespace();
+      Token readValueToken(int c);
+      Token readKey();
+      Token closeContainer(bool isObject);
+      void finishValue();
+      bool readString();
+      bool readHexQuad(uint32_t& value);
+      void appendUtf8(uint32_t codePoint);
+      bool readNumber(int first);
+      bool readLiteral(const char* rest);
+
+      std::istream* _stream;
+      int _fileDescriptor;
+      std::vector<char> _buffer;
+      size_t _position;
+      size_t _end;
+      uint64_t _bufferOffset;
+      uint64_t _tokenOffset;
+
+      enum class State
+      {
+        Value,        // Expects a value, e.g. at the beginning
+        ArrayFirst,   // Expects a value or the end of an array
+        ArrayNext,    // Expects a comma or the end of an array
+        ObjectFirst,  // Expects a key or the end of an object
+        ObjectNext,   // Expects a comma or the end of an object
+        Done,
+        Failed
+      };
+      State _state;
+      // For each open container, true if it is an object
+      std::vector<bool> _containers;
+      std::string _text;
+      std::string _errorMessage;
+    };
+
+  } // namespace json
+} // namespace persistence
+
+#endif // PERSISTENCE_JSON_JSONREADER_H
@@ -78,5 +78,86 @@ namespace persistence
       return resultJson;
     }
 
+    void JsonSerializer::serializeHotelCollection(const hotel::HotelCollection& hotelCollection, JsonWriter& writer)
+    {
+      writer.beginArray();
+      for (auto& hotel : hotelCollection.hotels())
+        serializeHotel(*hotel, writer);
+      writer.endArray();
+      writer.flush();
+    }
+
+    void JsonSerializer::serializePlanning(const hotel::PlanningBoard& planning, JsonWriter& writer)
+    {
+      writer.beginArray();
+      for (auto reservation : planning.reservations())
+        serializeReservation(*reservation, writer);
+      writer.endArray();
+      writer.flush();
+    }
+
+    void JsonSerializer::serializeHotel(const hotel::Hotel& hotel, JsonWriter& writer)
+    {
+      // The members are written in the order of their names, like nlohmann::json does
+      writer.beginObject();
+      writer.key("categories");
+      writer.beginArray();
+      for (auto& category : hotel.categories())
+      {
+        writer.beginObject();
+        writer.key("id");
+        writer.value(category->id());
+        writer.key("name");
+        writer.value(category->name());
+        writer.key("shortCode");
+        writer.value(category->shortCode());
+        writer.endObject();
+      }
+      writer.endArray();
+      writer.key("id");
+      writer.value(hotel.id());
+      writer.key("name");
+      writer.value(hotel.name());
+      writer.key("rooms");
+      writer.beginArray();
+      for (auto& room : hotel.rooms())
+      {
+        writer.beginObject();
+        writer.key("categoryId");
+        writer.value(room->category()->id());
+        writer.key("id");
+        writer.value(room->id());
+        writer.key("name");
+        writer.value(room->name());
+        writer.endObject();
+      }
+      writer.endArray();
+      writer.endObject();
+    }
+
+    void JsonSerializer::serializeReservation(const hotel::Reservation& reservation, JsonWriter& writer)
+    {
+      writer.beginObject();
+      writer.key("atoms");
+      writer.beginArray();
+      for (auto& atom : reservation.atoms())
+      {
+        writer.beginObject();
+        writer.key("from");
+        writer.value(atom.dateRange().begin());
+        writer.key("roomId");
+        writer.value(atom.roomId());
+        writer.key("to");
+        writer.value(atom.dateRange().end());
+        writer.endObject();
+      }
+      writer.endArray();
+      writer.key("description");
+      writer.value(reservation.description());
+      writer.key("id");
+      writer.value(reservation.id());
+      writer.endObject();
+    }
+
   } // namespace json
 } // namespace persistence
@@ -4,6 +4,7 @@
 #include "hotel/hotel.h"
 #include "hotel/hotelcollection.h"
 #include "hotel/planning.h"
+#include "persistence/json/jsonwriter.h"
 
 #include "json.hpp"
 
@@ -12,6 +13,13 @@ namespace persistence
   namespace json
   {
 
+    /**
+     * @brief The JsonSerializer class converts hotels and reservations to JSON
+     *
+     * The functions returning a nlohmann::json build the whole document in memory. The functions taking a JsonWriter
+     * stream the same document, member by member, and are meant for exporting large amounts of data. Both produce the
+     * same text, with the members of each object ordered by their names.
+     */
     class JsonSerializer
     {
     public:
@@ -19,6 +27,14 @@ namespace persistence
 
       nlohmann::json serializeHotelCollection(const hotel::HotelCollection& hotelCollection);
       nlohmann::json serializePlanning(const hotel::PlanningBoard& planning);
+
+      void serializeHotelCollection(const hotel::HotelCollection& hotelCollection, JsonWriter& writer);
+      void serializePlanning(const hotel::PlanningBoard& planning, JsonWriter& writer);
+
+      //! Writes a single hotel object
+      void serializeHotel(const hotel::Hotel& hotel, JsonWriter& writer);
+      //! Writes a single reservation object
+      void serializeReservation(const hotel::Reservation& reservation, JsonWriter& writer);
     };
 
   } // namespace json
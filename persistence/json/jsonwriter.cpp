@@ -0,0 +1,253 @@
+#include "persistence/json/jsonwriter.h"
+
+#include <boost/date_time/gregorian/formatters.hpp>
+
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace persistence
+{
+  namespace json
+  {
+    namespace
+    {
+      // Writes the decimal digits of the value backwards from end and returns the first digit
+      char* formatInteger(int64_t value, char* end)
+      {
+        // Negating in unsigned arithmetic also works for the smallest value
+        auto magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        auto begin = end;
+        do
+        {
+          *--begin = static_cast<char>('0' + magnitude % 10);
+          magnitude /= 10;
+        } while (magnitude != 0);
+        if (value < 0)
+          *--begin = '-';
+        return begin;
+      }
+    } // namespace
+
+    JsonWriter::JsonWriter(std::ostream& stream, size_t bufferSize)
+        : _stream(&stream), _string(nullptr), _fileDescriptor(-1), _buffer(std::max<size_t>(bufferSize, 32)), _used(0),
+          _failed(false), _hasElements(), _afterKey(false)
+    {
+    }
+
+    JsonWriter::JsonWriter(int fileDescriptor, size_t bufferSize)
+        : _stream(nullptr), _string(nullptr), _fileDescriptor(fileDescriptor),
+          _buffer(std::max<size_t>(bufferSize, 32)), _used(0), _failed(false), _hasElements(), _afterKey(false)
+    {
+    }
+
+    JsonWriter::JsonWriter(std::string& output, size_t bufferSize)
+        : _stream(nullptr), _string(&output), _fileDescriptor(-1), _buffer(std::max<size_t>(bufferSize, 32)), _used(0),
+          _failed(false), _hasElements(), _afterKey(false)
+    {
+    }
+
+    JsonWriter::~JsonWriter() { flush(); }
+
+    void JsonWriter::beginArray()
+    {
+      separate();
+      writeChar('[');
+      _hasElements.push_back(false);
+    }
+
+    void JsonWriter::endArray()
+    {
+      assert(!_hasElements.empty() && !_afterKey);
+      _hasElements.pop_back();
+      writeChar(']');
+    }
+
+    void JsonWriter::beginObject()
+    {
+      separate();
+      writeChar('{');
+      _hasElements.push_back(false);
+    }
+
+    void JsonWriter::endObject()
+    {
+      assert(!_hasElements.empty() && !_afterKey);
+      _hasElements.pop_back();
+      writeChar('}');
+    }
+
+    void JsonWriter::key(const char* name)
+    {
+      separate();
+      writeEscaped(name);
+      writeChar(':');
+      _afterKey = true;
+    }
+
+    void JsonWriter::value(int value) { this->value(static_cast<int64_t>(value)); }
+
+    void JsonWriter::value(int64_t value)
+    {
+      separate();
+      char digits[24];
+      auto end = digits + sizeof(digits);
+      auto begin = formatInteger(value, end);
+      writeRaw(begin, end - begin);
+    }
+
+    void JsonWriter::value(const std::string& value)
+    {
+      separate();
+      writeEscaped(value);
+    }
+
+    void JsonWriter::value(boost::gregorian::date value)
+    {
+      if (value.is_special())
+      {
+        this->value(boost::gregorian::to_iso_extended_string(value));
+        return;
+      }
+
+      separate();
+      auto ymd = value.year_month_day();
+      char text[12] = {'"', 0, 0, 0, 0, '-', 0, 0, '-', 0, 0, '"'};
+      auto year = static_cast<int>(ymd.year);
+      for (int i = 4; i >= 1; --i, year /= 10)
+        text[i] = static_cast<char>('0' + year % 10);
+      text[6] = static_cast<char>('0' + ymd.month / 10);
+      text[7] = static_cast<char>('0' + ymd.month % 10);
+      text[9] = static_cast<char>('0' + ymd.day / 10);
+      text[10] = static_cast<char>('0' + ymd.day % 10);
+      writeRaw(text, sizeof(text));
+    }
+
+    void JsonWriter::flush()
+    {
+      writeOut(_buffer.data(), _used);
+      _used = 0;
+    }
+
+    void JsonWriter::writeOut(const char* data, size_t size)
+    {
+      if (size == 0 || _failed)
+        return;
+
+      if (_stream != nullptr)
+      {
+        _stream->write(data, size);
+        _failed = !*_stream;
+      }
+      else if (_string != nullptr)
+        _string->append(data, size);
+      else
+      {
+        while (size > 0)
+        {
+          auto written = ::write(_fileDescriptor, data, size);
+          if (written < 0 && errno == EINTR)
+            continue;
+          if (written <= 0)
+          {
+            _failed = true;
+            break;
+          }
+          data += written;
+          size -= written;
+        }
+      }
+      if (_failed)
+        std::cerr << "Cannot write JSON output" << std::endl;
+    }
+
+    void JsonWriter::separate()
+    {
+      // A value following a key belongs to it, every other element is separated from its predecessor
+      if (_afterKey)
+      {
+        _afterKey = false;
+        return;
+      }
+      if (_hasElements.empty())
+        return;
+      if (_hasElements.back())
+        writeChar(',');
+      _hasElements.back() = true;
+    }
+
+    void JsonWriter::writeRaw(const char* data, size_t size)
+    {
+      if (_buffer.size() - _used < size)
+      {
+        flush();
+        // Chunks larger than the buffer bypass it
+        if (size > _buffer.size())
+        {
+          writeOut(data, size);
+          return;
+        }
+      }
+      std::memcpy(_buffer.data() + _used, data, size);
+      _used += size;
+    }
+
+    void JsonWriter::writeEscaped(const std::string& text)
+    {
+      // Escapes the same characters as nlohmann::json, runs of other characters are copied in one go
+      static const char hexDigits[] = "0123456789abcdef";
+      writeChar('"');
+      size_t runBegin = 0;
+      for (size_t i = 0; i < text.size(); ++i)
+      {
+        auto c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+          continue;
+
+        writeRaw(text.data() + runBegin, i - runBegin);
+        runBegin = i + 1;
+        char escape[6] = {'\\', 0, 0, 0, 0, 0};
+        size_t escapeSize = 2;
+        switch (c)
+        {
+        case '"':
+          escape[1] = '"';
+          break;
+        case '\\':
+          escape[1] = '\\';
+          break;
+        case '\b':
+          escape[1] = 'b';
+          break;
+        case '\f':
+          escape[1] = 'f';
+          break;
+        case '\n':
+          escape[1] = 'n';
+          break;
+        case '\r':
+          escape[1] = 'r';
+          break;
+        case '\t':
+          escape[1] = 't';
+          break;
+        default:
+          escape[1] = 'u';
+          escape[2] = '0';
+          escape[3] = '0';
+          escape[4] = hexDigits[c >> 4];
+          escape[5] = hexDigits[c & 0x0f];
+          escapeSize = 6;
+          break;
+        }
+        writeRaw(escape, escapeSize);
+      }
+      writeRaw(text.data() + runBegin, text.size() - runBegin);
+      writeChar('"');
+    }
+
+  } // namespace json
+} // namespace persistence
@@ -0,0 +1,87 @@
+#ifndef PERSISTENCE_JSON_JSONWRITER_H
+#define PERSISTENCE_JSON_JSONWRITER_H
+
+#include <boost/date_time/gregorian/gregorian_types.hpp>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace persistence
+{
+  namespace json
+  {
+    /**
+     * @brief The JsonWriter class writes compact JSON text directly to a stream or file descriptor
+     *
+     * The text is assembled in a buffer of fixed size, which is written out whenever it is full. No document is built
+     * in memory, thus the memory used does not depend on the amount of data written. The output is formatted like
+     * nlohmann::json::dump() without indentation.
+     *
+     * The writer does not check that the calls form a valid document, except by assertions in debug builds.
+     */
+    class JsonWriter
+    {
+    public:
+      static const size_t defaultBufferSize = 64 * 1024;
+
+      explicit JsonWriter(std::ostream& stream, size_t bufferSize = defaultBufferSize);
+      //! Writes to the given file descriptor, which stays owned by the caller
+      explicit JsonWriter(int fileDescriptor, size_t bufferSize = defaultBufferSize);
+      //! Appends to the given string, e.g. a buffer for a part of a larger document
+      explicit JsonWriter(std::string& output, size_t bufferSize = 4096);
+      JsonWriter(const JsonWriter&) = delete;
+      JsonWriter& operator=(const JsonWriter&) = delete;
+      ~JsonWriter();
+
+      void beginArray();
+      void endArray();
+      void beginObject();
+      void endObject();
+      //! Writes the key of the next member of the current object
+      void key(const char* name);
+
+      void value(int value);
+      void value(int64_t value);
+      void value(const std::string& value);
+      //! Writes the date as a string in ISO extended format, like boost::gregorian::to_iso_extended_string()
+      void value(boost::gregorian::date value);
+
+      //! Ends the current line, for documents holding one value per line (NDJSON)
+      void endLine() { writeChar('\n'); }
+      //! Writes a comma between top-level values, for a part of an array whose brackets are written elsewhere
+      void separateValues() { writeChar(','); }
+
+      //! Writes the buffered text to the output
+      void flush();
+      //! Returns false if writing to the output has failed
+      bool good() const { return !_failed; }
+
+    private:
+      void separate();
+      void writeRaw(const char* data, size_t size);
+      void writeOut(const char* data, size_t size);
+      void writeChar(char c)
+      {
+        if (_used == _buffer.size())
+          flush();
+        _buffer[_used++] = c;
+      }
+      void writeEscaped(const std::string& text);
+
+      std::ostream* _stream;
+      std::string* _string;
+      int _fileDescriptor;
+      std::vector<char> _buffer;
+      size_t _used;
+      bool _failed;
+      // For each open array or object, whether it already has an element, the next one is preceded by a comma
+      std::vector<bool> _hasElements;
+      bool _afterKey;
+    };
+
+  } // namespace json
+} // namespace persistence
+
+#endif // PERSISTENCE_JSON_JSONWRITER_H
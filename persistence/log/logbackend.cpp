@@ -0,0 +1,495 @@
+#include "persistence/log/logbackend.h"
+
+#include "persistence/filesync.h"
+#include "persistence/snapshot/snapshot.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace persistence
+{
+  namespace log
+  {
+    namespace
+    {
+      enum class RecordType : uint8_t
+      {
+        StoreHotel = 1,
+        StoreReservation,
+        DeleteReservation,
+        EraseAllData,
+        IdWatermark //!< Largest id handed out in one id space, including ids which are not in use anymore
+      };
+
+      class RecordWriter
+      {
+      public:
+        RecordWriter(std::vector<char>& buffer, RecordType type) : _buffer(buffer)
+        {
+          _buffer.clear();
+          _buffer.push_back(static_cast<char>(type));
+        }
+
+        void write(int32_t value)
+        {
+          auto bytes = reinterpret_cast<const char*>(&value);
+          _buffer.insert(_buffer.end(), bytes, bytes + sizeof(value));
+        }
+
+        void write(const std::string& value)
+        {
+          write(static_cast<int32_t>(value.size()));
+          _buffer.insert(_buffer.end(), value.begin(), value.end());
+        }
+
+      private:
+        std::vector<char>& _buffer;
+      };
+
+      //! Reads the fields of a record, reading beyond its end makes the reader fail and returns empty values
+      class RecordReader
+      {
+      public:
+        RecordReader(const char* data, size_t size) : _data(data), _size(size), _position(1), _failed(size == 0) {}
+
+        RecordType type() const { return _size > 0 ? static_cast<RecordType>(_data[0]) : RecordType(); }
+        bool failed() const { return _failed; }
+
+        int32_t readInt()
+        {
+          int32_t value = 0;
+          if (!canRead(sizeof(value)))
+            return 0;
+          std::memcpy(&value, _data + _position, sizeof(value));
+          _position += sizeof(value);
+          return value;
+        }
+
+        std::string readString()
+        {
+          auto length = readInt();
+          if (length < 0 || !canRead(length))
+            return std::string();
+          std::string value(_data + _position, length);
+          _position += length;
+          return value;
+        }
+
+      private:
+        bool canRead(size_t count)
+        {
+          if (_size - _position < count)
+            _failed = true;
+          return !_failed;
+        }
+
+        const char* _data;
+        size_t _size;
+        size_t _position;
+        bool _failed;
+      };
+
+      void writeHotel(std::vector<char>& buffer, const hotel::Hotel& hotel)
+      {
+        RecordWriter writer(buffer, RecordType::StoreHotel);
+        writer.write(hotel.id());
+        writer.write(hotel.name());
+        writer.write(static_cast<int32_t>(hotel.categories().size()));
+        for (auto& category : hotel.categories())
+        {
+          writer.write(category->id());
+          writer.write(category->shortCode());
+          writer.write(category->name());
+        }
+        writer.write(static_cast<int32_t>(hotel.rooms().size()));
+        for (auto& room : hotel.rooms())
+        {
+          writer.write(room->id());
+          writer.write(room->category()->id());
+          writer.write(room->name());
+        }
+      }
+
+      std::unique_ptr<hotel::Hotel> readHotel(RecordReader& reader)
+      {
+        auto id = reader.readInt();
+        auto hotel = std::make_unique<hotel::Hotel>(reader.readString());
+        hotel->setId(id);
+        auto categoryCount = reader.readInt();
+        for (int32_t i = 0; i < categoryCount && !reader.failed(); ++i)
+        {
+          auto categoryId = reader.readInt();
+          auto shortCode = reader.readString();
+          auto category = std::make_unique<hotel::RoomCategory>(shortCode, reader.readString());
+          category->setId(categoryId);
+          hotel->addRoomCategory(std::move(category));
+        }
+        auto roomCount = reader.readInt();
+        for (int32_t i = 0; i < roomCount && !reader.failed(); ++i)
+        {
+          auto roomId = reader.readInt();
+          auto category = hotel->getCategoryById(reader.readInt());
+          auto room = std::make_unique<hotel::HotelRoom>(reader.readString());
+          room->setId(roomId);
+          if (category != nullptr)
+            hotel->addRoom(std::move(room), category->shortCode());
+        }
+        return hotel;
+      }
+
+      void writeReservation(std::vector<char>& buffer, const hotel::Reservation& reservation)
+      {
+        RecordWriter writer(buffer, RecordType::StoreReservation);
+        writer.write(reservation.id());
+        writer.write(static_cast<int32_t>(reservation.status()));
+        writer.write(reservation.numberOfAdults());
+        writer.write(reservation.numberOfChildren());
+        writer.write(reservation.description());
+        writer.write(static_cast<int32_t>(reservation.atoms().size()));
+        for (auto& atom : reservation.atoms())
+        {
+          writer.write(atom.id());
+          writer.write(atom.roomId());
+          writer.write(static_cast<int32_t>(atom.dateRange().begin().day_number()));
+          writer.write(static_cast<int32_t>(atom.dateRange().end().day_number()));
+        }
+      }
+
+      std::unique_ptr<hotel::Reservation> readReservation(RecordReader& reader)
+      {
+        using namespace boost::gregorian;
+        auto toDate = [](int32_t dayNumber) { return date(gregorian_calendar::from_day_number(dayNumber)); };
+
+        auto id = reader.readInt();
+        auto status = reader.readInt();
+        auto adults = reader.readInt();
+        auto children = reader.readInt();
+        auto description = reader.readString();
+        auto atomCount = reader.readInt();
+        std::unique_ptr<hotel::Reservation> reservation;
+        for (int32_t i = 0; i < atomCount && !reader.failed(); ++i)
+        {
+          auto atomId = reader.readInt();
+          auto roomId = reader.readInt();
+          auto dateFrom = reader.readInt();
+          auto dateTo = reader.readInt();
+          if (reader.failed())
+            break;
+          if (reservation == nullptr)
+            reservation = std::make_unique<hotel::Reservation>(description, roomId,
+                                                               date_period(toDate(dateFrom), toDate(dateTo)));
+          else
+            reservation->addContinuation(roomId, toDate(dateTo));
+          reservation->atoms().back().setId(atomId);
+        }
+        if (reservation == nullptr)
+          return nullptr;
+
+        reservation->setId(id);
+        reservation->setStatus(static_cast<hotel::Reservation::ReservationStatus>(status));
+        reservation->setNumberOfAdults(adults);
+        reservation->setNumberOfChildren(children);
+        return reservation;
+      }
+    } // namespace
+
+    LogBackend::LogBackend(const std::string& logPath, uint64_t compactionThreshold)
+        : _log(), _snapshotPath(logPath + ".snapshot"), _compactionThreshold(compactionThreshold), _record(),
+          _transactionStart(0), _undoSteps()
+    {
+      if (_log.open(logPath))
+        recover();
+      else
+        std::cerr << "The data is kept in memory only, all tasks will fail to commit: " << logPath << std::endl;
+    }
+
+    void LogBackend::recover()
+    {
+      // A snapshot written for generation G holds the data of all logs before G. If the log is still of the previous
+      // generation, the backend has stopped between writing the snapshot and replacing the log.
+      snapshot::SnapshotReader reader(_snapshotPath);
+      auto generation = static_cast<int64_t>(_log.generation());
+      auto snapshotUsable = reader.valid() && reader.watermark() >= generation;
+      if (!snapshotUsable && generation > 1)
+        std::cerr << "The snapshot preceding the log is missing or outdated, data may have been lost: "
+                  << _snapshotPath << std::endl;
+
+      if (snapshotUsable)
+      {
+        reader.readHotels(std::numeric_limits<size_t>::max(),
+                          [this](std::vector<std::unique_ptr<hotel::Hotel>> hotels) {
+                            for (auto& hotel : hotels)
+                              _hotels.push_back(std::move(hotel));
+                          });
+        reader.readReservations(boost::none, std::numeric_limits<size_t>::max(),
+                                [this](std::vector<std::unique_ptr<hotel::Reservation>> reservations) {
+                                  for (auto& reservation : reservations)
+                                    addReservation(std::move(reservation));
+                                });
+      }
+
+      if (!snapshotUsable || reader.watermark() == generation)
+      {
+        _log.replay([this](const char* data, size_t size) { applyRecord(data, size); });
+      }
+      else
+      {
+        // The log only adds the ids leased after the snapshot has been written, its data is part of the snapshot
+        _log.replay([this](const char* data, size_t size) {
+          RecordReader record(data, size);
+          if (record.type() == RecordType::IdWatermark)
+            applyRecord(data, size);
+        });
+        appendIdWatermarks();
+        if (!_log.rotate(reader.watermark()) && _log.generation() == static_cast<uint64_t>(generation))
+        {
+          // Records appended to the old log would be skipped as part of the snapshot on the next start
+          std::cerr << "The data is kept in memory only, all tasks will fail to commit: cannot replace the log covered "
+                       "by the snapshot "
+                    << _snapshotPath << std::endl;
+          _log.close();
+        }
+      }
+
+      // Ids of stored objects are never handed out again, even if the watermark records are lost
+      for (auto& hotel : _hotels)
+      {
+        assignId(*hotel, op::IdSpace::Hotel);
+        for (auto& category : hotel->categories())
+          assignId(*category, op::IdSpace::RoomCategory);
+        for (auto& room : hotel->rooms())
+          assignId(*room, op::IdSpace::Room);
+      }
+      for (auto& entry : _reservations)
+      {
+        assignId(*entry.second, op::IdSpace::Reservation);
+        for (auto& atom : entry.second->atoms())
+          assignId(atom, op::IdSpace::ReservationAtom);
+      }
+    }
+
+    void LogBackend::applyRecord(const char* data, size_t size)
+    {
+      RecordReader reader(data, size);
+      switch (reader.type())
+      {
+      case RecordType::StoreHotel:
+      {
+        auto hotel = readHotel(reader);
+        if (!reader.failed())
+          _hotels.push_back(std::move(hotel));
+        break;
+      }
+      case RecordType::StoreReservation:
+      {
+        auto reservation = readReservation(reader);
+        if (!reader.failed() && reservation != nullptr)
+          addReservation(std::move(reservation));
+        break;
+      }
+      case RecordType::DeleteReservation:
+        removeReservation(reader.readInt());
+        break;
+      case RecordType::EraseAllData:
+        _hotels.clear();
+        _reservations.clear();
+        _atomIds.clear();
+        break;
+      case RecordType::IdWatermark:
+      {
+        auto space = reader.readInt();
+        auto lastId = reader.readInt();
+        if (!reader.failed() && space >= 0 && space < static_cast<int32_t>(op::idSpaceCount))
+          _lastIds[space] = std::max(_lastIds[space], lastId);
+        break;
+      }
+      default:
+        std::cerr << "Skipping log record of unknown type " << static_cast<int>(reader.type()) << std::endl;
+        return;
+      }
+
+      if (reader.failed())
+        std::cerr << "Skipping malformed log record" << std::endl;
+    }
+
+    void LogBackend::beginTransaction()
+    {
+      _transactionStart = _log.pendingSize();
+      _undoSteps.clear();
+    }
+
+    bool LogBackend::commitTransaction()
+    {
+      // All records of the group of tasks are made durable together. If that fails, the tasks must not leave any trace,
+      // neither in the log nor in memory, as the result integrator reverts their changes.
+      if (_log.isOpen() && _log.sync())
+      {
+        _undoSteps.clear();
+        return true;
+      }
+
+      _log.discard(_transactionStart);
+      undoTransaction();
+      return false;
+    }
+
+    void LogBackend::undoTransaction()
+    {
+      // The ids handed out by the tasks stay used, which is harmless as ids are never reused anyway
+      for (auto step = _undoSteps.rbegin(); step != _undoSteps.rend(); ++step)
+      {
+        switch (step->kind)
+        {
+        case UndoStep::Kind::RemoveLastHotel:
+          _hotels.pop_back();
+          break;
+        case UndoStep::Kind::RemoveReservation:
+          removeReservation(step->reservationId);
+          break;
+        case UndoStep::Kind::RestoreReservation:
+          addReservation(std::move(step->reservation));
+          break;
+        case UndoStep::Kind::RestoreAllData:
+          _hotels = std::move(step->hotels);
+          _reservations = std::move(step->reservations);
+          _atomIds = std::move(step->atomIds);
+          break;
+        }
+      }
+      _undoSteps.clear();
+    }
+
+    void LogBackend::runIdleWork()
+    {
+      // Records appended outside of a task, e.g. the id watermarks of a failed compaction, still belong to the old log
+      if (_log.isOpen() && _log.size() > _compactionThreshold && _log.sync())
+        compact();
+    }
+
+    void LogBackend::compact()
+    {
+      std::vector<const hotel::Hotel*> hotels;
+      for (auto& hotel : _hotels)
+        hotels.push_back(hotel.get());
+      std::vector<const hotel::Reservation*> reservations;
+      for (auto& entry : _reservations)
+        reservations.push_back(entry.second.get());
+
+      // The current snapshot is kept under a second name until the log has been replaced, such that it can be put
+      // back if that fails. A new snapshot must not replace it otherwise.
+      auto previousPath = _snapshotPath + ".previous";
+      std::remove(previousPath.c_str());
+      auto hasPrevious = ::link(_snapshotPath.c_str(), previousPath.c_str()) == 0;
+      if (!hasPrevious && errno != ENOENT)
+      {
+        std::cerr << "Cannot keep the snapshot while compacting the log: " << _snapshotPath << std::endl;
+        return;
+      }
+
+      // If the snapshot cannot be written, the log simply keeps growing. Otherwise it is durable once written, thus the
+      // log can be replaced right away.
+      auto nextGeneration = _log.generation() + 1;
+      if (!snapshot::writeSnapshot(_snapshotPath, nextGeneration, hotels, reservations))
+      {
+        std::cerr << "Cannot compact the log into snapshot: " << _snapshotPath << std::endl;
+        std::remove(previousPath.c_str());
+        return;
+      }
+
+      // The snapshot does not know about ids which are not in use anymore, the new log starts with them
+      appendIdWatermarks();
+      if (_log.rotate(nextGeneration) || _log.generation() == nextGeneration)
+      {
+        std::remove(previousPath.c_str());
+        return;
+      }
+
+      // The records keep going to the old log, which the new snapshot claims to cover. The old snapshot is put back and
+      // the compaction is retried once the next task has been executed.
+      auto restored = hasPrevious ? std::rename(previousPath.c_str(), _snapshotPath.c_str()) == 0
+                                  : std::remove(_snapshotPath.c_str()) == 0;
+      if (!restored || !syncParentDirectory(_snapshotPath))
+      {
+        std::cerr << "The data is kept in memory only, all tasks will fail to commit: cannot restore the snapshot "
+                  << _snapshotPath << std::endl;
+        _log.close();
+      }
+    }
+
+    void LogBackend::appendIdWatermarks()
+    {
+      for (size_t space = 0; space < op::idSpaceCount; ++space)
+      {
+        RecordWriter writer(_record, RecordType::IdWatermark);
+        writer.write(static_cast<int32_t>(space));
+        writer.write(_lastIds[space]);
+        _log.append(_record);
+      }
+    }
+
+    op::OperationResult LogBackend::executeOperation(op::EraseAllData& op)
+    {
+      UndoStep undo{UndoStep::Kind::RestoreAllData, 0, nullptr, std::move(_hotels), std::move(_reservations),
+                    std::move(_atomIds)};
+      _undoSteps.push_back(std::move(undo));
+      auto result = memory::MemoryBackend::executeOperation(op);
+      RecordWriter writer(_record, RecordType::EraseAllData);
+      _log.append(_record);
+      return result;
+    }
+
+    op::OperationResult LogBackend::executeOperation(op::StoreNewHotel& op)
+    {
+      auto result = memory::MemoryBackend::executeOperation(op);
+      if (boost::get<op::StoreNewHotelResult>(&result) != nullptr)
+      {
+        _undoSteps.push_back(UndoStep{UndoStep::Kind::RemoveLastHotel, 0, nullptr, {}, {}, {}});
+        writeHotel(_record, *_hotels.back());
+        _log.append(_record);
+      }
+      return result;
+    }
+
+    op::OperationResult LogBackend::executeOperation(op::StoreNewReservation& op)
+    {
+      auto result = memory::MemoryBackend::executeOperation(op);
+      if (auto stored = boost::get<op::StoreNewReservationResult>(&result))
+      {
+        _undoSteps.push_back(
+            UndoStep{UndoStep::Kind::RemoveReservation, stored->storedReservation->id(), nullptr, {}, {}, {}});
+        writeReservation(_record, *stored->storedReservation);
+        _log.append(_record);
+      }
+      return result;
+    }
+
+    op::OperationResult LogBackend::executeOperation(op::DeleteReservation& op)
+    {
+      // The reservation is taken out before the memory backend deletes it, such that it can be restored
+      if (auto reservation = removeReservation(op.reservationId))
+        _undoSteps.push_back(
+            UndoStep{UndoStep::Kind::RestoreReservation, op.reservationId, std::move(reservation), {}, {}, {}});
+      auto result = memory::MemoryBackend::executeOperation(op);
+      RecordWriter writer(_record, RecordType::DeleteReservation);
+      writer.write(op.reservationId);
+      _log.append(_record);
+      return result;
+    }
+
+    op::OperationResult LogBackend::executeOperation(op::LeaseIds& op)
+    {
+      auto result = memory::MemoryBackend::executeOperation(op);
+      RecordWriter writer(_record, RecordType::IdWatermark);
+      writer.write(static_cast<int32_t>(op.space));
+      writer.write(_lastIds[static_cast<size_t>(op.space)]);
+      _log.append(_record);
+      return result;
+    }
+
+  } // namespace log
+} // namespace persistence
@@ -0,0 +1,97 @@
+#ifndef PERSISTENCE_LOG_LOGBACKEND_H
+#define PERSISTENCE_LOG_LOGBACKEND_H
+
+#include "persistence/log/logfile.h"
+#include "persistence/memory/memorybackend.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace persistence
+{
+  namespace log
+  {
+    /**
+     * @brief The LogBackend class keeps the data in memory and persists each change by appending it to a log
+     *
+     * Every change is appended as a checksummed record to the log file (see LogFile). The tasks which are queued
+     * while the backend is busy are committed as a group (see Backend::groupsCommits()): their records are written and
+     * synced to disk in one go, thus many small tasks share one sync. If that fails, the records of the group are
+     * dropped and its changes to the data in memory are undone. Once the
+     * log has grown beyond the compaction threshold, the data is written to a snapshot (see snapshot::SnapshotReader)
+     * and the log is started afresh. Compaction runs while no task is queued, such that it does not delay interactive
+     * work.
+     *
+     * On construction, the data is recovered from the snapshot and the records appended after it. Records torn by a
+     * crash are dropped, as are all records after the first damaged one.
+     */
+    class LogBackend : public memory::MemoryBackend
+    {
+    public:
+      /**
+       * @param logPath Path of the log, the snapshot is stored under this path plus ".snapshot"
+       * @param compactionThreshold Size of the log in bytes beyond which it is compacted into a new snapshot
+       *
+       * If the log cannot be opened, the error is reported and the data is only kept in memory. Every task then ends
+       * with an op::CommitFailedResult.
+       */
+      LogBackend(const std::string& logPath, uint64_t compactionThreshold = 16 * 1024 * 1024);
+
+    protected:
+      virtual void beginTransaction() override;
+      virtual bool commitTransaction() override;
+      virtual bool groupsCommits() const override { return true; }
+      virtual void runIdleWork() override;
+
+      virtual op::OperationResult executeOperation(op::EraseAllData&) override;
+      virtual op::OperationResult executeOperation(op::StoreNewHotel& op) override;
+      virtual op::OperationResult executeOperation(op::StoreNewReservation& op) override;
+      virtual op::OperationResult executeOperation(op::DeleteReservation& op) override;
+      virtual op::OperationResult executeOperation(op::LeaseIds& op) override;
+
+      // The operations which do not change the data are executed by the memory backend
+      using memory::MemoryBackend::executeOperation;
+
+    private:
+      //! Change of the current transaction to the data in memory, undone if the transaction fails to commit
+      struct UndoStep
+      {
+        enum class Kind
+        {
+          RemoveLastHotel,
+          RemoveReservation,
+          RestoreReservation,
+          RestoreAllData
+        };
+
+        Kind kind;
+        int reservationId;
+        std::unique_ptr<hotel::Reservation> reservation;
+        std::vector<std::unique_ptr<hotel::Hotel>> hotels;
+        std::map<int, std::unique_ptr<hotel::Reservation>> reservations;
+        std::set<int> atomIds;
+      };
+
+      void recover();
+      void applyRecord(const char* data, size_t size);
+      //! Writes the data to a new snapshot and replaces the log by an empty one
+      void compact();
+      void appendIdWatermarks();
+      //! Undoes the changes of the current transaction in reverse order
+      void undoTransaction();
+
+      LogFile _log;
+      std::string _snapshotPath;
+      uint64_t _compactionThreshold;
+      std::vector<char> _record;
+      // Position in the pending records of the log at which the current transaction has started, and its changes
+      size_t _transactionStart;
+      std::vector<UndoStep> _undoSteps;
+    };
+
+  } // namespace log
+} // namespace persistence
+
+#endif // PERSISTENCE_LOG_LOGBACKEND_H
@@ -0,0 +1,245 @@
+#include "persistence/log/logfile.h"
+
+#include "persistence/filesync.h"
+
+#include <boost/crc.hpp>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace persistence
+{
+  namespace log
+  {
+    namespace
+    {
+      const char logMagic[8] = {'H', 'O', 'T', 'E', 'L', 'L', 'O', 'G'};
+      const uint32_t logVersion = 1;
+
+      struct Header
+      {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t generation;
+      };
+
+      // Each record is preceded by its size and checksum
+      struct RecordFrame
+      {
+        uint32_t size;
+        uint32_t checksum;
+      };
+
+      uint32_t checksum(const char* data, size_t size)
+      {
+        boost::crc_32_type crc;
+        crc.process_bytes(data, size);
+        return crc.checksum();
+      }
+
+      bool writeAll(int descriptor, const char* data, size_t size)
+      {
+        while (size > 0)
+        {
+          auto written = ::write(descriptor, data, size);
+          if (written < 0)
+          {
+            if (errno == EINTR)
+              continue;
+            return false;
+          }
+          data += written;
+          size -= written;
+        }
+        return true;
+      }
+
+      bool readAll(int descriptor, std::vector<char>& contents)
+      {
+        struct stat status;
+        if (::fstat(descriptor, &status) != 0)
+          return false;
+        contents.resize(status.st_size);
+        size_t position = 0;
+        while (position < contents.size())
+        {
+          auto read = ::pread(descriptor, contents.data() + position, contents.size() - position, position);
+          if (read < 0 && errno == EINTR)
+            continue;
+          if (read <= 0)
+            return false;
+          position += read;
+        }
+        return true;
+      }
+    } // namespace
+
+    LogFile::LogFile() : _path(), _descriptor(-1), _generation(0), _size(0), _buffer() {}
+
+    LogFile::~LogFile()
+    {
+      if (_descriptor != -1)
+      {
+        sync();
+        ::close(_descriptor);
+      }
+    }
+
+    bool LogFile::open(const std::string& path)
+    {
+      _path = path;
+      _descriptor = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+      if (_descriptor == -1)
+      {
+        std::cerr << "Cannot open log: " << path << std::endl;
+        return false;
+      }
+
+      Header header;
+      auto read = ::pread(_descriptor, &header, sizeof(header), 0);
+      if (read == 0)
+      {
+        // A new log
+        if (!writeHeader(_descriptor, 1) || ::fsync(_descriptor) != 0 || !syncParentDirectory(path))
+        {
+          std::cerr << "Cannot create log: " << path << std::endl;
+          ::close(_descriptor);
+          _descriptor = -1;
+          return false;
+        }
+        _generation = 1;
+        _size = sizeof(Header);
+        return true;
+      }
+
+      if (read != sizeof(header) || std::memcmp(header.magic, logMagic, sizeof(logMagic)) != 0 ||
+          header.version != logVersion)
+      {
+        std::cerr << "Not a log of a supported version: " << path << std::endl;
+        ::close(_descriptor);
+        _descriptor = -1;
+        return false;
+      }
+      _generation = header.generation;
+      _size = ::lseek(_descriptor, 0, SEEK_END);
+      return true;
+    }
+
+    bool LogFile::replay(const RecordConsumer& consumer)
+    {
+      std::vector<char> contents;
+      if (_descriptor == -1 || !readAll(_descriptor, contents))
+        return false;
+
+      size_t position = sizeof(Header);
+      while (position + sizeof(RecordFrame) <= contents.size())
+      {
+        RecordFrame frame;
+        std::memcpy(&frame, contents.data() + position, sizeof(frame));
+        auto data = contents.data() + position + sizeof(frame);
+        if (frame.size > contents.size() - position - sizeof(frame) || checksum(data, frame.size) != frame.checksum)
+          break;
+
+        consumer(data, frame.size);
+        position += sizeof(frame) + frame.size;
+      }
+
+      if (position == contents.size())
+        return true;
+
+      std::cerr << "Dropping " << contents.size() - position << " damaged bytes at the end of log " << _path
+                << std::endl;
+      if (::ftruncate(_descriptor, position) != 0 || ::fsync(_descriptor) != 0)
+        std::cerr << "Cannot truncate log: " << _path << std::endl;
+      _size = position;
+      return false;
+    }
+
+    void LogFile::append(const std::vector<char>& record)
+    {
+      RecordFrame frame{static_cast<uint32_t>(record.size()), checksum(record.data(), record.size())};
+      auto frameBytes = reinterpret_cast<const char*>(&frame);
+      _buffer.insert(_buffer.end(), frameBytes, frameBytes + sizeof(frame));
+      _buffer.insert(_buffer.end(), record.begin(), record.end());
+    }
+
+    bool LogFile::sync()
+    {
+      if (_buffer.empty())
+        return true;
+
+      // Appending at the known end overwrites whatever a failed earlier write may have left behind
+      if (_descriptor == -1 || ::lseek(_descriptor, _size, SEEK_SET) == -1 ||
+          !writeAll(_descriptor, _buffer.data(), _buffer.size()) || ::fdatasync(_descriptor) != 0)
+      {
+        // The records may have reached the file even though the sync has failed, they must not be replayed
+        std::cerr << "Cannot write log: " << _path << std::endl;
+        if (_descriptor != -1 && ::ftruncate(_descriptor, _size) != 0)
+          std::cerr << "Cannot truncate log: " << _path << std::endl;
+        return false;
+      }
+      _size += _buffer.size();
+      _buffer.clear();
+      return true;
+    }
+
+    void LogFile::discard(size_t position)
+    {
+      if (position < _buffer.size())
+        _buffer.resize(position);
+    }
+
+    void LogFile::close()
+    {
+      if (_descriptor != -1)
+        ::close(_descriptor);
+      _descriptor = -1;
+      _buffer.clear();
+    }
+
+    bool LogFile::rotate(uint64_t generation)
+    {
+      auto temporaryPath = _path + ".tmp";
+      auto descriptor = ::open(temporaryPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+      if (descriptor == -1 || !writeHeader(descriptor, generation) ||
+          ::lseek(descriptor, sizeof(Header), SEEK_SET) == -1 ||
+          !writeAll(descriptor, _buffer.data(), _buffer.size()) || ::fsync(descriptor) != 0 ||
+          std::rename(temporaryPath.c_str(), _path.c_str()) != 0)
+      {
+        std::cerr << "Cannot replace log: " << _path << std::endl;
+        if (descriptor != -1)
+          ::close(descriptor);
+        std::remove(temporaryPath.c_str());
+        return false;
+      }
+
+      if (_descriptor != -1)
+        ::close(_descriptor);
+      _descriptor = descriptor;
+      _generation = generation;
+      _size = sizeof(Header) + _buffer.size();
+      _buffer.clear();
+
+      // The old log is gone once the rename has reached the disk, also after a crash
+      return syncParentDirectory(_path);
+    }
+
+    bool LogFile::writeHeader(int descriptor, uint64_t generation)
+    {
+      Header header;
+      std::memcpy(header.magic, logMagic, sizeof(logMagic));
+      header.version = logVersion;
+      header.reserved = 0;
+      header.generation = generation;
+      return ::pwrite(descriptor, &header, sizeof(header), 0) == sizeof(header);
+    }
+
+  } // namespace log
+} // namespace persistence
@@ -0,0 +1,81 @@
+#ifndef PERSISTENCE_LOG_LOGFILE_H
+#define PERSISTENCE_LOG_LOGFILE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace persistence
+{
+  namespace log
+  {
+    /**
+     * @brief The LogFile class is an append-only file of checksummed records
+     *
+     * The file starts with a header holding its generation, which increases whenever the log is replaced by an empty
+     * one (see rotate()). Each record is framed by its size and the CRC-32 of its contents. Appended records are
+     * buffered, sync() writes all of them with a single write and a single fsync.
+     *
+     * A crash may leave a partially written record at the end of the file. Such a tail, and everything following a
+     * record with a wrong checksum, is dropped by replay().
+     */
+    class LogFile
+    {
+    public:
+      typedef std::function<void(const char* data, size_t size)> RecordConsumer;
+
+      LogFile();
+      LogFile(const LogFile&) = delete;
+      LogFile& operator=(const LogFile&) = delete;
+      ~LogFile();
+
+      //! Opens the log, or creates an empty one of generation 1, returns false if that is not possible
+      bool open(const std::string& path);
+      /**
+       * @brief replay hands all intact records to the consumer, in the order in which they have been appended
+       * A damaged tail is truncated, such that new records are appended right after the last intact one.
+       * @return false if the log has been damaged
+       */
+      bool replay(const RecordConsumer& consumer);
+
+      //! Appends a record, it is written by the next call to sync()
+      void append(const std::vector<char>& record);
+      /**
+       * @brief sync writes all appended records and waits until they are durable
+       * If that fails, the records stay appended and the file is cut back to its previous size, such that none of them
+       * is replayed after a restart.
+       */
+      bool sync();
+      //! Size of the records appended since the last sync(), a position to which discard() can return
+      size_t pendingSize() const { return _buffer.size(); }
+      //! Drops the records appended after pendingSize() has returned the given position
+      void discard(size_t position);
+      //! Closes the log without writing the pending records, isOpen() returns false afterwards
+      void close();
+
+      /**
+       * @brief rotate atomically replaces the log by a new log of the given generation
+       * The records appended since the last sync() are written to the new log instead of the old one.
+       */
+      bool rotate(uint64_t generation);
+
+      bool isOpen() const { return _descriptor != -1; }
+      uint64_t generation() const { return _generation; }
+      //! Size of the file including the records which have not been synced yet
+      uint64_t size() const { return _size + _buffer.size(); }
+
+    private:
+      bool writeHeader(int descriptor, uint64_t generation);
+
+      std::string _path;
+      int _descriptor;
+      uint64_t _generation;
+      uint64_t _size;
+      std::vector<char> _buffer;
+    };
+
+  } // namespace log
+} // namespace persistence
+
+#endif // PERSISTENCE_LOG_LOGFILE_H
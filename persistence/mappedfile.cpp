@@ -0,0 +1,41 @@
+#include "persistence/mappedfile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace persistence
+{
+  MappedFile::MappedFile(const std::string& path, size_t minimumSize) : _data(nullptr), _size(0)
+  {
+    auto descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor == -1)
+      return;
+
+    // The mapping stays valid after the descriptor has been closed
+    struct stat status;
+    if (::fstat(descriptor, &status) == 0 && static_cast<size_t>(status.st_size) >= minimumSize &&
+        status.st_size > 0)
+    {
+      auto data = ::mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      if (data != MAP_FAILED)
+      {
+        _data = static_cast<const char*>(data);
+        _size = status.st_size;
+      }
+    }
+    ::close(descriptor);
+  }
+
+  MappedFile::~MappedFile() { reset(); }
+
+  void MappedFile::reset()
+  {
+    if (_data != nullptr)
+      ::munmap(const_cast<char*>(_data), _size);
+    _data = nullptr;
+    _size = 0;
+  }
+
+} // namespace persistence
@@ -0,0 +1,37 @@
+#ifndef PERSISTENCE_MAPPEDFILE_H
+#define PERSISTENCE_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace persistence
+{
+  /**
+   * @brief The MappedFile class maps a whole file read-only into memory, for the readers of binary file formats
+   *
+   * The mapping is empty if the file cannot be opened or mapped, or if it is smaller than the given minimum size, e.g.
+   * the size of the header of the format. The readers check the contents themselves.
+   */
+  class MappedFile
+  {
+  public:
+    MappedFile(const std::string& path, size_t minimumSize);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool empty() const { return _data == nullptr; }
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+
+    //! Unmaps the file, e.g. once its contents have turned out to be invalid
+    void reset();
+
+  private:
+    const char* _data;
+    size_t _size;
+  };
+
+} // namespace persistence
+
+#endif // PERSISTENCE_MAPPEDFILE_H
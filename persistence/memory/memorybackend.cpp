@@ -0,0 +1,200 @@
+#include "persistence/memory/memorybackend.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace persistence
+{
+  namespace memory
+  {
+    namespace
+    {
+      bool intersects(const hotel::Reservation& reservation, boost::gregorian::date_period window)
+      {
+        return std::any_of(reservation.atoms().begin(), reservation.atoms().end(),
+                           [&](auto& atom) { return atom.dateRange().intersects(window); });
+      }
+
+      // The copy constructor of hotels does not copy the id
+      std::unique_ptr<hotel::Hotel> copyHotel(const hotel::Hotel& hotel)
+      {
+        auto copy = std::make_unique<hotel::Hotel>(hotel);
+        copy->setId(hotel.id());
+        return copy;
+      }
+    } // namespace
+
+    MemoryBackend::MemoryBackend() : _hotels(), _reservations(), _atomIds(), _lastIds() {}
+
+    void MemoryBackend::assignId(hotel::PersistentObject& object, op::IdSpace space)
+    {
+      auto& lastId = _lastIds[static_cast<size_t>(space)];
+      if (object.id() == 0)
+        object.setId(++lastId);
+      else
+        lastId = std::max(lastId, object.id());
+    }
+
+    bool MemoryBackend::canStore(const hotel::Hotel& hotel) const
+    {
+      // There are only a few hotels, thus their ids are looked up without an index
+      std::set<int> categoryIds;
+      std::set<int> roomIds;
+      for (auto& stored : _hotels)
+      {
+        if (hotel.id() != 0 && stored->id() == hotel.id())
+          return false;
+        for (auto& category : stored->categories())
+          categoryIds.insert(category->id());
+        for (auto& room : stored->rooms())
+          roomIds.insert(room->id());
+      }
+
+      for (auto& category : hotel.categories())
+        if (category->id() != 0 && !categoryIds.insert(category->id()).second)
+          return false;
+      for (auto& room : hotel.rooms())
+        if (room->id() != 0 && !roomIds.insert(room->id()).second)
+          return false;
+      return true;
+    }
+
+    bool MemoryBackend::canStore(const hotel::Reservation& reservation) const
+    {
+      if (reservation.id() != 0 && _reservations.count(reservation.id()) > 0)
+        return false;
+
+      std::set<int> atomIds;
+      for (auto& atom : reservation.atoms())
+        if (atom.id() != 0 && (_atomIds.count(atom.id()) > 0 || !atomIds.insert(atom.id()).second))
+          return false;
+      return true;
+    }
+
+    void MemoryBackend::addReservation(std::unique_ptr<hotel::Reservation> reservation)
+    {
+      removeReservation(reservation->id());
+      for (auto& atom : reservation->atoms())
+        _atomIds.insert(atom.id());
+      auto id = reservation->id();
+      _reservations[id] = std::move(reservation);
+    }
+
+    std::unique_ptr<hotel::Reservation> MemoryBackend::removeReservation(int reservationId)
+    {
+      auto entry = _reservations.find(reservationId);
+      if (entry == _reservations.end())
+        return nullptr;
+
+      auto reservation = std::move(entry->second);
+      _reservations.erase(entry);
+      for (auto& atom : reservation->atoms())
+        _atomIds.erase(atom.id());
+      return reservation;
+    }
+
+    op::OperationResult MemoryBackend::executeOperation(op::EraseAllData&)
+    {
+      _hotels.clear();
+      _reservations.clear();
+      _atomIds.clear();
+      return op::EraseAllDataResult();
+    }
+
+    op::OperationResult MemoryBackend::executeOperation(op::LoadInitialData& op)
+    {
+      // The data is already in memory, thus it is published in one chunk of each kind
+      publishPartialResult(op::LoadInitialDataResult());
+
+      op::LoadedHotelsChunk hotels;
+      for (auto& hotel : _hotels)
+        hotels.hotels.push_back(copyHotel(*hotel));
+      publishPartialResult(std::move(hotels));
+
+      op::LoadedReservationsChunk reservations;
+      for (auto& entry : _reservations)
+        if (!op.planningWindow || intersects(*entry.second, *op.planningWindow))
+          reservations.reservations.push_back(std::make_unique<hotel::Reservation>(*entry.second));
+      publishPartialResult(std::move(reservations));
+      return op::NoResult();
+    }
+
+    op::OperationResult MemoryBackend::executeOperation(op::LoadPlanningWindow& op)
+    {
+      op::LoadPlanningWindowResult result{op.window, {}};
+      for (auto& entry : _reservations)
+        if (intersects(*entry.second, op.window))
+          result.reservations.push_back(std::make_unique<hotel::Reservation>(*entry.second));
+      return result;
+    }
+
+    op::OperationResult MemoryBackend::executeOperation(op::StoreNewHotel& op)
+    {
+      if (op.newHotel == nullptr)
+        return op::NoResult();
+
+      if (!canStore(*op.newHotel))
+      {
+        std::cerr << "Cannot store hotel: one of its ids is already in use" << std::endl;
+        return op::NoResult();
+      }
+
+      assignId(*op.newHotel, op::IdSpace::Hotel);
+      for (auto& category : op.newHotel->categories())
+        assignId(*category, op::IdSpace::RoomCategory);
+      for (auto& room : op.newHotel->rooms())
+        assignId(*room, op::IdSpace::Room);
+
+      _hotels.push_back(copyHotel(*op.newHotel));
+      return op::StoreNewHotelResult{std::move(op.newHotel)};
+    }
+
+    op::OperationResult MemoryBackend::executeOperation(op::StoreNewReservation& op)
+    {
+      if (op.newReservation == nullptr)
+        return op::NoResult();
+
+      if (!canStore(*op.newReservation))
+      {
+        std::cerr << "Cannot store reservation: one of its ids is already in use" << std::endl;
+        return op::NoResult();
+      }
+
+      // "Unknown" is not a valid reservation status for storing, see the sqlite backend
+      if (op.newReservation->status() == hotel::Reservation::Unknown)
+        op.newReservation->setStatus(hotel::Reservation::New);
+
+      assignId(*op.newReservation, op::IdSpace::Reservation);
+      for (auto& atom : op.newReservation->atoms())
+        assignId(atom, op::IdSpace::ReservationAtom);
+
+      addReservation(std::make_unique<hotel::Reservation>(*op.newReservation));
+      return op::StoreNewReservationResult{std::move(op.newReservation), op.provisionalId};
+    }
+
+    op::OperationResult MemoryBackend::executeOperation(op::StoreNewPerson&)
+    {
+      // Persons are not part of the stored data yet, neither here nor in the sqlite backend
+      std::cerr << "Cannot store person: persons are not supported by the memory backend" << std::endl;
+      return op::NoResult();
+    }
+
+    op::OperationResult MemoryBackend::executeOperation(op::DeleteReservation& op)
+    {
+      removeReservation(op.reservationId);
+      return op::DeleteReservationResult{op.reservationId};
+    }
+
+    op::OperationResult MemoryBackend::executeOperation(op::LeaseIds& op)
+    {
+      if (op.count <= 0)
+        return op::LeaseIdsResult{op.space, 0, 0};
+
+      auto& lastId = _lastIds[static_cast<size_t>(op.space)];
+      auto firstId = lastId + 1;
+      lastId += op.count;
+      return op::LeaseIdsResult{op.space, firstId, op.count};
+    }
+
+  } // namespace memory
+} // namespace persistence
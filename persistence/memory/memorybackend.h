@@ -0,0 +1,68 @@
+#ifndef PERSISTENCE_MEMORY_MEMORYBACKEND_H
+#define PERSISTENCE_MEMORY_MEMORYBACKEND_H
+
+#include "persistence/backend.h"
+
+#include "hotel/hotel.h"
+#include "hotel/reservation.h"
+
+#include <array>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace persistence
+{
+  namespace memory
+  {
+    /**
+     * @brief The MemoryBackend class keeps the data in memory only
+     *
+     * It behaves like the sqlite backend, except that nothing survives the backend. Use it for tests and benchmarks
+     * which are not about the storage, and as a baseline which separates the cost of the storage from the cost of the
+     * integration.
+     */
+    class MemoryBackend : public Backend
+    {
+    public:
+      MemoryBackend();
+
+    protected:
+      virtual op::OperationResult executeOperation(op::EraseAllData&) override;
+      virtual op::OperationResult executeOperation(op::LoadInitialData& op) override;
+      virtual op::OperationResult executeOperation(op::LoadPlanningWindow& op) override;
+      virtual op::OperationResult executeOperation(op::StoreNewHotel& op) override;
+      virtual op::OperationResult executeOperation(op::StoreNewReservation& op) override;
+      virtual op::OperationResult executeOperation(op::StoreNewPerson&) override;
+      virtual op::OperationResult executeOperation(op::DeleteReservation& op) override;
+      virtual op::OperationResult executeOperation(op::LeaseIds& op) override;
+
+      //! Assigns the next id of the space if the object does not have an id yet
+      void assignId(hotel::PersistentObject& object, op::IdSpace space);
+
+      /**
+       * @brief canStore returns false if the new object carries an id which is already in use
+       * The sqlite backend rejects such objects through its primary keys, objects without an id always pass.
+       */
+      bool canStore(const hotel::Hotel& hotel) const;
+      bool canStore(const hotel::Reservation& reservation) const;
+
+      //! Adds a reservation to the data, replacing a stored reservation of the same id
+      void addReservation(std::unique_ptr<hotel::Reservation> reservation);
+      //! Removes a reservation from the data, returns nullptr if there is no reservation of this id
+      std::unique_ptr<hotel::Reservation> removeReservation(int reservationId);
+
+      // The data is accessible to backends which keep the data in memory, but persist it in another way. Reservations
+      // are added and removed through the functions above, such that the ids of their atoms are kept track of.
+      std::vector<std::unique_ptr<hotel::Hotel>> _hotels;
+      std::map<int, std::unique_ptr<hotel::Reservation>> _reservations;
+      std::set<int> _atomIds;
+      // Largest id handed out for each space, ids are never reused
+      std::array<int, op::idSpaceCount> _lastIds;
+    };
+
+  } // namespace memory
+} // namespace persistence
+
+#endif // PERSISTENCE_MEMORY_MEMORYBACKEND_H
@@ -0,0 +1,82 @@
+#ifndef PERSISTENCE_MPSCQUEUE_H
+#define PERSISTENCE_MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+namespace persistence
+{
+  /**
+   * @brief The MpscQueue class is an unbounded lock-free queue for multiple producers and a single consumer.
+   *
+   * Pushing never blocks and costs one allocation and one atomic exchange. Popping is only allowed from one thread at
+   * a time. The queue is a linked list with a stub node (see Dmitry Vyukov's intrusive MPSC queue): producers append
+   * to the head, the consumer removes from the tail. An element whose producer has swapped the head but not yet linked
+   * its node is not visible to the consumer until the link has been written.
+   *
+   * @note T has to be default constructible and move assignable.
+   */
+  template <typename T>
+  class MpscQueue
+  {
+  public:
+    MpscQueue() : _head(new Node()), _tail(_head.load(std::memory_order_relaxed)) {}
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+    ~MpscQueue()
+    {
+      while (_tail != nullptr)
+      {
+        auto next = _tail->next.load(std::memory_order_relaxed);
+        delete _tail;
+        _tail = next;
+      }
+    }
+
+    //! Appends a value to the queue, may be called from any thread
+    void push(T value)
+    {
+      auto node = new Node();
+      node->value = std::move(value);
+      auto previous = _head.exchange(node, std::memory_order_acq_rel);
+      previous->next.store(node, std::memory_order_release);
+    }
+
+    /**
+     * @brief tryPop removes the oldest value from the queue
+     * @return false if there is no value available, in which case value is left unchanged
+     * @note Must only be called by the consumer thread
+     */
+    bool tryPop(T& value)
+    {
+      auto next = _tail->next.load(std::memory_order_acquire);
+      if (next == nullptr)
+        return false;
+
+      // The node holding the value becomes the new stub node
+      value = std::move(next->value);
+      next->value = T();
+      delete _tail;
+      _tail = next;
+      return true;
+    }
+
+    //! Returns true if no value is visible to the consumer, must only be called by the consumer thread
+    bool empty() const { return _tail->next.load(std::memory_order_acquire) == nullptr; }
+
+  private:
+    struct Node
+    {
+      Node() : next(nullptr), value() {}
+
+      std::atomic<Node*> next;
+      T value;
+    };
+
+    std::atomic<Node*> _head;
+    Node* _tail;
+  };
+
+} // namespace persistence
+
+#endif // PERSISTENCE_MPSCQUEUE_H
@@ -5,6 +5,7 @@
 #include "hotel/person.h"
 #include "hotel/reservation.h"
 
+#include "boost/optional.hpp"
 #include "boost/variant.hpp"
 
 #include <memory>
@@ -18,22 +19,60 @@ namespace persistence
     //! Operations which deletes everyghing present in the database
     struct EraseAllData { };
 
-    //! Loads inital hotel, rooms, and planning data
-    struct LoadInitialData { };
+    /**
+     * @brief Loads inital hotel, rooms, and planning data
+     * If a planning window is given, only the reservations intersecting the window are loaded.
+     */
+    struct LoadInitialData { boost::optional<boost::gregorian::date_period> planningWindow; };
+
+    //! Loads all reservations intersecting the given date period
+    struct LoadPlanningWindow { boost::gregorian::date_period window; };
 
     struct StoreNewHotel { std::unique_ptr<hotel::Hotel> newHotel; };
-    struct StoreNewReservation { std::unique_ptr<hotel::Reservation> newReservation; };
+    /**
+     * @brief Stores a new reservation
+     * A non-zero provisional id marks a reservation which has already been applied to the local planning under that id,
+     * see DataSource::queueOptimisticOperations().
+     */
+    struct StoreNewReservation
+    {
+      std::unique_ptr<hotel::Reservation> newReservation;
+      int provisionalId = 0;
+    };
     struct StoreNewPerson { std::unique_ptr<hotel::Person> newPerson; };
 
     struct DeleteReservation { int reservationId; };
 
+    //! Kinds of objects whose ids are assigned by the client, see DataSource
+    enum class IdSpace
+    {
+      Hotel,
+      RoomCategory,
+      Room,
+      Reservation,
+      ReservationAtom
+    };
+    const size_t idSpaceCount = 5;
+
+    /**
+     * @brief Leases a range of ids from the database
+     * The ids of the range are never handed out again by the database, the client assigns them to new objects itself.
+     */
+    struct LeaseIds
+    {
+      IdSpace space;
+      int count;
+    };
+
     // Define a union type of all known operations
     typedef boost::variant<op::EraseAllData,
                            op::LoadInitialData,
+                           op::LoadPlanningWindow,
                            op::StoreNewHotel,
                            op::StoreNewReservation,
                            op::StoreNewPerson,
-                           op::DeleteReservation>
+                           op::DeleteReservation,
+                           op::LeaseIds>
             Operation;
     typedef std::vector<Operation> Operations;
 
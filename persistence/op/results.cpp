@@ -4,6 +4,52 @@ namespace persistence
 {
   namespace op
   {
+    namespace
+    {
+      template <typename T>
+      int idOf(const std::unique_ptr<T>& object, int storedId)
+      {
+        return object != nullptr ? object->id() : storedId;
+      }
+
+      struct ResultSummarizer : public boost::static_visitor<OperationResult>
+      {
+        OperationResult operator()(const NoResult& res) const { return res; }
+        OperationResult operator()(const EraseAllDataResult& res) const { return res; }
+        OperationResult operator()(const LoadInitialDataResult& res) const { return res; }
+        OperationResult operator()(const LoadedHotelsChunk&) const { return LoadedHotelsChunk(); }
+        OperationResult operator()(const LoadedReservationsChunk&) const { return LoadedReservationsChunk(); }
+        OperationResult operator()(const LoadPlanningWindowResult& res) const
+        {
+          return LoadPlanningWindowResult{res.window, {}};
+        }
+        OperationResult operator()(const StoreNewHotelResult& res) const
+        {
+          return StoreNewHotelResult{nullptr, idOf(res.storedHotel, res.storedHotelId)};
+        }
+        OperationResult operator()(const StoreNewReservationResult& res) const
+        {
+          return StoreNewReservationResult{nullptr, res.provisionalId,
+                                           idOf(res.storedReservation, res.storedReservationId)};
+        }
+        OperationResult operator()(const StoreNewPersonResult& res) const
+        {
+          return StoreNewPersonResult{nullptr, idOf(res.storedPerson, res.storedPersonId)};
+        }
+        OperationResult operator()(const DeleteReservationResult& res) const { return res; }
+        OperationResult operator()(const LeaseIdsResult& res) const { return res; }
+        OperationResult operator()(const CommitFailedResult& res) const { return res; }
+      };
+    } // namespace
+
+    OperationResults summarizeResults(const OperationResults& results)
+    {
+      OperationResults summary;
+      summary.reserve(results.size());
+      for (auto& result : results)
+        summary.push_back(boost::apply_visitor(ResultSummarizer(), result));
+      return summary;
+    }
 
   } // namespace op
 } // namespace persistence
@@ -1,6 +1,8 @@
 #ifndef PERSISTENCE_OP_RESULTS_H
 #define PERSISTENCE_OP_RESULTS_H
 
+#include "persistence/op/operations.h"
+
 #include "hotel/hotel.h"
 #include "hotel/hotelcollection.h"
 #include "hotel/person.h"
@@ -10,6 +12,7 @@
 #include "boost/variant.hpp"
 
 #include <memory>
+#include <vector>
 
 namespace persistence
 {
@@ -20,33 +23,99 @@ namespace persistence
     //! Result of erasing all data from the database
     struct EraseAllDataResult { };
 
-    //! Result of initial loading operation
-    struct LoadInitialDataResult
+    /**
+     * @brief Result of initial loading operation
+     * Resets the local data. The loaded data itself follows in LoadedHotelsChunk and LoadedReservationsChunk results,
+     * which the backend publishes while it is still reading from the database.
+     */
+    struct LoadInitialDataResult { };
+
+    //! Part of the initial data: hotels together with their rooms and categories
+    struct LoadedHotelsChunk
+    {
+      std::vector<std::unique_ptr<hotel::Hotel>> hotels;
+    };
+
+    //! Part of the initial data: reservations of the loaded rooms
+    struct LoadedReservationsChunk
     {
-      std::unique_ptr<hotel::HotelCollection> hotels;
-      std::unique_ptr<hotel::PlanningBoard> planning;
+      std::vector<std::unique_ptr<hotel::Reservation>> reservations;
     };
 
-    struct StoreNewHotelResult { std::unique_ptr<hotel::Hotel> storedHotel; };
-    struct StoreNewReservationResult { std::unique_ptr<hotel::Reservation> storedReservation; };
-    struct StoreNewPersonResult { std::unique_ptr<hotel::Person> storedPerson; };
+    //! Result of loading a window of the planning
+    struct LoadPlanningWindowResult
+    {
+      boost::gregorian::date_period window;
+      std::vector<std::unique_ptr<hotel::Reservation>> reservations;
+    };
+
+    // The results of the store operations carry the stored object to the result integrator. The results of the task
+    // only keep the id of the object, see summarizeResults().
+    struct StoreNewHotelResult
+    {
+      std::unique_ptr<hotel::Hotel> storedHotel;
+      int storedHotelId = 0;
+    };
+    struct StoreNewReservationResult
+    {
+      std::unique_ptr<hotel::Reservation> storedReservation;
+      int provisionalId = 0;
+      int storedReservationId = 0;
+    };
+    struct StoreNewPersonResult
+    {
+      std::unique_ptr<hotel::Person> storedPerson;
+      int storedPersonId = 0;
+    };
 
     struct DeleteReservationResult { int deletedReservationId; };
 
+    /**
+     * @brief The changes made by the task could not be made durable, e.g. because the disk is full
+     * It is the last result of the task. The other results still describe the changes, but the result integrator does
+     * not apply them and reverts the optimistic changes of the task. The backend has rolled the changes back, none of
+     * them becomes durable later on.
+     */
+    struct CommitFailedResult { };
+
+    //! Range [firstId, firstId + count) of leased ids
+    struct LeaseIdsResult
+    {
+      IdSpace space;
+      int firstId;
+      int count;
+    };
+
     // Define a union type of all known operation results
     typedef boost::variant<op::NoResult,
                            op::EraseAllDataResult,
                            op::LoadInitialDataResult,
+                           op::LoadedHotelsChunk,
+                           op::LoadedReservationsChunk,
+                           op::LoadPlanningWindowResult,
                            op::StoreNewHotelResult,
                            op::StoreNewReservationResult,
                            op::StoreNewPersonResult,
-                           op::DeleteReservationResult>
+                           op::DeleteReservationResult,
+                           op::LeaseIdsResult,
+                           op::CommitFailedResult>
             OperationResult;
     typedef std::vector<OperationResult> OperationResults;
 
+    /**
+     * @brief summarizeResults returns the results without the loaded and stored objects
+     * The results of a task go to the result integrator, which takes the objects over. The task itself keeps this
+     * summary, which holds the ids of the stored objects. Code waiting for the task or continuing it reads the objects
+     * from the data source, once the results have been integrated.
+     */
+    OperationResults summarizeResults(const OperationResults& results);
+
+    //! Results which the backend hands over to the result integrator
     struct OperationResultsMessage {
       int uniqueId;
       OperationResults results;
+      //! Whether this is the last message of the task, otherwise the results are a part published ahead of time
+      bool taskCompleted;
     };
 
   } // namespace op
@@ -1,57 +1,193 @@
 #ifndef PERSISTENCE_OP_TASK_H
 #define PERSISTENCE_OP_TASK_H
 
+#include "persistence/executor.h"
+
+#include <boost/pool/pool_alloc.hpp>
+
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <condition_variable>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace persistence
 {
   namespace op
   {
+    /**
+     * @brief Priority classes of tasks in the backend queue
+     *
+     * Tasks of a higher class are executed first. Tasks of the same class are executed in the order in which they were
+     * queued, there is no ordering guarantee between tasks of different classes.
+     */
+    enum class TaskPriority
+    {
+      Interactive, //!< Operations the user is actively waiting for
+      Normal,
+      Bulk //!< Large imports and other background work, which must not delay interactive work
+    };
+    const size_t taskPriorityCount = 3;
+
     template <typename ResultT>
     class TaskSharedState
     {
     public:
-      TaskSharedState(int uniqueId) : _uniqueId(uniqueId), _completed(false) {}
+      enum Status
+      {
+        Queued,
+        Running,
+        Completed,
+        Cancelled
+      };
+
+      TaskSharedState(int uniqueId) : _uniqueId(uniqueId), _status(Queued) {}
 
       int uniqueId() const { return _uniqueId; }
-      bool completed() const { return _completed; }
+      //! Returns true once the task is no longer waiting in the queue
+      bool started() const { return _status != Queued; }
+      //! Returns true once the task has either been completed or cancelled
+      bool completed() const { return _status == Completed || _status == Cancelled; }
+      bool cancelled() const { return _status == Cancelled; }
+
       void waitForCompletion()
       {
-        if (_completed)
+        if (completed())
           return;
 
         std::unique_lock<std::mutex> lock(_mutex);
-        while (!_completed)
+        while (!completed())
           _completedCondition.wait(lock);
       }
-      ResultT& results()
+
+      //! Waits until the task has been completed or the deadline has passed and returns true in the former case
+      bool waitForCompletion(std::chrono::steady_clock::time_point deadline)
       {
-        assert(_completed);
+        if (completed())
+          return true;
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _completedCondition.wait_until(lock, deadline, [this]() { return completed(); });
+      }
+
+      const ResultT& results()
+      {
+        assert(completed());
+        static const ResultT noResults;
+        return _results ? *_results : noResults;
+      }
+
+      //! Returns the results of a completed task, which are shared by all holders of the task
+      std::shared_ptr<const ResultT> sharedResults()
+      {
+        assert(completed());
         return _results;
       }
-      void setCompleted(ResultT results)
+
+      /**
+       * @brief cancel prevents the task from being executed
+       * @return true if the task has been cancelled, false if the backend has already started executing it
+       */
+      bool cancel()
       {
+        auto expected = Queued;
         {
           std::lock_guard<std::mutex> guard(_mutex);
+          if (!_status.compare_exchange_strong(expected, Cancelled))
+            return false;
+        }
+        _completedCondition.notify_all();
+        runContinuations();
+        return true;
+      }
+
+      //! Called by the backend before executing the task, returns false if the task has been cancelled
+      bool start()
+      {
+        auto expected = Queued;
+        return _status.compare_exchange_strong(expected, Running);
+      }
+
+      void setCompleted(ResultT results) { setCompleted(std::make_shared<const ResultT>(std::move(results))); }
+
+      void setCompleted(std::shared_ptr<const ResultT> results)
+      {
+        {
+          std::lock_guard<std::mutex> guard(_mutex);
+          assert(_status == Running);
           _results = std::move(results);
-          _completed = true;
+          _status = Completed;
+        }
+        _completedCondition.notify_all();
+        runContinuations();
+      }
+
+      //! Marks a started task as cancelled, e.g. a continuation whose inner task has been cancelled
+      void setCancelled()
+      {
+        {
+          std::lock_guard<std::mutex> guard(_mutex);
+          assert(_status == Running);
+          _status = Cancelled;
         }
         _completedCondition.notify_all();
+        runContinuations();
+      }
+
+      /**
+       * @brief addContinuation posts the given function to the executor once the task has been completed or cancelled
+       * If the task is already done, the function is posted right away.
+       */
+      void addContinuation(Executor& executor, std::function<void()> continuation)
+      {
+        {
+          std::lock_guard<std::mutex> guard(_mutex);
+          if (!completed())
+          {
+            _continuations.emplace_back(&executor, std::move(continuation));
+            return;
+          }
+        }
+        executor.post(std::move(continuation));
       }
 
     private:
+      void runContinuations()
+      {
+        std::vector<std::pair<Executor*, std::function<void()>>> continuations;
+        {
+          std::lock_guard<std::mutex> guard(_mutex);
+          std::swap(continuations, _continuations);
+        }
+        for (auto& continuation : continuations)
+          continuation.first->post(std::move(continuation.second));
+      }
+
       int _uniqueId;
-      std::atomic<bool> _completed;
+      std::atomic<Status> _status;
       mutable std::mutex _mutex;
       std::condition_variable _completedCondition;
+      std::vector<std::pair<Executor*, std::function<void()>>> _continuations;
 
-      ResultT _results;
+      std::shared_ptr<const ResultT> _results;
     };
 
+    /**
+     * @brief makeTaskSharedState creates a new shared state
+     * The states are allocated from a pool, which avoids a trip to the general purpose allocator for each operation.
+     */
+    template <typename ResultT>
+    std::shared_ptr<TaskSharedState<ResultT>> makeTaskSharedState(int uniqueId)
+    {
+      return std::allocate_shared<TaskSharedState<ResultT>>(boost::fast_pool_allocator<TaskSharedState<ResultT>>(),
+                                                            uniqueId);
+    }
+
     /**
      *
      */
@@ -65,11 +201,75 @@ namespace persistence
       }
 
       int uniqueId() const { return _sharedState->uniqueId(); }
+      bool started() const { return _sharedState->started(); }
       bool completed() const { return _sharedState->completed(); }
+      bool cancelled() const { return _sharedState->cancelled(); }
       void waitForCompletion() { return _sharedState->waitForCompletion(); }
-      ResultT& results() { return _sharedState->results(); }
+      bool waitForCompletion(std::chrono::steady_clock::time_point deadline)
+      {
+        return _sharedState->waitForCompletion(deadline);
+      }
+      bool waitForCompletion(std::chrono::steady_clock::duration timeout)
+      {
+        return _sharedState->waitForCompletion(std::chrono::steady_clock::now() + timeout);
+      }
+      bool cancel() { return _sharedState->cancel(); }
+      /**
+       * @brief results returns the results of a completed task
+       * Results which the backend publishes ahead of time, e.g. the chunks of the initial load, are only handed to the
+       * result integrator and are not part of them. Cancelled tasks have no results. The results are immutable and
+       * shared with the tasks chained onto this one.
+       */
+      const ResultT& results() { return _sharedState->results(); }
+
+      /**
+       * @brief then runs the given continuation on the executor once this task has been completed or cancelled
+       *
+       * The continuation receives this task as its argument. It may return another task, e.g. for the next step of a
+       * workflow. The returned task completes once the continuation has run, or, if the continuation returns a task,
+       * once that task completes. Further continuations can thus be chained onto it. The returned task has the id of
+       * this task, it is not known to the backend and cannot be cancelled. It shares the results of the task returned
+       * by the continuation and is cancelled if that task is cancelled, a continuation returning void leaves it without
+       * results.
+       */
+      template <typename Func>
+      Task<ResultT> then(Executor& executor, Func continuation)
+      {
+        typedef decltype(continuation(std::declval<Task<ResultT>&>())) ContinuationResult;
+
+        auto next = makeTaskSharedState<ResultT>(uniqueId());
+        next->start();
+        auto self = *this;
+        _sharedState->addContinuation(executor, [self, next, continuation]() mutable {
+          completeContinuation(next, continuation, self, std::is_void<ContinuationResult>());
+        });
+        return Task<ResultT>(next);
+      }
 
     private:
+      template <typename Func>
+      static void completeContinuation(std::shared_ptr<TaskSharedState<ResultT>> next, Func& continuation,
+                                       Task<ResultT>& task, std::true_type /* returns void */)
+      {
+        continuation(task);
+        next->setCompleted(ResultT());
+      }
+
+      template <typename Func>
+      static void completeContinuation(std::shared_ptr<TaskSharedState<ResultT>> next, Func& continuation,
+                                       Task<ResultT>& task, std::false_type /* returns a task */)
+      {
+        Task<ResultT> inner = continuation(task);
+        // The inline continuation runs while the inner state is completing, thus the state outlives it
+        auto innerState = inner._sharedState.get();
+        innerState->addContinuation(InlineExecutor::instance(), [next, innerState]() {
+          if (innerState->cancelled())
+            next->setCancelled();
+          else
+            next->setCompleted(innerState->sharedResults());
+        });
+      }
+
       std::shared_ptr<TaskSharedState<ResultT>> _sharedState;
     };
 
@@ -0,0 +1,73 @@
+#ifndef PERSISTENCE_OP_TASKAWAITABLE_H
+#define PERSISTENCE_OP_TASKAWAITABLE_H
+
+#ifdef HOTEL_WITH_COROUTINES
+
+#include "persistence/executor.h"
+#include "persistence/op/task.h"
+
+#include <coroutine>
+#include <exception>
+
+namespace persistence
+{
+  namespace op
+  {
+    /**
+     * @brief The Workflow struct is the return type of coroutines which await tasks
+     *
+     * A workflow starts running right away when it is called and frees itself once it has finished. It cannot be
+     * awaited itself. Exceptions escaping from a workflow terminate the application.
+     */
+    struct Workflow
+    {
+      struct promise_type
+      {
+        Workflow get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+      };
+    };
+
+    /**
+     * @brief The TaskAwaiter class suspends a coroutine until a task is done and resumes it on the given executor
+     * The coroutine is always resumed through the executor, even if the task has already been completed.
+     */
+    template <typename ResultT>
+    class TaskAwaiter
+    {
+    public:
+      TaskAwaiter(Task<ResultT> task, Executor& executor) : _task(task), _executor(executor) {}
+
+      bool await_ready() const { return false; }
+      void await_suspend(std::coroutine_handle<> handle)
+      {
+        _task.then(_executor, [handle](Task<ResultT>&) { handle.resume(); });
+      }
+      Task<ResultT> await_resume() { return _task; }
+
+    private:
+      Task<ResultT> _task;
+      Executor& _executor;
+    };
+
+    /**
+     * @brief awaitOn makes a task awaitable, e.g. co_await awaitOn(task, dataSource.integrationExecutor())
+     * @return The task, once it has been completed or cancelled
+     * @note Queue the operation in a statement of its own before awaiting it. GCC 12 miscompiles co_await expressions
+     *       containing temporaries such as the operation passed to queueOperation().
+     */
+    template <typename ResultT>
+    TaskAwaiter<ResultT> awaitOn(Task<ResultT> task, Executor& executor)
+    {
+      return TaskAwaiter<ResultT>(task, executor);
+    }
+
+  } // namespace op
+} // namespace persistence
+
+#endif // HOTEL_WITH_COROUTINES
+
+#endif // PERSISTENCE_OP_TASKAWAITABLE_H
@@ -1,9 +1,21 @@
 #include "persistence/resultintegrator.h"
 
 #include <algorithm>
+#include <iostream>
 
 namespace persistence
 {
+  namespace
+  {
+    bool commitFailed(const op::OperationResultsMessage& message)
+    {
+      return message.taskCompleted && !message.results.empty() &&
+             boost::get<op::CommitFailedResult>(&message.results.back()) != nullptr;
+    }
+  } // namespace
+
+  const int ResultIntegrator::unqueuedTaskId;
+
   hotel::HotelCollection& ResultIntegrator::hotels() { return _hotels; }
   const hotel::HotelCollection& ResultIntegrator::hotels() const { return _hotels; }
   hotel::PlanningBoard& ResultIntegrator::planning() { return _planning; }
@@ -11,50 +23,283 @@ namespace persistence
 
   void ResultIntegrator::processIntegrationQueue()
   {
-    std::unique_lock<std::mutex> lock(_queueMutex);
+    integrateUntil(std::chrono::steady_clock::time_point::max());
+  }
+
+  bool ResultIntegrator::processIntegrationQueue(std::chrono::steady_clock::duration timeBudget)
+  {
+    return integrateUntil(std::chrono::steady_clock::now() + timeBudget);
+  }
+
+  void ResultIntegrator::addPendingOperation()
+  {
+    ++_pendingOperations;
+  }
+
+  size_t ResultIntegrator::pendingOperationsCount() const
+  {
+    return _pendingOperations.load();
+  }
+
+  void ResultIntegrator::pushResults(op::OperationResultsMessage message)
+  {
+    _resultsQueue.push(std::move(message));
+    _resultsNotifier.notify();
+  }
+
+  void ResultIntegrator::post(std::function<void()> work)
+  {
+    _resultsQueue.push(std::move(work));
+    _resultsNotifier.notify();
+  }
+
+  bool ResultIntegrator::integrateUntil(std::chrono::steady_clock::time_point deadline)
+  {
+    // Results pushed after this point trigger a new notification
+    _resultsNotifier.reset();
+
+    while (true)
+    {
+      if (_nextResult == _currentMessage.results.size())
+      {
+        QueueItem item;
+        if (!_resultsQueue.tryPop(item))
+          return false;
+
+        if (auto work = boost::get<std::function<void()>>(&item))
+        {
+          (*work)();
+          if (std::chrono::steady_clock::now() >= deadline)
+            return true;
+          continue;
+        }
+
+        _currentMessage = std::move(boost::get<op::OperationResultsMessage>(item));
+        _nextResult = 0;
+        if (_currentMessage.results.empty())
+        {
+          if (_currentMessage.taskCompleted)
+            completeTask();
+          continue;
+        }
+
+        // The changes of a task which could not be committed are skipped, its optimistic changes are reverted once
+        // the task is completed
+        if (commitFailed(_currentMessage))
+          _nextResult = _currentMessage.results.size() - 1;
+      }
 
-    // Move all of the completed tasks to the end of the list
-    auto readyBegin = std::stable_partition(begin(_integrationQueue), end(_integrationQueue),
-                                            [](auto& task) { return !task.completed(); });
+      // At least one result is integrated per call, such that every call makes progress
+      auto& result = _currentMessage.results[_nextResult++];
+      boost::apply_visitor([this](auto& result) { return this->integrateResult(result); }, result);
+      if (_nextResult == _currentMessage.results.size() && _currentMessage.taskCompleted)
+        completeTask();
+
+      if (std::chrono::steady_clock::now() >= deadline)
+        return true;
+    }
+  }
+
+  void ResultIntegrator::completeTask()
+  {
+    rollbackOptimisticChanges(_currentMessage.uniqueId);
+    --_pendingOperations;
+  }
 
-    // For each of the completed tasks: integrate it!
-    for (auto it = readyBegin; it != end(_integrationQueue); ++it)
+  bool ResultIntegrator::isRemovedProvisionally(int reservationId) const
+  {
+    for (auto& changes : _optimisticChanges)
     {
-      for (auto& result : it->results())
-        boost::apply_visitor([this](auto& result) { return this->integrateResult(result); }, result);
+      auto& removed = changes.second.removedReservations;
+      if (std::any_of(removed.begin(), removed.end(),
+                      [reservationId](auto& reservation) { return reservation->id() == reservationId; }))
+        return true;
     }
+    return false;
+  }
+
+  bool ResultIntegrator::addProvisionalReservation(int taskId, std::unique_ptr<hotel::Reservation> reservation)
+  {
+    if (!_planning.canAddReservation(*reservation))
+      return false;
 
-    // Erase all completed tasks
-    _integrationQueue.erase(readyBegin, end(_integrationQueue));
+    _optimisticChanges[taskId].provisionalReservationIds.push_back(reservation->id());
+    _planning.addReservation(std::move(reservation));
+    return true;
   }
 
-  void ResultIntegrator::addPendingOperation(op::Task<op::OperationResults> task)
+  bool ResultIntegrator::removeReservationProvisionally(int taskId, int reservationId)
   {
-    std::unique_lock<std::mutex> lock(_queueMutex);
-    _integrationQueue.push_back(std::move(task));
+    auto reservation = _planning.getReservationById(reservationId);
+    if (reservation == nullptr)
+      return false;
+
+    // The store result of a provisional reservation must not bring it back once it arrives
+    for (auto& changes : _optimisticChanges)
+    {
+      auto& ids = changes.second.provisionalReservationIds;
+      auto id = std::find(ids.begin(), ids.end(), reservationId);
+      if (changes.first != taskId && id != ids.end())
+      {
+        ids.erase(id);
+        changes.second.deletedProvisionalIds.push_back(reservationId);
+        break;
+      }
+    }
+
+    _optimisticChanges[taskId].removedReservations.push_back(std::make_unique<hotel::Reservation>(*reservation));
+    _planning.removeReservation(reservation);
+    return true;
   }
 
-  size_t ResultIntegrator::pendingOperationsCount() const
+  void ResultIntegrator::bindOptimisticChanges(int taskId)
+  {
+    auto it = _optimisticChanges.find(unqueuedTaskId);
+    if (it == _optimisticChanges.end())
+      return;
+
+    _optimisticChanges[taskId] = std::move(it->second);
+    _optimisticChanges.erase(it);
+  }
+
+  void ResultIntegrator::rollbackOptimisticChanges(int taskId)
   {
-    return _integrationQueue.size();
+    auto it = _optimisticChanges.find(taskId);
+    if (it == _optimisticChanges.end())
+      return;
+
+    for (auto id : it->second.provisionalReservationIds)
+    {
+      auto reservation = _planning.getReservationById(id);
+      if (reservation != nullptr)
+        _planning.removeReservation(reservation);
+    }
+    // Provisional reservations which have never been stored are not restored by the tasks which deleted them
+    for (auto id : it->second.deletedProvisionalIds)
+    {
+      for (auto& changes : _optimisticChanges)
+      {
+        auto& removed = changes.second.removedReservations;
+        removed.erase(std::remove_if(removed.begin(), removed.end(),
+                                     [id](auto& reservation) { return reservation->id() == id; }),
+                      removed.end());
+      }
+    }
+    for (auto& reservation : it->second.removedReservations)
+    {
+      // A restored provisional reservation is replaced by its stored version again
+      for (auto& changes : _optimisticChanges)
+      {
+        auto& deleted = changes.second.deletedProvisionalIds;
+        auto id = std::find(deleted.begin(), deleted.end(), reservation->id());
+        if (id != deleted.end())
+        {
+          deleted.erase(id);
+          changes.second.provisionalReservationIds.push_back(reservation->id());
+          break;
+        }
+      }
+
+      if (_planning.canAddReservation(*reservation))
+        _planning.addReservation(std::move(reservation));
+      else
+        std::cerr << "Cannot restore reservation " << reservation->description() << std::endl;
+    }
+    _optimisticChanges.erase(it);
   }
 
   void ResultIntegrator::integrateResult(op::NoResult&) {}
 
   void ResultIntegrator::integrateResult(op::EraseAllDataResult&)
   {
+    _optimisticChanges.clear();
     _planning.clear();
     _hotels.clear();
+    ++_planningResetCount;
+  }
+
+  void ResultIntegrator::integrateResult(op::LoadInitialDataResult&)
+  {
+    _planning.clear();
+    _hotels.clear();
+    ++_planningResetCount;
+  }
+
+  void ResultIntegrator::integrateResult(op::LoadedHotelsChunk& res)
+  {
+    for (auto& hotel : res.hotels)
+    {
+      for (auto& room : hotel->rooms())
+        _planning.addRoomId(room->id());
+      _hotels.addHotel(std::move(hotel));
+    }
+  }
+
+  void ResultIntegrator::integrateResult(op::LoadedReservationsChunk& res)
+  {
+    for (auto& reservation : res.reservations)
+    {
+      // Loaded before a pending deletion has been executed by the backend
+      if (isRemovedProvisionally(reservation->id()))
+        continue;
+
+      if (!_planning.canAddReservation(*reservation))
+      {
+        std::cerr << "Cannot add reservation " << reservation->description() << std::endl;
+        continue;
+      }
+
+      _planning.addReservation(std::move(reservation));
+    }
   }
 
-  void ResultIntegrator::integrateResult(op::LoadInitialDataResult& res)
+  void ResultIntegrator::integrateResult(op::LoadPlanningWindowResult& res)
   {
-    _hotels = std::move(*res.hotels);
-    _planning = std::move(*res.planning);
+    for (auto& reservation : res.reservations)
+    {
+      // Reservations spanning multiple windows are delivered once for each window
+      if (_planning.getReservationById(reservation->id()) != nullptr)
+        continue;
+      // Loaded before a pending deletion has been executed by the backend
+      if (isRemovedProvisionally(reservation->id()))
+        continue;
+
+      if (!_planning.canAddReservation(*reservation))
+      {
+        std::cerr << "Cannot add reservation " << reservation->description() << std::endl;
+        continue;
+      }
+
+      _planning.addReservation(std::move(reservation));
+    }
   }
 
   void ResultIntegrator::integrateResult(op::StoreNewReservationResult& res)
   {
+    // The stored reservation replaces its provisional copy
+    auto changes = _optimisticChanges.find(_currentMessage.uniqueId);
+    if (res.provisionalId != 0 && changes != _optimisticChanges.end())
+    {
+      auto& ids = changes->second.provisionalReservationIds;
+      auto id = std::find(ids.begin(), ids.end(), res.provisionalId);
+      if (id != ids.end())
+      {
+        ids.erase(id);
+        auto provisional = _planning.getReservationById(res.provisionalId);
+        if (provisional != nullptr)
+          _planning.removeReservation(provisional);
+      }
+
+      // The provisional reservation has already been deleted by a later task
+      auto& deleted = changes->second.deletedProvisionalIds;
+      auto deletedId = std::find(deleted.begin(), deleted.end(), res.provisionalId);
+      if (deletedId != deleted.end())
+      {
+        deleted.erase(deletedId);
+        return;
+      }
+    }
+
     if (!_planning.canAddReservation(*res.storedReservation))
     {
       std::cerr << "Cannot add reservation " << res.storedReservation->description() << std::endl;
@@ -79,12 +324,39 @@ namespace persistence
 
   void ResultIntegrator::integrateResult(op::DeleteReservationResult& res)
   {
+    // Reservations which have been removed ahead of time are forgotten, a copy which has been loaded again in the
+    // meantime is removed from the planning as well
+    bool removedAhead = false;
+    auto changes = _optimisticChanges.find(_currentMessage.uniqueId);
+    if (changes != _optimisticChanges.end())
+    {
+      auto& removed = changes->second.removedReservations;
+      auto it = std::find_if(removed.begin(), removed.end(),
+                             [&](auto& reservation) { return reservation->id() == res.deletedReservationId; });
+      if (it != removed.end())
+      {
+        removed.erase(it);
+        removedAhead = true;
+      }
+    }
+
     auto reservation = _planning.getReservationById(res.deletedReservationId);
     if (reservation != nullptr)
       _planning.removeReservation(reservation);
-    else
+    else if (!removedAhead)
       std::cerr << "Cannot remove reservation with id " << res.deletedReservationId
                 << " from planning board: no such id" << std::endl;
   }
 
+  void ResultIntegrator::integrateResult(op::LeaseIdsResult& res)
+  {
+    _idAllocator.addLease(res.space, res.firstId, res.count);
+  }
+
+  void ResultIntegrator::integrateResult(op::CommitFailedResult&)
+  {
+    std::cerr << "The changes of task " << _currentMessage.uniqueId << " could not be committed and have been reverted"
+              << std::endl;
+  }
+
 } // namespace persistence
@@ -1,24 +1,34 @@
 #ifndef PERSISTENCE_RESULTINTEGRATOR_H
 #define PERSISTENCE_RESULTINTEGRATOR_H
 
+#include "persistence/executor.h"
+#include "persistence/idallocator.h"
+#include "persistence/mpscqueue.h"
 #include "persistence/op/operations.h"
 #include "persistence/op/results.h"
 #include "persistence/op/task.h"
+#include "persistence/wakeupnotifier.h"
 
 #include "hotel/hotelcollection.h"
 #include "hotel/planning.h"
 
 #include "boost/signals2.hpp"
 
-#include <mutex>
-#include <queue>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <vector>
 
 namespace persistence
 {
   /**
    * @brief The ResultIntegrator class collects results from the persitency backend and applies them locally.
+   *
+   * The integrator is also an executor: work posted to it runs on the thread which calls processIntegrationQueue(), in
+   * order with the integration of the results. A task continuation posted to it thus sees the results of its task.
    */
-  class ResultIntegrator
+  class ResultIntegrator : public Executor
   {
   public:
     ResultIntegrator() = default;
@@ -28,25 +38,112 @@ namespace persistence
     const hotel::HotelCollection& hotels() const;
     hotel::PlanningBoard& planning();
     const hotel::PlanningBoard& planning() const;
+    //! Ids leased from the backend, the leases are added when their results are integrated
+    IdAllocator& idAllocator() { return _idAllocator; }
+    //! Number of times the planning has been cleared, i.e. all data has been erased or loaded anew
+    int planningResetCount() const { return _planningResetCount; }
 
+    //! Integrates all of the results which are available
     void processIntegrationQueue();
-    void addPendingOperation(op::Task<op::OperationResults> task);
+    /**
+     * @brief processIntegrationQueue integrates the available results until the given time budget is used up
+     * The results are integrated in the order in which the backend delivers them. Results which a task publishes before
+     * it has been completed are integrated as well, thus a long loading operation can be integrated over multiple calls.
+     * @return true if available results are left over, i.e. the function should be called again soon
+     */
+    bool processIntegrationQueue(std::chrono::steady_clock::duration timeBudget);
+    //! Registers an operation which has been queued in the backend, must be called before queueing it
+    void addPendingOperation();
+    //! Returns the number of queued operations whose results have not been integrated completely yet
     size_t pendingOperationsCount() const;
 
+    /**
+     * @brief pushResults hands over results from the backend
+     * The results are integrated in the order in which they are pushed, i.e. in the order in which the backend executes
+     * the tasks. This function does not block and may be called from any thread.
+     */
+    void pushResults(op::OperationResultsMessage message);
+
+    /**
+     * @brief resultsAvailableFileDescriptor returns a descriptor which becomes readable when results have been pushed
+     * The descriptor is reset by processIntegrationQueue().
+     */
+    int resultsAvailableFileDescriptor() const { return _resultsNotifier.fileDescriptor(); }
+
+    // Executor interface
+    virtual void post(std::function<void()> work) override;
+
+    //! Task id under which optimistic changes are applied before their task has been queued
+    static const int unqueuedTaskId = 0;
+
+    /**
+     * @brief addProvisionalReservation adds a reservation to the planning before the backend has stored it
+     * @param taskId Id of the task storing the reservation
+     * @param reservation Copy of the reservation carrying a provisional id, see op::StoreNewReservation
+     * @return false if the reservation does not fit into the planning, in which case nothing has been changed
+     *
+     * The provisional reservation is replaced by the stored one once the result arrives. If the task ends without
+     * storing it, e.g. because it has been cancelled, the provisional reservation is removed again.
+     */
+    bool addProvisionalReservation(int taskId, std::unique_ptr<hotel::Reservation> reservation);
+    /**
+     * @brief removeReservationProvisionally removes a reservation from the planning before the backend has deleted it
+     * @param taskId Id of the task deleting the reservation
+     * @return false if there is no such reservation
+     *
+     * The reservation is restored if the task ends without deleting it. If the reservation is a provisional one of an
+     * earlier task, its stored version is not added to the planning once that task's result arrives.
+     */
+    bool removeReservationProvisionally(int taskId, int reservationId);
+    //! Hands the optimistic changes applied under unqueuedTaskId over to the given task
+    void bindOptimisticChanges(int taskId);
+    //! Reverts all optimistic changes of the given task which have not been confirmed by its results
+    void rollbackOptimisticChanges(int taskId);
+
   private:
+    bool integrateUntil(std::chrono::steady_clock::time_point deadline);
+    //! Called once all results of the task of the current message have been integrated
+    void completeTask();
+    //! Returns true if a task which has not been completed yet has removed the reservation ahead of the backend
+    bool isRemovedProvisionally(int reservationId) const;
+
     void integrateResult(op::NoResult& res);
     void integrateResult(op::EraseAllDataResult& res);
     void integrateResult(op::LoadInitialDataResult& res);
+    void integrateResult(op::LoadedHotelsChunk& res);
+    void integrateResult(op::LoadedReservationsChunk& res);
+    void integrateResult(op::LoadPlanningWindowResult& res);
     void integrateResult(op::StoreNewReservationResult& res);
     void integrateResult(op::StoreNewHotelResult& res);
     void integrateResult(op::StoreNewPersonResult& res);
     void integrateResult(op::DeleteReservationResult& res);
+    void integrateResult(op::LeaseIdsResult& res);
+    void integrateResult(op::CommitFailedResult& res);
 
     hotel::PlanningBoard _planning;
     hotel::HotelCollection _hotels;
+    IdAllocator _idAllocator;
+    int _planningResetCount = 0;
+
+    // Results pushed by the backend and posted work, which are drained by the thread integrating the results
+    typedef boost::variant<op::OperationResultsMessage, std::function<void()>> QueueItem;
+    MpscQueue<QueueItem> _resultsQueue;
+    std::atomic<size_t> _pendingOperations{0};
+    WakeupNotifier _resultsNotifier;
+
+    // Message which is being integrated and the index of its next result to integrate
+    op::OperationResultsMessage _currentMessage{0, op::OperationResults(), false};
+    size_t _nextResult = 0;
 
-    std::mutex _queueMutex;
-    std::vector<op::Task<op::OperationResults>> _integrationQueue;
+    // Local changes applied ahead of the backend, by the id of the task which performs them
+    struct OptimisticChanges
+    {
+      std::vector<int> provisionalReservationIds;
+      // Provisional reservations of this task which a later task has removed before they have been stored
+      std::vector<int> deletedProvisionalIds;
+      std::vector<std::unique_ptr<hotel::Reservation>> removedReservations;
+    };
+    std::map<int, OptimisticChanges> _optimisticChanges;
   };
 
 } // namespace persistence
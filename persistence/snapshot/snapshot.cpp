@@ -0,0 +1,355 @@
+#include "persistence/snapshot/snapshot.h"
+
+#include "persistence/filesync.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace persistence
+{
+  namespace snapshot
+  {
+    namespace
+    {
+      // The records only consist of 32 bit fields and are stored in native byte order. The byte order is covered by the
+      // version field, a snapshot written on a machine with another byte order is rejected.
+      const char snapshotMagic[8] = {'H', 'O', 'T', 'E', 'L', 'S', 'N', 'P'};
+
+      struct StringRef
+      {
+        uint32_t offset;
+        uint32_t length;
+      };
+
+      struct Header
+      {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        int64_t watermark;
+        uint64_t hotelCount;
+        uint64_t categoryCount;
+        uint64_t roomCount;
+        uint64_t reservationCount;
+        uint64_t atomCount;
+        uint64_t stringTableSize;
+      };
+
+      struct HotelRecord
+      {
+        int32_t id;
+        StringRef name;
+      };
+
+      struct CategoryRecord
+      {
+        int32_t id;
+        int32_t hotelId;
+        StringRef shortCode;
+        StringRef name;
+      };
+
+      struct RoomRecord
+      {
+        int32_t id;
+        int32_t hotelId;
+        int32_t categoryId;
+        StringRef name;
+      };
+
+      struct ReservationRecord
+      {
+        int32_t id;
+        int32_t status;
+        int32_t adults;
+        int32_t children;
+        uint32_t firstAtom;
+        uint32_t atomCount;
+        StringRef description;
+      };
+
+      struct AtomRecord
+      {
+        int32_t id;
+        int32_t roomId;
+        int32_t dateFrom; // Day numbers, as in the database
+        int32_t dateTo;
+      };
+
+      // Pointers to the sections of a mapped snapshot
+      struct Sections
+      {
+        const Header* header;
+        const HotelRecord* hotels;
+        const CategoryRecord* categories;
+        const RoomRecord* rooms;
+        const ReservationRecord* reservations;
+        const AtomRecord* atoms;
+        const char* strings;
+      };
+
+      uint64_t expectedSize(const Header& header)
+      {
+        return sizeof(Header) + header.hotelCount * sizeof(HotelRecord) +
+               header.categoryCount * sizeof(CategoryRecord) + header.roomCount * sizeof(RoomRecord) +
+               header.reservationCount * sizeof(ReservationRecord) + header.atomCount * sizeof(AtomRecord) +
+               header.stringTableSize;
+      }
+
+      Sections sections(const char* data)
+      {
+        Sections result;
+        result.header = reinterpret_cast<const Header*>(data);
+        auto position = data + sizeof(Header);
+        result.hotels = reinterpret_cast<const HotelRecord*>(position);
+        position += result.header->hotelCount * sizeof(HotelRecord);
+        result.categories = reinterpret_cast<const CategoryRecord*>(position);
+        position += result.header->categoryCount * sizeof(CategoryRecord);
+        result.rooms = reinterpret_cast<const RoomRecord*>(position);
+        position += result.header->roomCount * sizeof(RoomRecord);
+        result.reservations = reinterpret_cast<const ReservationRecord*>(position);
+        position += result.header->reservationCount * sizeof(ReservationRecord);
+        result.atoms = reinterpret_cast<const AtomRecord*>(position);
+        position += result.header->atomCount * sizeof(AtomRecord);
+        result.strings = position;
+        return result;
+      }
+
+      // Collects the records and strings of a snapshot before it is written
+      class SnapshotBuilder
+      {
+      public:
+        StringRef addString(const std::string& text)
+        {
+          StringRef ref{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(text.size())};
+          strings.insert(strings.end(), text.begin(), text.end());
+          return ref;
+        }
+
+        template <typename T> static void write(std::ofstream& stream, const std::vector<T>& records)
+        {
+          stream.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+        }
+
+        std::vector<HotelRecord> hotels;
+        std::vector<CategoryRecord> categories;
+        std::vector<RoomRecord> rooms;
+        std::vector<ReservationRecord> reservations;
+        std::vector<AtomRecord> atoms;
+        std::vector<char> strings;
+      };
+
+      std::string readString(const char* strings, StringRef ref)
+      {
+        return std::string(strings + ref.offset, ref.length);
+      }
+    } // namespace
+
+    bool writeSnapshot(const std::string& path, int64_t watermark, const std::vector<const hotel::Hotel*>& hotels,
+                       const std::vector<const hotel::Reservation*>& reservations)
+    {
+      SnapshotBuilder builder;
+      for (auto& hotel : hotels)
+      {
+        builder.hotels.push_back(HotelRecord{hotel->id(), builder.addString(hotel->name())});
+        for (auto& category : hotel->categories())
+          builder.categories.push_back(CategoryRecord{category->id(), hotel->id(),
+                                                      builder.addString(category->shortCode()),
+                                                      builder.addString(category->name())});
+        for (auto& room : hotel->rooms())
+          builder.rooms.push_back(
+              RoomRecord{room->id(), hotel->id(), room->category()->id(), builder.addString(room->name())});
+      }
+      for (auto& reservation : reservations)
+      {
+        builder.reservations.push_back(ReservationRecord{
+            reservation->id(), static_cast<int32_t>(reservation->status()), reservation->numberOfAdults(),
+            reservation->numberOfChildren(), static_cast<uint32_t>(builder.atoms.size()),
+            static_cast<uint32_t>(reservation->atoms().size()), builder.addString(reservation->description())});
+        for (auto& atom : reservation->atoms())
+          builder.atoms.push_back(AtomRecord{atom.id(), atom.roomId(),
+                                             static_cast<int32_t>(atom.dateRange().begin().day_number()),
+                                             static_cast<int32_t>(atom.dateRange().end().day_number())});
+      }
+
+      Header header;
+      std::memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+      header.version = snapshotVersion;
+      header.headerSize = sizeof(Header);
+      header.watermark = watermark;
+      header.hotelCount = builder.hotels.size();
+      header.categoryCount = builder.categories.size();
+      header.roomCount = builder.rooms.size();
+      header.reservationCount = builder.reservations.size();
+      header.atomCount = builder.atoms.size();
+      header.stringTableSize = builder.strings.size();
+
+      auto temporaryPath = path + ".tmp";
+      {
+        std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        SnapshotBuilder::write(stream, builder.hotels);
+        SnapshotBuilder::write(stream, builder.categories);
+        SnapshotBuilder::write(stream, builder.rooms);
+        SnapshotBuilder::write(stream, builder.reservations);
+        SnapshotBuilder::write(stream, builder.atoms);
+        SnapshotBuilder::write(stream, builder.strings);
+        if (!stream.flush())
+        {
+          std::cerr << "Cannot write snapshot: " << temporaryPath << std::endl;
+          std::remove(temporaryPath.c_str());
+          return false;
+        }
+      }
+
+      // The callers drop the data covered by the snapshot afterwards, thus it has to be durable under its final name
+      if (!syncFile(temporaryPath) || std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+      {
+        std::cerr << "Cannot replace snapshot: " << path << std::endl;
+        std::remove(temporaryPath.c_str());
+        return false;
+      }
+      return syncParentDirectory(path);
+    }
+
+    SnapshotReader::SnapshotReader(const std::string& path) : _file(path, sizeof(Header))
+    {
+      if (!_file.empty() && !validate())
+      {
+        std::cerr << "Ignoring invalid snapshot: " << path << std::endl;
+        _file.reset();
+      }
+    }
+
+    bool SnapshotReader::validate() const
+    {
+      auto& header = *reinterpret_cast<const Header*>(_file.data());
+      if (std::memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0 || header.version != snapshotVersion ||
+          header.headerSize != sizeof(Header) || expectedSize(header) != _file.size())
+        return false;
+
+      // All references within the file are checked once, such that reading does not have to
+      auto s = sections(_file.data());
+      auto validString = [&](StringRef ref) {
+        return static_cast<uint64_t>(ref.offset) + ref.length <= header.stringTableSize;
+      };
+      for (uint64_t i = 0; i < header.hotelCount; ++i)
+        if (!validString(s.hotels[i].name))
+          return false;
+      for (uint64_t i = 0; i < header.categoryCount; ++i)
+        if (!validString(s.categories[i].shortCode) || !validString(s.categories[i].name))
+          return false;
+      for (uint64_t i = 0; i < header.roomCount; ++i)
+        if (!validString(s.rooms[i].name))
+          return false;
+      for (uint64_t i = 0; i < header.reservationCount; ++i)
+      {
+        auto& reservation = s.reservations[i];
+        if (!validString(reservation.description) || reservation.atomCount == 0 ||
+            static_cast<uint64_t>(reservation.firstAtom) + reservation.atomCount > header.atomCount ||
+            reservation.status < hotel::Reservation::Unknown || reservation.status > hotel::Reservation::Archived)
+          return false;
+      }
+      return true;
+    }
+
+    int64_t SnapshotReader::watermark() const { return sections(_file.data()).header->watermark; }
+
+    size_t SnapshotReader::hotelCount() const { return sections(_file.data()).header->hotelCount; }
+
+    size_t SnapshotReader::reservationCount() const { return sections(_file.data()).header->reservationCount; }
+
+    void SnapshotReader::readHotels(size_t chunkSize, const HotelsConsumer& consumer) const
+    {
+      auto s = sections(_file.data());
+      uint64_t category = 0;
+      uint64_t room = 0;
+      std::vector<std::unique_ptr<hotel::Hotel>> chunk;
+      for (uint64_t i = 0; i < s.header->hotelCount; ++i)
+      {
+        // Categories and rooms are stored grouped by hotel, in the order of the hotels
+        auto& record = s.hotels[i];
+        auto hotel = std::make_unique<hotel::Hotel>(readString(s.strings, record.name));
+        hotel->setId(record.id);
+        for (; category < s.header->categoryCount && s.categories[category].hotelId == record.id; ++category)
+        {
+          auto& categoryRecord = s.categories[category];
+          auto newCategory = std::make_unique<hotel::RoomCategory>(readString(s.strings, categoryRecord.shortCode),
+                                                                   readString(s.strings, categoryRecord.name));
+          newCategory->setId(categoryRecord.id);
+          hotel->addRoomCategory(std::move(newCategory));
+        }
+        for (; room < s.header->roomCount && s.rooms[room].hotelId == record.id; ++room)
+        {
+          auto& roomRecord = s.rooms[room];
+          auto category = hotel->getCategoryById(roomRecord.categoryId);
+          if (category == nullptr)
+            continue;
+          auto newRoom = std::make_unique<hotel::HotelRoom>(readString(s.strings, roomRecord.name));
+          newRoom->setId(roomRecord.id);
+          hotel->addRoom(std::move(newRoom), category->shortCode());
+        }
+
+        chunk.push_back(std::move(hotel));
+        if (chunk.size() >= chunkSize)
+        {
+          consumer(std::move(chunk));
+          chunk.clear();
+        }
+      }
+      if (!chunk.empty())
+        consumer(std::move(chunk));
+    }
+
+    void SnapshotReader::readReservations(boost::optional<boost::gregorian::date_period> window, size_t chunkSize,
+                                          const ReservationsConsumer& consumer) const
+    {
+      using namespace boost::gregorian;
+      auto toDate = [](int32_t dayNumber) { return date(gregorian_calendar::from_day_number(dayNumber)); };
+
+      auto s = sections(_file.data());
+      std::vector<std::unique_ptr<hotel::Reservation>> chunk;
+      for (uint64_t i = 0; i < s.header->reservationCount; ++i)
+      {
+        auto& record = s.reservations[i];
+        auto atoms = s.atoms + record.firstAtom;
+        if (window)
+        {
+          auto windowBegin = static_cast<int32_t>(window->begin().day_number());
+          auto windowEnd = static_cast<int32_t>(window->end().day_number());
+          auto intersects = false;
+          for (uint32_t atom = 0; atom < record.atomCount && !intersects; ++atom)
+            intersects = atoms[atom].dateFrom < windowEnd && atoms[atom].dateTo > windowBegin;
+          if (!intersects)
+            continue;
+        }
+
+        auto reservation = std::make_unique<hotel::Reservation>(
+            readString(s.strings, record.description), atoms[0].roomId,
+            date_period(toDate(atoms[0].dateFrom), toDate(atoms[0].dateTo)));
+        reservation->setId(record.id);
+        reservation->setStatus(static_cast<hotel::Reservation::ReservationStatus>(record.status));
+        reservation->setNumberOfAdults(record.adults);
+        reservation->setNumberOfChildren(record.children);
+        reservation->atoms().back().setId(atoms[0].id);
+        for (uint32_t atom = 1; atom < record.atomCount; ++atom)
+        {
+          reservation->addContinuation(atoms[atom].roomId, toDate(atoms[atom].dateTo));
+          reservation->atoms().back().setId(atoms[atom].id);
+        }
+
+        chunk.push_back(std::move(reservation));
+        if (chunk.size() >= chunkSize)
+        {
+          consumer(std::move(chunk));
+          chunk.clear();
+        }
+      }
+      if (!chunk.empty())
+        consumer(std::move(chunk));
+    }
+
+  } // namespace snapshot
+} // namespace persistence
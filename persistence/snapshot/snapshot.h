@@ -0,0 +1,80 @@
+#ifndef PERSISTENCE_SNAPSHOT_SNAPSHOT_H
+#define PERSISTENCE_SNAPSHOT_SNAPSHOT_H
+
+#include "persistence/mappedfile.h"
+
+#include "hotel/hotel.h"
+#include "hotel/reservation.h"
+
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace persistence
+{
+  namespace snapshot
+  {
+    /**
+     * @brief Version of the snapshot format
+     * Snapshots of other versions are ignored. Increase it whenever the layout of the records, or the meaning of one of
+     * their fields (e.g. the values of hotel::Reservation::ReservationStatus) changes.
+     */
+    const uint32_t snapshotVersion = 1;
+
+    /**
+     * @brief writeSnapshot writes the hotels and reservations to a snapshot file
+     * @param watermark Position in the change log of the database up to which the snapshot contains the changes
+     *
+     * The file is written next to the target and renamed over it once complete, such that readers never see a partial
+     * snapshot. The function returns once the snapshot is durable.
+     * @return false if the file cannot be written
+     */
+    bool writeSnapshot(const std::string& path, int64_t watermark, const std::vector<const hotel::Hotel*>& hotels,
+                       const std::vector<const hotel::Reservation*>& reservations);
+
+    /**
+     * @brief The SnapshotReader class maps a snapshot file into memory and rebuilds the objects from its records
+     *
+     * A snapshot is a flat binary file: a header, fixed-size records for the hotels, categories, rooms, reservations
+     * and reservation atoms, and a table of all strings. The records are read in place, without parsing.
+     */
+    class SnapshotReader
+    {
+    public:
+      typedef std::function<void(std::vector<std::unique_ptr<hotel::Hotel>>)> HotelsConsumer;
+      typedef std::function<void(std::vector<std::unique_ptr<hotel::Reservation>>)> ReservationsConsumer;
+
+      //! Maps the given file, check valid() before reading
+      explicit SnapshotReader(const std::string& path);
+      SnapshotReader(const SnapshotReader&) = delete;
+      SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+      //! Returns false if the file does not exist, has another version, or is damaged
+      bool valid() const { return !_file.empty(); }
+      int64_t watermark() const;
+      size_t hotelCount() const;
+      size_t reservationCount() const;
+
+      //! Hands the hotels to the consumer in chunks of at most chunkSize hotels
+      void readHotels(size_t chunkSize, const HotelsConsumer& consumer) const;
+      /**
+       * @brief Hands the reservations to the consumer in chunks of at most chunkSize reservations
+       * If a window is given, only the reservations intersecting it are read.
+       */
+      void readReservations(boost::optional<boost::gregorian::date_period> window, size_t chunkSize,
+                            const ReservationsConsumer& consumer) const;
+
+    private:
+      bool validate() const;
+
+      MappedFile _file;
+    };
+
+  } // namespace snapshot
+} // namespace persistence
+
+#endif // PERSISTENCE_SNAPSHOT_SNAPSHOT_H
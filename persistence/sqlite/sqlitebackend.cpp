@@ -1,85 +1,280 @@
 #include "persistence/sqlite/sqlitebackend.h"
 
+#include "persistence/snapshot/snapshot.h"
+
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <limits>
 
 namespace persistence
 {
   namespace sqlite
   {
-    SqliteBackend::SqliteBackend(const std::string& databasePath)
-        : _storage(databasePath), _nextOperationId(1), _backendThread(), _quitBackendThread(false),
-          _workAvailableCondition(), _queueMutex(), _operationsQueue()
+    namespace
     {
-    }
+      // Minimal number of consecutive store operations of the same kind for which the bulk storage path is used
+      const size_t bulkOperationThreshold = 16;
+
+      // Sizes of the chunks in which the initial data is handed to the result integrator
+      const size_t loadHotelsChunkSize = 4;
+      const size_t loadReservationsChunkSize = 256;
+
+      // Returns the end of the run of operations of type Op starting at index begin
+      template <typename Op> size_t findRunEnd(op::Operations& operations, size_t begin)
+      {
+        auto end = begin;
+        while (end < operations.size() && boost::get<Op>(&operations[end]) != nullptr)
+          ++end;
+        return end;
+      }
+
+      template <typename Op> std::vector<Op*> collectRun(op::Operations& operations, size_t begin, size_t end)
+      {
+        std::vector<Op*> run;
+        run.reserve(end - begin);
+        for (auto i = begin; i < end; ++i)
+          run.push_back(boost::get<Op>(&operations[i]));
+        return run;
+      }
+
+      const char* idSpaceTable(op::IdSpace space)
+      {
+        switch (space)
+        {
+        case op::IdSpace::Hotel:
+          return "h_hotel";
+        case op::IdSpace::RoomCategory:
+          return "h_room_category";
+        case op::IdSpace::Room:
+          return "h_room";
+        case op::IdSpace::Reservation:
+          return "h_reservation";
+        case op::IdSpace::ReservationAtom:
+          return "h_reservation_atom";
+        }
+        assert(false);
+        return "";
+      }
+
+      bool intersects(const hotel::Reservation& reservation, boost::gregorian::date_period window)
+      {
+        return std::any_of(reservation.atoms().begin(), reservation.atoms().end(),
+                           [&](auto& atom) { return atom.dateRange().intersects(window); });
+      }
+    } // namespace
 
-    op::Task<op::OperationResults> SqliteBackend::queueOperation(op::Operations operations)
+    SqliteBackend::SqliteBackend(const std::string& databasePath, int snapshotInterval,
+                                 std::chrono::seconds tombstoneRetention)
+        : _storage(databasePath), _snapshotPath(), _snapshotInterval(snapshotInterval),
+          _tombstoneRetention(tombstoneRetention)
     {
-      // Create a task
-      auto sharedState = std::make_shared<op::TaskSharedState<op::OperationResults>>(_nextOperationId++);
-      op::Task<op::OperationResults> task(sharedState);
+      // In-memory databases do not outlive the backend, thus there is no point in a snapshot
+      if (snapshotInterval > 0 && databasePath != ":memory:")
+        _snapshotPath = databasePath + ".snapshot";
+    }
 
-      std::unique_lock<std::mutex> lock(_queueMutex);
-      auto pair = QueuedOperation{std::move(operations), sharedState};
-      _operationsQueue.push(std::move(pair));
-      lock.unlock();
-      _workAvailableCondition.notify_one();
+    void SqliteBackend::beginTransaction() { _storage.beginTransaction(); }
 
-      return task;
+    bool SqliteBackend::commitTransaction() { return _storage.commitTransaction(); }
+
+    void SqliteBackend::runIdleWork()
+    {
+      writeSnapshotIfDue();
+      pruneExpiredTombstones();
     }
 
-    void SqliteBackend::start(persistence::ResultIntegrator& resultIntegrator)
+    bool SqliteBackend::loadInitialDataFromSnapshot(boost::optional<boost::gregorian::date_period> planningWindow)
     {
-      assert(!_backendThread.joinable());
-      _backendThread = std::thread([this, &resultIntegrator]() { this->threadMain(resultIntegrator); });
+      if (_snapshotPath.empty())
+        return false;
+
+      // A snapshot ahead of the change log belongs to another database, e.g. one which has been replaced
+      snapshot::SnapshotReader reader(_snapshotPath);
+      if (!reader.valid() || reader.watermark() > _storage.latestChange())
+        return false;
+
+      auto changes = _storage.loadChangesSince(reader.watermark());
+      reader.readHotels(loadHotelsChunkSize, [this](std::vector<std::unique_ptr<hotel::Hotel>> hotels) {
+        this->publishPartialResult(op::LoadedHotelsChunk{std::move(hotels)});
+      });
+      op::LoadedHotelsChunk storedHotels;
+      for (auto id : changes.storedHotelIds)
+        if (auto hotel = _storage.loadHotel(id))
+          storedHotels.hotels.push_back(std::move(hotel));
+      if (!storedHotels.hotels.empty())
+        publishPartialResult(std::move(storedHotels));
+
+      auto& deleted = changes.deletedReservationIds;
+      auto isDeleted = [&](const std::unique_ptr<hotel::Reservation>& reservation) {
+        return deleted.count(reservation->id()) != 0;
+      };
+      reader.readReservations(planningWindow, loadReservationsChunkSize,
+                              [&](std::vector<std::unique_ptr<hotel::Reservation>> reservations) {
+                                reservations.erase(std::remove_if(reservations.begin(), reservations.end(), isDeleted),
+                                                   reservations.end());
+                                this->publishPartialResult(op::LoadedReservationsChunk{std::move(reservations)});
+                              });
+      op::LoadedReservationsChunk storedReservations;
+      for (auto id : changes.storedReservationIds)
+      {
+        if (deleted.count(id) != 0)
+          continue;
+        auto reservation = _storage.loadReservation(id);
+        if (reservation != nullptr && (!planningWindow || intersects(*reservation, *planningWindow)))
+          storedReservations.reservations.push_back(std::move(reservation));
+      }
+      if (!storedReservations.reservations.empty())
+        publishPartialResult(std::move(storedReservations));
+
+      return true;
     }
 
-    void SqliteBackend::stopAndJoin()
+    void SqliteBackend::writeSnapshotIfDue()
     {
-      assert(_backendThread.joinable());
+      if (_snapshotPath.empty())
+        return;
+
+      // The change log only holds the changes made since the last snapshot
+      if (_storage.changeCount() < _snapshotInterval)
+        return;
+
+      std::vector<std::unique_ptr<hotel::Hotel>> hotels;
+      std::vector<std::unique_ptr<hotel::Reservation>> reservations;
+      _storage.loadHotels(std::numeric_limits<size_t>::max(),
+                          [&](std::vector<std::unique_ptr<hotel::Hotel>> chunk) { hotels = std::move(chunk); });
+      _storage.loadReservations(boost::none, std::numeric_limits<size_t>::max(),
+                                [&](std::vector<std::unique_ptr<hotel::Reservation>> chunk) {
+                                  reservations = std::move(chunk);
+                                });
 
-      _quitBackendThread = true;
-      _workAvailableCondition.notify_one();
-      _backendThread.join();
+      // If writing fails, the old snapshot is dropped as well, such that the changes it lacks can still be pruned.
+      // The data is then loaded from the database until the next snapshot has been written.
+      auto latestChange = _storage.latestChange();
+      std::vector<const hotel::Hotel*> hotelPointers;
+      for (auto& hotel : hotels)
+        hotelPointers.push_back(hotel.get());
+      std::vector<const hotel::Reservation*> reservationPointers;
+      for (auto& reservation : reservations)
+        reservationPointers.push_back(reservation.get());
+      if (!snapshot::writeSnapshot(_snapshotPath, latestChange, hotelPointers, reservationPointers))
+        std::remove(_snapshotPath.c_str());
+      _storage.pruneChanges(latestChange);
     }
 
-    void SqliteBackend::threadMain(persistence::ResultIntegrator& resultIntegrator)
+    void SqliteBackend::pruneExpiredTombstones()
     {
-      while (!_quitBackendThread)
+      auto deletedBefore = std::chrono::system_clock::now() - _tombstoneRetention;
+      _storage.pruneTombstones(std::chrono::system_clock::to_time_t(deletedBefore));
+    }
+
+    void SqliteBackend::executeOperations(op::Operations& operations, op::OperationResults& results)
+    {
+      results.reserve(operations.size());
+
+      size_t i = 0;
+      while (i < operations.size())
       {
-        std::unique_lock<std::mutex> lock(_queueMutex);
-        if (_operationsQueue.empty())
+        // Long runs of store operations are handed to the storage in one go
+        auto hotelsEnd = findRunEnd<op::StoreNewHotel>(operations, i);
+        auto reservationsEnd = findRunEnd<op::StoreNewReservation>(operations, i);
+        if (hotelsEnd - i >= bulkOperationThreshold)
         {
-          _workAvailableCondition.wait(lock);
+          executeBulkOperation(collectRun<op::StoreNewHotel>(operations, i, hotelsEnd), results);
+          i = hotelsEnd;
+        }
+        else if (reservationsEnd - i >= bulkOperationThreshold)
+        {
+          executeBulkOperation(collectRun<op::StoreNewReservation>(operations, i, reservationsEnd), results);
+          i = reservationsEnd;
         }
         else
         {
-          auto operationsMessage = std::move(_operationsQueue.front());
-          _operationsQueue.pop();
-          lock.unlock();
-
-          op::OperationResults results;
-          _storage.beginTransaction();
-          for (auto& operation : operationsMessage.first)
-            results.push_back(
-                boost::apply_visitor([this](auto& op) { return this->executeOperation(op); }, operation));
-          _storage.commitTransaction();
-          operationsMessage.second->setCompleted(std::move(results));
-          _taskCompletedSignal(operationsMessage.second->uniqueId());
+          results.push_back(
+              boost::apply_visitor([this](auto& op) { return this->executeOperation(op); }, operations[i]));
+          ++i;
         }
       }
     }
 
+    void SqliteBackend::executeBulkOperation(const std::vector<op::StoreNewHotel*>& operations,
+                                             op::OperationResults& results)
+    {
+      std::vector<hotel::Hotel*> hotels;
+      for (auto operation : operations)
+        if (operation->newHotel != nullptr)
+          hotels.push_back(operation->newHotel.get());
+
+      // The objects of a run are stored together, a failure rejects all of them
+      auto stored = _storage.storeNewHotels(hotels);
+
+      for (auto operation : operations)
+      {
+        if (operation->newHotel == nullptr || !stored)
+          results.push_back(op::NoResult());
+        else
+          results.push_back(op::StoreNewHotelResult{std::move(operation->newHotel)});
+      }
+    }
+
+    void SqliteBackend::executeBulkOperation(const std::vector<op::StoreNewReservation*>& operations,
+                                             op::OperationResults& results)
+    {
+      std::vector<hotel::Reservation*> reservations;
+      for (auto operation : operations)
+      {
+        auto& reservation = operation->newReservation;
+        if (reservation == nullptr)
+          continue;
+
+        // "Unknown" is not a valid reservation status for serialization
+        if (reservation->status() == hotel::Reservation::Unknown)
+          reservation->setStatus(hotel::Reservation::New);
+        reservations.push_back(reservation.get());
+      }
+
+      auto stored = _storage.storeNewReservationsAndAtoms(reservations);
+
+      for (auto operation : operations)
+      {
+        if (operation->newReservation == nullptr || !stored)
+          results.push_back(op::NoResult());
+        else
+          results.push_back(
+              op::StoreNewReservationResult{std::move(operation->newReservation), operation->provisionalId});
+      }
+    }
+
     op::OperationResult SqliteBackend::executeOperation(op::EraseAllData&)
     {
       _storage.deleteAll();
+      if (!_snapshotPath.empty())
+        std::remove(_snapshotPath.c_str());
       return op::EraseAllDataResult();
     }
 
-    op::OperationResult SqliteBackend::executeOperation(op::LoadInitialData&)
+    op::OperationResult SqliteBackend::executeOperation(op::LoadInitialData& op)
+    {
+      // The data is streamed to the integrator while it is being read, such that the first rooms and reservations can
+      // be shown long before the whole planning has been loaded
+      publishPartialResult(op::LoadInitialDataResult());
+      if (loadInitialDataFromSnapshot(op.planningWindow))
+        return op::NoResult();
+
+      _storage.loadHotels(loadHotelsChunkSize, [this](std::vector<std::unique_ptr<hotel::Hotel>> hotels) {
+        this->publishPartialResult(op::LoadedHotelsChunk{std::move(hotels)});
+      });
+      _storage.loadReservations(op.planningWindow, loadReservationsChunkSize,
+                                [this](std::vector<std::unique_ptr<hotel::Reservation>> reservations) {
+                                  this->publishPartialResult(op::LoadedReservationsChunk{std::move(reservations)});
+                                });
+      return op::NoResult();
+    }
+
+    op::OperationResult SqliteBackend::executeOperation(op::LoadPlanningWindow& op)
     {
-      auto hotels = _storage.loadHotels();
-      auto planning = _storage.loadPlanning(hotels->allRoomIDs());
-      return op::LoadInitialDataResult{std::move(hotels), std::move(planning)};
+      return op::LoadPlanningWindowResult{op.window, _storage.loadReservations(op.window)};
     }
 
     op::OperationResult SqliteBackend::executeOperation(op::StoreNewHotel& op)
@@ -87,7 +282,8 @@ namespace persistence
       if (op.newHotel == nullptr)
         return op::NoResult();
 
-      _storage.storeNewHotel(*op.newHotel);
+      if (!_storage.storeNewHotel(*op.newHotel))
+        return op::NoResult();
       return op::StoreNewHotelResult{std::move(op.newHotel)};
     }
 
@@ -100,8 +296,9 @@ namespace persistence
       if (op.newReservation->status() == hotel::Reservation::Unknown)
         op.newReservation->setStatus(hotel::Reservation::New);
 
-      _storage.storeNewReservationAndAtoms(*op.newReservation);
-      return op::StoreNewReservationResult{std::move(op.newReservation)};
+      if (!_storage.storeNewReservationAndAtoms(*op.newReservation))
+        return op::NoResult();
+      return op::StoreNewReservationResult{std::move(op.newReservation), op.provisionalId};
     }
 
     op::OperationResult SqliteBackend::executeOperation(op::StoreNewPerson& op)
@@ -118,5 +315,11 @@ namespace persistence
       return op::DeleteReservationResult{op.reservationId};
     }
 
+    op::OperationResult SqliteBackend::executeOperation(op::LeaseIds& op)
+    {
+      auto firstId = _storage.reserveIds(idSpaceTable(op.space), op.count);
+      return op::LeaseIdsResult{op.space, static_cast<int>(firstId), firstId == 0 ? 0 : op.count};
+    }
+
   } // namespace sqlite
 } // namespace persistence
@@ -1,70 +1,73 @@
 #ifndef PERSISTENCE_SQLITE_SQLITEBACKEND_H
 #define PERSISTENCE_SQLITE_SQLITEBACKEND_H
 
+#include "persistence/backend.h"
 #include "persistence/sqlite/sqlitestorage.h"
 
-#include "persistence/op/operations.h"
-#include "persistence/op/results.h"
-#include "persistence/op/task.h"
-
-#include <boost/signals2.hpp>
-
-#include <atomic>
-#include <mutex>
-#include <condition_variable>
-#include <thread>
+#include <chrono>
 #include <string>
-#include <queue>
+#include <vector>
 
 namespace persistence
 {
-  class ResultIntegrator;
-
   namespace sqlite
   {
-    class SqliteBackend
+    /**
+     * @brief The SqliteBackend class stores the data in an sqlite database
+     * All operations of a task are executed under one transaction, and long runs of store operations are written with
+     * the bulk functions of the storage.
+     *
+     * Next to the database, the backend keeps a snapshot of all hotels and reservations (see snapshot::SnapshotReader).
+     * The initial data is loaded from the snapshot, completed with the changes made after it has been written. A new
+     * snapshot is written once the given number of changes has been made since the last one. It is written while no
+     * task is queued, such that it does not delay interactive work.
+     *
+     * The tombstones of deleted reservations, which the change feed reports (see writeChangeFeed()), are kept for the
+     * given retention period, independent of the snapshots. Readers of the feed which come by more rarely start over.
+     */
+    class SqliteBackend : public Backend
     {
     public:
-      SqliteBackend(const std::string& databasePath);
-
-      op::Task<op::OperationResults> queueOperation(op::Operations operations);
-
-      // TODO: Remove back-pointer to data source here!
-      void start(persistence::ResultIntegrator& resultIntegrator);
-      void stopAndJoin();
-
       /**
-       * @brief taskCompletedSignal returns the signal which is triggered when operations have been completed and results are available
-       * @note The signal is not called on the main thread, but on the backend worker thread
+       * @param databasePath Path of the database, the snapshot is stored under this path plus ".snapshot"
+       * @param snapshotInterval Number of changes after which a new snapshot is written, 0 disables snapshots
+       * @param tombstoneRetention Period for which the tombstones of deleted reservations are kept
        */
-      boost::signals2::signal<void(int)>& taskCompletedSignal() { return _taskCompletedSignal; }
+      SqliteBackend(const std::string& databasePath, int snapshotInterval = 1000,
+                    std::chrono::seconds tombstoneRetention = std::chrono::hours(7 * 24));
+
+    protected:
+      virtual void executeOperations(op::Operations& operations, op::OperationResults& results) override;
+      virtual void beginTransaction() override;
+      virtual bool commitTransaction() override;
+      virtual void runIdleWork() override;
+
+      virtual op::OperationResult executeOperation(op::EraseAllData&) override;
+      virtual op::OperationResult executeOperation(op::LoadInitialData& op) override;
+      virtual op::OperationResult executeOperation(op::LoadPlanningWindow& op) override;
+      virtual op::OperationResult executeOperation(op::StoreNewHotel& op) override;
+      virtual op::OperationResult executeOperation(op::StoreNewReservation& op) override;
+      virtual op::OperationResult executeOperation(op::StoreNewPerson& op) override;
+      virtual op::OperationResult executeOperation(op::DeleteReservation& op) override;
+      virtual op::OperationResult executeOperation(op::LeaseIds& op) override;
 
     private:
-      void threadMain(persistence::ResultIntegrator& dataSource);
+      void executeBulkOperation(const std::vector<op::StoreNewHotel*>& operations, op::OperationResults& results);
+      void executeBulkOperation(const std::vector<op::StoreNewReservation*>& operations, op::OperationResults& results);
 
-      op::OperationResult executeOperation(op::EraseAllData&);
-      op::OperationResult executeOperation(op::LoadInitialData&);
-      op::OperationResult executeOperation(op::StoreNewHotel& op);
-      op::OperationResult executeOperation(op::StoreNewReservation& op);
-      op::OperationResult executeOperation(op::StoreNewPerson& op);
-      op::OperationResult executeOperation(op::DeleteReservation& op);
+      //! Loads the initial data from the snapshot, returns false if there is no usable snapshot
+      bool loadInitialDataFromSnapshot(boost::optional<boost::gregorian::date_period> planningWindow);
+      void writeSnapshotIfDue();
+      void pruneExpiredTombstones();
 
       SqliteStorage _storage;
 
-      int _nextOperationId;
-
-      std::thread _backendThread;
-      std::atomic<bool> _quitBackendThread;
-      std::condition_variable _workAvailableCondition;
-
-      std::mutex _queueMutex;
-      typedef std::shared_ptr<op::TaskSharedState<op::OperationResults>> SharedState;
-      typedef std::pair<op::Operations, SharedState> QueuedOperation;
-      std::queue<QueuedOperation> _operationsQueue;
-      boost::signals2::signal<void(int)> _taskCompletedSignal;
+      std::string _snapshotPath;
+      int _snapshotInterval;
+      std::chrono::seconds _tombstoneRetention;
     };
 
   } // namespace sqlite
 } // namespace persistence
 
-#endif // PERSISTENCE_SQLITE_SQLITESTATEMENT_H
+#endif // PERSISTENCE_SQLITE_SQLITEBACKEND_H
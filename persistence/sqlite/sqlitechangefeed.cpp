@@ -0,0 +1,78 @@
+#include "persistence/sqlite/sqlitechangefeed.h"
+
+#include "persistence/json/jsonserializer.h"
+
+#include <iostream>
+
+namespace persistence
+{
+  namespace sqlite
+  {
+    boost::optional<int64_t> writeChangeFeed(SqliteStorage& storage, boost::optional<int64_t> watermark,
+                                             json::JsonWriter& writer)
+    {
+      // Within the transaction, the feed and the new watermark see the same state of the database
+      storage.beginTransaction();
+      auto latestChange = storage.latestChange();
+
+      // Deletions before the horizon are gone, the reader has to start over with the full feed
+      auto horizon = storage.changeFeedHorizon();
+      if (watermark && *watermark < horizon)
+      {
+        writer.beginObject();
+        writer.key("op");
+        writer.value(std::string("reset"));
+        writer.key("seq");
+        writer.value(horizon);
+        writer.endObject();
+        writer.endLine();
+        watermark = boost::none;
+      }
+
+      json::JsonSerializer serializer;
+      auto loaded = storage.loadReservationChangesSince(
+          watermark.value_or(-1),
+          [&](int64_t sequence, const hotel::Reservation& reservation) {
+            writer.beginObject();
+            writer.key("op");
+            writer.value(std::string("upsert"));
+            writer.key("reservation");
+            serializer.serializeReservation(reservation, writer);
+            writer.key("seq");
+            writer.value(sequence);
+            writer.endObject();
+            writer.endLine();
+          },
+          [&](int64_t sequence, int reservationId) {
+            // A full feed only holds the existing reservations
+            if (!watermark)
+              return;
+            writer.beginObject();
+            writer.key("id");
+            writer.value(reservationId);
+            writer.key("op");
+            writer.value(std::string("delete"));
+            writer.key("seq");
+            writer.value(sequence);
+            writer.endObject();
+            writer.endLine();
+          });
+
+      // The transaction only reads, committing it merely ends it
+      storage.commitTransaction();
+      writer.flush();
+      if (!loaded)
+      {
+        std::cerr << "Cannot read the changes of the reservations" << std::endl;
+        return boost::none;
+      }
+      if (!writer.good())
+      {
+        std::cerr << "Cannot write the change feed" << std::endl;
+        return boost::none;
+      }
+      return latestChange;
+    }
+
+  } // namespace sqlite
+} // namespace persistence
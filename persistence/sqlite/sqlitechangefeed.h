@@ -0,0 +1,38 @@
+#ifndef PERSISTENCE_SQLITE_SQLITECHANGEFEED_H
+#define PERSISTENCE_SQLITE_SQLITECHANGEFEED_H
+
+#include "persistence/json/jsonwriter.h"
+#include "persistence/sqlite/sqlitestorage.h"
+
+#include <boost/optional.hpp>
+
+#include <cstdint>
+
+namespace persistence
+{
+  namespace sqlite
+  {
+    /**
+     * @brief writeChangeFeed writes the reservations changed after the given watermark as NDJSON, one change per line
+     *
+     * Stored reservations are written as {"op":"upsert","reservation":{...},"seq":N}, with the reservation as written
+     * by json::JsonSerializer, deleted ones as {"id":N,"op":"delete","seq":N}. The lines are ordered by seq. Without a
+     * watermark, all reservations are written, without the deleted ones.
+     *
+     * The tombstones of deleted reservations are kept for the retention period of the backend (see SqliteBackend),
+     * and erasing all data drops them. If the watermark is older than that, the feed starts with
+     * {"op":"reset","seq":N}, the reader drops all reservations it knows, and continues with all existing reservations.
+     *
+     * The changes are read within one transaction, thus call it on a storage which is not within a transaction, e.g.
+     * on one opened for the export.
+     *
+     * @return The watermark to pass for the next feed, it covers all changes written. None if reading the changes or
+     *         writing the feed has failed, the next feed has to start from the same watermark then.
+     */
+    boost::optional<int64_t> writeChangeFeed(SqliteStorage& storage, boost::optional<int64_t> watermark,
+                                             json::JsonWriter& writer);
+
+  } // namespace sqlite
+} // namespace persistence
+
+#endif // PERSISTENCE_SQLITE_SQLITECHANGEFEED_H
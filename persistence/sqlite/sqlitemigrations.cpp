@@ -0,0 +1,234 @@
+#include "persistence/sqlite/sqlitemigrations.h"
+
+#include "persistence/sqlite/sqlitestatement.h"
+
+#include <iostream>
+
+namespace persistence
+{
+  namespace sqlite
+  {
+
+    namespace
+    {
+      bool executeMigrationSQL(sqlite3* db, const std::string& sql)
+      {
+        char* errorMessage = nullptr;
+        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errorMessage) != SQLITE_OK)
+        {
+          std::cerr << "Cannot execute query: " << sql << ": " << (errorMessage ? errorMessage : "") << std::endl;
+          sqlite3_free(errorMessage);
+          return false;
+        }
+        return true;
+      }
+
+      std::vector<SqliteMigration> makeSchemaMigrations()
+      {
+        std::vector<SqliteMigration> migrations;
+
+        // Databases created before schema versioning already contain these tables, hence the IF NOT EXISTS.
+        migrations.push_back({1, "Initial schema",
+                              {"CREATE TABLE IF NOT EXISTS h_hotel ("
+                               "id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
+                               "name TEXT NOT NULL);",
+                               "CREATE TABLE IF NOT EXISTS h_room_category ("
+                               "id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
+                               "hotel_id INTEGER NOT NULL," // Foreign key
+                               "short_code TEXT NOT NULL,"
+                               "name TEXT NOT NULL);",
+                               "CREATE TABLE IF NOT EXISTS h_room ("
+                               "id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
+                               "hotel_id INTEGER NOT NULL,"    // Foreign key
+                               "category_id INTEGER NOT NULL," // Foreign key
+                               "name TEXT NOT NULL);",
+                               "CREATE TABLE IF NOT EXISTS h_reservation ("
+                               "id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
+                               "description TEXT NOT NULL, "
+                               "status TEXT NOT NULL,"
+                               "adults INTEGER NOT NULL,"
+                               "children INTEGER NOT NULL);",
+                               "CREATE TABLE IF NOT EXISTS h_reservation_atom ("
+                               "id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
+                               "reservation_id INTEGER NOT NULL," // Foreign key
+                               "room_id INTEGER NOT NULL,"        // Foreign key
+                               "date_from TEXT NOT NULL,"
+                               "date_to TEXT NOT NULL);"}});
+
+        // The atoms index also holds the remaining atom columns, such that loading the planning (join on
+        // reservation_id, ordered by date_from) never has to touch the table itself.
+        migrations.push_back({2, "Indices for planning, room and hotel lookups",
+                              {"CREATE INDEX IF NOT EXISTS h_reservation_atom_reservation_idx "
+                               "ON h_reservation_atom (reservation_id, date_from, room_id, date_to);",
+                               "CREATE INDEX IF NOT EXISTS h_reservation_atom_room_idx "
+                               "ON h_reservation_atom (room_id, date_from, date_to);",
+                               "CREATE INDEX IF NOT EXISTS h_room_hotel_idx ON h_room (hotel_id);",
+                               "CREATE INDEX IF NOT EXISTS h_room_category_hotel_idx ON h_room_category (hotel_id);"}});
+
+        // Dates are stored as day numbers (julian day number, as used by boost::gregorian) and the reservation status
+        // as an integer code, which avoids parsing strings when loading. SQLite cannot change column types in place,
+        // hence the tables are rebuilt. The sqlite_sequence entries are carried over, such that ids of deleted rows
+        // are never reused.
+        auto toDayNumber = [](const std::string& column) {
+          return "CAST(julianday(substr(" + column + ", 1, 4) || '-' || substr(" + column + ", 5, 2) || '-' || substr(" +
+                 column + ", 7, 2)) + 0.5 AS INTEGER)";
+        };
+        auto carryOverSequence = [](const std::string& table) {
+          return "INSERT INTO sqlite_sequence (name, seq) SELECT '" + table + "_new', seq FROM sqlite_sequence "
+                 "WHERE name = '" + table + "' AND seq > COALESCE((SELECT MAX(id) FROM " + table + "_new), 0);";
+        };
+        migrations.push_back({3, "Integer day numbers and status codes",
+                              {"CREATE TABLE h_reservation_new ("
+                               "id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
+                               "description TEXT NOT NULL, "
+                               "status INTEGER NOT NULL,"
+                               "adults INTEGER NOT NULL,"
+                               "children INTEGER NOT NULL);",
+                               "INSERT INTO h_reservation_new (id, description, status, adults, children) "
+                               "SELECT id, description, CASE status WHEN 'new' THEN 1 WHEN 'confirmed' THEN 2 "
+                               "WHEN 'checked-in' THEN 3 WHEN 'checked-out' THEN 4 WHEN 'archived' THEN 5 ELSE 0 END, "
+                               "adults, children FROM h_reservation;",
+                               "DELETE FROM sqlite_sequence WHERE name = 'h_reservation_new';",
+                               carryOverSequence("h_reservation"),
+                               "DROP TABLE h_reservation;",
+                               "ALTER TABLE h_reservation_new RENAME TO h_reservation;",
+
+                               "CREATE TABLE h_reservation_atom_new ("
+                               "id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
+                               "reservation_id INTEGER NOT NULL," // Foreign key
+                               "room_id INTEGER NOT NULL,"        // Foreign key
+                               "date_from INTEGER NOT NULL,"
+                               "date_to INTEGER NOT NULL);",
+                               "INSERT INTO h_reservation_atom_new (id, reservation_id, room_id, date_from, date_to) "
+                               "SELECT id, reservation_id, room_id, " + toDayNumber("date_from") + ", " +
+                                   toDayNumber("date_to") + " FROM h_reservation_atom;",
+                               "DELETE FROM sqlite_sequence WHERE name = 'h_reservation_atom_new';",
+                               carryOverSequence("h_reservation_atom"),
+                               "DROP TABLE h_reservation_atom;",
+                               "ALTER TABLE h_reservation_atom_new RENAME TO h_reservation_atom;",
+                               "CREATE INDEX h_reservation_atom_reservation_idx "
+                               "ON h_reservation_atom (reservation_id, date_from, room_id, date_to);",
+                               "CREATE INDEX h_reservation_atom_room_idx "
+                               "ON h_reservation_atom (room_id, date_from, date_to);"}});
+
+        // The change log records which objects have been stored or deleted, such that a snapshot of the data only
+        // needs to be completed with the changes made after it has been written. Triggers keep it complete, whichever
+        // way the rows are written. The kinds of changes are part of the database format, see ChangeKind.
+        migrations.push_back({4, "Change log",
+                              {"CREATE TABLE h_change_log ("
+                               "seq INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
+                               "kind INTEGER NOT NULL,"
+                               "object_id INTEGER NOT NULL);",
+                               "CREATE TRIGGER h_hotel_insert_log AFTER INSERT ON h_hotel BEGIN "
+                               "INSERT INTO h_change_log (kind, object_id) VALUES (1, NEW.id); END;",
+                               "CREATE TRIGGER h_reservation_insert_log AFTER INSERT ON h_reservation BEGIN "
+                               "INSERT INTO h_change_log (kind, object_id) VALUES (2, NEW.id); END;",
+                               "CREATE TRIGGER h_reservation_delete_log AFTER DELETE ON h_reservation BEGIN "
+                               "INSERT INTO h_change_log (kind, object_id) VALUES (3, OLD.id); END;"}});
+
+        // Unlike the change log, which is pruned once a snapshot has been written, the change sequence of the
+        // reservations and the tombstones of the deleted ones are kept for the change feed (see writeChangeFeed()).
+        // Atoms are neither changed nor deleted on their own, the sequence of their reservation covers them. Existing
+        // reservations count as changed at the latest position of the change log.
+        //
+        // Writers set change_seq to the next position of the change log when inserting a reservation, the trigger
+        // logs the reservation at that position instead of updating the row again. Ids are never handed out twice,
+        // thus an inserted reservation has no tombstone to remove. Rows inserted without a sequence are still logged.
+        //
+        // The tombstones are kept for a period of time, independent of the pruning of the change log, such that
+        // readers of the change feed which come by at regular intervals still see the deletions (see
+        // SqliteStorage::pruneTombstones()). The feed horizon holds the position up to which the tombstones are gone.
+        // SqliteStorage::deleteAll() drops the tombstones, but keeps the horizon, hence the IF NOT EXISTS.
+        migrations.push_back(
+            {5, "Change sequence, tombstones and feed horizon",
+             {"ALTER TABLE h_reservation ADD COLUMN change_seq INTEGER NOT NULL DEFAULT 0;",
+              "UPDATE h_reservation SET change_seq = "
+              "COALESCE((SELECT seq FROM sqlite_sequence WHERE name = 'h_change_log'), 0);",
+              "CREATE INDEX h_reservation_change_idx ON h_reservation (change_seq);",
+              "CREATE TABLE IF NOT EXISTS h_reservation_tombstone ("
+              "reservation_id INTEGER NOT NULL PRIMARY KEY, "
+              "change_seq INTEGER NOT NULL, "
+              "deleted_at INTEGER NOT NULL);",
+              "CREATE INDEX IF NOT EXISTS h_reservation_tombstone_change_idx "
+              "ON h_reservation_tombstone (change_seq);",
+              "CREATE INDEX IF NOT EXISTS h_reservation_tombstone_deleted_idx "
+              "ON h_reservation_tombstone (deleted_at);",
+              "DROP TRIGGER h_reservation_insert_log;",
+              "CREATE TRIGGER h_reservation_insert_log AFTER INSERT ON h_reservation BEGIN "
+              "INSERT INTO h_change_log (seq, kind, object_id) VALUES (NULLIF(NEW.change_seq, 0), 2, NEW.id); END;",
+              "DROP TRIGGER h_reservation_delete_log;",
+              "CREATE TRIGGER h_reservation_delete_log AFTER DELETE ON h_reservation BEGIN "
+              "INSERT INTO h_change_log (kind, object_id) VALUES (3, OLD.id); "
+              "INSERT OR REPLACE INTO h_reservation_tombstone (reservation_id, change_seq, deleted_at) "
+              "VALUES (OLD.id, last_insert_rowid(), CAST(strftime('%s', 'now') AS INTEGER)); END;",
+              "CREATE TABLE IF NOT EXISTS h_change_feed_horizon (seq INTEGER NOT NULL);",
+              "INSERT INTO h_change_feed_horizon (seq) "
+              "SELECT 0 WHERE NOT EXISTS (SELECT * FROM h_change_feed_horizon);"}});
+
+        return migrations;
+      }
+    } // namespace
+
+    const std::vector<SqliteMigration>& schemaMigrations()
+    {
+      static const std::vector<SqliteMigration> migrations = makeSchemaMigrations();
+      return migrations;
+    }
+
+    int latestSchemaVersion() { return schemaMigrations().back().version; }
+
+    int schemaVersion(sqlite3* db)
+    {
+      int version = 0;
+      SqliteStatement versionQuery(db, "SELECT COALESCE(MAX(version), 0) FROM h_schema_version;");
+      versionQuery.execute();
+      if (versionQuery.hasResultRow())
+        versionQuery.readRow(version);
+      return version;
+    }
+
+    bool migrateSchema(sqlite3* db)
+    {
+      if (!executeMigrationSQL(db, "CREATE TABLE IF NOT EXISTS h_schema_version ("
+                                   "version INTEGER NOT NULL PRIMARY KEY, "
+                                   "description TEXT NOT NULL, "
+                                   "applied_at TEXT NOT NULL);"))
+        return false;
+
+      auto currentVersion = schemaVersion(db);
+      if (currentVersion > latestSchemaVersion())
+      {
+        std::cerr << "Database schema version " << currentVersion << " is newer than the supported version "
+                  << latestSchemaVersion() << std::endl;
+        return false;
+      }
+
+      for (auto& migration : schemaMigrations())
+      {
+        if (migration.version <= currentVersion)
+          continue;
+
+        // Savepoints also work when the caller already holds an open transaction (e.g. when erasing all data)
+        bool success = executeMigrationSQL(db, "SAVEPOINT migration;");
+        for (auto& statement : migration.statements)
+          success = success && executeMigrationSQL(db, statement);
+        success = success && SqliteStatement(db, "INSERT INTO h_schema_version (version, description, applied_at) "
+                                                 "VALUES (?, ?, datetime('now'));")
+                                 .execute(migration.version, migration.description);
+
+        if (!success)
+        {
+          std::cerr << "Migration to schema version " << migration.version << " failed" << std::endl;
+          executeMigrationSQL(db, "ROLLBACK TO SAVEPOINT migration;");
+          executeMigrationSQL(db, "RELEASE SAVEPOINT migration;");
+          return false;
+        }
+        executeMigrationSQL(db, "RELEASE SAVEPOINT migration;");
+        currentVersion = migration.version;
+      }
+
+      return true;
+    }
+
+  } // namespace sqlite
+} // namespace persistence
@@ -0,0 +1,50 @@
+#ifndef PERSISTENCE_SQLITE_SQLITEMIGRATIONS_H
+#define PERSISTENCE_SQLITE_SQLITEMIGRATIONS_H
+
+#include <sqlite3.h>
+
+#include <string>
+#include <vector>
+
+namespace persistence
+{
+  namespace sqlite
+  {
+
+    /**
+     * @brief The SqliteMigration struct describes one step in the evolution of the database schema
+     *
+     * A migration upgrades the schema from version - 1 to version. Its statements are executed in order, within one
+     * savepoint.
+     */
+    struct SqliteMigration
+    {
+      int version;
+      std::string description;
+      std::vector<std::string> statements;
+    };
+
+    //! Returns the ordered list of all known schema migrations
+    const std::vector<SqliteMigration>& schemaMigrations();
+
+    //! Returns the schema version the current code expects
+    int latestSchemaVersion();
+
+    //! Returns the schema version of the given database, 0 for a database predating schema versioning.
+    int schemaVersion(sqlite3* db);
+
+    /**
+     * @brief migrateSchema brings the schema of the given database up to date
+     *
+     * All migrations with a version newer than the current schema version are applied in order. Each migration is
+     * recorded in the h_schema_version table. If a migration fails, it is rolled back and no further migrations are
+     * applied.
+     *
+     * @return true if the database is at the latest schema version
+     */
+    bool migrateSchema(sqlite3* db);
+
+  } // namespace sqlite
+} // namespace persistence
+
+#endif // PERSISTENCE_SQLITE_SQLITEMIGRATIONS_H
@@ -0,0 +1,97 @@
+#ifndef PERSISTENCE_SQLITE_SQLITEQUERIES_H
+#define PERSISTENCE_SQLITE_SQLITEQUERIES_H
+
+#include <boost/date_time.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+
+namespace persistence
+{
+  namespace sqlite
+  {
+
+    /**
+     * @brief Identifiers of the prepared statements held by SqliteStorage
+     *
+     * The identifiers index a flat array of prepared statements, see SqliteStorage::query().
+     */
+    enum class QueryId
+    {
+      HotelInsert,
+      HotelAll,
+      HotelById,
+      RoomCategoryInsert,
+      RoomCategoryByHotelId,
+      RoomInsert,
+      RoomByHotelId,
+
+      ReservationAndAtomsAll,
+      ReservationAndAtomsInPeriod,
+      ReservationAndAtomsById,
+      ReservationInsert,
+      ReservationDelete,
+      ReservationAtomInsert,
+      ReservationAtomDeleteByReservationId,
+
+      // Multi-row inserts used by the bulk store functions
+      HotelInsertBulk,
+      RoomCategoryInsertBulk,
+      RoomInsertBulk,
+      ReservationInsertBulk,
+      ReservationAtomInsertBulk,
+
+      // Change log, see SqliteStorage::loadChangesSince()
+      ChangeLogLatest,
+      ChangeLogCount,
+      ChangeLogSince,
+      ChangeLogPrune,
+
+      // Change feed, see writeChangeFeed()
+      ReservationChangesSince,
+      ReservationTombstonesSince,
+      ReservationTombstoneExpired,
+      ReservationTombstonePrune,
+      ChangeFeedHorizon,
+      ChangeFeedHorizonRaise,
+
+      Count
+    };
+
+    constexpr size_t queryCount = static_cast<size_t>(QueryId::Count);
+
+    /**
+     * @brief QueryRow defines the type of the result rows of a query at compile time
+     *
+     * Text columns are read as boost::string_ref, pointing into the buffers of sqlite. They are only valid until the
+     * statement advances to the next row.
+     */
+    template <QueryId Id> struct QueryRow { typedef std::tuple<> type; };
+
+    // clang-format off
+    template <> struct QueryRow<QueryId::HotelAll> { typedef std::tuple<int, boost::string_ref> type; };
+    template <> struct QueryRow<QueryId::HotelById> { typedef std::tuple<int, boost::string_ref> type; };
+    template <> struct QueryRow<QueryId::RoomCategoryByHotelId> { typedef std::tuple<int, boost::string_ref, boost::string_ref> type; };
+    template <> struct QueryRow<QueryId::RoomByHotelId> { typedef std::tuple<int, int, boost::string_ref> type; };
+
+    typedef std::tuple<int, boost::string_ref, int, int, int, int, int, boost::gregorian::date, boost::gregorian::date>
+        ReservationAndAtomRow;
+    template <> struct QueryRow<QueryId::ReservationAndAtomsAll> { typedef ReservationAndAtomRow type; };
+    template <> struct QueryRow<QueryId::ReservationAndAtomsInPeriod> { typedef ReservationAndAtomRow type; };
+    template <> struct QueryRow<QueryId::ReservationAndAtomsById> { typedef ReservationAndAtomRow type; };
+
+    template <> struct QueryRow<QueryId::ChangeLogLatest> { typedef std::tuple<int64_t> type; };
+    template <> struct QueryRow<QueryId::ChangeLogCount> { typedef std::tuple<int64_t> type; };
+    template <> struct QueryRow<QueryId::ChangeLogSince> { typedef std::tuple<int64_t, int, int> type; };
+    template <> struct QueryRow<QueryId::ReservationChangesSince> { typedef std::tuple<int64_t, int> type; };
+    template <> struct QueryRow<QueryId::ReservationTombstonesSince> { typedef std::tuple<int64_t, int> type; };
+    template <> struct QueryRow<QueryId::ReservationTombstoneExpired> { typedef std::tuple<int64_t> type; };
+    template <> struct QueryRow<QueryId::ChangeFeedHorizon> { typedef std::tuple<int64_t> type; };
+    // clang-format on
+
+  } // namespace sqlite
+} // namespace persistence
+
+#endif // PERSISTENCE_SQLITE_SQLITEQUERIES_H
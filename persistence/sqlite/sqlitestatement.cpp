@@ -5,14 +5,19 @@ namespace persistence
   namespace sqlite
   {
 
-    SqliteStatement::SqliteStatement(sqlite3* db, const std::string& query)
+    SqliteStatement::SqliteStatement() : _statement(nullptr) {}
+
+    SqliteStatement::SqliteStatement(sqlite3* db, const std::string& query) : _statement(nullptr)
     {
       sqlite3_prepare_v2(db, query.c_str(), -1, &_statement, nullptr);
       if (_statement == nullptr)
         std::cerr << "Cannot create prepared statement for query: " << query << ": " << std::endl;
+      else
+        _bindStatic = sqlite3_stmt_readonly(_statement) == 0;
     }
 
-    SqliteStatement::SqliteStatement(SqliteStatement&& that) : _statement(that._statement)
+    SqliteStatement::SqliteStatement(SqliteStatement&& that)
+        : _lastResult(that._lastResult), _statement(that._statement), _bindStatic(that._bindStatic)
     {
       that._statement = nullptr;
     }
@@ -21,7 +26,9 @@ namespace persistence
     {
       if (_statement)
         sqlite3_finalize(_statement);
+      _lastResult = that._lastResult;
       _statement = that._statement;
+      _bindStatic = that._bindStatic;
       that._statement = nullptr;
       return *this;
     }
@@ -40,33 +47,47 @@ namespace persistence
         return false;
       }
 
-      if (_lastResult == SQLITE_DONE)
-        _lastResult = sqlite3_reset(_statement);
-
+      // The statement is reset after any previous execution, also a failed one or one whose rows have not all been read.
+      // sqlite3_reset() repeats the error of the failed step, which has already been reported.
       if (_lastResult != SQLITE_OK)
       {
-        std::cerr << "Should not query statement, which is in " << _lastResult << " state" << std::endl;
-        return false;
+        sqlite3_reset(_statement);
+        _lastResult = SQLITE_OK;
       }
-
       return true;
     }
 
+    bool SqliteStatement::step()
+    {
+      _lastResult = sqlite3_step(_statement);
+      if (_lastResult == SQLITE_DONE || _lastResult == SQLITE_ROW)
+        return true;
+
+      std::cerr << "Cannot execute statement: " << sqlite3_errmsg(sqlite3_db_handle(_statement)) << std::endl;
+      return false;
+    }
+
     void SqliteStatement::bindArgument(int pos, const char* text)
     {
-      sqlite3_bind_text(_statement, pos, text, -1, SQLITE_TRANSIENT);
+      sqlite3_bind_text(_statement, pos, text, -1, textDestructor());
     }
 
     void SqliteStatement::bindArgument(int pos, const std::string& text)
     {
-      sqlite3_bind_text(_statement, pos, text.c_str(), static_cast<int>(text.size()), SQLITE_TRANSIENT);
+      sqlite3_bind_text(_statement, pos, text.c_str(), static_cast<int>(text.size()), textDestructor());
+    }
+
+    void SqliteStatement::bindArgument(int pos, boost::string_ref text)
+    {
+      sqlite3_bind_text(_statement, pos, text.data(), static_cast<int>(text.size()), textDestructor());
     }
 
     void SqliteStatement::bindArgument(int pos, int64_t value) { sqlite3_bind_int64(_statement, pos, value); }
 
     void SqliteStatement::bindArgument(int pos, boost::gregorian::date date)
     {
-      bindArgument(pos, boost::gregorian::to_iso_string(date));
+      // Dates are stored as day numbers
+      sqlite3_bind_int64(_statement, pos, date.day_number());
     }
 
     void SqliteStatement::readArg(int pos, std::string& val)
@@ -76,13 +97,22 @@ namespace persistence
         val = text;
     }
 
+    void SqliteStatement::readArg(int pos, boost::string_ref& val)
+    {
+      // Note: sqlite3_column_bytes has to be called after sqlite3_column_text, for the size to match the text
+      auto text = reinterpret_cast<const char*>(sqlite3_column_text(_statement, pos));
+      auto size = sqlite3_column_bytes(_statement, pos);
+      val = text != nullptr ? boost::string_ref(text, static_cast<size_t>(size)) : boost::string_ref();
+    }
+
     void SqliteStatement::readArg(int pos, int& val) { val = sqlite3_column_int(_statement, pos); }
 
+    void SqliteStatement::readArg(int pos, int64_t& val) { val = sqlite3_column_int64(_statement, pos); }
+
     void SqliteStatement::readArg(int pos, boost::gregorian::date& date)
     {
-      std::string val;
-      readArg(pos, val);
-      date = boost::gregorian::from_undelimited_string(val);
+      using namespace boost::gregorian;
+      date = boost::gregorian::date(gregorian_calendar::from_day_number(sqlite3_column_int(_statement, pos)));
     }
 
   } // namespace sqlite
@@ -2,9 +2,13 @@
 #define PERSISTENCE_SQLITE_SQLITESTATEMENT_H
 
 #include <boost/date_time.hpp>
+#include <boost/utility/string_ref.hpp>
 #include <sqlite3.h>
 
+#include <initializer_list>
 #include <string>
+#include <tuple>
+#include <utility>
 
 namespace persistence
 {
@@ -19,6 +23,8 @@ namespace persistence
     class SqliteStatement
     {
     public:
+      //! Creates an empty statement, which cannot be executed
+      SqliteStatement();
       SqliteStatement(sqlite3* db, const std::string& query);
       SqliteStatement(SqliteStatement&& that);
       SqliteStatement& operator=(SqliteStatement&& that);
@@ -28,22 +34,41 @@ namespace persistence
 
       /**
        * @brief Executes the SQL statements with the given parameters
-       * The parameters are sequentially bound to the prepared statement.
+       * The parameters are sequentially bound to the prepared statement. For statements writing to the database, text
+       * parameters are bound without copying them, which is safe because the arguments outlive the statement step.
+       * @return false if the statement failed, e.g. because of a violated constraint. The error is reported.
        */
-      template <typename... Args> bool execute(Args... args)
+      template <typename... Args> bool execute(const Args&... args)
       {
         if (!prepareForQuery())
           return false;
         bindArguments(args...);
-        _lastResult = sqlite3_step(_statement);
-        return true;
+        return step();
       }
       bool execute()
       {
         if (!prepareForQuery())
           return false;
-        _lastResult = sqlite3_step(_statement);
-        return true;
+        return step();
+      }
+
+      /**
+       * @brief Executes a statement with multiple value rows, e.g. a multi-row INSERT
+       * The fields of each tuple in [begin, end) are bound one after the other, starting at the first parameter. The
+       * statement must have been prepared with exactly (end - begin) * sizeof...(Args) parameters.
+       */
+      template <typename Iterator> bool executeRows(Iterator begin, Iterator end)
+      {
+        if (!prepareForQuery())
+          return false;
+        int pos = 1;
+        for (auto it = begin; it != end; ++it)
+        {
+          using Row = typename std::decay<decltype(*it)>::type;
+          bindTuple(pos, *it, std::make_index_sequence<std::tuple_size<Row>::value>());
+          pos += static_cast<int>(std::tuple_size<Row>::value);
+        }
+        return step();
       }
 
       /**
@@ -58,17 +83,39 @@ namespace persistence
         _lastResult = sqlite3_step(_statement);
       }
 
+      /**
+       * @brief Reads the current result row into a tuple, without advancing to the next row
+       * Text columns may be read as boost::string_ref, which remain valid until nextRow() is called.
+       */
+      template <typename Row> Row currentRow()
+      {
+        Row row;
+        readTuple(row, std::make_index_sequence<std::tuple_size<Row>::value>());
+        return row;
+      }
+      void nextRow() { _lastResult = sqlite3_step(_statement); }
+      //! Returns true if the last step has failed, e.g. while reading the result rows
+      bool failed() const
+      {
+        return _lastResult != SQLITE_OK && _lastResult != SQLITE_ROW && _lastResult != SQLITE_DONE;
+      }
+
     private:
       // Prepares the statement to be queried again and checks some simple preconditions
       bool prepareForQuery();
+      // Executes the statement up to its first result row, returns false and reports the error if it fails
+      bool step();
 
       void bindArgument(int pos, const char* text);
       void bindArgument(int pos, const std::string& text);
+      void bindArgument(int pos, boost::string_ref text);
       void bindArgument(int pos, int64_t value);
       void bindArgument(int pos, boost::gregorian::date date);
 
       void readArg(int pos, std::string& val);
       void readArg(int pos, int& val);
+      void readArg(int pos, int64_t& val);
+      void readArg(int pos, boost::string_ref& val);
       void readArg(int pos, boost::gregorian::date& date);
 
       template <int Pos> void readRowInternal() {}
@@ -79,14 +126,65 @@ namespace persistence
       }
 
       template <int Pos> void bindArguments() {}
-      template <int Pos = 1, typename T, typename... Args> void bindArguments(T val, Args... others)
+      template <int Pos = 1, typename T, typename... Args> void bindArguments(const T& val, const Args&... others)
       {
         bindArgument(Pos, val);
         bindArguments<Pos + 1, Args...>(others...);
       }
 
+      template <typename Tuple, size_t... I> void bindTuple(int firstPos, const Tuple& row, std::index_sequence<I...>)
+      {
+        (void)std::initializer_list<int>{(bindArgument(firstPos + static_cast<int>(I), std::get<I>(row)), 0)...};
+      }
+
+      template <typename Tuple, size_t... I> void readTuple(Tuple& row, std::index_sequence<I...>)
+      {
+        (void)std::initializer_list<int>{(readArg(static_cast<int>(I), std::get<I>(row)), 0)...};
+      }
+
+      // Destructor to use when binding text: SQLITE_STATIC if the bound values are guaranteed to outlive their use.
+      sqlite3_destructor_type textDestructor() const { return _bindStatic ? SQLITE_STATIC : SQLITE_TRANSIENT; }
+
       int _lastResult = SQLITE_OK;
       sqlite3_stmt* _statement;
+
+      // Read-only statements may be stepped long after execute() returned, hence their bound text has to be copied.
+      bool _bindStatic = false;
+    };
+
+    /**
+     * @brief The TypedSqliteStatement class is a view on a SqliteStatement with a result row type fixed at compile time
+     *
+     * Usage:
+     *   query.execute(args...);
+     *   while (query.hasResultRow())
+     *   {
+     *     auto row = query.row();
+     *     // ...
+     *     query.next();
+     *   }
+     */
+    template <typename RowT> class TypedSqliteStatement
+    {
+    public:
+      typedef RowT Row;
+
+      explicit TypedSqliteStatement(SqliteStatement& statement) : _statement(statement) {}
+
+      template <typename... Args> bool execute(const Args&... args) { return _statement.execute(args...); }
+      template <typename Iterator> bool executeRows(Iterator begin, Iterator end)
+      {
+        return _statement.executeRows(begin, end);
+      }
+
+      bool hasResultRow() { return _statement.hasResultRow(); }
+      //! Returns the current result row. Text columns are only valid until next() is called.
+      Row row() { return _statement.template currentRow<Row>(); }
+      void next() { _statement.nextRow(); }
+      bool failed() const { return _statement.failed(); }
+
+    private:
+      SqliteStatement& _statement;
     };
 
   } // namespace sqlite
@@ -1,6 +1,9 @@
 #include "persistence/sqlite/sqlitestorage.h"
 
+#include "persistence/sqlite/sqlitemigrations.h"
+
 #include <iostream>
+#include <limits>
 
 namespace persistence
 {
@@ -9,55 +12,86 @@ namespace persistence
 
     namespace
     {
+      // Number of value rows written by one multi-row INSERT statement. This keeps the number of bound parameters
+      // well below SQLITE_MAX_VARIABLE_NUMBER for all of our tables.
+      const size_t bulkInsertRowCount = 100;
+
+      const char* hotelBulkColumns = "id, name";
+      const char* roomCategoryBulkColumns = "id, hotel_id, short_code, name";
+      const char* roomBulkColumns = "id, hotel_id, category_id, name";
+      const char* reservationBulkColumns = "id, description, status, adults, children, change_seq";
+      const char* reservationAtomBulkColumns = "id, reservation_id, room_id, date_from, date_to";
+
+      std::string makeMultiRowInsert(const std::string& table, const std::string& columns, size_t columnCount,
+                                     size_t rowCount)
+      {
+        std::string row = "(";
+        for (size_t i = 0; i < columnCount; ++i)
+          row += (i == 0) ? "?" : ", ?";
+        row += ")";
+
+        std::string sql = "INSERT INTO " + table + " (" + columns + ") VALUES ";
+        for (size_t i = 0; i < rowCount; ++i)
+          sql += (i == 0) ? row : ", " + row;
+        return sql + ";";
+      }
+
       void executeSQL(sqlite3* db, const std::string& sql)
       {
         if (!SqliteStatement(db, sql).execute())
           std::cerr << "Cannot execute query: " << sql;
       }
 
-      std::string serializeReservationStatus(hotel::Reservation::ReservationStatus status)
+      // New objects are inserted under a savepoint, such that a failed insert leaves no partial objects behind while
+      // the enclosing transaction goes on
+      void beginStoreSavepoint(sqlite3* db) { executeSQL(db, "SAVEPOINT store_new_objects;"); }
+
+      bool endStoreSavepoint(sqlite3* db, bool stored)
+      {
+        if (!stored)
+          executeSQL(db, "ROLLBACK TO store_new_objects;");
+        executeSQL(db, "RELEASE store_new_objects;");
+        return stored;
+      }
+
+      // Reservation statuses are stored as integer codes. The codes are part of the database format, and must not
+      // change, even if the ReservationStatus enum does.
+      int64_t serializeReservationStatus(hotel::Reservation::ReservationStatus status)
       {
         using Status = hotel::Reservation::ReservationStatus;
 
         switch (status)
         {
         case Status::Unknown:
-          return "unknown";
+          return 0;
         case Status::New:
-          return "new";
+          return 1;
         case Status::Confirmed:
-          return "confirmed";
+          return 2;
         case Status::CheckedIn:
-          return "checked-in";
+          return 3;
         case Status::CheckedOut:
-          return "checked-out";
+          return 4;
         case Status::Archived:
-          return "archived";
+          return 5;
         default:
           std::cerr << "Unknown reservation status: " << status;
           assert(false);
-          return "unknown";
+          return 0;
         };
       }
 
-      hotel::Reservation::ReservationStatus parseReservationStatus(const std::string& str) {
+      hotel::Reservation::ReservationStatus parseReservationStatus(int code)
+      {
         using Status = hotel::Reservation::ReservationStatus;
+        static const Status statuses[] = {Status::Unknown,   Status::New,        Status::Confirmed,
+                                          Status::CheckedIn, Status::CheckedOut, Status::Archived};
 
-        if (str == "unknown")
-          return Status::Unknown;
-        if (str == "new")
-          return Status::New;
-        if (str == "confirmed")
-          return Status::Confirmed;
-        if (str == "checked-in")
-          return Status::CheckedIn;
-        if (str == "checked-out")
-          return Status::CheckedOut;
-        if (str == "archived")
-          return Status::Archived;
+        if (code >= 0 && code < static_cast<int>(sizeof(statuses) / sizeof(statuses[0])))
+          return statuses[code];
 
         assert(false);
-        std::cerr << "Unknown reservation status: " << str;
+        std::cerr << "Unknown reservation status: " << code;
         return Status::Unknown;
       }
     }
@@ -71,9 +105,11 @@ namespace persistence
         _db = nullptr;
       }
 
+      // Create the schema, or upgrade the schema of an existing database in place
       if (_db != nullptr)
       {
-        createSchema();
+        if (!migrateSchema(_db))
+          std::cerr << "Cannot migrate the schema of sqlite database: " << file << std::endl;
         prepareQueries();
       }
     }
@@ -85,76 +121,123 @@ namespace persistence
       if (_db == nullptr)
         return;
 
-      _statements.clear();
+      // The sequences survive, such that ids which the client has leased before are never handed out twice
+      std::vector<std::tuple<std::string, int64_t>> sequences;
+      SqliteStatement sequencesQuery(_db, "SELECT name, seq FROM sqlite_sequence;");
+      sequencesQuery.execute();
+      while (sequencesQuery.hasResultRow())
+      {
+        std::string name;
+        int64_t seq;
+        sequencesQuery.readRow(name, seq);
+        // Erasing takes a position of the change log, which is after all watermarks of the change feed handed out
+        if (name == "h_change_log")
+          ++seq;
+        sequences.emplace_back(name, seq);
+      }
+
+      for (auto& statement : _statements)
+        statement = SqliteStatement();
       executeSQL(_db, "DROP TABLE IF EXISTS h_reservation_atom;");
       executeSQL(_db, "DROP TABLE IF EXISTS h_reservation;");
       executeSQL(_db, "DROP TABLE IF EXISTS h_room;");
       executeSQL(_db, "DROP TABLE IF EXISTS h_room_category;");
       executeSQL(_db, "DROP TABLE IF EXISTS h_hotel;");
-
-      createSchema();
+      executeSQL(_db, "DROP TABLE IF EXISTS h_change_log;");
+      executeSQL(_db, "DROP TABLE IF EXISTS h_reservation_tombstone;");
+      executeSQL(_db, "DROP TABLE IF EXISTS h_schema_version;");
+
+      migrateSchema(_db);
+      SqliteStatement(_db, "DELETE FROM sqlite_sequence;").execute();
+      SqliteStatement restoreSequence(_db, "INSERT INTO sqlite_sequence (name, seq) VALUES (?, ?);");
+      for (auto& sequence : sequences)
+        restoreSequence.execute(std::get<0>(sequence), std::get<1>(sequence));
       prepareQueries();
+
+      // Instead of a tombstone for each reservation, the change feed starts over for all earlier watermarks
+      query<QueryId::ChangeFeedHorizonRaise>().execute(latestChange());
     }
 
     void SqliteStorage::deleteReservationById(int id)
     {
-      query("reservation.delete").execute(id, id);
+      query<QueryId::ReservationAtomDeleteByReservationId>().execute(id);
+      query<QueryId::ReservationDelete>().execute(id);
     }
 
     std::unique_ptr<hotel::HotelCollection> SqliteStorage::loadHotels()
+    {
+      std::vector<std::unique_ptr<hotel::Hotel>> results;
+      loadHotels(std::numeric_limits<size_t>::max(),
+                 [&](std::vector<std::unique_ptr<hotel::Hotel>> hotels) { results = std::move(hotels); });
+      return std::make_unique<hotel::HotelCollection>(std::move(results));
+    }
+
+    void SqliteStorage::loadHotels(size_t chunkSize, const HotelsConsumer& consumer)
     {
       std::vector<std::unique_ptr<hotel::Hotel>> results;
 
       // Read hotels
-      auto& hotelsQuery = query("hotel.all");
+      auto hotelsQuery = query<QueryId::HotelAll>();
       hotelsQuery.execute();
-      while (hotelsQuery.hasResultRow())
+      for (; hotelsQuery.hasResultRow(); hotelsQuery.next())
       {
         int id;
-        std::string name;
-        hotelsQuery.readRow(id, name);
-        auto hotel = std::make_unique<hotel::Hotel>(name);
+        boost::string_ref name;
+        std::tie(id, name) = hotelsQuery.row();
+        auto hotel = std::make_unique<hotel::Hotel>(name.to_string());
         hotel->setId(id);
         results.push_back(std::move(hotel));
       }
 
+      std::vector<std::unique_ptr<hotel::Hotel>> chunk;
       for (auto& hotel : results)
       {
-        // Read categories
-        auto& categoriesQuery = query("room_category.by_hotel_id");
-        categoriesQuery.execute(hotel->id());
-        while (categoriesQuery.hasResultRow())
+        readHotelContents(*hotel);
+        chunk.push_back(std::move(hotel));
+        if (chunk.size() >= chunkSize)
         {
-          int id;
-          std::string short_code;
-          std::string name;
-          categoriesQuery.readRow(id, short_code, name);
-          auto category = std::make_unique<hotel::RoomCategory>(short_code, name);
-          category->setId(id);
-          hotel->addRoomCategory(std::move(category));
+          consumer(std::move(chunk));
+          chunk.clear();
         }
+      }
+      if (!chunk.empty())
+        consumer(std::move(chunk));
+    }
 
-        // Read rooms
-        auto& roomsQuery = query("room.by_hotel_id");
-        roomsQuery.execute(hotel->id());
-        while (roomsQuery.hasResultRow())
-        {
-          int id;
-          int category_id;
-          std::string name;
-          roomsQuery.readRow(id, category_id, name);
-          auto room = std::make_unique<hotel::HotelRoom>(name);
-          room->setId(id);
-          auto category = hotel->getCategoryById(category_id);
-          if (category)
-            hotel->addRoom(std::move(room), category->shortCode());
-          else
-            std::cerr << "Did not find category with id " << category_id << " in hotel " << hotel->name()
-                      << " for room " << name << std::endl;
-        }
+    void SqliteStorage::readHotelContents(hotel::Hotel& hotel)
+    {
+      // Read categories
+      auto categoriesQuery = query<QueryId::RoomCategoryByHotelId>();
+      categoriesQuery.execute(hotel.id());
+      for (; categoriesQuery.hasResultRow(); categoriesQuery.next())
+      {
+        int id;
+        boost::string_ref short_code;
+        boost::string_ref name;
+        std::tie(id, short_code, name) = categoriesQuery.row();
+        auto category = std::make_unique<hotel::RoomCategory>(short_code.to_string(), name.to_string());
+        category->setId(id);
+        hotel.addRoomCategory(std::move(category));
       }
 
-      return std::make_unique<hotel::HotelCollection>(std::move(results));
+      // Read rooms
+      auto roomsQuery = query<QueryId::RoomByHotelId>();
+      roomsQuery.execute(hotel.id());
+      for (; roomsQuery.hasResultRow(); roomsQuery.next())
+      {
+        int id;
+        int category_id;
+        boost::string_ref name;
+        std::tie(id, category_id, name) = roomsQuery.row();
+        auto room = std::make_unique<hotel::HotelRoom>(name.to_string());
+        room->setId(id);
+        auto category = hotel.getCategoryById(category_id);
+        if (category)
+          hotel.addRoom(std::move(room), category->shortCode());
+        else
+          std::cerr << "Did not find category with id " << category_id << " in hotel " << hotel.name()
+                    << " for room " << name << std::endl;
+      }
     }
 
     std::unique_ptr<hotel::PlanningBoard> SqliteStorage::loadPlanning(const std::vector<int>& roomIds)
@@ -164,28 +247,92 @@ namespace persistence
       for (auto id : roomIds)
         result->addRoomId(id);
 
-      auto& reservationsQuery = query("reservation_and_atoms.all");
+      auto reservationsQuery = query<QueryId::ReservationAndAtomsAll>();
       reservationsQuery.execute();
+      for (auto& reservation : readReservations(reservationsQuery))
+        result->addReservation(std::move(reservation));
+
+      return result;
+    }
+
+    std::unique_ptr<hotel::PlanningBoard> SqliteStorage::loadPlanning(const std::vector<int>& roomIds,
+                                                                      boost::gregorian::date_period window)
+    {
+      auto result = std::make_unique<hotel::PlanningBoard>();
+
+      for (auto id : roomIds)
+        result->addRoomId(id);
+
+      for (auto& reservation : loadReservations(window))
+        result->addReservation(std::move(reservation));
+
+      return result;
+    }
+
+    std::vector<std::unique_ptr<hotel::Reservation>> SqliteStorage::loadReservations(boost::gregorian::date_period window)
+    {
+      auto reservationsQuery = query<QueryId::ReservationAndAtomsInPeriod>();
+      reservationsQuery.execute(window.end(), window.begin());
+      return readReservations(reservationsQuery);
+    }
+
+    void SqliteStorage::loadReservations(boost::optional<boost::gregorian::date_period> window, size_t chunkSize,
+                                         const ReservationsConsumer& consumer)
+    {
+      if (window)
+      {
+        auto reservationsQuery = query<QueryId::ReservationAndAtomsInPeriod>();
+        reservationsQuery.execute(window->end(), window->begin());
+        readReservations(reservationsQuery, chunkSize, consumer);
+      }
+      else
+      {
+        auto reservationsQuery = query<QueryId::ReservationAndAtomsAll>();
+        reservationsQuery.execute();
+        readReservations(reservationsQuery, chunkSize, consumer);
+      }
+    }
+
+    std::vector<std::unique_ptr<hotel::Reservation>>
+    SqliteStorage::readReservations(TypedSqliteStatement<ReservationAndAtomRow>& reservationsQuery)
+    {
+      std::vector<std::unique_ptr<hotel::Reservation>> result;
+      readReservations(reservationsQuery, std::numeric_limits<size_t>::max(),
+                       [&](std::vector<std::unique_ptr<hotel::Reservation>> reservations) {
+                         result = std::move(reservations);
+                       });
+      return result;
+    }
+
+    void SqliteStorage::readReservations(TypedSqliteStatement<ReservationAndAtomRow>& reservationsQuery,
+                                         size_t chunkSize, const ReservationsConsumer& consumer)
+    {
+      std::vector<std::unique_ptr<hotel::Reservation>> result;
       std::unique_ptr<hotel::Reservation> current = nullptr;
-      while (reservationsQuery.hasResultRow())
+      for (; reservationsQuery.hasResultRow(); reservationsQuery.next())
       {
         int reservationId;
-        std::string description;
-        std::string reservationStatus;
+        boost::string_ref description;
+        int reservationStatus;
         int adults;
         int children;
         int atomId;
         int roomId;
         boost::gregorian::date dateFrom;
         boost::gregorian::date dateTo;
-        reservationsQuery.readRow(reservationId, description, reservationStatus, adults, children,
-                                  atomId, roomId, dateFrom, dateTo);
+        std::tie(reservationId, description, reservationStatus, adults, children, atomId, roomId, dateFrom, dateTo) =
+            reservationsQuery.row();
 
         if (current == nullptr || current->id() != reservationId)
         {
           if (current)
-            result->addReservation(std::move(current));
-          current = std::make_unique<hotel::Reservation>(description, roomId,
+            result.push_back(std::move(current));
+          if (result.size() >= chunkSize)
+          {
+            consumer(std::move(result));
+            result.clear();
+          }
+          current = std::make_unique<hotel::Reservation>(description.to_string(), roomId,
                                                          boost::gregorian::date_period(dateFrom, dateTo));
           current->setId(reservationId);
           current->setStatus(parseReservationStatus(reservationStatus));
@@ -199,119 +346,379 @@ namespace persistence
         (*current->atoms().rbegin()).setId(atomId);
       }
       if (current)
-        result->addReservation(std::move(current));
+        result.push_back(std::move(current));
+      if (!result.empty())
+        consumer(std::move(result));
+    }
 
-      return result;
+    std::unique_ptr<hotel::Hotel> SqliteStorage::loadHotel(int id)
+    {
+      auto hotelQuery = query<QueryId::HotelById>();
+      hotelQuery.execute(id);
+      if (!hotelQuery.hasResultRow())
+        return nullptr;
+
+      auto hotel = std::make_unique<hotel::Hotel>(std::get<1>(hotelQuery.row()).to_string());
+      hotel->setId(id);
+      hotelQuery.next();
+      readHotelContents(*hotel);
+      return hotel;
+    }
+
+    std::unique_ptr<hotel::Reservation> SqliteStorage::loadReservation(int id)
+    {
+      auto reservationQuery = query<QueryId::ReservationAndAtomsById>();
+      reservationQuery.execute(id);
+      auto reservations = readReservations(reservationQuery);
+      return reservations.empty() ? nullptr : std::move(reservations.front());
+    }
+
+    int64_t SqliteStorage::latestChange()
+    {
+      auto latestQuery = query<QueryId::ChangeLogLatest>();
+      latestQuery.execute();
+      int64_t position = 0;
+      if (latestQuery.hasResultRow())
+        position = std::get<0>(latestQuery.row());
+      latestQuery.next();
+      return position;
     }
 
-    void SqliteStorage::storeNewHotel(hotel::Hotel& hotel)
+    int64_t SqliteStorage::changeCount()
     {
-      // First, store the hotel
-      query("hotel.insert").execute(hotel.name());
-      hotel.setId(static_cast<int>(lastInsertId()));
+      auto countQuery = query<QueryId::ChangeLogCount>();
+      countQuery.execute();
+      int64_t count = 0;
+      if (countQuery.hasResultRow())
+        count = std::get<0>(countQuery.row());
+      countQuery.next();
+      return count;
+    }
 
-      // Store all of the categories
-      for (auto& category : hotel.categories())
+    ChangeSet SqliteStorage::loadChangesSince(int64_t position)
+    {
+      ChangeSet changes;
+      auto changesQuery = query<QueryId::ChangeLogSince>();
+      changesQuery.execute(position);
+      for (; changesQuery.hasResultRow(); changesQuery.next())
       {
-        query("room_category.insert").execute(hotel.id(), category->shortCode(), category->name());
-        category->setId(static_cast<int>(lastInsertId()));
+        int64_t seq;
+        int kind;
+        int objectId;
+        std::tie(seq, kind, objectId) = changesQuery.row();
+        switch (static_cast<ChangeKind>(kind))
+        {
+        case ChangeKind::HotelStored:
+          changes.storedHotelIds.push_back(objectId);
+          break;
+        case ChangeKind::ReservationStored:
+          changes.storedReservationIds.push_back(objectId);
+          break;
+        case ChangeKind::ReservationDeleted:
+          changes.deletedReservationIds.insert(objectId);
+          break;
+        default:
+          std::cerr << "Unknown change log entry: " << kind << std::endl;
+        }
       }
+      return changes;
+    }
+
+    void SqliteStorage::pruneChanges(int64_t position) { query<QueryId::ChangeLogPrune>().execute(position); }
 
-      // Store all of the rooms
-      for (auto& room : hotel.rooms())
+    void SqliteStorage::pruneTombstones(int64_t deletedBefore)
+    {
+      // The horizon is a position of the change sequence, thus the tombstones are pruned up to the latest expired one.
+      // It is raised first, such that a feed never misses the deletions of the pruned tombstones.
+      auto expiredQuery = query<QueryId::ReservationTombstoneExpired>();
+      expiredQuery.execute(deletedBefore);
+      int64_t position = 0;
+      if (expiredQuery.hasResultRow())
+        position = std::get<0>(expiredQuery.row());
+      expiredQuery.next();
+      if (position == 0)
+        return;
+
+      query<QueryId::ChangeFeedHorizonRaise>().execute(position);
+      query<QueryId::ReservationTombstonePrune>().execute(position);
+    }
+
+    int64_t SqliteStorage::changeFeedHorizon()
+    {
+      auto horizonQuery = query<QueryId::ChangeFeedHorizon>();
+      horizonQuery.execute();
+      int64_t position = 0;
+      if (horizonQuery.hasResultRow())
+        position = std::get<0>(horizonQuery.row());
+      horizonQuery.next();
+      return position;
+    }
+
+    bool SqliteStorage::loadReservationChangesSince(int64_t position, const StoredReservationConsumer& stored,
+                                                    const DeletedReservationConsumer& deleted)
+    {
+      // Both queries are ordered by the sequence and merged while they are read
+      auto storedQuery = query<QueryId::ReservationChangesSince>();
+      auto deletedQuery = query<QueryId::ReservationTombstonesSince>();
+      if (!storedQuery.execute(position) || !deletedQuery.execute(position))
+        return false;
+      while (storedQuery.hasResultRow() || deletedQuery.hasResultRow())
       {
-        query("room.insert").execute(hotel.id(), room->category()->id(), room->name());
-        room->setId(static_cast<int>(lastInsertId()));
+        if (!storedQuery.hasResultRow() ||
+            (deletedQuery.hasResultRow() && std::get<0>(deletedQuery.row()) < std::get<0>(storedQuery.row())))
+        {
+          deleted(std::get<0>(deletedQuery.row()), std::get<1>(deletedQuery.row()));
+          deletedQuery.next();
+          continue;
+        }
+
+        int64_t sequence;
+        int id;
+        std::tie(sequence, id) = storedQuery.row();
+        if (auto reservation = loadReservation(id))
+          stored(sequence, *reservation);
+        storedQuery.next();
       }
+      return !storedQuery.failed() && !deletedQuery.failed();
     }
 
-    void SqliteStorage::storeNewReservationAndAtoms(hotel::Reservation& reservation)
+    bool SqliteStorage::storeNewHotel(hotel::Hotel& hotel) { return storeNewHotels({&hotel}); }
+
+    bool SqliteStorage::storeNewReservationAndAtoms(hotel::Reservation& reservation)
     {
-      auto reservationStatus = serializeReservationStatus(reservation.status());
-      query("reservation.insert").execute(reservation.description(), reservationStatus,
-                                          reservation.numberOfAdults(), reservation.numberOfChildren());
-      reservation.setId(static_cast<int>(lastInsertId()));
-      for (auto& atom : reservation.atoms())
+      return storeNewReservationsAndAtoms({&reservation});
+    }
+
+    bool SqliteStorage::storeNewHotels(const std::vector<hotel::Hotel*>& hotels)
+    {
+      // Objects usually carry the ids which the client has assigned from its leases, ids are only reserved for the rest
+      size_t categoryCount = 0;
+      size_t roomCount = 0;
+      int64_t missingHotelIds = 0;
+      int64_t missingCategoryIds = 0;
+      int64_t missingRoomIds = 0;
+      for (auto hotel : hotels)
       {
-        auto& q = query("reservation_atom.insert");
-        q.execute(reservation.id(), atom.roomId(), atom.dateRange().begin(), atom.dateRange().end());
-        atom.setId(static_cast<int>(lastInsertId()));
+        categoryCount += hotel->categories().size();
+        roomCount += hotel->rooms().size();
+        missingHotelIds += (hotel->id() == 0);
+        for (auto& category : hotel->categories())
+          missingCategoryIds += (category->id() == 0);
+        for (auto& room : hotel->rooms())
+          missingRoomIds += (room->id() == 0);
       }
+
+      auto nextHotelId = reserveIds("h_hotel", missingHotelIds);
+      auto nextCategoryId = reserveIds("h_room_category", missingCategoryIds);
+      auto nextRoomId = reserveIds("h_room", missingRoomIds);
+
+      // Assign the missing ids and collect the rows to insert
+      std::vector<std::tuple<int64_t, std::string>> hotelRows;
+      std::vector<std::tuple<int64_t, int64_t, std::string, std::string>> categoryRows;
+      std::vector<std::tuple<int64_t, int64_t, int64_t, std::string>> roomRows;
+      hotelRows.reserve(hotels.size());
+      categoryRows.reserve(categoryCount);
+      roomRows.reserve(roomCount);
+      for (auto hotel : hotels)
+      {
+        if (hotel->id() == 0)
+          hotel->setId(static_cast<int>(nextHotelId++));
+        hotelRows.emplace_back(hotel->id(), hotel->name());
+        for (auto& category : hotel->categories())
+        {
+          if (category->id() == 0)
+            category->setId(static_cast<int>(nextCategoryId++));
+          categoryRows.emplace_back(category->id(), hotel->id(), category->shortCode(), category->name());
+        }
+        for (auto& room : hotel->rooms())
+        {
+          if (room->id() == 0)
+            room->setId(static_cast<int>(nextRoomId++));
+          roomRows.emplace_back(room->id(), hotel->id(), room->category()->id(), room->name());
+        }
+      }
+
+      beginStoreSavepoint(_db);
+      auto stored =
+          insertRows(QueryId::HotelInsert, QueryId::HotelInsertBulk, "h_hotel", hotelBulkColumns, hotelRows) &&
+          insertRows(QueryId::RoomCategoryInsert, QueryId::RoomCategoryInsertBulk, "h_room_category",
+                     roomCategoryBulkColumns, categoryRows) &&
+          insertRows(QueryId::RoomInsert, QueryId::RoomInsertBulk, "h_room", roomBulkColumns, roomRows);
+      return endStoreSavepoint(_db, stored);
     }
 
-    SqliteStatement& SqliteStorage::query(const std::string& key)
+    bool SqliteStorage::storeNewReservationsAndAtoms(const std::vector<hotel::Reservation*>& reservations)
     {
-      auto it = _statements.find(key);
-      if (it == _statements.end())
+      size_t atomCount = 0;
+      int64_t missingReservationIds = 0;
+      int64_t missingAtomIds = 0;
+      for (auto reservation : reservations)
       {
-        std::cerr << "Query '" << key << "' does not exist!" << std::endl;
+        atomCount += reservation->atoms().size();
+        missingReservationIds += (reservation->id() == 0);
+        for (auto& atom : reservation->atoms())
+          missingAtomIds += (atom.id() == 0);
+      }
+
+      auto nextReservationId = reserveIds("h_reservation", missingReservationIds);
+      auto nextAtomId = reserveIds("h_reservation_atom", missingAtomIds);
+      // The reservations take the next positions of the change log, the insert trigger logs them there
+      auto nextChange = latestChange() + 1;
+
+      // Assign the missing ids and collect the rows to insert
+      std::vector<std::tuple<int64_t, std::string, int64_t, int64_t, int64_t, int64_t>> reservationRows;
+      std::vector<std::tuple<int64_t, int64_t, int64_t, boost::gregorian::date, boost::gregorian::date>> atomRows;
+      reservationRows.reserve(reservations.size());
+      atomRows.reserve(atomCount);
+      for (auto reservation : reservations)
+      {
+        if (reservation->id() == 0)
+          reservation->setId(static_cast<int>(nextReservationId++));
+        reservationRows.emplace_back(reservation->id(), reservation->description(),
+                                     serializeReservationStatus(reservation->status()), reservation->numberOfAdults(),
+                                     reservation->numberOfChildren(), nextChange++);
+        for (auto& atom : reservation->atoms())
+        {
+          if (atom.id() == 0)
+            atom.setId(static_cast<int>(nextAtomId++));
+          atomRows.emplace_back(atom.id(), reservation->id(), atom.roomId(), atom.dateRange().begin(),
+                                atom.dateRange().end());
+        }
       }
 
-      return it->second;
+      beginStoreSavepoint(_db);
+      auto stored = insertRows(QueryId::ReservationInsert, QueryId::ReservationInsertBulk, "h_reservation",
+                               reservationBulkColumns, reservationRows) &&
+                    insertRows(QueryId::ReservationAtomInsert, QueryId::ReservationAtomInsertBulk, "h_reservation_atom",
+                               reservationAtomBulkColumns, atomRows);
+      return endStoreSavepoint(_db, stored);
     }
 
-    int64_t SqliteStorage::lastInsertId() { return sqlite3_last_insert_rowid(_db); }
+    int64_t SqliteStorage::reserveIds(const std::string& table, int64_t count)
+    {
+      // With AUTOINCREMENT, sqlite_sequence holds the largest id ever handed out for the table. Moving it past the
+      // reserved range guarantees that sqlite will never hand out one of the reserved ids itself.
+      if (count <= 0)
+        return 0;
+
+      int64_t lastId = 0;
+      SqliteStatement lastIdQuery(_db, "SELECT MAX(COALESCE((SELECT seq FROM sqlite_sequence WHERE name = ?), 0), "
+                                       "COALESCE((SELECT MAX(id) FROM " + table + "), 0));");
+      lastIdQuery.execute(table);
+      if (lastIdQuery.hasResultRow())
+        lastIdQuery.readRow(lastId);
+
+      SqliteStatement(_db, "UPDATE sqlite_sequence SET seq = ? WHERE name = ?;").execute(lastId + count, table);
+      if (sqlite3_changes(_db) == 0)
+        SqliteStatement(_db, "INSERT INTO sqlite_sequence (name, seq) VALUES (?, ?);").execute(table, lastId + count);
+      return lastId + 1;
+    }
 
-    void SqliteStorage::beginTransaction() { sqlite3_exec(_db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr); }
+    template <typename Row>
+    bool SqliteStorage::insertRows(QueryId singleRowId, QueryId multiRowId, const std::string& table,
+                                   const std::string& columns, const std::vector<Row>& rows)
+    {
+      // Full chunks and single rows use the statements prepared in prepareQueries(), other remainders get an ad-hoc
+      // statement
+      auto fullChunks = rows.size() / bulkInsertRowCount;
+      if (fullChunks > 0)
+      {
+        auto& statement = _statements[static_cast<size_t>(multiRowId)];
+        for (size_t i = 0; i < fullChunks; ++i)
+        {
+          auto begin = rows.begin() + i * bulkInsertRowCount;
+          if (!statement.executeRows(begin, begin + bulkInsertRowCount))
+            return false;
+        }
+      }
 
-    void SqliteStorage::commitTransaction() { sqlite3_exec(_db, "END TRANSACTION", nullptr, nullptr, nullptr); }
+      auto remainder = rows.size() % bulkInsertRowCount;
+      if (remainder == 1)
+        return _statements[static_cast<size_t>(singleRowId)].executeRows(rows.end() - 1, rows.end());
+      if (remainder > 0)
+      {
+        SqliteStatement statement(_db, makeMultiRowInsert(table, columns, std::tuple_size<Row>::value, remainder));
+        return statement.executeRows(rows.end() - remainder, rows.end());
+      }
+      return true;
+    }
 
-    void SqliteStorage::prepareQueries()
+    void SqliteStorage::beginTransaction() { sqlite3_exec(_db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr); }
+
+    bool SqliteStorage::commitTransaction()
     {
-      _statements.emplace("hotel.insert", SqliteStatement(_db, "INSERT INTO h_hotel (name) VALUES (?);"));
-      _statements.emplace("hotel.all", SqliteStatement(_db, "SELECT id, name FROM h_hotel;"));
-      _statements.emplace(
-          "room_category.insert",
-          SqliteStatement(_db, "INSERT INTO h_room_category (hotel_id, short_code, name) VALUES (?, ?, ?);"));
-      _statements.emplace("room_category.by_hotel_id",
-                          SqliteStatement(_db, "SELECT id, short_code, name FROM h_room_category WHERE hotel_id = ?;"));
-      _statements.emplace("room.insert",
-                          SqliteStatement(_db, "INSERT INTO h_room (hotel_id, category_id, name) VALUES (?, ?, ?);"));
-      _statements.emplace("room.by_hotel_id",
-                          SqliteStatement(_db, "SELECT id, category_id, name FROM h_room WHERE hotel_id = ?;"));
-
-      _statements.emplace(
-          "reservation_and_atoms.all",
-          SqliteStatement(_db, "SELECT r.id, r.description, r.status, r.adults, r.children, a.id, a.room_id, a.date_from, a.date_to "
-                               "FROM h_reservation as r, h_reservation_atom as a WHERE "
-                               "a.reservation_id = r.id ORDER BY r.id, a.date_from;"));
-      _statements.emplace("reservation.insert",
-                          SqliteStatement(_db, "INSERT INTO h_reservation (description, status, adults, children) VALUES (?, ?, ?, ?);"));
-      _statements.emplace("reservation.delete",
-                          SqliteStatement(_db, "DELETE FROM h_reservation_atom where reservation_id = ?; DELETE FROM h_reservation WHERE reservation_id = ?;"));
-      _statements.emplace("reservation_atom.insert",
-                          SqliteStatement(_db, "INSERT INTO h_reservation_atom (reservation_id, room_id, "
-                                               "date_from, date_to) VALUES (?, ?, ?, ?);"));
+      if (sqlite3_exec(_db, "END TRANSACTION", nullptr, nullptr, nullptr) == SQLITE_OK)
+        return true;
+
+      // E.g. a busy database leaves the transaction open, its changes must not be committed along with the next one
+      std::cerr << "Cannot commit transaction: " << sqlite3_errmsg(_db) << std::endl;
+      if (!sqlite3_get_autocommit(_db))
+        sqlite3_exec(_db, "ROLLBACK", nullptr, nullptr, nullptr);
+      return false;
     }
 
-    void SqliteStorage::createSchema()
+    void SqliteStorage::prepareQueries()
     {
-      executeSQL(_db, "CREATE TABLE IF NOT EXISTS h_hotel ("
-                      "id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
-                      "name TEXT NOT NULL);");
-      executeSQL(_db, "CREATE TABLE IF NOT EXISTS h_room_category ("
-                      "id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
-                      "hotel_id INTEGER NOT NULL," // Foreign key
-                      "short_code TEXT NOT NULL,"
-                      "name TEXT NOT NULL);");
-      executeSQL(_db, "CREATE TABLE IF NOT EXISTS h_room ("
-                      "id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
-                      "hotel_id INTEGER NOT NULL,"    // Foreign key
-                      "category_id INTEGER NOT NULL," // Foreign key
-                      "name TEXT NOT NULL);");
-
-      executeSQL(_db, "CREATE TABLE IF NOT EXISTS h_reservation ("
-                      "id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
-                      "description TEXT NOT NULL, "
-                      "status TEXT NOT NULL,"
-                      "adults INTEGER NOT NULL,"
-                      "children INTEGER NOT NULL);");
-      executeSQL(_db, "CREATE TABLE IF NOT EXISTS h_reservation_atom ("
-                      "id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
-                      "reservation_id INTEGER NOT NULL," // Foreign key
-                      "room_id INTEGER NOT NULL,"        // Foreign key
-                      "date_from TEXT NOT NULL,"
-                      "date_to TEXT NOT NULL);");
+      auto prepare = [this](QueryId id, const std::string& sql) {
+        _statements[static_cast<size_t>(id)] = SqliteStatement(_db, sql);
+      };
+
+      prepare(QueryId::HotelInsert, "INSERT INTO h_hotel (id, name) VALUES (?, ?);");
+      prepare(QueryId::HotelAll, "SELECT id, name FROM h_hotel;");
+      prepare(QueryId::HotelById, "SELECT id, name FROM h_hotel WHERE id = ?;");
+      prepare(QueryId::RoomCategoryInsert,
+              "INSERT INTO h_room_category (id, hotel_id, short_code, name) VALUES (?, ?, ?, ?);");
+      prepare(QueryId::RoomCategoryByHotelId, "SELECT id, short_code, name FROM h_room_category WHERE hotel_id = ?;");
+      prepare(QueryId::RoomInsert, "INSERT INTO h_room (id, hotel_id, category_id, name) VALUES (?, ?, ?, ?);");
+      prepare(QueryId::RoomByHotelId, "SELECT id, category_id, name FROM h_room WHERE hotel_id = ?;");
+
+      prepare(QueryId::ReservationAndAtomsAll,
+              "SELECT r.id, r.description, r.status, r.adults, r.children, a.id, a.room_id, a.date_from, a.date_to "
+              "FROM h_reservation as r, h_reservation_atom as a WHERE "
+              "a.reservation_id = r.id ORDER BY r.id, a.date_from;");
+      prepare(QueryId::ReservationAndAtomsInPeriod,
+              "SELECT r.id, r.description, r.status, r.adults, r.children, a.id, a.room_id, a.date_from, a.date_to "
+              "FROM h_reservation as r, h_reservation_atom as a WHERE "
+              "a.reservation_id = r.id AND r.id IN (SELECT reservation_id FROM h_reservation_atom "
+              "WHERE date_from < ? AND date_to > ?) ORDER BY r.id, a.date_from;");
+      prepare(QueryId::ReservationAndAtomsById,
+              "SELECT r.id, r.description, r.status, r.adults, r.children, a.id, a.room_id, a.date_from, a.date_to "
+              "FROM h_reservation as r, h_reservation_atom as a WHERE "
+              "a.reservation_id = r.id AND r.id = ? ORDER BY a.date_from;");
+      prepare(QueryId::ReservationInsert, "INSERT INTO h_reservation (id, description, status, adults, children, "
+                                          "change_seq) VALUES (?, ?, ?, ?, ?, ?);");
+      prepare(QueryId::ReservationDelete, "DELETE FROM h_reservation WHERE id = ?;");
+      prepare(QueryId::ReservationAtomInsert,
+              "INSERT INTO h_reservation_atom (id, reservation_id, room_id, date_from, date_to) "
+              "VALUES (?, ?, ?, ?, ?);");
+      prepare(QueryId::ReservationAtomDeleteByReservationId, "DELETE FROM h_reservation_atom WHERE reservation_id = ?;");
+
+      prepare(QueryId::HotelInsertBulk, makeMultiRowInsert("h_hotel", hotelBulkColumns, 2, bulkInsertRowCount));
+      prepare(QueryId::RoomCategoryInsertBulk,
+              makeMultiRowInsert("h_room_category", roomCategoryBulkColumns, 4, bulkInsertRowCount));
+      prepare(QueryId::RoomInsertBulk, makeMultiRowInsert("h_room", roomBulkColumns, 4, bulkInsertRowCount));
+      prepare(QueryId::ReservationInsertBulk,
+              makeMultiRowInsert("h_reservation", reservationBulkColumns, 6, bulkInsertRowCount));
+      prepare(QueryId::ReservationAtomInsertBulk,
+              makeMultiRowInsert("h_reservation_atom", reservationAtomBulkColumns, 5, bulkInsertRowCount));
+
+      // Pruned entries are gone from the log, but sqlite_sequence still knows the latest position
+      prepare(QueryId::ChangeLogLatest,
+              "SELECT COALESCE((SELECT seq FROM sqlite_sequence WHERE name = 'h_change_log'), 0);");
+      prepare(QueryId::ChangeLogCount, "SELECT COUNT(*) FROM h_change_log;");
+      prepare(QueryId::ChangeLogSince, "SELECT seq, kind, object_id FROM h_change_log WHERE seq > ? ORDER BY seq;");
+      prepare(QueryId::ChangeLogPrune, "DELETE FROM h_change_log WHERE seq <= ?;");
+
+      prepare(QueryId::ReservationChangesSince,
+              "SELECT change_seq, id FROM h_reservation WHERE change_seq > ? ORDER BY change_seq, id;");
+      prepare(QueryId::ReservationTombstonesSince,
+              "SELECT change_seq, reservation_id FROM h_reservation_tombstone WHERE change_seq > ? "
+              "ORDER BY change_seq, reservation_id;");
+      prepare(QueryId::ReservationTombstoneExpired,
+              "SELECT COALESCE(MAX(change_seq), 0) FROM h_reservation_tombstone WHERE deleted_at < ?;");
+      prepare(QueryId::ReservationTombstonePrune, "DELETE FROM h_reservation_tombstone WHERE change_seq <= ?;");
+      prepare(QueryId::ChangeFeedHorizon, "SELECT seq FROM h_change_feed_horizon;");
+      prepare(QueryId::ChangeFeedHorizonRaise, "UPDATE h_change_feed_horizon SET seq = MAX(seq, ?);");
     }
 
   } // namespace sqlite
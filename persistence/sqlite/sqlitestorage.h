@@ -1,6 +1,7 @@
 #ifndef PERSISTENCE_SQLITE_SQLITESTORAGE_H
 #define PERSISTENCE_SQLITE_SQLITESTORAGE_H
 
+#include "persistence/sqlite/sqlitequeries.h"
 #include "persistence/sqlite/sqlitestatement.h"
 
 #include "hotel/hotel.h"
@@ -8,18 +9,41 @@
 #include "hotel/planning.h"
 #include "hotel/reservation.h"
 
+#include <boost/optional.hpp>
 #include <sqlite3.h>
 
+#include <array>
 #include <cstdint>
-#include <map>
+#include <functional>
 #include <memory>
+#include <set>
 #include <string>
+#include <vector>
 
 namespace persistence
 {
   namespace sqlite
   {
 
+    //! Kinds of entries in the change log, the values are part of the database format
+    enum class ChangeKind
+    {
+      HotelStored = 1,
+      ReservationStored = 2,
+      ReservationDeleted = 3
+    };
+
+    /**
+     * @brief The ChangeSet struct lists the objects which have been stored or deleted after a position of the change
+     * log
+     */
+    struct ChangeSet
+    {
+      std::vector<int> storedHotelIds;
+      std::vector<int> storedReservationIds;
+      std::set<int> deletedReservationIds;
+    };
+
     class SqliteStorage
     {
     public:
@@ -29,26 +53,114 @@ namespace persistence
       void deleteAll();
       void deleteReservationById(int id);
 
+      typedef std::function<void(std::vector<std::unique_ptr<hotel::Hotel>>)> HotelsConsumer;
+      typedef std::function<void(std::vector<std::unique_ptr<hotel::Reservation>>)> ReservationsConsumer;
+
       std::unique_ptr<hotel::HotelCollection> loadHotels();
+      //! Loads all hotels and hands them to the consumer in chunks of at most chunkSize hotels
+      void loadHotels(size_t chunkSize, const HotelsConsumer& consumer);
       std::unique_ptr<hotel::PlanningBoard> loadPlanning(const std::vector<int>& roomIds);
-
-      void storeNewHotel(hotel::Hotel& hotel);
-      void storeNewReservationAndAtoms(hotel::Reservation& reservation);
+      //! Loads a planning board containing only the reservations which intersect the given window
+      std::unique_ptr<hotel::PlanningBoard> loadPlanning(const std::vector<int>& roomIds,
+                                                         boost::gregorian::date_period window);
+      //! Loads all reservations which have at least one atom intersecting the given window
+      std::vector<std::unique_ptr<hotel::Reservation>> loadReservations(boost::gregorian::date_period window);
+      /**
+       * @brief Loads the reservations intersecting the given window, or all of them if no window is given
+       * The reservations are handed to the consumer in chunks of at most chunkSize reservations while the query is
+       * still being read.
+       */
+      void loadReservations(boost::optional<boost::gregorian::date_period> window, size_t chunkSize,
+                            const ReservationsConsumer& consumer);
+
+      //! Loads a single hotel with its categories and rooms, returns nullptr if there is no such hotel
+      std::unique_ptr<hotel::Hotel> loadHotel(int id);
+      //! Loads a single reservation with its atoms, returns nullptr if there is no such reservation
+      std::unique_ptr<hotel::Reservation> loadReservation(int id);
+
+      //! Returns the position of the latest entry in the change log
+      int64_t latestChange();
+      //! Returns the number of entries in the change log
+      int64_t changeCount();
+      //! Returns the changes recorded after the given position of the change log
+      ChangeSet loadChangesSince(int64_t position);
+      //! Removes the entries up to the given position from the change log, once they are no longer needed
+      void pruneChanges(int64_t position);
+      /**
+       * @brief Removes the tombstones of the reservations deleted before the given time from the change feed
+       * The time is given in seconds since the epoch. The tombstones are pruned up to the position of the latest
+       * expired one, changeFeedHorizon() is raised to that position.
+       */
+      void pruneTombstones(int64_t deletedBefore);
+      //! Returns the position up to which the tombstones have been pruned, the change feed is incomplete before it
+      int64_t changeFeedHorizon();
+
+      typedef std::function<void(int64_t sequence, const hotel::Reservation& reservation)> StoredReservationConsumer;
+      typedef std::function<void(int64_t sequence, int reservationId)> DeletedReservationConsumer;
+      /**
+       * @brief Hands the reservations stored or deleted after the given position of the change sequence to the
+       * consumers, in the order of the sequence
+       * Unlike loadChangesSince(), this also works for positions before the last pruning of the change log. Stored
+       * reservations are handed over in their current state, reservations which have been deleted again only once as
+       * deleted. Deleted reservations are missing for positions before changeFeedHorizon().
+       * @return false if the changes could not be read
+       */
+      bool loadReservationChangesSince(int64_t position, const StoredReservationConsumer& stored,
+                                       const DeletedReservationConsumer& deleted);
+
+      /**
+       * @brief Stores new objects under the ids they carry
+       * Objects with id 0 get their ids assigned here, reserving the ids in one go for the whole call. The rows are
+       * inserted with explicit ids, nothing is read back from the database.
+       * @return false if the objects could not be stored, e.g. because one of their ids is taken already. Nothing of
+       *         the call is stored then.
+       */
+      bool storeNewHotel(hotel::Hotel& hotel);
+      bool storeNewReservationAndAtoms(hotel::Reservation& reservation);
+
+      /**
+       * @brief Bulk variants of the above store functions
+       * The rows are written with multi-row INSERT statements, which avoids one statement execution per stored object.
+       */
+      bool storeNewHotels(const std::vector<hotel::Hotel*>& hotels);
+      bool storeNewReservationsAndAtoms(const std::vector<hotel::Reservation*>& reservations);
+
+      /**
+       * @brief Reserves count consecutive ids in the given table and returns the first one
+       * The reserved ids are never handed out again, also not after deleteAll(). Returns 0 if count is not positive.
+       */
+      int64_t reserveIds(const std::string& table, int64_t count);
 
       void getReservation();
 
       void beginTransaction();
-      void commitTransaction();
+      //! Returns false if the transaction could not be committed, its changes have been rolled back then
+      bool commitTransaction();
 
     private:
-      SqliteStatement& query(const std::string& key);
-      int64_t lastInsertId();
+      //! Returns the prepared statement with the given id, typed with its result row
+      template <QueryId Id> TypedSqliteStatement<typename QueryRow<Id>::type> query()
+      {
+        return TypedSqliteStatement<typename QueryRow<Id>::type>(_statements[static_cast<size_t>(Id)]);
+      }
+
+      //! Reads the rows of an executed reservation_and_atoms query
+      std::vector<std::unique_ptr<hotel::Reservation>>
+      readReservations(TypedSqliteStatement<ReservationAndAtomRow>& reservationsQuery);
+      void readReservations(TypedSqliteStatement<ReservationAndAtomRow>& reservationsQuery, size_t chunkSize,
+                            const ReservationsConsumer& consumer);
+      //! Reads the categories and rooms of the given hotel
+      void readHotelContents(hotel::Hotel& hotel);
+
+      //! Inserts the rows, returns false as soon as one of the statements fails
+      template <typename Row>
+      bool insertRows(QueryId singleRowId, QueryId multiRowId, const std::string& table, const std::string& columns,
+                      const std::vector<Row>& rows);
 
       void prepareQueries();
-      void createSchema();
 
       sqlite3* _db;
-      std::map<std::string, SqliteStatement> _statements;
+      std::array<SqliteStatement, queryCount> _statements;
     };
 
   } // namespace sqlite
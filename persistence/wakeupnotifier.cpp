@@ -0,0 +1,77 @@
+#include "persistence/wakeupnotifier.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+namespace persistence
+{
+  WakeupNotifier::WakeupNotifier() : _readDescriptor(-1), _writeDescriptor(-1), _notified(false)
+  {
+#ifdef __linux__
+    _readDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    _writeDescriptor = _readDescriptor;
+    if (_readDescriptor == -1)
+      std::cerr << "Cannot create eventfd: " << std::strerror(errno) << std::endl;
+#else
+    int descriptors[2];
+    if (pipe(descriptors) == 0)
+    {
+      _readDescriptor = descriptors[0];
+      _writeDescriptor = descriptors[1];
+      for (auto descriptor : descriptors)
+      {
+        fcntl(descriptor, F_SETFL, fcntl(descriptor, F_GETFL) | O_NONBLOCK);
+        fcntl(descriptor, F_SETFD, FD_CLOEXEC);
+      }
+    }
+    else
+    {
+      std::cerr << "Cannot create pipe: " << std::strerror(errno) << std::endl;
+    }
+#endif
+  }
+
+  WakeupNotifier::~WakeupNotifier()
+  {
+    if (_readDescriptor != -1)
+      close(_readDescriptor);
+    if (_writeDescriptor != -1 && _writeDescriptor != _readDescriptor)
+      close(_writeDescriptor);
+  }
+
+  void WakeupNotifier::notify()
+  {
+    // Only the first notification after a reset has to touch the descriptor
+    if (_notified.exchange(true))
+      return;
+
+    uint64_t value = 1;
+    while (write(_writeDescriptor, &value, sizeof(value)) == -1 && errno == EINTR)
+      ;
+  }
+
+  void WakeupNotifier::reset()
+  {
+    // Drain the descriptor, an eventfd is drained by one read, a pipe might need several
+    uint64_t value;
+    while (true)
+    {
+      auto bytesRead = read(_readDescriptor, &value, sizeof(value));
+      if (bytesRead > 0 || (bytesRead == -1 && errno == EINTR))
+        continue;
+      break;
+    }
+
+    // Notifications arriving from now on write to the descriptor again
+    _notified = false;
+  }
+
+} // namespace persistence
@@ -0,0 +1,42 @@
+#ifndef PERSISTENCE_WAKEUPNOTIFIER_H
+#define PERSISTENCE_WAKEUPNOTIFIER_H
+
+#include <atomic>
+
+namespace persistence
+{
+  /**
+   * @brief The WakeupNotifier class wakes up an event loop waiting on a file descriptor
+   *
+   * The file descriptor becomes readable when notify() is called and stays readable until reset() is called. Any number
+   * of notifications between two resets result in a single write to the descriptor, such that a burst of events only
+   * causes one wakeup. On Linux an eventfd is used, on other systems a non-blocking pipe.
+   */
+  class WakeupNotifier
+  {
+  public:
+    WakeupNotifier();
+    ~WakeupNotifier();
+    WakeupNotifier(const WakeupNotifier&) = delete;
+    WakeupNotifier& operator=(const WakeupNotifier&) = delete;
+
+    //! Returns the descriptor to watch for readability, e.g. with poll() or a QSocketNotifier
+    int fileDescriptor() const { return _readDescriptor; }
+
+    //! Makes the descriptor readable, may be called from any thread
+    void notify();
+    /**
+     * @brief reset makes the descriptor non-readable again
+     * Must be called by the waiting thread before it processes the events it has been notified about.
+     */
+    void reset();
+
+  private:
+    int _readDescriptor;
+    int _writeDescriptor;
+    std::atomic<bool> _notified;
+  };
+
+} // namespace persistence
+
+#endif // PERSISTENCE_WAKEUPNOTIFIER_H
@@ -0,0 +1,369 @@
+#include "gtest/gtest.h"
+
+#include "persistence/datasource.h"
+#include "persistence/log/logbackend.h"
+#include "persistence/log/logfile.h"
+#include "persistence/op/operations.h"
+
+#include "tests/testutils.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+  const char* logPath = "test.log";
+
+  std::unique_ptr<persistence::DataSource> openDataSource(uint64_t compactionThreshold = 1024 * 1024)
+  {
+    auto dataSource = std::make_unique<persistence::DataSource>(
+        std::make_unique<persistence::log::LogBackend>(logPath, compactionThreshold));
+    waitForAllOperations(*dataSource);
+    return dataSource;
+  }
+
+  int storeHotel(persistence::DataSource& dataSource)
+  {
+    auto hotel = std::make_unique<hotel::Hotel>("Hotel 1");
+    hotel->addRoomCategory(std::make_unique<hotel::RoomCategory>("cat", "Category"));
+    hotel->addRoom(std::make_unique<hotel::HotelRoom>("Room 1"), "cat");
+    hotel->addRoom(std::make_unique<hotel::HotelRoom>("Room 2"), "cat");
+    dataSource.queueOperation(persistence::op::StoreNewHotel{std::move(hotel)});
+    waitForAllOperations(dataSource);
+    return dataSource.hotels().hotels().back()->rooms()[0]->id();
+  }
+
+  void storeReservations(persistence::DataSource& dataSource, int roomId, int count, int offset = 0)
+  {
+    using namespace boost::gregorian;
+    persistence::op::Operations operations;
+    for (int i = 0; i < count; ++i)
+    {
+      auto begin = date(2017, 1, 1) + days(10 * (i + offset));
+      auto reservation =
+          std::make_unique<hotel::Reservation>("Reservation", roomId, date_period(begin, begin + days(5)));
+      reservation->setNumberOfAdults(2);
+      operations.push_back(persistence::op::StoreNewReservation{std::move(reservation)});
+    }
+    dataSource.queueOperations(std::move(operations));
+    waitForAllOperations(dataSource);
+  }
+
+  //! Counts the transactions, i.e. the syncs of the log
+  class CountingLogBackend : public persistence::log::LogBackend
+  {
+  public:
+    CountingLogBackend(std::atomic<int>& commits) : LogBackend(logPath), _commits(commits) {}
+
+  protected:
+    bool commitTransaction() override
+    {
+      ++_commits;
+      return LogBackend::commitTransaction();
+    }
+
+  private:
+    std::atomic<int>& _commits;
+  };
+
+  long fileSize(const std::string& path)
+  {
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    return stream ? static_cast<long>(stream.tellg()) : -1;
+  }
+} // namespace
+
+class LogStorage : public testing::Test
+{
+public:
+  void SetUp() override
+  {
+    std::remove(logPath);
+    std::remove((std::string(logPath) + ".snapshot").c_str());
+  }
+};
+
+TEST_F(LogStorage, ReopenRestoresData)
+{
+  int deletedId = 0;
+  std::vector<hotel::Reservation> expectedReservations;
+  {
+    auto dataSource = openDataSource();
+    auto roomId = storeHotel(*dataSource);
+    storeReservations(*dataSource, roomId, 5);
+    deletedId = dataSource->planning().reservations()[2]->id();
+    dataSource->queueOperation(persistence::op::DeleteReservation{deletedId});
+    waitForAllOperations(*dataSource);
+    for (auto reservation : dataSource->planning().reservations())
+      expectedReservations.push_back(*reservation);
+  }
+
+  auto dataSource = openDataSource();
+  ASSERT_EQ(1u, dataSource->hotels().hotels().size());
+  ASSERT_EQ(2u, dataSource->hotels().hotels()[0]->rooms().size());
+  ASSERT_EQ(nullptr, dataSource->planning().getReservationById(deletedId));
+  ASSERT_EQ(4u, dataSource->planning().reservations().size());
+  for (auto& expected : expectedReservations)
+  {
+    auto loaded = dataSource->planning().getReservationById(expected.id());
+    ASSERT_NE(nullptr, loaded);
+    ASSERT_EQ(expected, *loaded);
+    ASSERT_EQ(2, loaded->numberOfAdults());
+  }
+}
+
+TEST_F(LogStorage, TornTailIsDropped)
+{
+  {
+    auto dataSource = openDataSource();
+    auto roomId = storeHotel(*dataSource);
+    storeReservations(*dataSource, roomId, 3);
+  }
+
+  // A crash in the middle of writing the last record leaves only a part of it
+  auto intactSize = fileSize(logPath);
+  {
+    std::ofstream stream(logPath, std::ios::binary | std::ios::app);
+    const char partialRecord[] = {42, 0, 0, 0, 1, 2, 3};
+    stream.write(partialRecord, sizeof(partialRecord));
+  }
+
+  {
+    persistence::log::LogFile log;
+    ASSERT_TRUE(log.open(logPath));
+    ASSERT_FALSE(log.replay([](const char*, size_t) {}));
+    ASSERT_EQ(intactSize, fileSize(logPath));
+  }
+
+  {
+    auto dataSource = openDataSource();
+    ASSERT_EQ(3u, dataSource->planning().reservations().size());
+
+    // New records are appended right after the last intact one
+    storeReservations(*dataSource, dataSource->hotels().hotels()[0]->rooms()[0]->id(), 1, 3);
+  }
+
+  auto dataSource = openDataSource();
+  ASSERT_EQ(4u, dataSource->planning().reservations().size());
+}
+
+TEST_F(LogStorage, DamagedRecordDropsTheRest)
+{
+  long firstTaskEnd = 0;
+  {
+    auto dataSource = openDataSource();
+    auto roomId = storeHotel(*dataSource);
+    storeReservations(*dataSource, roomId, 2);
+    firstTaskEnd = fileSize(logPath);
+    storeReservations(*dataSource, roomId, 2, 2);
+  }
+
+  // Flip a byte within the first record of the second task, its checksum does not match anymore
+  {
+    std::fstream stream(logPath, std::ios::binary | std::ios::in | std::ios::out);
+    stream.seekg(firstTaskEnd + 12);
+    char byte = 0;
+    stream.read(&byte, 1);
+    byte ^= 0x5a;
+    stream.seekp(firstTaskEnd + 12);
+    stream.write(&byte, 1);
+  }
+
+  {
+    persistence::log::LogFile log;
+    ASSERT_TRUE(log.open(logPath));
+    ASSERT_FALSE(log.replay([](const char*, size_t) {}));
+    ASSERT_EQ(firstTaskEnd, fileSize(logPath));
+  }
+
+  auto dataSource = openDataSource();
+  ASSERT_EQ(1u, dataSource->hotels().hotels().size());
+  ASSERT_EQ(2u, dataSource->planning().reservations().size());
+}
+
+TEST_F(LogStorage, CompactionKeepsDataAndIds)
+{
+  int lastId = 0;
+  {
+    auto dataSource = openDataSource(1024);
+    auto roomId = storeHotel(*dataSource);
+    storeReservations(*dataSource, roomId, 30);
+    for (auto reservation : dataSource->planning().reservations())
+      lastId = std::max(lastId, reservation->id());
+
+    // The deleted reservation had the largest id, only the id watermark remembers it
+    dataSource->queueOperation(persistence::op::DeleteReservation{lastId});
+    waitForAllOperations(*dataSource);
+  }
+
+  // The log has been replaced by the snapshot and a short log of later changes
+  ASSERT_LT(0, fileSize(std::string(logPath) + ".snapshot"));
+  ASSERT_GT(1024, fileSize(logPath));
+
+  auto dataSource = openDataSource(1024);
+  ASSERT_EQ(1u, dataSource->hotels().hotels().size());
+  ASSERT_EQ(29u, dataSource->planning().reservations().size());
+  ASSERT_EQ(nullptr, dataSource->planning().getReservationById(lastId));
+
+  storeReservations(*dataSource, dataSource->hotels().hotels()[0]->rooms()[1]->id(), 1);
+  for (auto reservation : dataSource->planning().reservations())
+    ASSERT_NE(lastId, reservation->id());
+}
+
+TEST_F(LogStorage, CrashBetweenSnapshotAndLogRotation)
+{
+  {
+    auto dataSource = openDataSource();
+    auto roomId = storeHotel(*dataSource);
+    storeReservations(*dataSource, roomId, 3);
+  }
+
+  // Keep the log of the first generation and let the backend compact it
+  auto oldLogPath = std::string(logPath) + ".old";
+  {
+    std::ifstream source(logPath, std::ios::binary);
+    std::ofstream copy(oldLogPath, std::ios::binary | std::ios::trunc);
+    copy << source.rdbuf();
+  }
+  {
+    auto dataSource = openDataSource(1);
+    storeReservations(*dataSource, dataSource->hotels().hotels()[0]->rooms()[0]->id(), 1, 3);
+  }
+  std::rename(oldLogPath.c_str(), logPath);
+
+  // The snapshot already holds the data of the old log, which must not be applied again
+  auto dataSource = openDataSource();
+  ASSERT_EQ(1u, dataSource->hotels().hotels().size());
+  ASSERT_EQ(4u, dataSource->planning().reservations().size());
+}
+
+TEST_F(LogStorage, FailedRotationKeepsLog)
+{
+  // A directory in place of the temporary file keeps the backend from replacing the log after writing the snapshot.
+  // It is not empty, such that the backend cannot remove it.
+  auto temporaryPath = std::string(logPath) + ".tmp";
+  auto blockingPath = temporaryPath + "/file";
+  ASSERT_EQ(0, ::mkdir(temporaryPath.c_str(), 0755));
+  std::ofstream(blockingPath).put('x');
+  {
+    auto dataSource = openDataSource(1024);
+    auto roomId = storeHotel(*dataSource);
+    storeReservations(*dataSource, roomId, 30);
+    // The compaction runs while the backend is idle, before this task
+    storeReservations(*dataSource, roomId, 1, 30);
+  }
+  ASSERT_LT(1024, fileSize(logPath));
+
+  // Changes appended to the log after the failed rotation are not taken for a part of the snapshot
+  {
+    auto dataSource = openDataSource();
+    storeReservations(*dataSource, dataSource->hotels().hotels()[0]->rooms()[0]->id(), 1, 31);
+  }
+  std::remove(blockingPath.c_str());
+  ::rmdir(temporaryPath.c_str());
+
+  // The compaction succeeds once the log can be replaced
+  {
+    auto dataSource = openDataSource(1024);
+    ASSERT_EQ(1u, dataSource->hotels().hotels().size());
+    ASSERT_EQ(32u, dataSource->planning().reservations().size());
+    storeReservations(*dataSource, dataSource->hotels().hotels()[0]->rooms()[0]->id(), 1, 32);
+    storeReservations(*dataSource, dataSource->hotels().hotels()[0]->rooms()[0]->id(), 1, 33);
+  }
+  ASSERT_GT(1024, fileSize(logPath));
+
+  auto dataSource = openDataSource(1024);
+  ASSERT_EQ(34u, dataSource->planning().reservations().size());
+}
+
+TEST_F(LogStorage, QueuedTasksShareOneSync)
+{
+  using namespace boost::gregorian;
+  const int numberOfTasks = 50;
+  std::atomic<int> commits(0);
+  {
+    persistence::DataSource dataSource(std::make_unique<CountingLogBackend>(commits));
+    waitForAllOperations(dataSource);
+    auto roomId = storeHotel(dataSource);
+
+    // The small tasks are queued while the backend is busy with the first one
+    persistence::op::Operations busyWork;
+    for (int i = 0; i < 1000; ++i)
+      busyWork.push_back(persistence::op::StoreNewReservation{std::make_unique<hotel::Reservation>(
+          "Busy", roomId, date_period(date(2017, 1, 1) + days(i), date(2017, 1, 2) + days(i)))});
+    auto busyTask = dataSource.queueOperations(std::move(busyWork));
+    std::vector<persistence::op::Task<persistence::op::OperationResults>> tasks;
+    for (int i = 0; i < numberOfTasks; ++i)
+      tasks.push_back(dataSource.queueOperation(persistence::op::StoreNewReservation{std::make_unique<hotel::Reservation>(
+          "Small", roomId, date_period(date(2020, 1, 1) + days(i), date(2020, 1, 2) + days(i)))}));
+    commits = 0;
+    waitForAllOperations(dataSource);
+
+    ASSERT_GT(numberOfTasks / 2, commits.load());
+    for (auto& task : tasks)
+    {
+      ASSERT_EQ(1u, task.results().size());
+      ASSERT_NE(nullptr, boost::get<persistence::op::StoreNewReservationResult>(&task.results()[0]));
+    }
+    ASSERT_EQ(1000u + numberOfTasks, dataSource.planning().reservations().size());
+  }
+
+  auto dataSource = openDataSource();
+  ASSERT_EQ(1000u + numberOfTasks, dataSource->planning().reservations().size());
+}
+
+TEST_F(LogStorage, UnavailableLogFailsTasks)
+{
+  // The directory of the log does not exist, the data can only be kept in memory
+  persistence::DataSource dataSource(std::make_unique<persistence::log::LogBackend>("missing/test.log"));
+  auto hotel = std::make_unique<hotel::Hotel>("Hotel 1");
+  hotel->addRoomCategory(std::make_unique<hotel::RoomCategory>("cat", "Category"));
+  hotel->addRoom(std::make_unique<hotel::HotelRoom>("Room 1"), "cat");
+  auto task = dataSource.queueOperation(persistence::op::StoreNewHotel{std::move(hotel)});
+  waitForTask(dataSource, task);
+
+  ASSERT_EQ(2u, task.results().size());
+  ASSERT_NE(nullptr, boost::get<persistence::op::StoreNewHotelResult>(&task.results()[0]));
+  ASSERT_NE(nullptr, boost::get<persistence::op::CommitFailedResult>(&task.results()[1]));
+  waitForAllOperations(dataSource);
+  ASSERT_TRUE(dataSource.hotels().hotels().empty());
+
+  // The backend has undone the changes of the failed task as well
+  auto load = dataSource.queueOperation(persistence::op::LoadInitialData());
+  waitForTask(dataSource, load);
+  ASSERT_TRUE(dataSource.hotels().hotels().empty());
+}
+
+TEST(LogFile, AppendReplayAndRotate)
+{
+  std::remove(logPath);
+  {
+    persistence::log::LogFile log;
+    ASSERT_TRUE(log.open(logPath));
+    ASSERT_EQ(1u, log.generation());
+    log.append({'a', 'b'});
+    log.append({});
+    log.append({'c'});
+    ASSERT_TRUE(log.sync());
+  }
+
+  persistence::log::LogFile log;
+  ASSERT_TRUE(log.open(logPath));
+  std::vector<std::string> records;
+  ASSERT_TRUE(log.replay([&](const char* data, size_t size) { records.emplace_back(data, size); }));
+  ASSERT_EQ((std::vector<std::string>{"ab", "", "c"}), records);
+
+  log.append({'d'});
+  ASSERT_TRUE(log.rotate(2));
+  ASSERT_EQ(2u, log.generation());
+  records.clear();
+  ASSERT_TRUE(log.replay([&](const char* data, size_t size) { records.emplace_back(data, size); }));
+  ASSERT_EQ((std::vector<std::string>{"d"}), records);
+  std::remove(logPath);
+}
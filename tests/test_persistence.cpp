@@ -1,36 +1,41 @@
 #include "gtest/gtest.h"
 
+#include "persistence/columnar/columnar.h"
 #include "persistence/datasource.h"
+#include "persistence/executor.h"
+#include "persistence/exporter/planningexporter.h"
+#include "persistence/importer/csvimporter.h"
+#include "persistence/json/jsonimporter.h"
+#include "persistence/json/jsonreader.h"
+#include "persistence/json/jsonserializer.h"
+#include "persistence/memory/memorybackend.h"
+#include "persistence/mpscqueue.h"
 #include "persistence/op/operations.h"
+#include "persistence/op/taskawaitable.h"
+#include "persistence/snapshot/snapshot.h"
+#include "persistence/sqlite/sqlitebackend.h"
+#include "persistence/sqlite/sqlitechangefeed.h"
+#include "persistence/sqlite/sqlitemigrations.h"
+#include "persistence/sqlite/sqlitestatement.h"
+#include "persistence/wakeupnotifier.h"
 
 #include "hotel/hotelcollection.h"
 
-#include <condition_variable>
-
+#include "tests/testutils.h"
 
-void waitForAllOperations(persistence::DataSource& ds)
-{
-  std::mutex mutex;
-  std::unique_lock<std::mutex> lock(mutex);
-  std::condition_variable condition;
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 
-  ds.taskCompletedSignal().connect([&](int) { condition.notify_one(); });
-
-  while(ds.pendingOperationsCount() != 0)
-  {
-    ds.processIntegrationQueue();
-    condition.wait_for(lock, std::chrono::milliseconds(10));
-  }
-
-  ds.taskCompletedSignal().disconnect_all_slots();
-}
-
-void waitForTask(persistence::DataSource& ds, persistence::op::Task<persistence::op::OperationResults>& task)
-{
-  // Waits for one task to complete and to be integrated
-  task.waitForCompletion();
-  ds.processIntegrationQueue();
-}
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <set>
+#include <thread>
 
 
 class Persistence : public testing::Test
@@ -131,3 +136,1543 @@ TEST_F(Persistence, ReservationPersistence)
   }
 }
 
+
+TEST_F(Persistence, BulkPersistence)
+{
+  // Enough operations of the same kind in one batch take the bulk storage path
+  const int numberOfHotels = 20;
+  const int numberOfReservations = 250;
+  std::vector<int> reservationIds;
+
+  {
+    persistence::DataSource dataSource("test.db");
+    persistence::op::Operations hotelOperations;
+    for (int i = 0; i < numberOfHotels; ++i)
+    {
+      auto hotel = makeNewHotel("Hotel " + std::to_string(i), "Category", 3);
+      hotelOperations.push_back(persistence::op::StoreNewHotel{std::make_unique<hotel::Hotel>(hotel)});
+    }
+    auto hotelsTask = dataSource.queueOperations(std::move(hotelOperations));
+    waitForTask(dataSource, hotelsTask);
+    ASSERT_EQ(static_cast<size_t>(numberOfHotels), dataSource.hotels().hotels().size());
+
+    // Every object must have received a distinct id
+    std::set<int> roomIds;
+    for (auto room : dataSource.hotels().allRooms())
+      roomIds.insert(room->id());
+    ASSERT_EQ(static_cast<size_t>(numberOfHotels * 3), roomIds.size());
+    ASSERT_EQ(0u, roomIds.count(0));
+
+    persistence::op::Operations reservationOperations;
+    auto roomId = dataSource.hotels().hotels()[0]->rooms()[0]->id();
+    for (int i = 0; i < numberOfReservations; ++i)
+    {
+      using namespace boost::gregorian;
+      auto reservation = std::make_unique<hotel::Reservation>("Reservation " + std::to_string(i), roomId,
+                                                              date_period(date(2017, 1, 1) + days(2 * i),
+                                                                          date(2017, 1, 1) + days(2 * i + 1)));
+      reservation->addContinuation(roomId + 1, date(2017, 1, 1) + days(2 * i + 2));
+      reservationOperations.push_back(persistence::op::StoreNewReservation{std::move(reservation)});
+    }
+    auto reservationsTask = dataSource.queueOperations(std::move(reservationOperations));
+    waitForTask(dataSource, reservationsTask);
+    ASSERT_EQ(static_cast<size_t>(numberOfReservations), dataSource.planning().reservations().size());
+
+    std::set<int> atomIds;
+    for (auto reservation : dataSource.planning().reservations())
+    {
+      reservationIds.push_back(reservation->id());
+      for (auto& atom : reservation->atoms())
+        atomIds.insert(atom.id());
+    }
+    ASSERT_EQ(static_cast<size_t>(2 * numberOfReservations), atomIds.size());
+    ASSERT_EQ(0u, atomIds.count(0));
+  }
+
+  // Check data after reopening the database
+  {
+    persistence::DataSource dataSource("test.db");
+    waitForAllOperations(dataSource);
+    ASSERT_EQ(static_cast<size_t>(numberOfHotels), dataSource.hotels().hotels().size());
+    ASSERT_EQ(static_cast<size_t>(numberOfReservations), dataSource.planning().reservations().size());
+    for (auto reservation : dataSource.planning().reservations())
+    {
+      ASSERT_NE(reservationIds.end(), std::find(reservationIds.begin(), reservationIds.end(), reservation->id()));
+      ASSERT_EQ(2u, reservation->atoms().size());
+    }
+  }
+}
+
+TEST_F(Persistence, WindowedPlanningLoad)
+{
+  using namespace boost::gregorian;
+  auto hotel = makeNewHotel("Hotel 1", "Category 1", 1);
+
+  // Store one reservation per year
+  {
+    persistence::DataSource dataSource("test.db");
+    auto roomId = storeHotel(dataSource, hotel).rooms()[0]->id();
+    persistence::op::Operations operations;
+    for (int year = 2010; year <= 2017; ++year)
+      operations.push_back(persistence::op::StoreNewReservation{std::make_unique<hotel::Reservation>(
+          "Reservation " + std::to_string(year), roomId, date_period(date(year, 6, 1), date(year, 6, 10)))});
+    auto task = dataSource.queueOperations(std::move(operations));
+    waitForTask(dataSource, task);
+    ASSERT_EQ(8u, dataSource.planning().reservations().size());
+  }
+
+  // Only the reservations around the initial window are loaded
+  {
+    persistence::DataSource dataSource("test.db", date_period(date(2017, 5, 1), date(2017, 7, 1)));
+    // The pages of the initial load are not requested again, neither before nor after it has been integrated
+    auto pendingOperations = dataSource.pendingOperationsCount();
+    dataSource.ensurePlanningLoaded(date_period(date(2017, 6, 1), date(2017, 6, 2)));
+    ASSERT_EQ(pendingOperations, dataSource.pendingOperationsCount());
+    waitForAllOperations(dataSource);
+    dataSource.ensurePlanningLoaded(date_period(date(2017, 6, 1), date(2017, 6, 2)));
+    ASSERT_EQ(0u, dataSource.pendingOperationsCount());
+    ASSERT_EQ(1u, dataSource.hotels().hotels().size());
+    ASSERT_EQ(1u, dataSource.planning().reservations().size());
+    ASSERT_EQ("Reservation 2017", dataSource.planning().reservations()[0]->description());
+
+    // Loading further pages on demand
+    dataSource.ensurePlanningLoaded(date_period(date(2015, 6, 5), date(2015, 6, 6)));
+    waitForAllOperations(dataSource);
+    ASSERT_EQ(2u, dataSource.planning().reservations().size());
+    ASSERT_EQ("Reservation 2015", dataSource.planning().reservations()[1]->description());
+
+    // Requesting an already loaded period does not load anything twice
+    dataSource.ensurePlanningLoaded(date_period(date(2015, 6, 1), date(2017, 6, 10)));
+    waitForAllOperations(dataSource);
+    ASSERT_EQ(3u, dataSource.planning().reservations().size());
+
+    // Loading the initial data anew resets the planning, the pages are requested again afterwards
+    dataSource.queueOperation(persistence::op::LoadInitialData{date_period(date(2017, 5, 1), date(2017, 7, 1))});
+    waitForAllOperations(dataSource);
+    ASSERT_EQ(1u, dataSource.planning().reservations().size());
+    dataSource.ensurePlanningLoaded(date_period(date(2015, 6, 5), date(2015, 6, 6)));
+    waitForAllOperations(dataSource);
+    ASSERT_EQ(2u, dataSource.planning().reservations().size());
+  }
+}
+
+TEST_F(Persistence, StreamedInitialLoad)
+{
+  using namespace boost::gregorian;
+  const int numberOfReservations = 600;
+
+  {
+    persistence::DataSource dataSource("test.db");
+    auto roomId = storeHotel(dataSource, makeNewHotel("Hotel 1", "Category 1", 1)).rooms()[0]->id();
+    persistence::op::Operations operations;
+    for (int i = 0; i < numberOfReservations; ++i)
+      operations.push_back(persistence::op::StoreNewReservation{std::make_unique<hotel::Reservation>(
+          "Reservation " + std::to_string(i), roomId,
+          date_period(date(2017, 1, 1) + days(i), date(2017, 1, 2) + days(i)))});
+    auto task = dataSource.queueOperations(std::move(operations));
+    waitForTask(dataSource, task);
+  }
+
+  // Without any time budget, one chunk of the initial data is integrated per call
+  persistence::DataSource dataSource("test.db");
+  std::set<size_t> observedSizes;
+  while (dataSource.pendingOperationsCount() != 0)
+  {
+    if (!dataSource.processIntegrationQueue(std::chrono::steady_clock::duration::zero()))
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    observedSizes.insert(dataSource.planning().reservations().size());
+  }
+
+  ASSERT_EQ(1u, dataSource.hotels().hotels().size());
+  ASSERT_EQ(static_cast<size_t>(numberOfReservations), dataSource.planning().reservations().size());
+  ASSERT_LT(2u, observedSizes.size());
+  ASSERT_LT(0u, *std::next(observedSizes.begin()));
+  ASSERT_GT(static_cast<size_t>(numberOfReservations), *std::next(observedSizes.begin()));
+}
+
+TEST_F(Persistence, TaskPrioritiesAndCancellation)
+{
+  using namespace boost::gregorian;
+  using persistence::op::TaskPriority;
+  persistence::DataSource dataSource("test.db");
+  auto roomId = storeHotel(dataSource, makeNewHotel("Hotel 1", "Category 1", 1)).rooms()[0]->id();
+
+  std::mutex mutex;
+  std::vector<int> completionOrder;
+  dataSource.taskCompletedSignal().connect([&](int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    completionOrder.push_back(id);
+  });
+
+  auto reservationAt = [&](int day) {
+    return persistence::op::StoreNewReservation{std::make_unique<hotel::Reservation>(
+        "Reservation", roomId, date_period(date(2017, 1, 1) + days(day), date(2017, 1, 2) + days(day)))};
+  };
+
+  // Keep the backend busy, such that all of the following tasks are queued at the same time
+  persistence::op::Operations busyWork;
+  for (int i = 0; i < 1000; ++i)
+    busyWork.push_back(reservationAt(i));
+  auto busyTask = dataSource.queueOperations(std::move(busyWork), TaskPriority::Bulk);
+  while (!busyTask.started())
+    std::this_thread::yield();
+
+  auto bulkTask = dataSource.queueOperation(reservationAt(2000), TaskPriority::Bulk);
+  auto cancelledTask = dataSource.queueOperation(reservationAt(2001), TaskPriority::Bulk);
+  auto normalTask = dataSource.queueOperation(reservationAt(2002), TaskPriority::Normal);
+  std::vector<persistence::op::Task<persistence::op::OperationResults>> interactiveTasks;
+  for (int i = 0; i < 10; ++i)
+    interactiveTasks.push_back(dataSource.queueOperation(reservationAt(2010 + i), TaskPriority::Interactive));
+
+  ASSERT_FALSE(cancelledTask.waitForCompletion(std::chrono::milliseconds(1)));
+  ASSERT_TRUE(cancelledTask.cancel());
+  ASSERT_TRUE(cancelledTask.completed());
+  ASSERT_TRUE(cancelledTask.cancelled());
+
+  waitForAllOperations(dataSource);
+  ASSERT_TRUE(busyTask.completed());
+  ASSERT_FALSE(busyTask.cancel());
+  ASSERT_FALSE(normalTask.cancelled());
+  ASSERT_EQ(1000u + 12u, dataSource.planning().reservations().size());
+
+  auto position = [&](int id) {
+    return std::find(completionOrder.begin(), completionOrder.end(), id) - completionOrder.begin();
+  };
+  ASSERT_LT(position(busyTask.uniqueId()), position(interactiveTasks[0].uniqueId()));
+  ASSERT_LT(position(interactiveTasks[0].uniqueId()), position(normalTask.uniqueId()));
+  ASSERT_LT(position(normalTask.uniqueId()), position(bulkTask.uniqueId()));
+
+  // Lower classes are not starved by a steady stream of higher priority tasks
+  ASSERT_LT(position(normalTask.uniqueId()), position(interactiveTasks.back().uniqueId()));
+}
+
+TEST_F(Persistence, OptimisticOperations)
+{
+  using namespace boost::gregorian;
+  persistence::DataSource dataSource("test.db");
+  auto& hotel = storeHotel(dataSource, makeNewHotel("Hotel 1", "Category 1", 2));
+  auto roomId = hotel.rooms()[0]->id();
+  auto otherRoomId = hotel.rooms()[1]->id();
+  auto reservationAt = [&](int room, int day) {
+    return persistence::op::StoreNewReservation{std::make_unique<hotel::Reservation>(
+        "Reservation", room, date_period(date(2017, 1, 1) + days(day), date(2017, 1, 2) + days(day)))};
+  };
+  auto reservationsInRoom = [&]() {
+    std::vector<const hotel::Reservation*> result;
+    for (auto reservation : dataSource.planning().reservations())
+      if (reservation->atoms().front().roomId() == roomId)
+        result.push_back(reservation);
+    return result;
+  };
+
+  // New reservations show up right away and are confirmed by the backend later
+  dataSource.queueOptimisticOperation(reservationAt(roomId, 0));
+  ASSERT_EQ(1u, reservationsInRoom().size());
+  auto assignedId = reservationsInRoom()[0]->id();
+  ASSERT_LT(0, assignedId);
+  waitForAllOperations(dataSource);
+  ASSERT_EQ(1u, reservationsInRoom().size());
+  auto storedId = reservationsInRoom()[0]->id();
+  ASSERT_EQ(assignedId, storedId);
+
+  // Deletions are applied right away
+  dataSource.queueOptimisticOperation(persistence::op::DeleteReservation{storedId});
+  ASSERT_EQ(0u, reservationsInRoom().size());
+  waitForAllOperations(dataSource);
+  ASSERT_EQ(0u, reservationsInRoom().size());
+
+  // Changes of cancelled tasks are rolled back
+  auto confirmed = dataSource.queueOperation(reservationAt(roomId, 1));
+  waitForTask(dataSource, confirmed);
+  persistence::op::Operations busyWork;
+  for (int i = 0; i < 1000; ++i)
+    busyWork.push_back(reservationAt(otherRoomId, i));
+  auto busyTask = dataSource.queueOperations(std::move(busyWork));
+  while (!busyTask.started())
+    std::this_thread::yield();
+
+  persistence::op::Operations operations;
+  operations.push_back(reservationAt(roomId, 2));
+  operations.push_back(persistence::op::DeleteReservation{reservationsInRoom()[0]->id()});
+  auto cancelledTask = dataSource.queueOptimisticOperations(std::move(operations));
+  ASSERT_EQ(1u, reservationsInRoom().size());
+  ASSERT_EQ(date(2017, 1, 3), reservationsInRoom()[0]->dateRange().begin());
+
+  ASSERT_TRUE(cancelledTask.cancel());
+  waitForAllOperations(dataSource);
+  ASSERT_EQ(1u, reservationsInRoom().size());
+  ASSERT_EQ(date(2017, 1, 2), reservationsInRoom()[0]->dateRange().begin());
+
+  // A conflicting reservation rejects the whole batch
+  operations.clear();
+  operations.push_back(persistence::op::DeleteReservation{reservationsInRoom()[0]->id()});
+  operations.push_back(reservationAt(roomId, 3));
+  operations.push_back(reservationAt(roomId, 3));
+  auto rejectedTask = dataSource.queueOptimisticOperations(std::move(operations));
+  ASSERT_TRUE(rejectedTask.cancelled());
+  ASSERT_EQ(1u, reservationsInRoom().size());
+  ASSERT_EQ(date(2017, 1, 2), reservationsInRoom()[0]->dateRange().begin());
+  waitForAllOperations(dataSource);
+  ASSERT_EQ(1u, reservationsInRoom().size());
+}
+
+TEST_F(Persistence, OptimisticDeleteBeforeStore)
+{
+  using namespace boost::gregorian;
+  int roomId = 0;
+  int reservationId = 0;
+  {
+    persistence::DataSource dataSource("test.db");
+    auto& hotel = storeHotel(dataSource, makeNewHotel("Hotel 1", "Category 1", 1));
+    roomId = hotel.rooms()[0]->id();
+
+    // The reservation is deleted again before the result of storing it has been integrated
+    auto reservation = std::make_unique<hotel::Reservation>(makeNewReservation("Guest", roomId));
+    auto store = dataSource.queueOptimisticOperation(persistence::op::StoreNewReservation{std::move(reservation)});
+    reservationId = dataSource.planning().reservations().front()->id();
+    ASSERT_LT(0, reservationId);
+    dataSource.queueOptimisticOperation(persistence::op::DeleteReservation{reservationId});
+    ASSERT_TRUE(dataSource.planning().reservations().empty());
+
+    store.waitForCompletion();
+    dataSource.processIntegrationQueue();
+    ASSERT_EQ(nullptr, dataSource.planning().getReservationById(reservationId));
+    waitForAllOperations(dataSource);
+    ASSERT_TRUE(dataSource.planning().reservations().empty());
+  }
+  {
+    persistence::DataSource dataSource("test.db");
+    waitForAllOperations(dataSource);
+    ASSERT_TRUE(dataSource.planning().reservations().empty());
+  }
+}
+
+TEST_F(Persistence, OptimisticDeleteAfterWindowLoad)
+{
+  using namespace boost::gregorian;
+  auto roomId = 0;
+  {
+    persistence::DataSource dataSource("test.db");
+    roomId = storeHotel(dataSource, makeNewHotel("Hotel 1", "Category 1", 1)).rooms()[0]->id();
+    storeReservation(dataSource, makeNewReservation("Guest", roomId));
+  }
+
+  persistence::DataSource dataSource("test.db", date_period(date(2016, 12, 1), date(2017, 2, 1)));
+  waitForAllOperations(dataSource);
+  ASSERT_EQ(1u, dataSource.planning().reservations().size());
+  auto reservationId = dataSource.planning().reservations()[0]->id();
+
+  // The window is loaded by the backend before the deletion, but its result is integrated afterwards
+  auto load = dataSource.queueOperation(
+      persistence::op::LoadPlanningWindow{date_period(date(2017, 1, 1), date(2017, 2, 1))});
+  load.waitForCompletion();
+  dataSource.queueOptimisticOperation(persistence::op::DeleteReservation{reservationId});
+  ASSERT_TRUE(dataSource.planning().reservations().empty());
+
+  dataSource.processIntegrationQueue();
+  ASSERT_EQ(nullptr, dataSource.planning().getReservationById(reservationId));
+  waitForAllOperations(dataSource);
+  ASSERT_TRUE(dataSource.planning().reservations().empty());
+}
+
+TEST_F(Persistence, FailedCommit)
+{
+  {
+    persistence::DataSource dataSource("test.db");
+    auto roomId = storeHotel(dataSource, makeNewHotel("Hotel 1", "Category 1", 1)).rooms()[0]->id();
+
+    // A reader holding the database keeps the backend from committing
+    sqlite3* db = nullptr;
+    ASSERT_EQ(SQLITE_OK, sqlite3_open("test.db", &db));
+    ASSERT_EQ(SQLITE_OK, sqlite3_exec(db, "BEGIN; SELECT COUNT(*) FROM h_hotel;", nullptr, nullptr, nullptr));
+    auto task = dataSource.queueOptimisticOperation(persistence::op::StoreNewReservation{
+        std::make_unique<hotel::Reservation>(makeNewReservation("Failed", roomId))});
+    ASSERT_EQ(1u, dataSource.planning().reservations().size());
+    waitForTask(dataSource, task);
+    ASSERT_NE(nullptr, boost::get<persistence::op::CommitFailedResult>(&task.results().back()));
+    ASSERT_TRUE(dataSource.planning().reservations().empty());
+    ASSERT_EQ(SQLITE_OK, sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr));
+    sqlite3_close(db);
+
+    // The changes of the failed task are not committed along with the next one
+    task = dataSource.queueOperation(persistence::op::StoreNewReservation{
+        std::make_unique<hotel::Reservation>(makeNewReservation("Stored", roomId))});
+    waitForTask(dataSource, task);
+    ASSERT_EQ(1u, task.results().size());
+    ASSERT_EQ(1u, dataSource.planning().reservations().size());
+  }
+
+  persistence::DataSource dataSource("test.db");
+  waitForAllOperations(dataSource);
+  ASSERT_EQ(1u, dataSource.planning().reservations().size());
+  ASSERT_EQ("Stored", dataSource.planning().reservations()[0]->description());
+}
+
+TEST_F(Persistence, ClientAssignedIds)
+{
+  using namespace boost::gregorian;
+  int hotelId = 0;
+  int reservationId = 0;
+  {
+    persistence::DataSource dataSource("test.db");
+    waitForAllOperations(dataSource);
+
+    // The reservation refers to a room of the hotel stored in the same batch
+    persistence::op::Operations operations;
+    operations.push_back(
+        persistence::op::StoreNewHotel{std::make_unique<hotel::Hotel>(makeNewHotel("Hotel 1", "Category 1", 2))});
+    dataSource.assignIds(operations);
+    auto& newHotel = *boost::get<persistence::op::StoreNewHotel>(operations[0]).newHotel;
+    hotelId = newHotel.id();
+    ASSERT_LT(0, hotelId);
+    ASSERT_LT(0, newHotel.categories()[0]->id());
+    ASSERT_LT(0, newHotel.rooms()[0]->id());
+    ASSERT_NE(newHotel.rooms()[0]->id(), newHotel.rooms()[1]->id());
+
+    auto reservation =
+        std::make_unique<hotel::Reservation>(makeNewReservation("Reservation", newHotel.rooms()[1]->id()));
+    operations.push_back(persistence::op::StoreNewReservation{std::move(reservation)});
+    dataSource.assignIds(operations);
+    reservationId = boost::get<persistence::op::StoreNewReservation>(operations[1]).newReservation->id();
+    ASSERT_LT(0, reservationId);
+
+    auto task = dataSource.queueOperations(std::move(operations));
+    waitForTask(dataSource, task);
+    ASSERT_EQ(hotelId, dataSource.hotels().hotels()[0]->id());
+    ASSERT_NE(nullptr, dataSource.planning().getReservationById(reservationId));
+  }
+
+  // The ids have been stored as assigned, and leased ids are not handed out again after erasing all data
+  {
+    persistence::DataSource dataSource("test.db");
+    waitForAllOperations(dataSource);
+    ASSERT_EQ(hotelId, dataSource.hotels().hotels()[0]->id());
+    auto reservation = dataSource.planning().getReservationById(reservationId);
+    ASSERT_NE(nullptr, reservation);
+    ASSERT_EQ(dataSource.hotels().hotels()[0]->rooms()[1]->id(), reservation->atoms()[0].roomId());
+
+    auto erase = dataSource.queueOperation(persistence::op::EraseAllData());
+    waitForTask(dataSource, erase);
+  }
+  {
+    persistence::DataSource dataSource("test.db");
+    auto& storedHotel = storeHotel(dataSource, makeNewHotel("Hotel 2", "Category 1", 1));
+    ASSERT_LT(hotelId, storedHotel.id());
+  }
+}
+
+TEST_F(Persistence, ConcurrentlyAssignedIds)
+{
+  persistence::DataSource dataSource("test.db");
+  waitForAllOperations(dataSource);
+
+  // Operations may be queued from any thread, neither the task ids nor the leased ids are handed out twice
+  std::vector<std::thread> threads;
+  std::vector<std::vector<int>> taskIds(4);
+  for (int t = 0; t < 4; ++t)
+  {
+    threads.emplace_back([this, &dataSource, &taskIds, t]() {
+      for (int i = 0; i < 25; ++i)
+      {
+        auto name = "Hotel " + std::to_string(t) + "/" + std::to_string(i);
+        auto task = dataSource.queueOperation(
+            persistence::op::StoreNewHotel{std::make_unique<hotel::Hotel>(makeNewHotel(name, "Category", 2))});
+        taskIds[t].push_back(task.uniqueId());
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  waitForAllOperations(dataSource);
+
+  std::set<int> uniqueTaskIds;
+  for (auto& ids : taskIds)
+    uniqueTaskIds.insert(ids.begin(), ids.end());
+  ASSERT_EQ(100u, uniqueTaskIds.size());
+
+  std::set<int> hotelIds;
+  std::set<int> roomIds;
+  for (auto& hotel : dataSource.hotels().hotels())
+  {
+    hotelIds.insert(hotel->id());
+    for (auto& room : hotel->rooms())
+      roomIds.insert(room->id());
+  }
+  ASSERT_EQ(100u, dataSource.hotels().hotels().size());
+  ASSERT_EQ(100u, hotelIds.size());
+  ASSERT_EQ(200u, roomIds.size());
+}
+
+TEST_F(Persistence, ImportThenStore)
+{
+  // A document whose ids collide with the ids which the database leases for new objects
+  persistence::DataSource source(std::make_unique<persistence::memory::MemoryBackend>());
+  waitForAllOperations(source);
+  source.queueOperation(persistence::op::StoreNewHotel{
+      std::make_unique<hotel::Hotel>(makeNewHotel("Imported hotel", "Category 1", 2))});
+  waitForAllOperations(source);
+  auto importedRoomId = source.hotels().hotels()[0]->rooms()[1]->id();
+  source.queueOperation(persistence::op::StoreNewReservation{
+      std::make_unique<hotel::Reservation>(makeNewReservation("Imported reservation", importedRoomId))});
+  waitForAllOperations(source);
+  persistence::json::JsonSerializer serializer;
+  std::stringstream hotelsJson(serializer.serializeHotelCollection(source.hotels()).dump());
+  std::stringstream planningJson(serializer.serializePlanning(source.planning()).dump());
+
+  {
+    persistence::DataSource dataSource("test.db");
+    waitForAllOperations(dataSource);
+    persistence::json::JsonImporter importer(dataSource);
+    persistence::json::JsonReader hotelsReader(hotelsJson);
+    ASSERT_TRUE(importer.importHotelCollection(hotelsReader)) << importer.errorMessage();
+    persistence::json::JsonReader planningReader(planningJson);
+    ASSERT_TRUE(importer.importPlanning(planningReader)) << importer.errorMessage();
+
+    // New objects get ids which the import has not taken
+    auto task = dataSource.queueOperation(persistence::op::StoreNewHotel{
+        std::make_unique<hotel::Hotel>(makeNewHotel("New hotel", "Category 1", 2))});
+    waitForTask(dataSource, task);
+    ASSERT_EQ(1u, task.results().size());
+    ASSERT_NE(nullptr, boost::get<persistence::op::StoreNewHotelResult>(&task.results()[0]));
+    auto newRoomId = dataSource.hotels().hotels()[1]->rooms()[0]->id();
+    task = dataSource.queueOperation(persistence::op::StoreNewReservation{
+        std::make_unique<hotel::Reservation>(makeNewReservation("New reservation", newRoomId))});
+    waitForTask(dataSource, task);
+    ASSERT_EQ(1u, task.results().size());
+    ASSERT_NE(nullptr, boost::get<persistence::op::StoreNewReservationResult>(&task.results()[0]));
+  }
+
+  persistence::DataSource dataSource("test.db");
+  waitForAllOperations(dataSource);
+  auto& hotels = dataSource.hotels().hotels();
+  ASSERT_EQ(2u, hotels.size());
+  ASSERT_EQ(*source.hotels().hotels()[0], *hotels[0]);
+  ASSERT_EQ("New hotel", hotels[1]->name());
+  ASSERT_NE(hotels[0]->id(), hotels[1]->id());
+  ASSERT_EQ(2u, dataSource.planning().reservations().size());
+  for (auto reservation : dataSource.planning().reservations())
+  {
+    auto& hotel = reservation->description() == "New reservation" ? hotels[1] : hotels[0];
+    auto roomIndex = reservation->description() == "New reservation" ? 0 : 1;
+    ASSERT_EQ(hotel->rooms()[roomIndex]->id(), reservation->atoms()[0].roomId());
+  }
+}
+
+TEST_F(Persistence, CsvImportThenStore)
+{
+  int existingId = 0;
+  int newId = 0;
+  {
+    persistence::DataSource dataSource("test.db");
+    auto& hotel = storeHotel(dataSource, makeNewHotel("Hotel 1", "Category 1", 3));
+    auto roomId = hotel.rooms()[0]->id();
+    auto otherRoomId = hotel.rooms()[1]->id();
+    existingId = storeReservation(dataSource, makeNewReservation("Existing", roomId)).id();
+
+    // The id of the table is taken already
+    std::string table = "reservation_id,description,status,adults,children,room_id,from,to\n" +
+                        std::to_string(existingId) + ",Imported,2,2,0," + std::to_string(otherRoomId) +
+                        ",2017-01-01,2017-01-05\n";
+    persistence::ThreadPoolExecutor executor(2);
+    persistence::importer::CsvImporter importer(executor);
+    ASSERT_TRUE(importer.parse(table.data(), table.size())) << importer.errorMessage();
+    ASSERT_TRUE(importer.validate(dataSource.planning())) << importer.errorMessage();
+    auto task = importer.queueReservations(dataSource);
+    waitForTask(dataSource, task);
+    ASSERT_EQ(1u, task.results().size());
+    ASSERT_NE(nullptr, boost::get<persistence::op::StoreNewReservationResult>(&task.results()[0]));
+
+    // A reservation stored after the import gets an id of its own
+    task = dataSource.queueOperation(persistence::op::StoreNewReservation{
+        std::make_unique<hotel::Reservation>(makeNewReservation("New", hotel.rooms()[2]->id()))});
+    waitForTask(dataSource, task);
+    ASSERT_EQ(1u, task.results().size());
+    auto stored = boost::get<persistence::op::StoreNewReservationResult>(&task.results()[0]);
+    ASSERT_NE(nullptr, stored);
+    newId = stored->storedReservationId;
+  }
+
+  persistence::DataSource dataSource("test.db");
+  waitForAllOperations(dataSource);
+  std::set<int> ids;
+  std::set<std::string> descriptions;
+  for (auto reservation : dataSource.planning().reservations())
+  {
+    ids.insert(reservation->id());
+    descriptions.insert(reservation->description());
+  }
+  ASSERT_EQ(3u, ids.size());
+  ASSERT_EQ((std::set<std::string>{"Existing", "Imported", "New"}), descriptions);
+  ASSERT_EQ("Existing", dataSource.planning().getReservationById(existingId)->description());
+  ASSERT_EQ("New", dataSource.planning().getReservationById(newId)->description());
+}
+
+TEST_F(Persistence, SnapshotStartup)
+{
+  using namespace boost::gregorian;
+  std::vector<hotel::Reservation> expectedReservations;
+  int deletedId = 0;
+  {
+    persistence::DataSource dataSource(std::make_unique<persistence::sqlite::SqliteBackend>("test.db", 5));
+    auto roomId = storeHotel(dataSource, makeNewHotel("Hotel 1", "Category 1", 2)).rooms()[0]->id();
+
+    // Storing the reservations exceeds the snapshot interval
+    persistence::op::Operations operations;
+    for (int i = 0; i < 8; ++i)
+    {
+      auto begin = date(2017, 1, 1) + days(10 * i);
+      operations.push_back(persistence::op::StoreNewReservation{
+          std::make_unique<hotel::Reservation>("Reservation", roomId, date_period(begin, begin + days(5)))});
+    }
+    auto task = dataSource.queueOperations(std::move(operations));
+    waitForTask(dataSource, task);
+
+    // The snapshot is written in the background once the backend has run out of tasks
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!persistence::snapshot::SnapshotReader("test.db.snapshot").valid() &&
+           std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // These changes are not part of the snapshot
+    deletedId = dataSource.planning().reservations()[0]->id();
+    operations.clear();
+    operations.push_back(
+        persistence::op::StoreNewHotel{std::make_unique<hotel::Hotel>(makeNewHotel("Hotel 2", "Category 1", 1))});
+    operations.push_back(persistence::op::StoreNewReservation{std::make_unique<hotel::Reservation>(
+        "Late reservation", roomId, date_period(date(2018, 1, 1), date(2018, 1, 5)))});
+    operations.push_back(persistence::op::DeleteReservation{deletedId});
+    task = dataSource.queueOperations(std::move(operations));
+    waitForTask(dataSource, task);
+
+    for (auto reservation : dataSource.planning().reservations())
+      expectedReservations.push_back(*reservation);
+  }
+
+  {
+    persistence::snapshot::SnapshotReader reader("test.db.snapshot");
+    ASSERT_TRUE(reader.valid());
+    ASSERT_EQ(1u, reader.hotelCount());
+    ASSERT_EQ(8u, reader.reservationCount());
+  }
+
+  // The snapshot is completed with the changes made after it has been written
+  persistence::DataSource dataSource("test.db");
+  waitForAllOperations(dataSource);
+  ASSERT_EQ(2u, dataSource.hotels().hotels().size());
+  ASSERT_EQ("Hotel 2", dataSource.hotels().hotels()[1]->name());
+  ASSERT_EQ(1u, dataSource.hotels().hotels()[1]->rooms().size());
+  ASSERT_EQ(nullptr, dataSource.planning().getReservationById(deletedId));
+  ASSERT_EQ(expectedReservations.size(), dataSource.planning().reservations().size());
+  for (auto& expected : expectedReservations)
+  {
+    auto loaded = dataSource.planning().getReservationById(expected.id());
+    ASSERT_NE(nullptr, loaded);
+    ASSERT_EQ(expected, *loaded);
+    ASSERT_EQ(expected.atoms()[0].id(), loaded->atoms()[0].id());
+  }
+}
+
+namespace
+{
+  std::vector<nlohmann::json> readChangeFeed(boost::optional<int64_t>& watermark)
+  {
+    persistence::sqlite::SqliteStorage storage("test.db");
+    std::ostringstream stream;
+    persistence::json::JsonWriter writer(stream);
+    auto next = persistence::sqlite::writeChangeFeed(storage, watermark, writer);
+    EXPECT_TRUE(next.is_initialized());
+    watermark = next;
+
+    std::vector<nlohmann::json> lines;
+    std::istringstream feed(stream.str());
+    for (std::string line; std::getline(feed, line);)
+      lines.push_back(nlohmann::json::parse(line));
+    return lines;
+  }
+} // namespace
+
+TEST_F(Persistence, ChangeFeed)
+{
+  std::vector<int> ids;
+  {
+    persistence::DataSource dataSource("test.db");
+    auto roomId = storeHotel(dataSource, makeNewHotel("Hotel 1", "Category 1", 4)).rooms()[0]->id();
+    persistence::op::Operations operations;
+    for (int i = 0; i < 3; ++i)
+    {
+      auto reservation = makeNewReservation("Reservation " + std::to_string(i), roomId + i);
+      operations.push_back(persistence::op::StoreNewReservation{std::make_unique<hotel::Reservation>(reservation)});
+    }
+    auto task = dataSource.queueOperations(std::move(operations));
+    waitForTask(dataSource, task);
+    for (auto reservation : dataSource.planning().reservations())
+      ids.push_back(reservation->id());
+    std::sort(ids.begin(), ids.end());
+  }
+
+  // Without a watermark, the feed holds all reservations
+  boost::optional<int64_t> watermark;
+  auto lines = readChangeFeed(watermark);
+  ASSERT_EQ(3u, lines.size());
+  for (auto& line : lines)
+    ASSERT_EQ("upsert", line["op"]);
+  ASSERT_EQ("Reservation 0", lines[0]["reservation"]["description"]);
+  ASSERT_EQ(ids[0], lines[0]["reservation"]["id"]);
+  ASSERT_LE(lines[2]["seq"].get<int64_t>(), *watermark);
+
+  int newId = 0;
+  {
+    persistence::DataSource dataSource("test.db");
+    waitForAllOperations(dataSource);
+    auto roomId = dataSource.hotels().hotels()[0]->rooms()[3]->id();
+    auto task = dataSource.queueOperation(persistence::op::DeleteReservation{ids[1]});
+    waitForTask(dataSource, task);
+    task = dataSource.queueOperation(persistence::op::StoreNewReservation{
+        std::make_unique<hotel::Reservation>(makeNewReservation("Late", roomId))});
+    waitForTask(dataSource, task);
+    for (auto reservation : dataSource.planning().reservations())
+      if (reservation->description() == "Late")
+        newId = reservation->id();
+  }
+
+  // Only the changes after the watermark are part of the feed, in the order in which they have been made
+  lines = readChangeFeed(watermark);
+  ASSERT_EQ(2u, lines.size());
+  ASSERT_EQ("delete", lines[0]["op"]);
+  ASSERT_EQ(ids[1], lines[0]["id"]);
+  ASSERT_EQ("upsert", lines[1]["op"]);
+  ASSERT_EQ(newId, lines[1]["reservation"]["id"]);
+  ASSERT_LT(lines[0]["seq"].get<int64_t>(), lines[1]["seq"].get<int64_t>());
+  ASSERT_TRUE(readChangeFeed(watermark).empty());
+
+  // Pruning the change log, e.g. after a snapshot, keeps the tombstones
+  auto olderWatermark = watermark;
+  auto prunedPosition = *watermark + 1;
+  {
+    persistence::DataSource dataSource("test.db");
+    waitForAllOperations(dataSource);
+    auto task = dataSource.queueOperation(persistence::op::DeleteReservation{ids[0]});
+    waitForTask(dataSource, task);
+  }
+  {
+    persistence::sqlite::SqliteStorage storage("test.db");
+    storage.pruneChanges(storage.latestChange());
+    storage.pruneTombstones(std::time(nullptr) - 60);
+  }
+  auto unprunedWatermark = olderWatermark;
+  lines = readChangeFeed(unprunedWatermark);
+  ASSERT_EQ(1u, lines.size());
+  ASSERT_EQ("delete", lines[0]["op"]);
+  ASSERT_EQ(ids[0], lines[0]["id"]);
+
+  // Once the tombstones have expired, a feed from an older watermark starts over with the existing reservations
+  {
+    persistence::sqlite::SqliteStorage storage("test.db");
+    storage.pruneTombstones(std::time(nullptr) + 1);
+  }
+  lines = readChangeFeed(olderWatermark);
+  ASSERT_EQ(3u, lines.size());
+  ASSERT_EQ("reset", lines[0]["op"]);
+  ASSERT_EQ("upsert", lines[1]["op"]);
+  ASSERT_EQ("upsert", lines[2]["op"]);
+  ASSERT_EQ(prunedPosition, lines[0]["seq"].get<int64_t>());
+  ASSERT_TRUE(readChangeFeed(olderWatermark).empty());
+
+  // Erasing all data leaves no tombstones, the feed starts over instead
+  {
+    persistence::DataSource dataSource("test.db");
+    auto task = dataSource.queueOperation(persistence::op::EraseAllData());
+    waitForTask(dataSource, task);
+  }
+  lines = readChangeFeed(watermark);
+  ASSERT_EQ(1u, lines.size());
+  ASSERT_EQ("reset", lines[0]["op"]);
+  ASSERT_TRUE(readChangeFeed(watermark).empty());
+}
+
+TEST_F(Persistence, TaskResults)
+{
+  persistence::DataSource dataSource("test.db");
+  waitForAllOperations(dataSource);
+
+  // The integrator takes the stored objects over, the results of the task tell their ids
+  auto storeHotel = dataSource.queueOperation(
+      persistence::op::StoreNewHotel{std::make_unique<hotel::Hotel>(makeNewHotel("Hotel 1", "Category 1", 2))});
+  waitForTask(dataSource, storeHotel);
+  ASSERT_EQ(1u, storeHotel.results().size());
+  auto& storedHotelResult = boost::get<persistence::op::StoreNewHotelResult>(storeHotel.results()[0]);
+  ASSERT_EQ(nullptr, storedHotelResult.storedHotel);
+  ASSERT_EQ(1u, dataSource.hotels().hotels().size());
+  auto storedHotel = dataSource.hotels().findHotelById(storedHotelResult.storedHotelId);
+  ASSERT_NE(nullptr, storedHotel);
+  ASSERT_EQ(dataSource.hotels().hotels()[0].get(), storedHotel);
+  ASSERT_EQ(2u, storedHotel->rooms().size());
+
+  // A continuation returning a task shares the results of that task, they remain available to its other holders
+  auto roomId = storedHotel->rooms()[0]->id();
+  boost::optional<persistence::op::Task<persistence::op::OperationResults>> storeReservation;
+  auto workflow = storeHotel.then(dataSource.integrationExecutor(),
+                                  [&](persistence::op::Task<persistence::op::OperationResults>&) {
+                                    storeReservation = dataSource.queueOperation(persistence::op::StoreNewReservation{
+                                        std::make_unique<hotel::Reservation>(makeNewReservation("Guest", roomId))});
+                                    return *storeReservation;
+                                  });
+  while (!workflow.completed())
+  {
+    dataSource.processIntegrationQueue();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_FALSE(workflow.cancelled());
+  ASSERT_EQ(1u, workflow.results().size());
+  ASSERT_EQ(&storeReservation->results(), &workflow.results());
+  dataSource.processIntegrationQueue();
+  auto reservationId =
+      boost::get<persistence::op::StoreNewReservationResult>(workflow.results()[0]).storedReservationId;
+  auto storedReservation = dataSource.planning().getReservationById(reservationId);
+  ASSERT_NE(nullptr, storedReservation);
+  ASSERT_EQ("Guest", storedReservation->description());
+}
+
+TEST_F(Persistence, TaskContinuations)
+{
+  persistence::DataSource dataSource("test.db");
+  waitForAllOperations(dataSource);
+
+  // Continuations on the integration executor see the integrated results and can queue the next step
+  size_t hotelsSeen = 0;
+  size_t reservationsSeen = 0;
+  auto storeHotel = dataSource.queueOperation(
+      persistence::op::StoreNewHotel{std::make_unique<hotel::Hotel>(makeNewHotel("Hotel 1", "Category 1", 1))});
+  auto workflow =
+      storeHotel
+          .then(dataSource.integrationExecutor(),
+                [&](persistence::op::Task<persistence::op::OperationResults>&) {
+                  hotelsSeen = dataSource.hotels().hotels().size();
+                  auto roomId = dataSource.hotels().hotels()[0]->rooms()[0]->id();
+                  return dataSource.queueOperation(persistence::op::StoreNewReservation{
+                      std::make_unique<hotel::Reservation>(makeNewReservation("Reservation", roomId))});
+                })
+          .then(dataSource.integrationExecutor(), [&](persistence::op::Task<persistence::op::OperationResults>&) {
+            reservationsSeen = dataSource.planning().reservations().size();
+          });
+
+  while (!workflow.completed())
+  {
+    dataSource.processIntegrationQueue();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ(1u, hotelsSeen);
+  ASSERT_EQ(1u, reservationsSeen);
+
+  // Continuations of cancelled tasks run as well, here on a thread pool
+  persistence::ThreadPoolExecutor pool(2);
+  auto cancelledTask = dataSource.queueOperation(persistence::op::EraseAllData(), persistence::op::TaskPriority::Bulk);
+  cancelledTask.cancel();
+  std::atomic<bool> sawCancellation(false);
+  auto continuation = cancelledTask.then(
+      pool, [&](persistence::op::Task<persistence::op::OperationResults>& task) { sawCancellation = task.cancelled(); });
+  ASSERT_TRUE(continuation.waitForCompletion(std::chrono::seconds(10)));
+  ASSERT_TRUE(sawCancellation);
+
+  // A continuation returning a cancelled task is cancelled as well
+  auto cancelledWorkflow = storeHotel.then(pool, [](persistence::op::Task<persistence::op::OperationResults>&) {
+    persistence::op::Task<persistence::op::OperationResults> task(
+        persistence::op::makeTaskSharedState<persistence::op::OperationResults>(0));
+    task.cancel();
+    return task;
+  });
+  ASSERT_TRUE(cancelledWorkflow.waitForCompletion(std::chrono::seconds(10)));
+  ASSERT_TRUE(cancelledWorkflow.cancelled());
+  ASSERT_TRUE(cancelledWorkflow.results().empty());
+  waitForAllOperations(dataSource);
+}
+
+#ifdef HOTEL_WITH_COROUTINES
+namespace
+{
+  persistence::op::Workflow storeHotelAndReservation(persistence::DataSource& dataSource, hotel::Hotel hotel,
+                                                     std::vector<std::string>& log)
+  {
+    using persistence::op::awaitOn;
+    auto& executor = dataSource.integrationExecutor();
+    auto storeHotel = dataSource.queueOperation(persistence::op::StoreNewHotel{std::make_unique<hotel::Hotel>(hotel)});
+    co_await awaitOn(storeHotel, executor);
+    log.push_back("hotels: " + std::to_string(dataSource.hotels().hotels().size()));
+
+    using namespace boost::gregorian;
+    auto roomId = dataSource.hotels().hotels()[0]->rooms()[0]->id();
+    auto reservation =
+        std::make_unique<hotel::Reservation>("Reservation", roomId, date_period(date(2017, 1, 1), date(2017, 1, 5)));
+    auto storeReservation = dataSource.queueOperation(persistence::op::StoreNewReservation{std::move(reservation)});
+    co_await awaitOn(storeReservation, executor);
+    log.push_back("reservations: " + std::to_string(dataSource.planning().reservations().size()));
+  }
+} // namespace
+
+TEST_F(Persistence, TaskCoroutines)
+{
+  persistence::DataSource dataSource("test.db");
+  waitForAllOperations(dataSource);
+
+  std::vector<std::string> log;
+  storeHotelAndReservation(dataSource, makeNewHotel("Hotel 1", "Category 1", 1), log);
+  while (log.size() < 2)
+  {
+    dataSource.processIntegrationQueue();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ("hotels: 1", log[0]);
+  ASSERT_EQ("reservations: 1", log[1]);
+}
+#endif
+
+TEST_F(Persistence, SchemaMigration)
+{
+  // Create a database with the schema used before schema versioning was introduced
+  std::remove("test_legacy.db");
+  {
+    sqlite3* db = nullptr;
+    ASSERT_EQ(SQLITE_OK, sqlite3_open("test_legacy.db", &db));
+    auto sql = "CREATE TABLE h_hotel (id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, name TEXT NOT NULL);"
+               "CREATE TABLE h_room_category (id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, hotel_id INTEGER NOT "
+               "NULL, short_code TEXT NOT NULL, name TEXT NOT NULL);"
+               "CREATE TABLE h_room (id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, hotel_id INTEGER NOT NULL, "
+               "category_id INTEGER NOT NULL, name TEXT NOT NULL);"
+               "CREATE TABLE h_reservation (id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, description TEXT NOT "
+               "NULL, status TEXT NOT NULL, adults INTEGER NOT NULL, children INTEGER NOT NULL);"
+               "CREATE TABLE h_reservation_atom (id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, reservation_id "
+               "INTEGER NOT NULL, room_id INTEGER NOT NULL, date_from TEXT NOT NULL, date_to TEXT NOT NULL);"
+               "INSERT INTO h_hotel (id, name) VALUES (1, 'Hotel 1');"
+               "INSERT INTO h_room_category (id, hotel_id, short_code, name) VALUES (1, 1, 'C', 'Category');"
+               "INSERT INTO h_room (id, hotel_id, category_id, name) VALUES (1, 1, 1, 'Room 1');"
+               "INSERT INTO h_reservation (id, description, status, adults, children) "
+               "VALUES (1, 'Legacy', 'confirmed', 2, 1);"
+               "INSERT INTO h_reservation_atom (id, reservation_id, room_id, date_from, date_to) "
+               "VALUES (1, 1, 1, '20170101', '20170105');";
+    ASSERT_EQ(SQLITE_OK, sqlite3_exec(db, sql, nullptr, nullptr, nullptr));
+    sqlite3_close(db);
+  }
+
+  // Opening the database upgrades it in place, without losing data
+  {
+    persistence::DataSource dataSource("test_legacy.db");
+    waitForAllOperations(dataSource);
+    ASSERT_EQ(1u, dataSource.hotels().hotels().size());
+    ASSERT_EQ(1u, dataSource.planning().reservations().size());
+
+    auto& reservation = *dataSource.planning().reservations()[0];
+    ASSERT_EQ("Legacy", reservation.description());
+    ASSERT_EQ(hotel::Reservation::Confirmed, reservation.status());
+    ASSERT_EQ(2, reservation.numberOfAdults());
+    ASSERT_EQ(1, reservation.numberOfChildren());
+    using namespace boost::gregorian;
+    ASSERT_EQ(date_period(date(2017, 1, 1), date(2017, 1, 5)), reservation.dateRange());
+  }
+
+  sqlite3* db = nullptr;
+  ASSERT_EQ(SQLITE_OK, sqlite3_open("test_legacy.db", &db));
+  ASSERT_EQ(5, persistence::sqlite::latestSchemaVersion());
+  ASSERT_EQ(persistence::sqlite::latestSchemaVersion(), persistence::sqlite::schemaVersion(db));
+  int indexCount = 0;
+  persistence::sqlite::SqliteStatement indexQuery(
+      db, "SELECT COUNT(*) FROM sqlite_master WHERE type = 'index' AND name IN ('h_reservation_atom_room_idx', "
+          "'h_reservation_change_idx', 'h_reservation_tombstone_deleted_idx');");
+  indexQuery.execute();
+  indexQuery.readRow(indexCount);
+  ASSERT_EQ(3, indexCount);
+
+  // The change feed objects are created by one migration, the legacy reservation counts as changed
+  int changeSeq = -1;
+  int horizon = -1;
+  persistence::sqlite::SqliteStatement changeQuery(db, "SELECT change_seq FROM h_reservation WHERE id = 1;");
+  changeQuery.execute();
+  changeQuery.readRow(changeSeq);
+  ASSERT_EQ(0, changeSeq);
+  persistence::sqlite::SqliteStatement horizonQuery(db, "SELECT seq FROM h_change_feed_horizon;");
+  horizonQuery.execute();
+  horizonQuery.readRow(horizon);
+  ASSERT_EQ(0, horizon);
+  ASSERT_EQ(SQLITE_OK, sqlite3_exec(db, "DELETE FROM h_reservation WHERE id = 1;", nullptr, nullptr, nullptr));
+  int tombstoneCount = 0;
+  persistence::sqlite::SqliteStatement tombstoneQuery(
+      db, "SELECT COUNT(*) FROM h_reservation_tombstone WHERE reservation_id = 1 AND deleted_at > 0;");
+  tombstoneQuery.execute();
+  tombstoneQuery.readRow(tombstoneCount);
+  ASSERT_EQ(1, tombstoneCount);
+  sqlite3_close(db);
+}
+
+TEST(MemoryBackend, StoreLoadAndDelete)
+{
+  using namespace boost::gregorian;
+  persistence::DataSource dataSource(std::make_unique<persistence::memory::MemoryBackend>());
+  waitForAllOperations(dataSource);
+  ASSERT_TRUE(dataSource.hotels().hotels().empty());
+
+  auto hotel = std::make_unique<hotel::Hotel>("Hotel 1");
+  hotel->addRoomCategory(std::make_unique<hotel::RoomCategory>("cat", "Category"));
+  hotel->addRoom(std::make_unique<hotel::HotelRoom>("Room 1"), "cat");
+  auto storeHotel = dataSource.queueOperation(persistence::op::StoreNewHotel{std::move(hotel)});
+  waitForTask(dataSource, storeHotel);
+  ASSERT_EQ(1u, dataSource.hotels().hotels().size());
+  auto roomId = dataSource.hotels().hotels()[0]->rooms()[0]->id();
+  ASSERT_LT(0, roomId);
+
+  persistence::op::Operations operations;
+  for (int i = 0; i < 3; ++i)
+  {
+    auto begin = date(2017, 1, 1) + days(10 * i);
+    operations.push_back(persistence::op::StoreNewReservation{
+        std::make_unique<hotel::Reservation>("Reservation", roomId, date_period(begin, begin + days(5)))});
+  }
+  auto storeReservations = dataSource.queueOperations(std::move(operations));
+  waitForTask(dataSource, storeReservations);
+  ASSERT_EQ(3u, dataSource.planning().reservations().size());
+  auto deletedId = dataSource.planning().reservations()[0]->id();
+
+  auto deleteReservation = dataSource.queueOperation(persistence::op::DeleteReservation{deletedId});
+  waitForTask(dataSource, deleteReservation);
+  ASSERT_EQ(2u, dataSource.planning().reservations().size());
+  ASSERT_EQ(nullptr, dataSource.planning().getReservationById(deletedId));
+
+  // Loading a window only delivers the reservations intersecting it
+  while (!dataSource.planning().reservations().empty())
+    dataSource.planning().removeReservation(dataSource.planning().reservations()[0]);
+  auto load = dataSource.queueOperation(
+      persistence::op::LoadPlanningWindow{date_period(date(2017, 1, 12), date(2017, 1, 13))});
+  waitForTask(dataSource, load);
+  ASSERT_EQ(1u, dataSource.planning().reservations().size());
+  ASSERT_EQ(date(2017, 1, 11), dataSource.planning().reservations()[0]->dateRange().begin());
+}
+
+TEST(MemoryBackend, RejectsIdsInUse)
+{
+  using namespace boost::gregorian;
+  persistence::DataSource dataSource(std::make_unique<persistence::memory::MemoryBackend>());
+  waitForAllOperations(dataSource);
+
+  auto hotel = std::make_unique<hotel::Hotel>("Hotel 1");
+  hotel->addRoomCategory(std::make_unique<hotel::RoomCategory>("cat", "Category"));
+  hotel->addRoom(std::make_unique<hotel::HotelRoom>("Room 1"), "cat");
+  auto storeHotel = dataSource.queueOperation(persistence::op::StoreNewHotel{std::move(hotel)});
+  waitForTask(dataSource, storeHotel);
+  auto& storedHotel = *dataSource.hotels().hotels()[0];
+  auto roomId = storedHotel.rooms()[0]->id();
+
+  auto reservation = std::make_unique<hotel::Reservation>("Stored", roomId,
+                                                          date_period(date(2017, 1, 1), date(2017, 1, 5)));
+  auto storeReservation = dataSource.queueOperation(persistence::op::StoreNewReservation{std::move(reservation)});
+  waitForTask(dataSource, storeReservation);
+  ASSERT_EQ(1u, dataSource.planning().reservations().size());
+  auto& storedReservation = *dataSource.planning().reservations()[0];
+
+  // Objects carrying the id of a stored object are rejected, as by the primary keys of the sqlite backend
+  auto duplicateHotel = std::make_unique<hotel::Hotel>("Hotel 2");
+  duplicateHotel->setId(storedHotel.id());
+  auto duplicateReservation = std::make_unique<hotel::Reservation>(
+      "Duplicate", roomId, date_period(date(2017, 2, 1), date(2017, 2, 5)));
+  duplicateReservation->setId(storedReservation.id());
+  auto duplicateAtom = std::make_unique<hotel::Reservation>("Duplicate atom", roomId,
+                                                            date_period(date(2017, 3, 1), date(2017, 3, 5)));
+  duplicateAtom->atoms()[0].setId(storedReservation.atoms()[0].id());
+  persistence::op::Operations operations;
+  operations.push_back(persistence::op::StoreNewHotel{std::move(duplicateHotel)});
+  operations.push_back(persistence::op::StoreNewReservation{std::move(duplicateReservation)});
+  operations.push_back(persistence::op::StoreNewReservation{std::move(duplicateAtom)});
+  auto task = dataSource.queueOperations(std::move(operations));
+  waitForTask(dataSource, task);
+  ASSERT_EQ(3u, task.results().size());
+  for (auto& result : task.results())
+    ASSERT_NE(nullptr, boost::get<persistence::op::NoResult>(&result));
+
+  auto load = dataSource.queueOperation(persistence::op::LoadInitialData());
+  waitForTask(dataSource, load);
+  ASSERT_EQ(1u, dataSource.hotels().hotels().size());
+  ASSERT_EQ("Hotel 1", dataSource.hotels().hotels()[0]->name());
+  ASSERT_EQ(1u, dataSource.planning().reservations().size());
+  ASSERT_EQ("Stored", dataSource.planning().reservations()[0]->description());
+}
+
+namespace
+{
+  // Fails to commit the tasks while failCommits is set
+  class FailingMemoryBackend : public persistence::memory::MemoryBackend
+  {
+  public:
+    std::atomic<bool> failCommits{true};
+
+  protected:
+    bool commitTransaction() override { return !failCommits; }
+  };
+} // namespace
+
+TEST(IdAllocator, FailedLeaseIsRequestedAgain)
+{
+  auto backend = std::make_unique<FailingMemoryBackend>();
+  auto& failCommits = backend->failCommits;
+  persistence::DataSource dataSource(std::move(backend));
+  waitForAllOperations(dataSource);
+  failCommits = false;
+
+  // The lease requested at startup has failed, the next task answers the request for good
+  auto load = dataSource.queueOperation(persistence::op::LoadPlanningWindow{
+      boost::gregorian::date_period(boost::gregorian::date(2017, 1, 1), boost::gregorian::date(2017, 1, 2))});
+  waitForTask(dataSource, load);
+  load = dataSource.queueOperation(persistence::op::LoadPlanningWindow{
+      boost::gregorian::date_period(boost::gregorian::date(2017, 1, 1), boost::gregorian::date(2017, 1, 2))});
+  waitForTask(dataSource, load);
+  waitForAllOperations(dataSource);
+
+  persistence::op::Operations operations;
+  operations.push_back(persistence::op::StoreNewHotel{std::make_unique<hotel::Hotel>("Hotel 1")});
+  dataSource.assignIds(operations);
+  ASSERT_LT(0, boost::get<persistence::op::StoreNewHotel>(operations[0]).newHotel->id());
+}
+
+TEST(MpscQueue, MultipleProducers)
+{
+  const int numberOfProducers = 4;
+  const int valuesPerProducer = 10000;
+  persistence::MpscQueue<std::pair<int, int>> queue;
+
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < numberOfProducers; ++producer)
+    producers.emplace_back([&queue, producer]() {
+      for (int i = 0; i < valuesPerProducer; ++i)
+        queue.push(std::make_pair(producer, i));
+    });
+
+  // Values of each single producer arrive in the order in which they were pushed
+  std::vector<int> nextValue(numberOfProducers, 0);
+  int received = 0;
+  int outOfOrder = 0;
+  while (received < numberOfProducers * valuesPerProducer)
+  {
+    std::pair<int, int> value;
+    if (!queue.tryPop(value))
+      continue;
+    if (nextValue[value.first] != value.second)
+      ++outOfOrder;
+    nextValue[value.first] = value.second + 1;
+    ++received;
+  }
+
+  for (auto& producer : producers)
+    producer.join();
+  ASSERT_EQ(0, outOfOrder);
+  ASSERT_TRUE(queue.empty());
+}
+
+TEST(WakeupNotifier, CollapsesNotifications)
+{
+  persistence::WakeupNotifier notifier;
+  auto readable = [&]() {
+    pollfd descriptor{notifier.fileDescriptor(), POLLIN, 0};
+    return poll(&descriptor, 1, 0) == 1;
+  };
+
+  ASSERT_FALSE(readable());
+  notifier.notify();
+  notifier.notify();
+  ASSERT_TRUE(readable());
+  notifier.reset();
+  ASSERT_FALSE(readable());
+  notifier.notify();
+  ASSERT_TRUE(readable());
+}
+
+TEST(JsonSerializer, StreamingMatchesDocument)
+{
+  using namespace boost::gregorian;
+  hotel::HotelCollection hotels;
+  hotel::PlanningBoard planning;
+  for (int i = 0; i < 3; ++i)
+  {
+    auto hotel = std::make_unique<hotel::Hotel>("Hotel \"" + std::to_string(i) + "\"\n\t\\\x01");
+    hotel->setId(i + 1);
+    auto category = std::make_unique<hotel::RoomCategory>("cat", "Caf\xc3\xa9");
+    category->setId(10 + i);
+    hotel->addRoomCategory(std::move(category));
+    for (int j = 0; j < 4; ++j)
+    {
+      auto room = std::make_unique<hotel::HotelRoom>("Room " + std::to_string(j));
+      room->setId(100 * (i + 1) + j);
+      planning.addRoomId(room->id());
+      hotel->addRoom(std::move(room), "cat");
+    }
+    hotels.addHotel(std::move(hotel));
+  }
+  for (int i = 0; i < 20; ++i)
+  {
+    auto begin = date(1999, 12, 25) + days(10 * i);
+    auto reservation = std::make_unique<hotel::Reservation>("Reservation " + std::to_string(i), 100 + i % 4,
+                                                            date_period(begin, begin + days(3)));
+    reservation->addContinuation(200 + i % 4, begin + days(5));
+    reservation->setId(-i);
+    ASSERT_NE(nullptr, planning.addReservation(std::move(reservation)));
+  }
+
+  persistence::json::JsonSerializer serializer;
+  auto expectedHotels = serializer.serializeHotelCollection(hotels).dump();
+  auto expectedPlanning = serializer.serializePlanning(planning).dump();
+
+  // A tiny buffer makes the writer flush in the middle of values
+  std::ostringstream stream;
+  {
+    persistence::json::JsonWriter writer(stream, 7);
+    serializer.serializeHotelCollection(hotels, writer);
+  }
+  ASSERT_EQ(expectedHotels, stream.str());
+
+  auto descriptor = ::open("test.json", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  ASSERT_NE(-1, descriptor);
+  {
+    persistence::json::JsonWriter writer(descriptor);
+    serializer.serializePlanning(planning, writer);
+    ASSERT_TRUE(writer.good());
+  }
+  ::close(descriptor);
+  std::ifstream file("test.json");
+  std::string written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  ASSERT_EQ(expectedPlanning, written);
+  std::remove("test.json");
+}
+
+TEST(JsonImporter, ImportsSerializedData)
+{
+  using namespace boost::gregorian;
+  persistence::DataSource source(std::make_unique<persistence::memory::MemoryBackend>());
+  waitForAllOperations(source);
+  for (int i = 0; i < 5; ++i)
+  {
+    auto hotel = std::make_unique<hotel::Hotel>("Hotel \"" + std::to_string(i) + "\" \xe2\x82\xac");
+    hotel->addRoomCategory(std::make_unique<hotel::RoomCategory>("cat", "Category"));
+    hotel->addRoomCategory(std::make_unique<hotel::RoomCategory>("dbl", "Double\n"));
+    hotel->addRoom(std::make_unique<hotel::HotelRoom>("Room 1"), "cat");
+    hotel->addRoom(std::make_unique<hotel::HotelRoom>("Room 2"), "dbl");
+    source.queueOperation(persistence::op::StoreNewHotel{std::move(hotel)});
+  }
+  waitForAllOperations(source);
+  auto roomIds = source.hotels().allRoomIDs();
+  persistence::op::Operations operations;
+  for (int i = 0; i < 40; ++i)
+  {
+    auto begin = date(2017, 1, 1) + days(10 * (i / 10));
+    auto reservation = std::make_unique<hotel::Reservation>("Reservation " + std::to_string(i), roomIds[i % 10],
+                                                            date_period(begin, begin + days(3)));
+    reservation->addContinuation(roomIds[i % 10], begin + days(5));
+    operations.push_back(persistence::op::StoreNewReservation{std::move(reservation)});
+  }
+  source.queueOperations(std::move(operations));
+  waitForAllOperations(source);
+  ASSERT_EQ(40u, source.planning().reservations().size());
+
+  persistence::json::JsonSerializer serializer;
+  std::stringstream hotelsJson(serializer.serializeHotelCollection(source.hotels()).dump(2));
+  std::stringstream planningJson(serializer.serializePlanning(source.planning()).dump());
+
+  // The target already has a hotel, the ids of the document are taken and the imported objects get new ones. Small
+  // batches and a small buffer exercise the backpressure and the refilling of the buffer.
+  persistence::DataSource target(std::make_unique<persistence::memory::MemoryBackend>());
+  waitForAllOperations(target);
+  target.queueOperation(persistence::op::StoreNewHotel{std::make_unique<hotel::Hotel>("Existing")});
+  waitForAllOperations(target);
+  persistence::json::JsonImporter importer(target, 3, 2);
+  persistence::json::JsonReader hotelsReader(hotelsJson, 16);
+  ASSERT_TRUE(importer.importHotelCollection(hotelsReader)) << importer.errorMessage();
+  persistence::json::JsonReader planningReader(planningJson, 16);
+  ASSERT_TRUE(importer.importPlanning(planningReader)) << importer.errorMessage();
+  ASSERT_EQ(5u, importer.importedHotels());
+  ASSERT_EQ(40u, importer.importedReservations());
+  ASSERT_EQ(0u, target.pendingOperationsCount());
+
+  auto& sourceHotels = source.hotels().hotels();
+  auto& targetHotels = target.hotels().hotels();
+  ASSERT_EQ(sourceHotels.size() + 1, targetHotels.size());
+  std::map<int, int> targetRoomIds;
+  for (auto i = 0u; i < sourceHotels.size(); ++i)
+  {
+    ASSERT_EQ(*sourceHotels[i], *targetHotels[i + 1]);
+    for (auto j = 0u; j < sourceHotels[i]->rooms().size(); ++j)
+      targetRoomIds[sourceHotels[i]->rooms()[j]->id()] = targetHotels[i + 1]->rooms()[j]->id();
+  }
+  auto findReservation = [&target](const std::string& description) -> const hotel::Reservation* {
+    for (auto reservation : target.planning().reservations())
+      if (reservation->description() == description)
+        return reservation;
+    return nullptr;
+  };
+  for (auto reservation : source.planning().reservations())
+  {
+    auto imported = findReservation(reservation->description());
+    ASSERT_NE(nullptr, imported);
+    ASSERT_EQ(reservation->atoms().size(), imported->atoms().size());
+    for (auto i = 0u; i < reservation->atoms().size(); ++i)
+    {
+      ASSERT_EQ(targetRoomIds[reservation->atoms()[i].roomId()], imported->atoms()[i].roomId());
+      ASSERT_EQ(reservation->atoms()[i].dateRange(), imported->atoms()[i].dateRange());
+    }
+  }
+
+  // Objects preceding an error are stored, the error is located in the input
+  std::stringstream truncated(R"([{"atoms":[{"from":"2018-01-01","roomId":)" + std::to_string(roomIds[0]) +
+                              R"(,"to":"2018-01-03"}],"description":"A","id":1000}, {"atoms":[{"from":)");
+  persistence::json::JsonReader truncatedReader(truncated);
+  ASSERT_FALSE(importer.importPlanning(truncatedReader));
+  ASSERT_NE(std::string::npos, importer.errorMessage().find("end of input"));
+  auto truncatedReservation = findReservation("A");
+  ASSERT_NE(nullptr, truncatedReservation);
+  ASSERT_EQ(targetRoomIds[roomIds[0]], truncatedReservation->atoms()[0].roomId());
+
+  // Hotels with categories sharing a short code are rejected
+  std::stringstream duplicateCategories(
+      R"([{"categories":[{"id":1,"name":"A","shortCode":"cat"},{"id":2,"name":"B","shortCode":"cat"}],)"
+      R"("id":1,"name":"Duplicate","rooms":[]}])");
+  persistence::json::JsonReader duplicateReader(duplicateCategories);
+  ASSERT_FALSE(importer.importHotelCollection(duplicateReader));
+  ASSERT_NE(std::string::npos, importer.errorMessage().find("Category already registered"));
+  ASSERT_EQ(sourceHotels.size() + 1, targetHotels.size());
+
+  // Batches which fail to commit count all of their objects, and the reservations in their rooms are not stored under
+  // the room ids of the document
+  auto failingBackend = std::make_unique<FailingMemoryBackend>();
+  auto& failCommits = failingBackend->failCommits;
+  persistence::DataSource failingTarget(std::move(failingBackend));
+  waitForAllOperations(failingTarget);
+  persistence::json::JsonImporter failingImporter(failingTarget, 3, 2);
+  std::stringstream failingHotelsJson(serializer.serializeHotelCollection(source.hotels()).dump());
+  persistence::json::JsonReader failingHotelsReader(failingHotelsJson);
+  ASSERT_FALSE(failingImporter.importHotelCollection(failingHotelsReader));
+  ASSERT_EQ("5 objects could not be stored", failingImporter.errorMessage());
+  ASSERT_EQ(0u, failingImporter.importedHotels());
+  ASSERT_TRUE(failingTarget.hotels().hotels().empty());
+
+  failCommits = false;
+  std::stringstream failingPlanningJson(serializer.serializePlanning(source.planning()).dump());
+  persistence::json::JsonReader failingPlanningReader(failingPlanningJson);
+  ASSERT_FALSE(failingImporter.importPlanning(failingPlanningReader));
+  ASSERT_EQ("40 objects could not be stored", failingImporter.errorMessage());
+  ASSERT_EQ(0u, failingImporter.importedReservations());
+  waitForAllOperations(failingTarget);
+  ASSERT_TRUE(failingTarget.planning().reservations().empty());
+}
+
+TEST(JsonReader, TokensAndErrors)
+{
+  typedef persistence::json::JsonReader::Token Token;
+  std::stringstream input(R"( {"a" : [1, -2.5e3, true, false, null, "\u00e9\ud83d\ude00\/"], "b": {}} )");
+  persistence::json::JsonReader reader(input, 16);
+  std::vector<Token> expected = {Token::BeginObject, Token::Key,   Token::BeginArray, Token::Number,    Token::Number,
+                                 Token::True,        Token::False, Token::Null,       Token::String,    Token::EndArray,
+                                 Token::Key,         Token::BeginObject,             Token::EndObject, Token::EndObject,
+                                 Token::EndOfInput};
+  for (auto token : expected)
+  {
+    ASSERT_EQ(token, reader.next()) << reader.errorMessage();
+    if (token == Token::String)
+    {
+      ASSERT_EQ("\xc3\xa9\xf0\x9f\x98\x80/", reader.text());
+    }
+  }
+
+  for (auto text : {"[1,]", "{\"a\" 1}", "[01]", "\"abc", "[1] 2", "{\"a\":tru}"})
+  {
+    std::stringstream malformed(text);
+    persistence::json::JsonReader malformedReader(malformed);
+    auto token = Token::BeginArray;
+    while (token != Token::Error && token != Token::EndOfInput)
+      token = malformedReader.next();
+    ASSERT_EQ(Token::Error, token) << text;
+    ASSERT_FALSE(malformedReader.errorMessage().empty());
+  }
+}
+
+TEST(PlanningExporter, ChunksAreWrittenInOrder)
+{
+  using namespace boost::gregorian;
+  hotel::PlanningBoard planning;
+  for (int room = 1; room <= 4; ++room)
+    planning.addRoomId(room);
+  for (int i = 0; i < 50; ++i)
+  {
+    auto begin = date(2017, 1, 1) + days(3 * (i / 4));
+    auto reservation = std::make_unique<hotel::Reservation>(i == 7 ? "Smith, \"John\"" : "Reservation",
+                                                            1 + i % 4, date_period(begin, begin + days(2)));
+    reservation->setId(i + 1);
+    ASSERT_NE(nullptr, planning.addReservation(std::move(reservation)));
+  }
+
+  // Few slots for many small chunks make the chunks wait for each other
+  persistence::ThreadPoolExecutor executor(4);
+  persistence::exporter::PlanningExporter exporter(executor, 3, 2);
+  std::ostringstream json;
+  ASSERT_TRUE(exporter.exportPlanning(planning, persistence::exporter::JsonReservationFormat(), json));
+  ASSERT_EQ(persistence::json::JsonSerializer().serializePlanning(planning).dump(), json.str());
+
+  std::ostringstream csv;
+  ASSERT_TRUE(exporter.exportPlanning(planning, persistence::exporter::CsvReservationFormat(), csv));
+  auto text = csv.str();
+  ASSERT_EQ(51, std::count(text.begin(), text.end(), '\n'));
+  ASSERT_NE(std::string::npos, text.find("\r\n8,\"Smith, \"\"John\"\"\",0,"));
+
+  hotel::PlanningBoard empty;
+  std::ostringstream emptyJson;
+  ASSERT_TRUE(exporter.exportPlanning(empty, persistence::exporter::JsonReservationFormat(), emptyJson));
+  ASSERT_EQ("[]", emptyJson.str());
+}
+
+TEST(CsvImporter, ImportsExportedTable)
+{
+  using namespace boost::gregorian;
+  hotel::PlanningBoard planning;
+  for (int room = 1; room <= 4; ++room)
+    planning.addRoomId(room);
+  for (int i = 0; i < 40; ++i)
+  {
+    auto begin = date(2017, 1, 1) + days(4 * (i / 4));
+    auto reservation = std::make_unique<hotel::Reservation>(i == 7 ? "Smith,\r\n\"John\"" : "Reservation",
+                                                            1 + i % 4, date_period(begin, begin + days(2)));
+    reservation->addContinuation(1 + (i + 1) % 4, begin + days(3));
+    reservation->setId(i + 1);
+    reservation->setStatus(hotel::Reservation::Confirmed);
+    reservation->setNumberOfAdults(2);
+    reservation->setNumberOfChildren(i % 3);
+    ASSERT_NE(nullptr, planning.addReservation(std::move(reservation)));
+  }
+  std::string table;
+  persistence::exporter::CsvReservationFormat format;
+  format.writePrefix(table);
+  for (auto reservation : planning.reservations())
+    format.writeReservation(*reservation, table);
+
+  // Small chunks split the rows of reservations and the quoted line breaks
+  persistence::ThreadPoolExecutor executor(4);
+  persistence::importer::CsvImporter importer(executor, 50);
+  ASSERT_TRUE(importer.parse(table.data(), table.size()));
+  ASSERT_EQ(40u, importer.reservations().size());
+  for (auto& reservation : importer.reservations())
+    ASSERT_EQ(*planning.getReservationById(reservation->id()), *reservation);
+
+  hotel::PlanningBoard emptyPlanning;
+  for (int room = 1; room <= 4; ++room)
+    emptyPlanning.addRoomId(room);
+  ASSERT_TRUE(importer.validate(emptyPlanning));
+  ASSERT_FALSE(importer.validate(planning));
+  ASSERT_EQ("Reservations 1 and 1 overlap in room 1", importer.errorMessage());
+
+  // Conflicts with the planning and between the imported reservations
+  hotel::PlanningBoard otherPlanning;
+  for (int room = 1; room <= 4; ++room)
+    otherPlanning.addRoomId(room);
+  auto blocking = std::make_unique<hotel::Reservation>("Blocking", 3, date_period(date(2017, 1, 30), date(2017, 2, 2)));
+  blocking->setId(100);
+  otherPlanning.addReservation(std::move(blocking));
+  ASSERT_FALSE(importer.validate(otherPlanning));
+  ASSERT_NE(std::string::npos, importer.errorMessage().find("and 100 overlap in room 3")) << importer.errorMessage();
+
+  std::string overlapping = "reservation_id,description,status,adults,children,room_id,from,to\n"
+                            "1,A,2,1,0,1,2017-01-01,2017-01-05\n"
+                            "2,B,2,1,0,1,2017-01-04,2017-01-06\n";
+  ASSERT_TRUE(importer.parse(overlapping.data(), overlapping.size()));
+  ASSERT_FALSE(importer.validate(emptyPlanning));
+  ASSERT_EQ("Reservations 1 and 2 overlap in room 1", importer.errorMessage());
+
+  // Errors name the row
+  std::string malformed = "reservation_id,description,status,adults,children,room_id,from,to\r\n"
+                          "1,A,2,1,0,1,2017-01-01,2017-01-05\r\n"
+                          "2,B,2,1,0,1,2017-02-30,2017-03-06\r\n";
+  ASSERT_FALSE(importer.parse(malformed.data(), malformed.size()));
+  ASSERT_EQ("Row 3: Invalid date \"2017-02-30\"", importer.errorMessage());
+  ASSERT_TRUE(importer.reservations().empty());
+}
+
+TEST(Columnar, WriteAndScan)
+{
+  using namespace boost::gregorian;
+  using persistence::columnar::Column;
+  hotel::PlanningBoard planning;
+  for (int room = 1; room <= 4; ++room)
+    planning.addRoomId(room);
+  for (int i = 0; i < 100; ++i)
+  {
+    auto begin = date(2017, 1, 1) + days(3 * (i / 4));
+    auto reservation = std::make_unique<hotel::Reservation>(i % 3 == 0 ? "Smith" : "Miller", 1 + i % 4,
+                                                            date_period(begin, begin + days(2)));
+    reservation->setId(100 - i);
+    reservation->setNumberOfAdults(1 + i % 2);
+    reservation->setNumberOfChildren(i % 3);
+    ASSERT_NE(nullptr, planning.addReservation(std::move(reservation)));
+  }
+
+  for (auto compress : {false, true})
+  {
+    persistence::columnar::WriteOptions options;
+    options.rowsPerChunk = 16;
+    options.compress = compress;
+    ASSERT_TRUE(persistence::columnar::writeColumnar("test.col", planning, options));
+    persistence::columnar::ColumnarReader reader("test.col");
+    ASSERT_TRUE(reader.valid());
+    ASSERT_EQ(100u, reader.reservationCount());
+    ASSERT_EQ(100u, reader.atomCount());
+
+    // Only requested columns are handed out
+    std::vector<int> ids;
+    reader.scanReservations({Column::ReservationId, Column::ReservationDescription}, [&](auto& batch) {
+      ASSERT_EQ(nullptr, batch.column(Column::ReservationAdults));
+      for (size_t i = 0; i < batch.rowCount; ++i)
+      {
+        auto id = batch.column(Column::ReservationId)[i];
+        ids.push_back(id);
+        auto expected = planning.getReservationById(id)->description();
+        ASSERT_EQ(expected, reader.description(batch.column(Column::ReservationDescription)[i]));
+      }
+    });
+    ASSERT_EQ(100u, ids.size());
+    ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+
+    // A window of one week only touches the chunks of the atoms around it
+    date_period window(date(2017, 2, 1), date(2017, 2, 8));
+    size_t atomsInWindow = 0;
+    auto checkAtoms = [&](const persistence::columnar::ColumnarReader::Batch& batch) {
+      for (size_t i = 0; i < batch.rowCount; ++i)
+      {
+        auto reservation = planning.getReservationById(batch.column(Column::AtomReservationId)[i]);
+        auto& atom = reservation->atoms().front();
+        ASSERT_EQ(atom.roomId(), batch.column(Column::AtomRoomId)[i]);
+        date_period period(date(batch.column(Column::AtomDateFrom)[i]), date(batch.column(Column::AtomDateTo)[i]));
+        ASSERT_EQ(atom.dateRange(), period);
+        if (period.intersects(window))
+          ++atomsInWindow;
+      }
+    };
+    auto chunks = reader.scanAtoms(
+        {Column::AtomReservationId, Column::AtomRoomId, Column::AtomDateFrom, Column::AtomDateTo}, window, checkAtoms);
+    ASSERT_EQ(2u, chunks);
+    ASSERT_EQ(12u, atomsInWindow);
+    ASSERT_EQ(7u, reader.scanAtoms({Column::AtomRoomId}, boost::none, [](auto&) {}));
+  }
+
+  // A damaged chunk is skipped, the scan goes on with the following ones. The first chunk of the compressed file
+  // follows the header.
+  {
+    std::fstream file("test.col", std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(16);
+    file.put('\x80');
+  }
+  {
+    persistence::columnar::ColumnarReader reader("test.col");
+    ASSERT_TRUE(reader.valid());
+    size_t rows = 0;
+    reader.scanReservations({Column::ReservationId}, [&](auto& batch) { rows += batch.rowCount; });
+    ASSERT_EQ(100u - 16u, rows);
+  }
+
+  // Damaged files are rejected
+  {
+    std::fstream file("test.col", std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(-1, std::ios::end);
+    file.put('X');
+  }
+  ASSERT_FALSE(persistence::columnar::ColumnarReader("test.col").valid());
+  std::remove("test.col");
+}
@@ -0,0 +1,132 @@
+#include "gtest/gtest.h"
+
+#include "cli/testdata.h"
+
+#include "persistence/executor.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  cli::TestDataOptions smallOptions()
+  {
+    cli::TestDataOptions options;
+    options.seed = 42;
+    options.hotels = 5;
+    options.roomsPerHotel = 30;
+    options.horizonDays = 200;
+    return options;
+  }
+} // namespace
+
+TEST(TestData, IndependentOfTheNumberOfThreads)
+{
+  persistence::ThreadPoolExecutor singleThread(1);
+  persistence::ThreadPoolExecutor threadPool(4);
+  auto expected = cli::createTestData(smallOptions(), singleThread);
+  auto data = cli::createTestData(smallOptions(), threadPool);
+
+  ASSERT_EQ(expected.hotels.size(), data.hotels.size());
+  for (size_t i = 0; i < data.hotels.size(); ++i)
+  {
+    ASSERT_EQ(expected.hotels[i]->id(), data.hotels[i]->id());
+    ASSERT_EQ(*expected.hotels[i], *data.hotels[i]);
+    for (size_t j = 0; j < data.hotels[i]->rooms().size(); ++j)
+      ASSERT_EQ(expected.hotels[i]->rooms()[j]->id(), data.hotels[i]->rooms()[j]->id());
+  }
+
+  ASSERT_FALSE(data.reservations.empty());
+  ASSERT_EQ(expected.reservations.size(), data.reservations.size());
+  for (size_t i = 0; i < data.reservations.size(); ++i)
+  {
+    ASSERT_EQ(expected.reservations[i]->id(), data.reservations[i]->id());
+    // Compares the rooms and periods of the atoms as well
+    ASSERT_EQ(*expected.reservations[i], *data.reservations[i]);
+  }
+
+  // Another seed results in other data
+  auto options = smallOptions();
+  options.seed = 43;
+  auto other = cli::createTestData(options, threadPool);
+  ASSERT_FALSE(other.reservations.size() == data.reservations.size() &&
+               std::equal(other.reservations.begin(), other.reservations.end(), data.reservations.begin(),
+                          [](auto& a, auto& b) { return *a == *b; }));
+}
+
+TEST(TestData, ReservationsDoNotOverlap)
+{
+  persistence::ThreadPoolExecutor threadPool(4);
+  auto options = smallOptions();
+  options.occupancy = 0.95;
+  auto data = cli::createTestData(options, threadPool);
+
+  std::set<int> roomIds;
+  for (auto& hotel : data.hotels)
+    for (auto& room : hotel->rooms())
+      roomIds.insert(room->id());
+
+  std::set<int> reservationIds;
+  std::map<int, std::vector<boost::gregorian::date_period>> periodsByRoom;
+  auto horizonEnd = options.firstDay + boost::gregorian::days(options.horizonDays);
+  boost::gregorian::date_period horizon(options.firstDay, horizonEnd);
+  for (auto& reservation : data.reservations)
+  {
+    ASSERT_TRUE(reservationIds.insert(reservation->id()).second);
+    for (auto& atom : reservation->atoms())
+    {
+      ASSERT_EQ(1u, roomIds.count(atom.roomId()));
+      ASSERT_TRUE(horizon.contains(atom.dateRange()));
+      periodsByRoom[atom.roomId()].push_back(atom.dateRange());
+    }
+  }
+
+  for (auto& room : periodsByRoom)
+  {
+    auto& periods = room.second;
+    std::sort(periods.begin(), periods.end(), [](auto& a, auto& b) { return a.begin() < b.begin(); });
+    for (size_t i = 1; i < periods.size(); ++i)
+      ASSERT_LE(periods[i - 1].end(), periods[i].begin()) << "Room " << room.first;
+  }
+}
+
+TEST(TestData, ResetIds)
+{
+  persistence::ThreadPoolExecutor threadPool(4);
+  auto data = cli::createTestData(smallOptions(), threadPool);
+
+  auto generatedRoomIds = cli::resetHotelIds(data.hotels);
+  ASSERT_EQ(150u, generatedRoomIds.size());
+  for (auto& hotel : data.hotels)
+  {
+    ASSERT_EQ(0, hotel->id());
+    for (auto& category : hotel->categories())
+      ASSERT_EQ(0, category->id());
+    for (auto& room : hotel->rooms())
+      ASSERT_EQ(0, room->id());
+  }
+
+  // The reservations are moved to the rooms at the same positions
+  std::vector<int> storedRoomIds;
+  for (auto id : generatedRoomIds)
+    storedRoomIds.push_back(id + 1000);
+  std::vector<int> expectedRoomIds;
+  for (auto& reservation : data.reservations)
+    for (auto& atom : reservation->atoms())
+      expectedRoomIds.push_back(atom.roomId() + 1000);
+  ASSERT_TRUE(cli::resetReservationIds(data.reservations, generatedRoomIds, storedRoomIds));
+  std::vector<int> roomIds;
+  for (auto& reservation : data.reservations)
+  {
+    ASSERT_EQ(0, reservation->id());
+    for (auto& atom : reservation->atoms())
+      roomIds.push_back(atom.roomId());
+  }
+  ASSERT_EQ(expectedRoomIds, roomIds);
+
+  // Rooms which have not been generated are reported
+  ASSERT_FALSE(cli::resetReservationIds(data.reservations, generatedRoomIds, storedRoomIds));
+}
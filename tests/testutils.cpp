@@ -0,0 +1,29 @@
+#include "tests/testutils.h"
+
+#include <condition_variable>
+#include <mutex>
+
+void waitForAllOperations(persistence::DataSource& ds)
+{
+  std::mutex mutex;
+  std::unique_lock<std::mutex> lock(mutex);
+  std::condition_variable condition;
+
+  ds.taskCompletedSignal().connect([&](int) { condition.notify_one(); });
+
+  while(ds.pendingOperationsCount() != 0)
+  {
+    ds.processIntegrationQueue();
+    condition.wait_for(lock, std::chrono::milliseconds(10));
+  }
+
+  ds.taskCompletedSignal().disconnect_all_slots();
+}
+
+void waitForTask(persistence::DataSource& ds, persistence::op::Task<persistence::op::OperationResults>& task)
+{
+  // Waits for one task to complete and to be integrated
+  task.waitForCompletion();
+  ds.processIntegrationQueue();
+}
+
@@ -0,0 +1,11 @@
+#ifndef TESTS_TESTUTILS_H
+#define TESTS_TESTUTILS_H
+
+#include "persistence/datasource.h"
+
+//! Waits until all queued operations have been completed and their results have been integrated
+void waitForAllOperations(persistence::DataSource& ds);
+//! Waits for one task to complete and integrates its results
+void waitForTask(persistence::DataSource& ds, persistence::op::Task<persistence::op::OperationResults>& task);
+
+#endif // TESTS_TESTUTILS_H